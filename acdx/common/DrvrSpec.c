@@ -116,6 +116,11 @@ int cnt, dir;
       dir = READ_FLAG;
       break;
 
+   case AcdxDrvrZBT_WRITE:              /* Write a block to the ZBT SRAM */
+      cnt = sizeof(AcdxDrvrRawIoBlock);
+      dir = WRIT_FLAG | READ_FLAG;
+      break;
+
    default:
       cnt = -EFAULT;
       dir = 0;
@@ -144,7 +144,8 @@ char *ioctl_names[AcdxDrvrLAST_IOCTL] = {
    "GET_STATUS_CONTROL",
    "OPEN_USER_FPGA",
    "WRITE_FPGA_CHUNK",
-   "CLOSE_USER_FPGA" };
+   "CLOSE_USER_FPGA",
+   "ZBT_WRITE" };
 
 /* =========================================================================================== */
 
@@ -248,6 +249,93 @@ char                      *iod;
    return rval;
 }
 
+/*=========================================================== */
+/* Write a block of longs to the ZBT SRAM. The SRAM address   */
+/* register is stepped by the driver, so the whole block goes */
+/* to consecutive addresses from riob->Offset in one call.    */
+/* On Linux the user array is copied in page sized chunks     */
+/* before they go to the card.                                */
+/*=========================================================== */
+
+#ifdef EMULATE_LYNXOS_ON_LINUX
+#define ZBT_CHUNK (PAGE_SIZE / sizeof(unsigned long))
+#endif
+
+static int ZbtWrite(AcdxDrvrModuleContext *mcon,
+		    AcdxDrvrRawIoBlock    *riob,
+		    unsigned long         debg) {
+
+volatile AcdxDrvrMemoryMap *mmap; /* Module Memory map */
+int                         rval; /* Return value */
+unsigned long               ps;   /* Processor status word */
+int                         i, j, n;
+unsigned long              *uary, *src;
+#ifdef EMULATE_LYNXOS_ON_LINUX
+unsigned long              *kbuf; /* Bounce buffer */
+#endif
+
+   ps = 0;
+
+   mmap = (AcdxDrvrMemoryMap *) mcon->Map;
+   uary = riob->UserArray;
+   rval = OK;
+
+   if ((riob->Offset >= AcdxDrvrTOTAL_POINTS/2)
+   ||  (riob->Size > AcdxDrvrTOTAL_POINTS/2 - riob->Offset)) {
+      pseterr(EINVAL);
+      return SYSERR;
+   }
+
+#ifdef EMULATE_LYNXOS_ON_LINUX
+   if ((kbuf = kmalloc(PAGE_SIZE,GFP_KERNEL)) == NULL) {
+      pseterr(ENOMEM);
+      return SYSERR;
+   }
+#endif
+
+   i = 0;
+   if (!recoset()) {         /* Catch bus errors */
+
+      for (i=0; i<riob->Size; i+=n) {
+	 n = riob->Size - i;
+#ifdef EMULATE_LYNXOS_ON_LINUX
+	 if (n > ZBT_CHUNK) n = ZBT_CHUNK;
+	 if (copy_from_user(kbuf,&uary[i],n*sizeof(unsigned long))) {
+	    pseterr(EFAULT);
+	    rval = SYSERR;
+	    break;
+	 }
+	 src = kbuf;
+#else
+	 src = &uary[i];
+#endif
+	 for (j=0; j<n; j++) {
+	    mmap->ZBTSRAMAddr = riob->Offset+i+j;
+	    EIEIO;
+	    mmap->ZBTSRAMData = src[j];
+	    EIEIO;
+	 }
+      }
+      SYNC;
+      if (debg >= 2) cprintf("ZbtWrite: %d longs at:0x%x\n",(int) i,(int) riob->Offset);
+   } else {
+      disable(ps);
+
+      kkprintf("AcdxDrvr: BUS-ERROR: Module:%d ZBT SRAM Addr:%x\n",
+	       (int) mcon->ModuleIndex+1,(int) (riob->Offset+i));
+
+      pseterr(ENXIO);        /* No such device or address */
+      rval = SYSERR;
+      enable(ps);
+   }
+   noreco();                 /* Remove local bus trap */
+#ifdef EMULATE_LYNXOS_ON_LINUX
+   kfree(kbuf);
+#endif
+   riob->Size = i;
+   return rval;
+}
+
 /* ========================================================== */
 /* The ISR                                                    */
 /* ========================================================== */
@@ -670,6 +758,19 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 	 }
       break;
 
+      case AcdxDrvrZBT_WRITE:              /* Write a block to the ZBT SRAM */
+	 if (rcnt >= sizeof(AcdxDrvrRawIoBlock)) {
+	    riob = (AcdxDrvrRawIoBlock *) arg;
+	    if (riob->UserArray != NULL) {
+	       if (TestLock(mcon,ccon) == 0) {
+		  pseterr(ENOLCK);
+		  return SYSERR;
+	       }
+	       return ZbtWrite(mcon,riob,ccon->DebugOn);
+	    }
+	 }
+      break;
+
       case AcdxDrvrSET_FUNCTION_PARAMS:    /* Set sin-wave function parameters */
 	 if (rcnt >= sizeof(AcdxDrvrFunctionParams)) {
 	    funp = (AcdxDrvrFunctionParams *) arg;
@@ -126,6 +126,8 @@ typedef enum {
    AcdxDrvrWRITE_FPGA_CHUNK,       /* Write a chunk of FPGA bitstream */
    AcdxDrvrCLOSE_USER_FPGA,        /* Close FPGA after write */
 
+   AcdxDrvrZBT_WRITE,              /* Write a block to the ZBT SRAM, Offset is the SRAM address */
+
    AcdxDrvrLAST_IOCTL
 
  } AcdxDrvrControlFunction;
@@ -34,6 +34,7 @@
 double round(double x);
 
 static short    func[TOTAL_POINTS];
+static unsigned long zbt[TOTAL_POINTS/2];
 static unsigned long srise, sftop, sfall;
 
 static unsigned long freq = 3000;
@@ -118,28 +119,52 @@ AcdxDrvrRawIoBlock iob;
 }
 
 /* ================================================ */
+/* Each point of the sine is got from the previous  */
+/* one by a rotation, rather than by calling sin(). */
+/* The exact value is taken again every RESYNC      */
+/* points so that rounding errors don't build up.   */
+/* Points past the end of the envelope stay zero.   */
+
+#define RESYNC 4096
 
 static int SinWave() {
 
-double omega, tee;
+double omega, c, s, dc, ds, t;
 
-unsigned long i;
+unsigned long i, j, end, last;
 
    bzero((void *) func, sizeof(short)*TOTAL_POINTS);
 
    spts = GetSampClock();
 
-   omega = 2.0 * PI * (double) freq;
-   for (i=0; i<TOTAL_POINTS; i++) {
-      tee = (double) i / spts;
-      func[i] = FuncToShort(sin(omega * tee) * GetAmplitude(i));
+   omega = 2.0 * PI * (double) freq / (double) spts; /* Radians per point */
+   dc = cos(omega);
+   ds = sin(omega);
+
+   last = 0;
+   if (rise > 0) last = rise + ftop + fall + 1;
+   if (last > TOTAL_POINTS) last = TOTAL_POINTS;
+
+   for (i=0; i<last; i+=RESYNC) {
+      s = sin(omega * i);
+      c = cos(omega * i);
+      end = i + RESYNC;
+      if (end > last) end = last;
+      for (j=i; j<end; j++) {
+	 func[j] = FuncToShort(s * GetAmplitude(j));
+	 t = s * dc + c * ds;
+	 c = c * dc - s * ds;
+	 s = t;
+      }
    }
    return 1;
 }
 
 /* ================================================ */
+/* Old drivers can only write the ZBT SRAM one long */
+/* at a time, address then data.                    */
 
-static int PutFunc() {
+static int PutFuncRaw() {
 
 AcdxMap *map = NULL;
 AcdxDrvrRawIoBlock iob;
@@ -161,14 +186,39 @@ unsigned long i;
       iob.Size = 1;
       iob.UserArray = array;
       iob.Offset = zbtdata;
-      array[0] = ( (0x0000FFFF & (func[i  ]      ))
-	       |   (0xFFFF0000 & (func[i+1] << 16)) );
+      array[0] = zbt[i>>1];
       if (ioctl(acdx,AcdxDrvrRAW_WRITE,&iob) < 0) return 0;
    }
 
    return 1;
 }
 
+/* ================================================ */
+/* Pack the function two points per long and write  */
+/* the whole ZBT SRAM image with a single call.     */
+
+static int PutFunc() {
+
+AcdxDrvrRawIoBlock iob;
+unsigned long i;
+
+   for (i=0; i<TOTAL_POINTS; i+=2) {
+      zbt[i>>1] = ( (0x0000FFFF & (func[i  ]      ))
+		|   (0xFFFF0000 & (func[i+1] << 16)) );
+   }
+
+   iob.Size = TOTAL_POINTS/2;
+   iob.UserArray = zbt;
+   iob.Offset = 0;
+   if (ioctl(acdx,AcdxDrvrZBT_WRITE,&iob) >= 0) return 1;
+
+   /* Drivers without ZBT_WRITE: ENOTTY from the Linux emulation, */
+   /* EINVAL from the end of the native LynxOs ioctl switch.      */
+
+   if ((errno == ENOTTY) || (errno == EINVAL)) return PutFuncRaw();
+   return 0;
+}
+
 /* ================================================ */
 
 AcdxLibCompletion AcdxLibInit() {
@@ -323,3 +373,22 @@ unsigned long stat;
    }
    return AcdxLibFAIL;
 }
+
+/* ================================================ */
+/* Load an arbitrary function of up to TOTAL_POINTS */
+/* points, the rest of the function is set to zero. */
+
+AcdxLibCompletion AcdxLoadTable(short *table,          /* DAC values */
+				unsigned int points) { /* Number of values */
+
+   if (points > TOTAL_POINTS) return AcdxLibFAIL;
+
+   if (AcdxLibInit() == AcdxLibOK) {
+
+      bzero((void *) func, sizeof(short)*TOTAL_POINTS);
+      memcpy((void *) func, (void *) table, sizeof(short)*points);
+
+      if (PutFunc()) return AcdxLibOK;
+   }
+   return AcdxLibFAIL;
+}
@@ -12,6 +12,9 @@ typedef enum {
 AcdxLibCompletion AcdxLoadFunction(unsigned int freq,         /* Frequency in Hertz */
 				   unsigned int ampl);        /* Amplitude in Milli-Volts */
 
+AcdxLibCompletion AcdxLoadTable(short *table,                 /* DAC values */
+				unsigned int points);         /* Number of values */
+
 AcdxLibCompletion AcdxArm();      /* Arm */
 
 AcdxLibCompletion AcdxUnArm();    /* Set Arm bit to 0 */
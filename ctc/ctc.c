@@ -452,7 +452,13 @@ static char *ioctl_names[vmeioLAST - vmeioFIRST] = {
 	"RAW_WRITE",
 	"RAW_READ_DMA",
 	"RAW_WRITE_DMA",
-	"SET_DEVICE"
+	"SET_DEVICE",
+	"READ_DMA",
+	"WRITE_DMA",
+	"GET_NREGS",
+	"GET_MAPPING",
+	"GET_REGINFO",
+	"RAW_BATCH"
 };
 
 static void debug_ioctl(int ionr, int iodr, int iosz, void *arg, long num,
@@ -678,6 +684,100 @@ static int raw_write(struct vmeio_device *dev, struct vmeio_riob *riob)
 	return 0;
 }
 
+static int batch_check(struct vmeio_device *dev, struct vmeio_op *op)
+{
+	struct vme_mapping *mapx;
+	int dwidth;
+
+	if (op->mapnum < 1 || op->mapnum > MAX_MAPS)
+		return -EINVAL;
+	mapx = &dev->maps[op->mapnum-1];
+	if (mapx->kernel_va == NULL)
+		return -ENODEV;
+	dwidth = op->data_width ? op->data_width : mapx->data_width;
+	if (dwidth != VME_D32 && dwidth != VME_D16 && dwidth != VME_D8)
+		return -EINVAL;
+	if (op->op < VMEIO_OP_READ || op->op > VMEIO_OP_RMW)
+		return -EINVAL;
+	if (op->offset < 0 || op->offset % (dwidth/8) ||
+	    op->offset + dwidth/8 > mapx->sizel)
+		return -EINVAL;
+	op->data_width = dwidth;
+	return 0;
+}
+
+static unsigned int batch_read(char *map, int offset, int dwidth)
+{
+	if (dwidth == VME_D32)
+		return ioread32be(&map[offset]);
+	else if (dwidth == VME_D16)
+		return ioread16be(&map[offset]);
+	else
+		return ioread8(&map[offset]);
+}
+
+static void batch_write(char *map, int offset, int dwidth, unsigned int value)
+{
+	if (dwidth == VME_D32)
+		iowrite32be(value, &map[offset]);
+	else if (dwidth == VME_D16)
+		iowrite16be(value, &map[offset]);
+	else
+		iowrite8(value, &map[offset]);
+}
+
+static int raw_batch(struct vmeio_device *dev, struct vmeio_batch *batch)
+{
+	struct vmeio_op *ops, *op;
+	char *map;
+	int bsize = batch->nops * sizeof(*ops);
+	int i, cc;
+
+	if (batch->nops <= 0 || batch->nops > vmeioMAX_OPS)
+		return -EINVAL;
+	ops = kmalloc(bsize, GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+	if (copy_from_user(ops, batch->ops, bsize)) {
+		kfree(ops);
+		return -EACCES;
+	}
+
+	/* nothing is executed unless every operation is valid */
+	for (i = 0; i < batch->nops; i++) {
+		if ((cc = batch_check(dev, &ops[i])) < 0) {
+			kfree(ops);
+			return cc;
+		}
+	}
+
+	if (dev->debug > 1)
+		printk("RAW:BATCH:ops:%d\n", batch->nops);
+
+	for (i = 0, op = ops; i < batch->nops; i++, op++) {
+		map = dev->maps[op->mapnum-1].kernel_va;
+		switch (op->op) {
+		case VMEIO_OP_READ:
+			op->value = batch_read(map, op->offset, op->data_width);
+			break;
+		case VMEIO_OP_WRITE:
+			batch_write(map, op->offset, op->data_width, op->value);
+			break;
+		case VMEIO_OP_RMW:
+			op->value = (batch_read(map, op->offset, op->data_width) & ~op->mask) |
+				(op->value & op->mask);
+			batch_write(map, op->offset, op->data_width, op->value);
+			break;
+		}
+	}
+
+	cc = copy_to_user(batch->ops, ops, bsize);
+	kfree(ops);
+	if (cc)
+		return -EACCES;
+	return 0;
+}
+
 #ifdef ENCORE_DAL
 static int *nregs = &ctc_nregs;
 static struct encore_reginfo *reginfo = ctc_registers;
@@ -787,6 +887,12 @@ int vmeio_ioctl(struct inode *inode, struct file *filp, unsigned int cmd,
 			goto out;
 		break;
 
+	case VMEIO_RAW_BATCH:
+		cc = raw_batch(dev, arb);
+		if (cc < 0)
+			goto out;
+		break;
+
 	case VMEIO_GET_MAPPING:
 		cc = get_mapping(dev, arb);
 		if (cc < 0)
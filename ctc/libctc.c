@@ -32,6 +32,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "vmeio.h"
 #include "ctc_regs.h"
 #include "libctc.h"
@@ -78,6 +80,147 @@ static int ctc_raw(int fd, int mapping,
 		return ioctl(fd, VMEIO_RAW_READ, riobp);
 }
 
+/*
+ * Register transactions: reads, writes and read-modify-writes of the
+ * 32-bit registers of mapping 1, recorded in order and submitted with a
+ * single VMEIO_RAW_BATCH ioctl. Drivers without it get the operations
+ * one by one through ctc_raw.
+ */
+
+struct ctc_batch {
+	int		nops;
+	int		size;
+	struct vmeio_op	*ops;
+	unsigned int	**dst;	/* where read values go, per operation */
+};
+
+struct ctc_batch *ctc_batch_new(void)
+{
+	struct ctc_batch *b;
+
+	b = calloc(1, sizeof(*b));
+	if (b == NULL)
+		errno = ENOMEM;
+	return b;
+}
+
+void ctc_batch_free(struct ctc_batch *b)
+{
+	if (b == NULL)
+		return;
+	free(b->ops);
+	free(b->dst);
+	free(b);
+}
+
+void ctc_batch_reset(struct ctc_batch *b)
+{
+	b->nops = 0;
+}
+
+static int ctc_batch_add(struct ctc_batch *b, int op, unsigned offset,
+	unsigned int value, unsigned int mask, unsigned int *dst)
+{
+	struct vmeio_op *vop;
+
+	if (b->nops == b->size) {
+		int size = b->size ? 2 * b->size : 32;
+		struct vmeio_op *ops;
+		unsigned int **dsts;
+
+		if (size > vmeioMAX_OPS) {
+			errno = E2BIG;
+			return -1;
+		}
+		ops = realloc(b->ops, size * sizeof(*ops));
+		if (ops == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		b->ops = ops;
+		dsts = realloc(b->dst, size * sizeof(*dsts));
+		if (dsts == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		b->dst = dsts;
+		b->size = size;
+	}
+
+	vop = &b->ops[b->nops];
+	memset(vop, 0, sizeof(*vop));
+	vop->op         = op;
+	vop->mapnum     = 1;
+	vop->offset     = offset;
+	vop->data_width = 32;
+	vop->value      = value;
+	vop->mask       = mask;
+	b->dst[b->nops] = dst;
+	b->nops++;
+	return 0;
+}
+
+int ctc_batch_read(struct ctc_batch *b, unsigned offset, unsigned int *value)
+{
+	return ctc_batch_add(b, VMEIO_OP_READ, offset, 0, 0, value);
+}
+
+int ctc_batch_write(struct ctc_batch *b, unsigned offset, unsigned int value)
+{
+	return ctc_batch_add(b, VMEIO_OP_WRITE, offset, value, 0, NULL);
+}
+
+int ctc_batch_rmw(struct ctc_batch *b, unsigned offset,
+	unsigned int mask, unsigned int value)
+{
+	return ctc_batch_add(b, VMEIO_OP_RMW, offset, value, mask, NULL);
+}
+
+/* the operations one syscall each, for drivers without VMEIO_RAW_BATCH */
+static int ctc_batch_run_raw(int fd, struct ctc_batch *b)
+{
+	struct vmeio_op *op;
+	unsigned int val;
+	int i, ret;
+
+	for (i = 0, op = b->ops; i < b->nops; i++, op++) {
+		if (op->op == VMEIO_OP_WRITE) {
+			ret = ctc_raw(fd, op->mapnum, op->offset, 1, 32, &op->value, ENCORE_WRITE);
+		} else {
+			ret = ctc_raw(fd, op->mapnum, op->offset, 1, 32, &val, ENCORE_READ);
+			if (ret == 0 && op->op == VMEIO_OP_RMW) {
+				val = (val & ~op->mask) | (op->value & op->mask);
+				ret = ctc_raw(fd, op->mapnum, op->offset, 1, 32, &val, ENCORE_WRITE);
+			}
+			op->value = val;
+		}
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+int ctc_batch_submit(int fd, struct ctc_batch *b)
+{
+	struct vmeio_batch batch;
+	int i, ret;
+
+	if (b->nops == 0)
+		return 0;
+	batch.nops = b->nops;
+	batch.ops  = b->ops;
+	ret = ioctl(fd, VMEIO_RAW_BATCH, &batch);
+	if (ret && (errno == ENOENT || errno == ENOTTY))
+		ret = ctc_batch_run_raw(fd, b);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < b->nops; i++)
+		if (b->dst[i])
+			*b->dst[i] = b->ops[i].value;
+	return 0;
+}
+
 /*********************************************************************
  *********************************************************************
  *
@@ -497,21 +640,162 @@ int ctc_chan_get_cur_val_counter2(int fd, int chan, int *value)
 	return 0;
 }
 
+/*
+ * Channel-wide helpers on top of the transactions. The channel
+ * configuration register holds the external start, both clock sources,
+ * the mode and the direction.
+ */
+
+#define CTC_ENABLE_REG		0x04
+#define CTC_CHAN_REG(chan, r)	((r) + 0x18*((chan) - 1))
+#define CTC_CONFIG_MASK		0xffff000f
+#define CTC_ENABLE_BIT(chan)	(1 << (8 - (chan) + 1))
+
+static int ctc_chan_config_ok(int chan, struct ctc_chan_config *cfg)
+{
+	return chan >= 1 && chan <= 8 &&
+		cfg->ext_start >= 1 && cfg->ext_start <= 40 &&
+		cfg->clk_counter1 >= 1 && cfg->clk_counter1 <= 6 &&
+		cfg->clk_counter2 >= 1 && cfg->clk_counter2 <= 6 &&
+		cfg->mode >= NORMAL_MODE && cfg->mode <= UPDOWN_MODE &&
+		cfg->direction >= FALLING_EDGE_COUNTER2 &&
+		cfg->direction <= FALLING_EDGE_COUNTER1;
+}
+
+int ctc_batch_chan_set_config(struct ctc_batch *b, int chan,
+	struct ctc_chan_config *cfg)
+{
+	unsigned int val;
+
+	if (!ctc_chan_config_ok(chan, cfg)) {
+		errno = EINVAL;
+		return -1;
+	}
+	val = ((cfg->ext_start - 1) << 24) |
+		(((cfg->clk_counter1 - 1) & 0x0f) << 20) |
+		(((cfg->clk_counter2 - 1) & 0x0f) << 16) |
+		(cfg->direction << 1) | cfg->mode;
+
+	if (ctc_batch_rmw(b, CTC_CHAN_REG(chan, 0x08), CTC_CONFIG_MASK, val) ||
+	    ctc_batch_write(b, CTC_CHAN_REG(chan, 0x0C), cfg->delay_counter1) ||
+	    ctc_batch_write(b, CTC_CHAN_REG(chan, 0x10), cfg->delay_counter2))
+		return -1;
+	return ctc_batch_rmw(b, CTC_ENABLE_REG, CTC_ENABLE_BIT(chan),
+			cfg->enable ? CTC_ENABLE_BIT(chan) : 0);
+}
+
+int ctc_chan_set_config(int fd, int chan, struct ctc_chan_config *cfg)
+{
+	return ctc_set_config(fd, chan, chan, cfg);
+}
+
+int ctc_set_config(int fd, int first, int last, struct ctc_chan_config *cfg)
+{
+	struct ctc_batch *b;
+	int chan, ret;
+
+	if (first < 1 || last > 8 || first > last) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((b = ctc_batch_new()) == NULL)
+		return -1;
+	for (chan = first, ret = 0; chan <= last && ret == 0; chan++)
+		ret = ctc_batch_chan_set_config(b, chan, &cfg[chan - first]);
+	if (ret == 0)
+		ret = ctc_batch_submit(fd, b);
+	ctc_batch_free(b);
+	return ret;
+}
+
+int ctc_get_config(int fd, int first, int last, struct ctc_chan_config *cfg)
+{
+	struct ctc_batch *b;
+	unsigned int enable, regs[8][3];
+	int chan, ret;
+
+	if (first < 1 || last > 8 || first > last) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((b = ctc_batch_new()) == NULL)
+		return -1;
+	ret = ctc_batch_read(b, CTC_ENABLE_REG, &enable);
+	for (chan = first; chan <= last && ret == 0; chan++) {
+		ret = ctc_batch_read(b, CTC_CHAN_REG(chan, 0x08), &regs[chan - 1][0]) ||
+		      ctc_batch_read(b, CTC_CHAN_REG(chan, 0x0C), &regs[chan - 1][1]) ||
+		      ctc_batch_read(b, CTC_CHAN_REG(chan, 0x10), &regs[chan - 1][2]);
+	}
+	if (ret == 0)
+		ret = ctc_batch_submit(fd, b);
+	ctc_batch_free(b);
+	if (ret)
+		return -1;
+
+	for (chan = first; chan <= last; chan++) {
+		struct ctc_chan_config *c = &cfg[chan - first];
+		unsigned int val = regs[chan - 1][0];
+
+		c->enable         = (enable & CTC_ENABLE_BIT(chan)) != 0;
+		c->ext_start      = ((val >> 24) & 0xff) + 1;
+		c->clk_counter1   = ((val >> 20) & 0x0f) + 1;
+		c->clk_counter2   = ((val >> 16) & 0x0f) + 1;
+		c->mode           = val & 0x01;
+		c->direction      = (val & 0x02) >> 1;
+		c->delay_counter1 = regs[chan - 1][1];
+		c->delay_counter2 = regs[chan - 1][2];
+	}
+	return 0;
+}
+
+int ctc_chan_get_config(int fd, int chan, struct ctc_chan_config *cfg)
+{
+	return ctc_get_config(fd, chan, chan, cfg);
+}
+
+int ctc_get_counters(int fd, int first, int last, struct ctc_chan_counters *cnt)
+{
+	struct ctc_batch *b;
+	int chan, ret;
+
+	if (first < 1 || last > 8 || first > last) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((b = ctc_batch_new()) == NULL)
+		return -1;
+	for (chan = first, ret = 0; chan <= last && ret == 0; chan++) {
+		struct ctc_chan_counters *c = &cnt[chan - first];
+
+		ret = ctc_batch_read(b, CTC_CHAN_REG(chan, 0x14), (unsigned int *)&c->output) ||
+		      ctc_batch_read(b, CTC_CHAN_REG(chan, 0x18), (unsigned int *)&c->counter1) ||
+		      ctc_batch_read(b, CTC_CHAN_REG(chan, 0x1C), (unsigned int *)&c->counter2);
+	}
+	if (ret == 0)
+		ret = ctc_batch_submit(fd, b);
+	ctc_batch_free(b);
+	return ret ? -1 : 0;
+}
+
+int ctc_chan_get_counters(int fd, int chan, struct ctc_chan_counters *cnt)
+{
+	return ctc_get_counters(fd, chan, chan, cnt);
+}
+
 void ctc_reset(int fd)
 {
+	struct ctc_batch *b;
 	int chan;
 
-	// Disable all channels and all setups.
+	/* Disable all channels and all setups, in one transaction. */
+	if ((b = ctc_batch_new()) == NULL)
+		return;
+	ctc_batch_rmw(b, CTC_ENABLE_REG, 0x1fe, 0);
 	for(chan = 1; chan <= 8; chan++) {
-		ctc_chan_disable(fd, chan);
-		ctc_chan_set_ext_start(fd, chan, 0);
-		ctc_chan_set_clk_counter1(fd, chan, 0);
-		ctc_chan_set_clk_counter2(fd, chan, 0);
-		ctc_chan_set_delay_counter1(fd, chan, 0);
-		ctc_chan_set_delay_counter2(fd, chan, 0);
-		ctc_chan_set_mode(fd, chan, 0, 0);
+		ctc_batch_write(b, CTC_CHAN_REG(chan, 0x0C), 0);
+		ctc_batch_write(b, CTC_CHAN_REG(chan, 0x10), 0);
+		ctc_batch_rmw(b, CTC_CHAN_REG(chan, 0x08), 0x0000000f, 0);
 	}
-	
+	ctc_batch_submit(fd, b);
+	ctc_batch_free(b);
 }
-
-
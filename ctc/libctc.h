@@ -328,6 +328,161 @@ int ctc_chan_get_cur_val_counter1(int fd, int chan, int *value);
 int ctc_chan_get_cur_val_counter2(int fd, int chan, int *value);
 
 
+/* Register transactions */
+
+/*!
+ * A transaction: an ordered list of register reads, writes and
+ * read-modify-writes submitted to the driver in a single system call.
+ * All the operations are checked before any of them touches the board.
+ */
+struct ctc_batch;
+
+/*!
+ * Whole configuration of a channel, see ctc_chan_set_config
+ */
+struct ctc_chan_config {
+	int enable;		/*!< 1 enabled, 0 disabled */
+	int ext_start;		/*!< external start input [1-40] */
+	int clk_counter1;	/*!< clock of counter 1 [1-6] */
+	int clk_counter2;	/*!< clock of counter 2 [1-6] */
+	int mode;		/*!< enum ctc_mode */
+	int direction;		/*!< enum ctc_dir */
+	int delay_counter1;	/*!< delay of counter 1 */
+	int delay_counter2;	/*!< delay of counter 2 */
+};
+
+/*!
+ * Counters of a channel, see ctc_chan_get_counters
+ */
+struct ctc_chan_counters {
+	int output;		/*!< output counter */
+	int counter1;		/*!< current value of counter 1 */
+	int counter2;		/*!< current value of counter 2 */
+};
+
+//! Create an empty transaction
+/*!
+  \return returns the transaction on success. On error, NULL is returned, and errno is set appropriately.
+*/
+struct ctc_batch *ctc_batch_new(void);
+
+//! Free a transaction
+/*!
+  \param b	transaction
+*/
+void ctc_batch_free(struct ctc_batch *b);
+
+//! Empty a transaction so it can be filled again
+/*!
+  \param b	transaction
+*/
+void ctc_batch_reset(struct ctc_batch *b);
+
+//! Add a register read to a transaction
+/*!
+  \param b	transaction
+  \param offset	register offset
+  \param value	pointer to receive the value when the transaction is submitted
+  \return returns 0 on success. On error, -1 is returned, and errno is set appropriately.
+*/
+int ctc_batch_read(struct ctc_batch *b, unsigned offset, unsigned int *value);
+
+//! Add a register write to a transaction
+/*!
+  \param b	transaction
+  \param offset	register offset
+  \param value	value to write
+  \return returns 0 on success. On error, -1 is returned, and errno is set appropriately.
+*/
+int ctc_batch_write(struct ctc_batch *b, unsigned offset, unsigned int value);
+
+//! Add a register read-modify-write to a transaction
+/*!
+  \brief The bits set in mask are replaced by the ones of value, the driver does it without another system call.
+  \param b	transaction
+  \param offset	register offset
+  \param mask	bits to change
+  \param value	new value of those bits
+  \return returns 0 on success. On error, -1 is returned, and errno is set appropriately.
+*/
+int ctc_batch_rmw(struct ctc_batch *b, unsigned offset, unsigned int mask, unsigned int value);
+
+//! Add the whole configuration of a channel to a transaction
+/*!
+  \param b	transaction
+  \param chan	channel number [1-8]
+  \param cfg	configuration
+  \return returns 0 on success. On error, -1 is returned, and errno is set appropriately.
+*/
+int ctc_batch_chan_set_config(struct ctc_batch *b, int chan, struct ctc_chan_config *cfg);
+
+//! Submit a transaction
+/*!
+  \brief The operations are executed in order and the values read are stored. The transaction is kept and can be submitted again.
+  \param fd	file descriptor
+  \param b	transaction
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_batch_submit(int fd, struct ctc_batch *b);
+
+//! Set the whole configuration of a channel in one system call
+/*!
+  \param fd 	file descriptor
+  \param chan	channel number [1-8]
+  \param cfg	configuration
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_chan_set_config(int fd, int chan, struct ctc_chan_config *cfg);
+
+//! Get the whole configuration of a channel in one system call
+/*!
+  \param fd 	file descriptor
+  \param chan	channel number [1-8]
+  \param cfg	pointer to receive the configuration
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_chan_get_config(int fd, int chan, struct ctc_chan_config *cfg);
+
+//! Set the configuration of a range of channels in one system call
+/*!
+  \param fd 	file descriptor
+  \param first	first channel [1-8]
+  \param last	last channel [first-8]
+  \param cfg	array of last - first + 1 configurations
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_set_config(int fd, int first, int last, struct ctc_chan_config *cfg);
+
+//! Get the configuration of a range of channels in one system call
+/*!
+  \param fd 	file descriptor
+  \param first	first channel [1-8]
+  \param last	last channel [first-8]
+  \param cfg	array to receive last - first + 1 configurations
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_get_config(int fd, int first, int last, struct ctc_chan_config *cfg);
+
+//! Get the output counter and both current counter values of a channel in one system call
+/*!
+  \param fd 	file descriptor
+  \param chan	channel number [1-8]
+  \param cnt	pointer to receive the counters
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_chan_get_counters(int fd, int chan, struct ctc_chan_counters *cnt);
+
+//! Get the counters of a range of channels in one system call
+/*!
+  \param fd 	file descriptor
+  \param first	first channel [1-8]
+  \param last	last channel [first-8]
+  \param cnt	array to receive last - first + 1 counters
+  \return returns 0 on success. On error, negative value is returned, and errno is set appropriately.
+*/
+int ctc_get_counters(int fd, int first, int last, struct ctc_chan_counters *cnt);
+
+
 #ifdef __cplusplus
 }
 #endif
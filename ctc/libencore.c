@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <stdint.h>
 #include <netinet/in.h>
+#include <endian.h>
 
 #include "vmeio.h"
 #include "libencore.h"
@@ -210,6 +211,178 @@ int encore_set_register(encore_handle h, int reg_id, unsigned int value)
 	return encore_set_window(h, reg_id, 0, 1, &value);
 }
 
+/*
+ * VME data is big endian, DMA buffers are converted in place to the host
+ * order. On x86 the conversion runs with byte shuffles of 16 (SSSE3) or
+ * 32 (AVX2) bytes at a time, picked from the CPU features on first use.
+ * The VME bridge DMA descriptor (struct vme_dma) has no byte swapping
+ * option, so the pass cannot be left to the hardware.
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN && (defined(__i386__) || defined(__x86_64__)) && \
+	defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define ENCORE_SWAP_SIMD
+#include <immintrin.h>
+#endif
+
+typedef void (*swap_fn)(void *buf, unsigned long size);
+
+static void swap16_scalar(void *buf, unsigned long size)
+{
+	uint16_t *ptr = buf;
+	unsigned long i;
+
+	for (i = 0; i < size/2; i++) {
+		*ptr = htons(*ptr);
+		ptr++;
+	}
+}
+
+static void swap32_scalar(void *buf, unsigned long size)
+{
+	uint32_t *ptr = buf;
+	unsigned long i;
+
+	for (i = 0; i < size/4; i++) {
+		*ptr = htonl(*ptr);
+		ptr++;
+	}
+}
+
+#ifdef ENCORE_SWAP_SIMD
+
+#define SHUF16 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+#define SHUF32 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+
+__attribute__((target("ssse3")))
+static void swap_ssse3(void *buf, unsigned long size, __m128i mask)
+{
+	char *p = buf;
+	unsigned long i;
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(p + i));
+		_mm_storeu_si128((__m128i *)(p + i), _mm_shuffle_epi8(v, mask));
+	}
+}
+
+__attribute__((target("ssse3")))
+static void swap16_ssse3(void *buf, unsigned long size)
+{
+	unsigned long done = size & ~15UL;
+
+	swap_ssse3(buf, size, _mm_set_epi8(SHUF16));
+	swap16_scalar((char *)buf + done, size - done);
+}
+
+__attribute__((target("ssse3")))
+static void swap32_ssse3(void *buf, unsigned long size)
+{
+	unsigned long done = size & ~15UL;
+
+	swap_ssse3(buf, size, _mm_set_epi8(SHUF32));
+	swap32_scalar((char *)buf + done, size - done);
+}
+
+/* vpshufb shuffles within each 128-bit lane, so the mask is repeated */
+__attribute__((target("avx2")))
+static void swap_avx2(void *buf, unsigned long size, __m256i mask)
+{
+	char *p = buf;
+	unsigned long i;
+
+	for (i = 0; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((__m256i *)(p + i));
+		_mm256_storeu_si256((__m256i *)(p + i), _mm256_shuffle_epi8(v, mask));
+	}
+}
+
+__attribute__((target("avx2")))
+static void swap16_avx2(void *buf, unsigned long size)
+{
+	unsigned long done = size & ~31UL;
+
+	swap_avx2(buf, size, _mm256_set_epi8(SHUF16, SHUF16));
+	swap16_scalar((char *)buf + done, size - done);
+}
+
+__attribute__((target("avx2")))
+static void swap32_avx2(void *buf, unsigned long size)
+{
+	unsigned long done = size & ~31UL;
+
+	swap_avx2(buf, size, _mm256_set_epi8(SHUF32, SHUF32));
+	swap32_scalar((char *)buf + done, size - done);
+}
+
+#endif /* ENCORE_SWAP_SIMD */
+
+static swap_fn swap16 = NULL;
+static swap_fn swap32 = NULL;
+
+static int swap_supported(enum encore_swap_impl impl)
+{
+	switch (impl) {
+	case ENCORE_SWAP_AUTO:
+	case ENCORE_SWAP_SCALAR:
+		return 1;
+#ifdef ENCORE_SWAP_SIMD
+	case ENCORE_SWAP_SSSE3:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("ssse3");
+	case ENCORE_SWAP_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+int encore_swap_select(enum encore_swap_impl impl)
+{
+	if (!swap_supported(impl)) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (impl == ENCORE_SWAP_AUTO) {
+		if (swap_supported(ENCORE_SWAP_AVX2))
+			impl = ENCORE_SWAP_AVX2;
+		else if (swap_supported(ENCORE_SWAP_SSSE3))
+			impl = ENCORE_SWAP_SSSE3;
+		else
+			impl = ENCORE_SWAP_SCALAR;
+	}
+	switch (impl) {
+#ifdef ENCORE_SWAP_SIMD
+	case ENCORE_SWAP_AVX2:
+		swap32 = swap32_avx2;
+		swap16 = swap16_avx2;
+		break;
+	case ENCORE_SWAP_SSSE3:
+		swap32 = swap32_ssse3;
+		swap16 = swap16_ssse3;
+		break;
+#endif
+	default:
+		swap32 = swap32_scalar;
+		swap16 = swap16_scalar;
+		break;
+	}
+	return 0;
+}
+
+void encore_swap(void *buf, unsigned data_width, unsigned long size)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	if (swap16 == NULL)
+		encore_swap_select(ENCORE_SWAP_AUTO);
+	if (data_width == 16)
+		swap16(buf, size);
+	else if (data_width == 32)
+		swap32(buf, size);
+#endif
+}
+
 int encore_dma_read(encore_handle h, unsigned long address,
 	unsigned am, unsigned data_width, unsigned long size,
 	void *dst)
@@ -235,24 +408,7 @@ int encore_dma_read(encore_handle h, unsigned long address,
 	dma_desc.ctrl.vme_backoff_time = VME_DMA_BACKOFF_0;
 
 	ret = ioctl(h->dmafd, VME_IOCTL_START_DMA, &dma_desc);
-
-	if (data_width == 16) {
-		int i;
-		uint16_t *ptr = dst;
-
-		for (i = 0; i < size/2; i++) {
-			*ptr = htons(*ptr);
-			ptr++;
-		}
-	} else if (data_width == 32) {
-		int i;
-		uint32_t *ptr = dst;
-
-		for (i = 0; i < size/4; i++) {
-			*ptr = htonl(*ptr);
-			ptr++;
-		}
-	}
+	encore_swap(dst, data_width, size);
 
 	return ret;
 }
@@ -281,24 +437,7 @@ int encore_dma_write(encore_handle h, unsigned long address,
 	dma_desc.ctrl.vme_block_size = VME_DMA_BSIZE_4096;
 	dma_desc.ctrl.vme_backoff_time = VME_DMA_BACKOFF_0;
 
-	if (data_width == 16) {
-		int i;
-		uint16_t *ptr = src;
-
-		for (i = 0; i < size/2; i++) {
-			*ptr = htons(*ptr);
-			ptr++;
-		}
-	} else if (data_width == 32) {
-		int i;
-		uint32_t *ptr = src;
-
-		for (i = 0; i < size/4; i++) {
-			*ptr = htonl(*ptr);
-			ptr++;
-		}
-	}
-
+	encore_swap(src, data_width, size);
 	ret = ioctl(h->dmafd, VME_IOCTL_START_DMA, &dma_desc);
 	return ret;
 }
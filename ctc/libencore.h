@@ -50,6 +50,22 @@ int encore_dma_get_window(encore_handle h, int reg_id, int from, int to,
 int encore_dma_set_window(encore_handle h, int reg_id, int from, int to,
 					void *src);
 
+/*
+ * In place conversion of 16 or 32-bit VME data to host order, as done
+ * by the DMA calls. The fastest byte swap the CPU supports is used
+ * unless another one is selected, encore_swap_select() fails with
+ * ENOTSUP for an implementation this CPU or build lacks.
+ */
+enum encore_swap_impl {
+	ENCORE_SWAP_AUTO = 0,
+	ENCORE_SWAP_SCALAR,
+	ENCORE_SWAP_SSSE3,
+	ENCORE_SWAP_AVX2,
+};
+
+int encore_swap_select(enum encore_swap_impl impl);
+void encore_swap(void *buf, unsigned data_width, unsigned long size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,107 @@
+/*
+ * encore_swap_bench - compare the byte swap paths of the DMA calls
+ *
+ * Times encore_swap() with each implementation the CPU supports, for
+ * 16 and 32-bit data, on buffers from 64 bytes to 4 megabytes, and
+ * checks every result against a byte by byte reference. No hardware is
+ * needed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <libencore.h>
+
+#define PROGNAME	"encore_swap_bench"
+#define MIN_SIZE	64
+#define MAX_SIZE	(4 << 20)
+#define MIN_BYTES	(64 << 20)	/* bytes swapped per measurement */
+
+static const struct {
+	enum encore_swap_impl	impl;
+	char			*name;
+} impls[] = {
+	{ ENCORE_SWAP_SCALAR,	"scalar" },
+	{ ENCORE_SWAP_SSSE3,	"ssse3" },
+	{ ENCORE_SWAP_AVX2,	"avx2" },
+};
+#define NIMPLS	(sizeof(impls)/sizeof(impls[0]))
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *buf, *in, *expect;
+	unsigned long size, i, k, loops, l;
+	unsigned width, bytes;
+	int j, errors = 0;
+	double t;
+
+	buf    = malloc(MAX_SIZE);
+	in     = malloc(MAX_SIZE);
+	expect = malloc(MAX_SIZE);
+	if (buf == NULL || in == NULL || expect == NULL) {
+		fprintf(stderr, PROGNAME ": not enough memory\n");
+		return 1;
+	}
+	for (i = 0; i < MAX_SIZE; i++)
+		in[i] = i * 7 + 1;
+
+	printf("%-6s %8s", "width", "bytes");
+	for (j = 0; j < NIMPLS; j++)
+		printf(" %12s", impls[j].name);
+	printf("   (MB/s)\n");
+
+	for (width = 16; width <= 32; width += 16) {
+		/* big endian words to host order, byte by byte */
+		bytes = width / 8;
+		for (i = 0; i < MAX_SIZE; i += bytes)
+			for (k = 0; k < bytes; k++)
+				expect[i + k] = in[i + bytes - 1 - k];
+		if (encore_swap_select(ENCORE_SWAP_SCALAR) == 0) {
+			memcpy(buf, in, 4);
+			encore_swap(buf, width, 4);
+			if (memcmp(buf, in, 4) == 0)
+				memcpy(expect, in, MAX_SIZE);	/* big endian host */
+		}
+
+		for (size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+			printf("%-6u %8lu", width, size);
+			for (j = 0; j < NIMPLS; j++) {
+				if (encore_swap_select(impls[j].impl) != 0) {
+					printf(" %12s", "-");
+					continue;
+				}
+
+				/* an odd number of swaps leaves the buffer swapped */
+				loops = (MIN_BYTES / size) | 1;
+				memcpy(buf, in, size);
+				t = now();
+				for (l = 0; l < loops; l++)
+					encore_swap(buf, width, size);
+				t = now() - t;
+				printf(" %12.0f", t > 0.0 ? (double)size * loops / t / 1e6 : 0.0);
+
+				if (memcmp(buf, expect, size) != 0) {
+					printf(" (%s wrong)", impls[j].name);
+					errors++;
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	encore_swap_select(ENCORE_SWAP_AUTO);
+	free(buf);
+	free(in);
+	free(expect);
+	return errors != 0;
+}
@@ -63,6 +63,34 @@ struct vmeio_riob {
    int data_width;	/** optional data width */
 };
 
+/*
+ * Batched single register accesses, executed in order by one
+ * VMEIO_RAW_BATCH ioctl. All the operations are checked before the
+ * first one is executed, read values are returned in value.
+ */
+
+#define vmeioMAX_OPS 1024
+
+enum vmeio_op_type {
+   VMEIO_OP_READ = 0,	/** value = register */
+   VMEIO_OP_WRITE,	/** register = value */
+   VMEIO_OP_RMW,	/** register = (register & ~mask) | (value & mask), value = new register */
+};
+
+struct vmeio_op {
+   int op;		/** enum vmeio_op_type */
+   int mapnum;		/** Mapping number 1..2 */
+   int offset;		/** Byte offset in map */
+   int data_width;	/** optional data width */
+   unsigned int value;	/** Value to write or value read */
+   unsigned int mask;	/** Bits to write for VMEIO_OP_RMW */
+};
+
+struct vmeio_batch {
+   int nops;		/** Number of operations, at most vmeioMAX_OPS */
+   struct vmeio_op *ops; /** Operations, updated with the read values */
+};
+
 struct vmeio_dma_op {
    int am;		/** address modifier, defines transfer mode */
    int data_width;	/** transfer data width */
@@ -120,6 +148,8 @@ typedef enum {
    vmeioGET_MAPPING,   /** Obtain mapping properties */
    vmeioGET_REGINFO,   /** Obtain register properties */
 
+   vmeioRAW_BATCH,     /** Batch of single register accesses */
+
    vmeioLAST           /** For range checking (LAST - FIRST) */
 
 } vmeio_ioctl_function_t;
@@ -146,5 +176,6 @@ typedef enum {
 #define  VMEIO_GET_MAPPING    _IOWR(MAGIC,  vmeioGET_MAPPING,    struct  vmeio_get_mapping)
 #define  VMEIO_GET_NREGS      _IOR(MAGIC,   vmeioGET_NREGS,      int)
 #define  VMEIO_GET_REGINFO    _IOW(MAGIC,   vmeioGET_REGINFO,    void *)
+#define  VMEIO_RAW_BATCH      _IOW(MAGIC,   vmeioRAW_BATCH,      struct  vmeio_batch)
 
 #endif
@@ -365,9 +365,21 @@ int cnt, dir;
       dir = READ_FLAG;
       break;
 
-   case CtrDrvrIOCTL_64:
-   case CtrDrvrIOCTL_65:
-   case CtrDrvrIOCTL_66:
+   case CtrDrvrGET_ISR_STATS:
+      cnt = sizeof(CtrDrvrIsrStats);
+      dir = WRIT_FLAG;
+      break;
+
+   case CtrDrvrSET_QUEUE_CONFIG:
+      cnt = sizeof(CtrDrvrQueueConfig);
+      dir = READ_FLAG;
+      break;
+
+   case CtrDrvrGET_QUEUE_STATS:
+      cnt = sizeof(CtrDrvrQueueStats);
+      dir = WRIT_FLAG;
+      break;
+
    case CtrDrvrIOCTL_67:
    case CtrDrvrIOCTL_68:
    case CtrDrvrIOCTL_69:
@@ -179,7 +179,8 @@ int rc;
       if ((lynxmem = kmalloc(count,GFP_KERNEL)) != NULL) {
 	 rc = entry_points.dldd_read(LynxOsWorkingArea,&lynx_file,lynxmem,count);
 	 if (rc >= 0) {
-	    cc = __copy_to_user(buf,lynxmem,count);
+	    if (rc > count) rc = count;
+	    cc = __copy_to_user(buf,lynxmem,rc);     /* Only what was read */
 	    if (cc) {
 	       kfree(lynxmem);
 	       printk(KERN_WARNING "LynxOsRead __copy_to_user: Returned: %ld\n",cc);
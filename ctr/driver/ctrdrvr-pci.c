@@ -12,6 +12,7 @@
 #include "plx9030.h"   /* PLX9030 Registers and definition   */
 
 #include <linux/interrupt.h>	/* enable_irq, disable_irq */
+#include <linux/ktime.h>	/* ISR duration statistics */
 
 /* These next defines are needed just here for the emulation */
 
@@ -398,18 +399,6 @@ static int RawIo(CtrDrvrModuleContext *mcon,
 		 unsigned int          flag,
 		 unsigned int          debg);
 
-static CtrDrvrHwTrigger *TriggerToHard(CtrDrvrTrigger *strg);
-
-static CtrDrvrTrigger *HardToTrigger(volatile CtrDrvrHwTrigger *htrg);
-
-static CtrDrvrHwCounterConfiguration *ConfigToHard(CtrDrvrCounterConfiguration *scnf);
-
-static CtrDrvrCounterConfiguration *HardToConfig(volatile CtrDrvrHwCounterConfiguration *hcnf);
-
-static unsigned int  AutoShiftLeft(unsigned int  mask, unsigned int  value);
-
-static unsigned int  AutoShiftRight(unsigned int  mask, unsigned int  value);
-
 static unsigned int  GetPtimModule(unsigned int  eqpnum);
 
 static int Connect(CtrDrvrConnection    *conx,
@@ -454,6 +443,10 @@ static int WriteEpromWord(CtrDrvrModuleContext *mcon, unsigned int  word);
 
 static void ReadEpromWord(CtrDrvrModuleContext *mcon, unsigned int  *word);
 
+/* Trigger encoding, ISR fan out and client queues, shared with CtrEmu */
+
+#include "ctrdrvrIsr.h"
+
 /* ========================= */
 /* Driver entry points       */
 /* ========================= */
@@ -555,7 +548,7 @@ char *ioctl_names[CtrDrvrLAST_IOCTL] = {
 "JTAG_WRITE_BYTE", "JTAG_CLOSE", "HPTDC_OPEN", "HPTDC_IO", "HPTDC_CLOSE", "RAW_READ", "RAW_WRITE",
 "GET_RECEPTION_ERRORS", "GET_IO_STATUS", "GET_IDENTITY",
 "SET_DEBUG_HISTORY","SET_BRUTAL_PLL","GET_MODULE_STATS","SET_CABLE_ID",
-"IOCTL64","IOCTL65","IOCTL66","IOCTL67","IOCTL68","IOCTL69",
+"GET_ISR_STATS","SET_QUEUE_CONFIG","GET_QUEUE_STATS","IOCTL67","IOCTL68","IOCTL69",
 
 "SET_MODULE_BY_SLOT", "GET_MODULE_SLOT",
 "REMAP", "93LC56B_EEPROM_OPEN", "93LC56B_EEPROM_READ", "93LC56B_EEPROM_WRITE",
@@ -1329,117 +1322,183 @@ char                     *iod;
 }
 
 /* ========================================================== */
-/* Auto shift left  a value for a given mask                  */
+/* Hash indexes on EqpNum, so that objects and trigger table  */
+/* slots are found without scanning. The chains are threaded  */
+/* through Next arrays holding index+1, zero ends a chain.    */
 /* ========================================================== */
 
-static unsigned int AutoShiftLeft(unsigned int mask, unsigned int value) {
-int i,m;
+static unsigned int EqpHash(unsigned int eqpnum) {
+   return (eqpnum * 2654435761U) >> (32 - CtrDrvrHASH_BITS);
+}
+
+static void ChainAdd(unsigned short *head, unsigned short *next, int i) {
+   next[i] = *head;
+   *head = i + 1;
+}
+
+static void ChainDel(unsigned short *head, unsigned short *next, int i) {
+unsigned short *p;
 
-   m = mask;
-   for (i=0; i<32; i++) {
-      if (m & 1) break;
-      m >>= 1;
+   for (p = head; *p; p = &(next[*p - 1])) {
+      if (*p == i + 1) {
+	 *p = next[i];
+	 next[i] = 0;
+	 return;
+      }
    }
-   return (value << i) & mask;
 }
 
 /* ========================================================== */
-/* Auto shift right a value for a given mask                  */
+/* CTIM and PTIM objects: find returns the index or -1, and   */
+/* delete moves the last object into the freed place.         */
 /* ========================================================== */
 
-static unsigned int AutoShiftRight(unsigned int mask, unsigned int value) {
-int i,m;
+static int CtimFind(unsigned int eqpnum) {
+int i;
+
+   for (i = Wa->CtimHash[EqpHash(eqpnum)]; i; i = Wa->CtimNext[i - 1])
+      if (Wa->Ctim.Objects[i - 1].EqpNum == eqpnum) return i - 1;
+   return -1;
+}
+
+static void CtimAdd(CtrDrvrCtimBinding *ctim) {
+int i;
+
+   i = Wa->Ctim.Size++;
+   Wa->Ctim.Objects[i] = *ctim;
+   ChainAdd(&(Wa->CtimHash[EqpHash(ctim->EqpNum)]),Wa->CtimNext,i);
+}
+
+static void CtimDel(int i) {
+int last;
 
-   m = mask;
-   for (i=0; i<32; i++) {
-      if (m & 1) break;
-      m >>= 1;
+   last = Wa->Ctim.Size - 1;
+   ChainDel(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[i].EqpNum)]),Wa->CtimNext,i);
+   if (i != last) {
+      ChainDel(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[last].EqpNum)]),Wa->CtimNext,last);
+      Wa->Ctim.Objects[i] = Wa->Ctim.Objects[last];
+      ChainAdd(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[i].EqpNum)]),Wa->CtimNext,i);
    }
-   return (value >> i) & m;
+   Wa->Ctim.Size = last;
 }
 
-/* ========================================================== */
-/* Convert driver API trigger to compact hardware form.       */
-/* The API form for a trigger is too big to fit in the FPGA.  */
-/* We keep a propper structure for the driver API, and        */
-/* declare a second version packed into bit fields for the    */
-/* hardware representation.                                   */
-/* ========================================================== */
+static int PtimFind(unsigned int eqpnum) {
+int i;
 
-static CtrDrvrHwTrigger *TriggerToHard(CtrDrvrTrigger *strg) {
-static CtrDrvrHwTrigger htrg;
-unsigned int trigger;
+   for (i = Wa->PtimHash[EqpHash(eqpnum)]; i; i = Wa->PtimNext[i - 1])
+      if (Wa->Ptim.Objects[i - 1].EqpNum == eqpnum) return i - 1;
+   return -1;
+}
+
+static void PtimAdd(CtrDrvrPtimBinding *ptim) {
+int i;
 
-   trigger  = AutoShiftLeft(CtrDrvrTrigGROUP_VALUE_MASK ,strg->Group.GroupValue);
-   trigger |= AutoShiftLeft(CtrDrvrTrigCONDITION_MASK   ,strg->TriggerCondition);
-   trigger |= AutoShiftLeft(CtrDrvrTrigMACHINE_MASK     ,strg->Machine);
-   trigger |= AutoShiftLeft(CtrDrvrTrigCOUNTER_MASK     ,strg->Counter);
-   trigger |= AutoShiftLeft(CtrDrvrTrigGROUP_NUMBER_MASK,strg->Group.GroupNumber);
+   i = Wa->Ptim.Size++;
+   Wa->Ptim.Objects[i] = *ptim;
+   ChainAdd(&(Wa->PtimHash[EqpHash(ptim->EqpNum)]),Wa->PtimNext,i);
+}
 
-   htrg.Frame   = strg->Frame;
-   htrg.Trigger = trigger;
+static void PtimDel(int i) {
+int last;
 
-   return &htrg;
+   last = Wa->Ptim.Size - 1;
+   ChainDel(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[i].EqpNum)]),Wa->PtimNext,i);
+   if (i != last) {
+      ChainDel(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[last].EqpNum)]),Wa->PtimNext,last);
+      Wa->Ptim.Objects[i] = Wa->Ptim.Objects[last];
+      ChainAdd(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[i].EqpNum)]),Wa->PtimNext,i);
+   }
+   Wa->Ptim.Size = last;
 }
 
 /* ========================================================== */
-/* Convert compact hardware trigger to driver API trigger     */
+/* Trigger table slots. All changes of a slot's EqpNum must   */
+/* go through SetSlotOwner to keep the index up to date.      */
 /* ========================================================== */
 
-static CtrDrvrTrigger *HardToTrigger(volatile CtrDrvrHwTrigger *htrg) {
-static CtrDrvrTrigger strg;
-unsigned int trigger;
+static void SetSlotOwner(CtrDrvrModuleContext  *mcon,
+			 int                    i,
+			 unsigned int           eqpnum,
+			 CtrDrvrConnectionClass clss) {
+
+   if (mcon->EqpNum[i])
+      ChainDel(&(mcon->SlotHash[EqpHash(mcon->EqpNum[i])]),mcon->SlotNext,i);
+
+   mcon->EqpNum[i]   = eqpnum;
+   mcon->EqpClass[i] = clss;
+
+   if (eqpnum) ChainAdd(&(mcon->SlotHash[EqpHash(eqpnum)]),mcon->SlotNext,i);
+   else if (i < mcon->FreeSlot) mcon->FreeSlot = i;
+}
+
+/* Next slot after i owned by (eqpnum, clss), i = -1 for the */
+/* first one. Returns -1 when there are no more.             */
+
+static int SlotNextOwned(CtrDrvrModuleContext  *mcon,
+			 int                    i,
+			 unsigned int           eqpnum,
+			 CtrDrvrConnectionClass clss) {
+int k;
+
+   if (i < 0) k = mcon->SlotHash[EqpHash(eqpnum)];
+   else       k = mcon->SlotNext[i];
 
-   strg.Frame = htrg->Frame;
-   trigger    = htrg->Trigger;
+   for (; k; k = mcon->SlotNext[k - 1]) {
+      if ((mcon->EqpNum[k - 1]   == eqpnum)
+      &&  (mcon->EqpClass[k - 1] == clss)) return k - 1;
+   }
+   return -1;
+}
+
+/* Lowest slot owned by (eqpnum, clss) or -1 */
 
-   strg.Group.GroupValue  = AutoShiftRight(CtrDrvrTrigGROUP_VALUE_MASK ,trigger);
-   strg.TriggerCondition  = AutoShiftRight(CtrDrvrTrigCONDITION_MASK   ,trigger);
-   strg.Machine           = AutoShiftRight(CtrDrvrTrigMACHINE_MASK     ,trigger);
-   strg.Counter           = AutoShiftRight(CtrDrvrTrigCOUNTER_MASK     ,trigger);
-   strg.Group.GroupNumber = AutoShiftRight(CtrDrvrTrigGROUP_NUMBER_MASK,trigger);
+static int SlotFirstOwned(CtrDrvrModuleContext  *mcon,
+			  unsigned int           eqpnum,
+			  CtrDrvrConnectionClass clss) {
+int i, first;
 
-   return &strg;
+   first = -1;
+   for (i = SlotNextOwned(mcon,-1,eqpnum,clss); i >= 0; i = SlotNextOwned(mcon,i,eqpnum,clss))
+      if ((first < 0) || (i < first)) first = i;
+   return first;
 }
 
-/* ================================================================================== */
-/* Convert a soft counter configuration to compact hardware form.                     */
-/* ================================================================================== */
+/* Set the trigger of slot i. All changes of a slot's Ctim must */
+/* go through here to keep the CTIM users index up to date.     */
 
-static CtrDrvrHwCounterConfiguration *ConfigToHard(CtrDrvrCounterConfiguration *scnf) {
-static CtrDrvrHwCounterConfiguration hcnf;
-unsigned int config;
+static void SetSlotTrigger(CtrDrvrModuleContext *mcon,
+			   int                   i,
+			   CtrDrvrTrigger       *trig) {
 
-   config  = AutoShiftLeft(CtrDrvrCounterConfigPULSE_WIDTH_MASK,scnf->PulsWidth);
-   config |= AutoShiftLeft(CtrDrvrCounterConfigCLOCK_MASK      ,scnf->Clock);
-   config |= AutoShiftLeft(CtrDrvrCounterConfigMODE_MASK       ,scnf->Mode);
-   config |= AutoShiftLeft(CtrDrvrCounterConfigSTART_MASK      ,scnf->Start);
-   config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK    ,scnf->OnZero);
+   if (mcon->Trigs[i].Ctim)
+      ChainDel(&(mcon->CtimSlotHash[EqpHash(mcon->Trigs[i].Ctim)]),mcon->CtimSlotNext,i);
 
-   hcnf.Config = config;
-   hcnf.Delay  = scnf->Delay;
+   mcon->Trigs[i] = *trig;
 
-   return &hcnf;
+   if (trig->Ctim) ChainAdd(&(mcon->CtimSlotHash[EqpHash(trig->Ctim)]),mcon->CtimSlotNext,i);
 }
 
-/* ================================================================================== */
-/* Convert a compacr hardware counter configuration to API form.                      */
-/* ================================================================================== */
+/* True if a slot of the module is triggered by the CTIM */
 
-static CtrDrvrCounterConfiguration *HardToConfig(volatile CtrDrvrHwCounterConfiguration *hcnf) {
-static CtrDrvrCounterConfiguration scnf;
-unsigned int config;
+static int CtimInUse(CtrDrvrModuleContext *mcon, unsigned int ctim) {
+int k;
+
+   for (k = mcon->CtimSlotHash[EqpHash(ctim)]; k; k = mcon->CtimSlotNext[k - 1])
+      if (mcon->Trigs[k - 1].Ctim == ctim) return 1;
+   return 0;
+}
 
-   config     = hcnf->Config;
-   scnf.Delay = hcnf->Delay;
+/* Lowest empty slot or -1 if the table is full */
 
-   scnf.OnZero    = AutoShiftRight(CtrDrvrCounterConfigON_ZERO_MASK    ,config);
-   scnf.Start     = AutoShiftRight(CtrDrvrCounterConfigSTART_MASK      ,config);
-   scnf.Mode      = AutoShiftRight(CtrDrvrCounterConfigMODE_MASK       ,config);
-   scnf.Clock     = AutoShiftRight(CtrDrvrCounterConfigCLOCK_MASK      ,config);
-   scnf.PulsWidth = AutoShiftRight(CtrDrvrCounterConfigPULSE_WIDTH_MASK,config);
+static int FindFreeSlot(CtrDrvrModuleContext *mcon) {
+int i;
 
-   return &scnf;
+   for (i = mcon->FreeSlot; i < CtrDrvrRamTableSIZE; i++) {
+      if (mcon->EqpNum[i] == 0) break;
+   }
+   mcon->FreeSlot = i;
+   if (i < CtrDrvrRamTableSIZE) return i;
+   return -1;
 }
 
 /* ========================================================== */
@@ -1449,11 +1508,8 @@ unsigned int config;
 static unsigned int GetPtimModule(unsigned int eqpnum) {
 int i;
 
-   for (i=0; i<Wa->Ptim.Size; i++) {
-      if (eqpnum == Wa->Ptim.Objects[i].EqpNum) {
-	 return Wa->Ptim.Objects[i].ModuleIndex + 1;
-      }
-   }
+   i = PtimFind(eqpnum);
+   if (i >= 0) return Wa->Ptim.Objects[i].ModuleIndex + 1;
    return 0;
 }
 
@@ -1493,15 +1549,13 @@ int i, midx, cmsk, hmsk, count;
       if (midx >= 0) {
 	 mcon = &(Wa->ModuleContexts[midx]);
 	 mmap = mcon->Map;
-	 for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	    if ((conx->EqpNum   == mcon->EqpNum[i])
-	    &&  (conx->EqpClass == mcon->EqpClass[i])) {
-	       count++;
-	       mcon->Clients[i]        |= cmsk;
-	       mcon->InterruptEnable   |= (1 << mcon->Trigs[i].Counter);
-	       mmap->Configs[i].Config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK,
-						     CtrDrvrCounterOnZeroBUS);
-	    }
+	 for (i=SlotNextOwned(mcon,-1,conx->EqpNum,conx->EqpClass); i>=0;
+	      i=SlotNextOwned(mcon,i,conx->EqpNum,conx->EqpClass)) {
+	    count++;
+	    mcon->Clients[i]        |= cmsk;
+	    mcon->InterruptEnable   |= (1 << mcon->Trigs[i].Counter);
+	    mmap->Configs[i].Config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK,
+						  CtrDrvrCounterOnZeroBUS);
 	 }
       }
 
@@ -1511,66 +1565,56 @@ int i, midx, cmsk, hmsk, count;
 
       /* Check to see if there is already an instance, and connect to it */
 
-      for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	 if ((conx->EqpNum   == mcon->EqpNum[i])
-	 &&  (conx->EqpClass == mcon->EqpClass[i])) {
-	    mcon->Clients[i]        |= cmsk;
-	    mcon->InterruptEnable   |= CtrDrvrInterruptMaskCOUNTER_0;
-	    mmap->Configs[i].Config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK,
-						     CtrDrvrCounterOnZeroBUS);
-	    count = 1;
-	    break;
-	 }
+      i = SlotFirstOwned(mcon,conx->EqpNum,conx->EqpClass);
+      if (i >= 0) {
+	 mcon->Clients[i]        |= cmsk;
+	 mcon->InterruptEnable   |= CtrDrvrInterruptMaskCOUNTER_0;
+	 mmap->Configs[i].Config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK,
+						  CtrDrvrCounterOnZeroBUS);
+	 count = 1;
       }
 
       /* Need to create a new CTIM instance, so first find the CTIM object */
 
       if (count == 0) {
 	 frme.Struct = (CtrDrvrFrameStruct) {0,0,0};    /* No frame has been found yet */
-	 for (i=0; i<Wa->Ctim.Size; i++) {
-	    if (conx->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-	       frme = Wa->Ctim.Objects[i].Frame;
-	       break;
-	    }
-	 }
+	 i = CtimFind(conx->EqpNum);
+	 if (i >= 0) frme = Wa->Ctim.Objects[i].Frame;
 
 	 /* If we found the CTIM object, look for an empty slot and create the instance */
 
 	 if (frme.Struct.Header != 0) {
-	    for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	       if (mcon->EqpNum[i] == 0) {      /* Is the slot empty ? */
-		  mcon->EqpNum[i]   = conx->EqpNum;
-		  mcon->EqpClass[i] = CtrDrvrConnectionClassCTIM;
-
-		  trig.Ctim             = conx->EqpNum;
-		  trig.Frame            = frme;
-		  trig.TriggerCondition = CtrDrvrTriggerConditionNO_CHECK;
-		  trig.Machine          = CtrDrvrMachineNONE;
-		  trig.Counter          = CtrDrvrCounter0;
-		  trig.Group            = (CtrDrvrTgmGroup) {0,0}; /* Number and Value */
-		  mcon->Trigs[i]        = trig;
-
-		  conf.OnZero           = CtrDrvrCounterOnZeroBUS;
-		  conf.Start            = CtrDrvrCounterStartNORMAL;
-		  conf.Mode             = CtrDrvrCounterModeNORMAL;
-		  conf.Clock            = CtrDrvrCounterClock1KHZ;
-		  conf.Delay            = 0;
-		  conf.PulsWidth        = 0;
-		  mcon->Configs[i]      = conf;
+	    i = FindFreeSlot(mcon);
+	    if (i >= 0) {
+	       SetSlotOwner(mcon,i,conx->EqpNum,CtrDrvrConnectionClassCTIM);
+
+	       trig.Ctim             = conx->EqpNum;
+	       trig.Frame            = frme;
+	       trig.TriggerCondition = CtrDrvrTriggerConditionNO_CHECK;
+	       trig.Machine          = CtrDrvrMachineNONE;
+	       trig.Counter          = CtrDrvrCounter0;
+	       trig.Group            = (CtrDrvrTgmGroup) {0,0}; /* Number and Value */
+	       SetSlotTrigger(mcon,i,&trig);
+
+	       conf.OnZero           = CtrDrvrCounterOnZeroBUS;
+	       conf.Start            = CtrDrvrCounterStartNORMAL;
+	       conf.Mode             = CtrDrvrCounterModeNORMAL;
+	       conf.Clock            = CtrDrvrCounterClock1KHZ;
+	       conf.Delay            = 0;
+	       conf.PulsWidth        = 0;
+	       mcon->Configs[i]      = conf;
 
-		  Int32Copy((unsigned int *) &(mmap->Trigs[i]),
-			   (unsigned int *) TriggerToHard(&trig),
-			   (unsigned int  ) sizeof(CtrDrvrHwTrigger));
+	       Int32Copy((unsigned int *) &(mmap->Trigs[i]),
+			(unsigned int *) TriggerToHard(&trig),
+			(unsigned int  ) sizeof(CtrDrvrHwTrigger));
 
-		  Int32Copy((unsigned int *) &(mmap->Configs[i]),
-			   (unsigned int *) ConfigToHard(&conf),
-			   (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
+	       Int32Copy((unsigned int *) &(mmap->Configs[i]),
+			(unsigned int *) ConfigToHard(&conf),
+			(unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 
-		  mcon->Clients[i]      |= cmsk;
-		  mcon->InterruptEnable |= CtrDrvrInterruptMaskCOUNTER_0;
-		  count = 1;
-		  break;
-	       }
+	       mcon->Clients[i]      |= cmsk;
+	       mcon->InterruptEnable |= CtrDrvrInterruptMaskCOUNTER_0;
+	       count = 1;
 	    }
 
 	    /* Give a NOMEM error if no empty slot available */
@@ -1642,8 +1686,7 @@ unsigned int ncmsk, cmsk;
 			(unsigned int *) ConfigToHard(&conf),
 			(unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 
-	       mcon->EqpNum[tndx]   = 0;
-	       mcon->EqpClass[tndx] = 0;
+	       SetSlotOwner(mcon,tndx,0,0);
 
 	    } else {
 
@@ -1674,15 +1717,16 @@ static int DisConnect(CtrDrvrConnection    *conx,
 		      CtrDrvrClientContext *ccon) {
 
 CtrDrvrModuleContext *mcon;
-int i, midx;
+int i, n, midx;
 
    midx = conx->Module -1;
    mcon = &(Wa->ModuleContexts[midx]);
 
    if (conx->EqpClass != CtrDrvrConnectionClassHARD) {
-      for (i=0; i<CtrDrvrRamTableSIZE; i++)
-	 if ((conx->EqpNum   == mcon->EqpNum[i])
-	 &&  (conx->EqpClass == mcon->EqpClass[i])) DisConnectOne(i,midx,conx->EqpClass,ccon);
+      for (i=SlotNextOwned(mcon,-1,conx->EqpNum,conx->EqpClass); i>=0; i=n) {
+	 n = SlotNextOwned(mcon,i,conx->EqpNum,conx->EqpClass);
+	 DisConnectOne(i,midx,conx->EqpClass,ccon);
+      }
 
    } else for (i=0; i<CtrDrvrInterruptSOURCES; i++) DisConnectOne(i,midx,CtrDrvrConnectionClassHARD,ccon);
 
@@ -1710,6 +1754,101 @@ int i, midx;
    return OK;
 }
 
+/* ========================================================== */
+/* Client queue setup, QueuePut and QueueGet are shared       */
+/* ========================================================== */
+
+/* Set the queue depth and entry format, anything on the queue is lost */
+
+static int QueueSetup(CtrDrvrClientContext *ccon, CtrDrvrQueueConfig *qcf) {
+
+CtrDrvrQueue *queue;
+unsigned int depth, size;
+unsigned long ps;
+char *mem, *old;
+unsigned int oldsize;
+
+   queue = &(ccon->Queue);
+
+   depth = qcf->Depth;
+   if (depth == 0) depth = CtrDrvrQUEUE_SIZE;
+   if ((depth > CtrDrvrQUEUE_MAX_DEPTH)
+   ||  ((qcf->Format != CtrDrvrQueueFormatFULL) && (qcf->Format != CtrDrvrQueueFormatCOMPACT))) {
+      pseterr(EINVAL);
+      return SYSERR;
+   }
+
+   if (qcf->Format == CtrDrvrQueueFormatCOMPACT) size = depth * sizeof(CtrDrvrCompactBuf);
+   else                                          size = depth * sizeof(CtrDrvrReadBuf);
+
+   mem = NULL;
+   if (size > sizeof(queue->Default)) {
+      mem = sysbrk(size);
+      if (mem == NULL) {
+	 pseterr(ENOMEM);
+	 return SYSERR;
+      }
+   }
+
+   disable(ps);
+   {
+      old     = queue->Alloc;
+      oldsize = queue->AllocSize;
+
+      queue->Alloc     = mem;
+      queue->AllocSize = mem ? size : 0;
+      if (mem == NULL) mem = (char *) queue->Default;
+      queue->Entries   = (CtrDrvrReadBuf    *) mem;
+      queue->Compact   = (CtrDrvrCompactBuf *) mem;
+      queue->Depth     = depth;
+      queue->Format    = qcf->Format;
+      queue->Size      = 0;
+      queue->RdPntr    = 0;
+      queue->WrPntr    = 0;
+      queue->Burst     = 0;
+      sreset(&(ccon->Semaphore));
+   }
+   restore(ps);
+
+   if (old) sysfree(old,oldsize);
+   return OK;
+}
+
+/* Stop queuing for a closed client and free its storage */
+
+static void QueueRelease(CtrDrvrClientContext *ccon) {
+
+CtrDrvrQueue *queue;
+unsigned long ps;
+char *old;
+unsigned int oldsize;
+
+   queue = &(ccon->Queue);
+
+   disable(ps);
+   {
+      old     = queue->Alloc;
+      oldsize = queue->AllocSize;
+
+      queue->Alloc     = NULL;
+      queue->AllocSize = 0;
+      queue->Depth     = 0;
+      queue->Size      = 0;
+   }
+   restore(ps);
+
+   if (old) sysfree(old,oldsize);
+}
+
+/* ========================================================== */
+/* Account the time spent in the ISR since t0                 */
+/* ========================================================== */
+
+static void IsrStatsUpdate(CtrDrvrModuleContext *mcon, ktime_t t0) {
+
+   IsrStatsAdd(mcon,(unsigned int) ktime_to_ns(ktime_sub(ktime_get(),t0)));
+}
+
 /* ========================================================== */
 /* The ISR                                                    */
 /* ========================================================== */
@@ -1718,17 +1857,13 @@ int debug_isr = 0;
 
 irqreturn_t IntrHandler(CtrDrvrModuleContext *mcon) {
 
-unsigned int  isrc, clients, msk, i, hlock, tndx = 0;
+unsigned int  isrc, clients, msk, tndx = 0;
 unsigned char inum;
-unsigned long ps;
+ktime_t       t0;
 
-CtrDrvrMemoryMap      *mmap = NULL;
-CtrDrvrFpgaCounter    *fpgc = NULL;
-CtrDrvrCounterHistory *hist = NULL;
+CtrDrvrMemoryMap *mmap = NULL;
 
-CtrDrvrQueue          *queue;
-CtrDrvrClientContext  *ccon;
-CtrDrvrReadBuf         rbf;
+   t0 = ktime_get();
 
    mmap = mcon->Map;
    isrc = mmap->InterruptSource;                 /* Read and clear interrupt sources */
@@ -1739,79 +1874,7 @@ CtrDrvrReadBuf         rbf;
    for (inum=0; inum<CtrDrvrInterruptSOURCES; inum++) {
       msk = 1 << inum;                           /* Get counter source mask bit */
       if (msk & isrc) {
-	 bzero((void *) &rbf, sizeof(CtrDrvrReadBuf));
-	 clients = 0;                            /* No clients yet */
-
-	 if (inum < CtrDrvrCOUNTERS) {           /* Counter Interrupt ? */
-	    fpgc = &(mmap->Counters[inum]);      /* Get counter FPGA configuration */
-	    hist = &(fpgc->History);             /* History of counter */
-
-	    if (fpgc->Control.LockConfig == 0) {    /* If counter not in remote */
-	       tndx = hist->Index;                  /* Index into trigger table */
-	       if (tndx < CtrDrvrRamTableSIZE) {
-
-		  clients = mcon->Clients[tndx];    /* Clients connected to timing objects */
-		  if (clients) {
-		     rbf.TriggerNumber = tndx +1;            /* Trigger that loaded counter */
-		     rbf.Frame         = hist->Frame;        /* Actual event that interrupted */
-		     rbf.TriggerTime   = hist->TriggerTime;  /* Time counter was loaded */
-		     rbf.StartTime     = hist->StartTime;    /* Time start arrived */
-		     rbf.OnZeroTime    = hist->OnZeroTime;   /* Time of interrupt */
-
-		     hlock = fpgc->Control.LockHistory;      /* Unlock history count Read/Clear */
-		     if (hlock > 1)
-			mcon->Status &= ~CtrDrvrStatusNO_LOST_INTERRUPTS;
-
-		     /* Copy the rest of the information from the module context */
-
-		     rbf.Ctim                = mcon->Trigs[tndx].Ctim;
-		     rbf.Connection.Module   = mcon->ModuleIndex +1;
-		     rbf.Connection.EqpClass = mcon->EqpClass[tndx];
-		     rbf.Connection.EqpNum   = mcon->EqpNum[tndx];
-		  }
-	       }
-	    }
-	 }
-
-	 if (clients == 0) {                     /* No object clients connections */
-	    clients = mcon->HardClients[inum];   /* Hardware only connection */
-	    if (clients) {
-	       if (inum < CtrDrvrCOUNTERS) rbf.OnZeroTime = hist->OnZeroTime;
-	       else                        rbf.OnZeroTime = *GetTime(mcon);
-	       rbf.Connection.Module   = mcon->ModuleIndex +1;
-	       rbf.Connection.EqpClass = CtrDrvrConnectionClassHARD;
-	       rbf.Connection.EqpNum   = msk;
-	    }
-	 }
-
-	 /* If client is connected to a hardware interrupt, and   */
-	 /* other clients are connected to a timing object on the */
-	 /* same counter; the client needs the interrupt number   */
-	 /* to know from where the interrupt came. */
-
-	 rbf.InterruptNumber = inum; /* Source of interrupt, Counter or other */
-
-	 /* Place read buffer on connected clients queues */
-
-	 clients |= mcon->HardClients[inum];
-	 for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) {
-	    if (clients & (1 << i)) {
-	       ccon = &(Wa->ClientContexts[i]);
-
-	       disable(ps);
-	       queue = &(ccon->Queue);
-	       queue->Entries[queue->WrPntr] = rbf;
-	       queue->WrPntr = (queue->WrPntr + 1) % CtrDrvrQUEUE_SIZE;
-	       if (queue->Size < CtrDrvrQUEUE_SIZE) {
-		  queue->Size++;
-		  ssignal(&(ccon->Semaphore));
-	       } else {
-		  queue->Missed++;
-		  queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-	       }
-	       restore(ps);
-	    }
-	 }
+	 clients = IsrSource(mcon,Wa->ClientContexts,inum,&tndx);
 
 	 if ((clients == 0) && (debug_isr)) {
 	    kkprintf("CtrDrvr: Spurious interrupt: Module:%d Source:0x%X Number:%d Tindex:%d\n",
@@ -1820,6 +1883,7 @@ CtrDrvrReadBuf         rbf;
 	 }
       }
    }
+   IsrStatsUpdate(mcon,t0);
    return IRQ_HANDLED;
 }
 
@@ -1864,6 +1928,9 @@ CtrDrvrClientContext * ccon;    /* Client context */
    ccon->Timeout     = CtrDrvrDEFAULT_TIMEOUT;
    ccon->InUse       = 1;
    ccon->Pid         = getpid();
+   ccon->Queue.Depth   = CtrDrvrQUEUE_SIZE;
+   ccon->Queue.Entries = ccon->Queue.Default;
+   ccon->Queue.Compact = (CtrDrvrCompactBuf *) ccon->Queue.Default;
    sreset(&(ccon->Semaphore));
    return OK;
 }
@@ -1905,6 +1972,10 @@ CtrDrvrClientContext *ccon; /* Client context */
 
       DisConnectAll(ccon);
 
+      /* Free the queue if it was made bigger */
+
+      QueueRelease(ccon);
+
       return(OK);
 
    } else {
@@ -1926,8 +1997,9 @@ int CtrDrvrRead(CtrDrvrWorkingArea *wa, struct LynxFile *flp, char *u_buf, int c
 
 CtrDrvrClientContext *ccon;    /* Client context */
 CtrDrvrQueue         *queue;
-CtrDrvrReadBuf       *rb;
 int                   cnum;    /* Client number */
+int                   esize;   /* Size of one queue entry */
+int                   i, k, n, max;
 unsigned long         ps;
 
    ps = 0;
@@ -1936,6 +2008,16 @@ unsigned long         ps;
    ccon = &(wa->ClientContexts[cnum]);
 
    queue = &(ccon->Queue);
+   if (queue->Format == CtrDrvrQueueFormatCOMPACT) esize = sizeof(CtrDrvrCompactBuf);
+   else                                            esize = sizeof(CtrDrvrReadBuf);
+   if (cnt < esize) {
+
+      /* EINVAL = "Invalid argument" */
+
+      pseterr(EINVAL);  /* Buffer too small for one entry */
+      return 0;
+   }
+
    if (queue->QueueOff) {
       disable(ps);
       {
@@ -1981,16 +2063,24 @@ unsigned long         ps;
       }
    }
 
-   rb = (CtrDrvrReadBuf *) u_buf;
+   /* Return as many entries as are queued and fit in the buffer.  */
+   /* Interrupts are only held off for a limited number at a time. */
+
    if (queue->Size) {
-      disable(ps);
-      {
-	 *rb = queue->Entries[queue->RdPntr];
-	 queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-	 queue->Size--;
-      }
-      restore(ps);
-      return sizeof(CtrDrvrReadBuf);
+      max = cnt / esize;
+      n = 0;
+      do {
+	 disable(ps);
+	 k = QueueGet(queue,u_buf,n,max);
+	 restore(ps);
+	 n += k;
+      } while ((k == CtrDrvrQUEUE_SIZE) && (n < max));
+
+      /* swait took the count for the first entry, take the others */
+
+      for (i=1; i<n; i++) tswait(&(ccon->Semaphore), SEM_SIGIGNORE, 0);
+
+      return n * esize;
    }
 
    pseterr(EINTR);
@@ -2008,7 +2098,6 @@ int CtrDrvrWrite(CtrDrvrWorkingArea *wa, struct LynxFile *flp, char *u_buf, int
 
 CtrDrvrClientContext *ccon;    /* Client context */
 CtrDrvrModuleContext *mcon;
-CtrDrvrQueue         *queue;
 CtrDrvrConnection    *conx;
 CtrDrvrReadBuf        rb;
 CtrDrvrWriteBuf      *wb;
@@ -2036,17 +2125,14 @@ unsigned int          clients;
 
 	 /* This code provokes the first matching trigger */
 
-	 for (tndx=0; tndx<CtrDrvrRamTableSIZE; tndx++) {
-	    if ((mcon->EqpNum[tndx]   == conx->EqpNum)
-	    &&  (mcon->EqpClass[tndx] == conx->EqpClass)) {
-	       clients = mcon->Clients[tndx];
-	       rb.TriggerNumber = tndx +1;
-	       rb.Frame = mcon->Trigs[tndx].Frame;
-	       rb.Frame.Struct.Value = wb->Payload;
-	       rb.Ctim = mcon->Trigs[tndx].Ctim;
-	       rb.InterruptNumber = mcon->Trigs[tndx].Counter;
-	       break;
-	    }
+	 tndx = SlotFirstOwned(mcon,conx->EqpNum,conx->EqpClass);
+	 if (tndx >= 0) {
+	    clients = mcon->Clients[tndx];
+	    rb.TriggerNumber = tndx +1;
+	    rb.Frame = mcon->Trigs[tndx].Frame;
+	    rb.Frame.Struct.Value = wb->Payload;
+	    rb.Ctim = mcon->Trigs[tndx].Ctim;
+	    rb.InterruptNumber = mcon->Trigs[tndx].Counter;
 	 }
       } else {
 	 tndx = wb->TriggerNumber -1;
@@ -2078,18 +2164,8 @@ unsigned int          clients;
       for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) {
 	 if (clients & (1 << i)) {
 	    ccon = &(Wa->ClientContexts[i]);
-	    queue = &(ccon->Queue);
-
 	    disable(ps);
-	    queue->Entries[queue->WrPntr] = rb;
-	    queue->WrPntr = (queue->WrPntr + 1) % CtrDrvrQUEUE_SIZE;
-	    if (queue->Size < CtrDrvrQUEUE_SIZE) {
-	       queue->Size++;
-	       ssignal(&(ccon->Semaphore));
-	    } else {
-	       queue->Missed++;
-	       queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-	    }
+	    QueuePut(ccon,&rb);
 	    restore(ps);
 	 }
       }
@@ -2318,7 +2394,6 @@ CtrDrvrVersion                 *ver;
 CtrDrvrModuleAddress           *moad;
 CtrDrvrCTime                   *ctod;
 CtrDrvrHwTrigger               *htrg;
-CtrDrvrTrigger                 *strg;
 CtrDrvrAction                  *act;
 CtrDrvrCtimBinding             *ctim;
 CtrDrvrPtimBinding             *ptim;
@@ -2336,6 +2411,8 @@ CtrDrvrEventHistory            *evhs;
 CtrDrvrReceptionErrors         *rcpe;
 CtrDrvrBoardId                 *bird;
 CtrDrvrModuleStats             *mods;
+CtrDrvrIsrStats                *isrs;
+CtrDrvrQueueStats              *qsts;
 
 volatile CtrDrvrMemoryMap   *mmap;
 
@@ -2345,6 +2422,7 @@ int cnum;                 /* Client number */
 long lav, *lap;           /* Long Value pointed to by Arg */
 unsigned short sav;       /* Short argument and for Jtag IO */
 int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
+unsigned long ps;         /* Processor status for disable/restore */
 
 unsigned int  lval;      /* For general IO stuff */
 unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
@@ -2494,6 +2572,25 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 	 }
       break;
 
+      case CtrDrvrSET_QUEUE_CONFIG:       /* Set queue depth and entry format */
+	 if (rcnt >= sizeof(CtrDrvrQueueConfig)) {
+	    return QueueSetup(ccon,(CtrDrvrQueueConfig *) arg);
+	 }
+      break;
+
+      case CtrDrvrGET_QUEUE_STATS:        /* Queue statistics, cleared on read */
+	 if (wcnt >= sizeof(CtrDrvrQueueStats)) {
+	    qsts = (CtrDrvrQueueStats *) arg;
+	    disable(ps);
+	    *qsts = ccon->Queue.Stats;
+	    qsts->Depth = ccon->Queue.Depth;
+	    qsts->Size  = ccon->Queue.Size;
+	    bzero((void *) &(ccon->Queue.Stats), sizeof(CtrDrvrQueueStats));
+	    restore(ps);
+	    return OK;
+	 }
+      break;
+
       case CtrDrvrSET_MODULE_BY_SLOT:     /* Select the module to work with by ID */
 	 if (lap) {
 	    for (i=0; i<Wa->Modules; i++) {
@@ -2958,15 +3055,14 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 		  }
 
 	       } else {
-		  mcon->EqpNum[i] = act->EqpNum;
-		  mcon->EqpClass[i] = act->EqpClass;
+		  SetSlotOwner(mcon,i,act->EqpNum,act->EqpClass);
 		  mcon->Trigs[i].Counter = act->Trigger.Counter;
 	       }
 
 	       Int32Copy((unsigned int *) &(mmap->Trigs[i]),
 			(unsigned int *) TriggerToHard(&act->Trigger),
 			(unsigned int  ) sizeof(CtrDrvrHwTrigger));
-	       mcon->Trigs[i] = act->Trigger;
+	       SetSlotTrigger(mcon,i,&(act->Trigger));
 
 	       /* Override bus interrupt settings for connected clients */
 
@@ -2988,16 +3084,12 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
       case CtrDrvrCREATE_CTIM_OBJECT:     /* Create a new CTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  pseterr(EBUSY);        /* Already defined */
-		  return SYSERR;
-	       }
+	    if (CtimFind(ctim->EqpNum) >= 0) {
+	       pseterr(EBUSY);        /* Already defined */
+	       return SYSERR;
 	    }
-	    i = Wa->Ctim.Size;
-	    if (i<CtrDrvrCtimOBJECTS) {
-	       Wa->Ctim.Objects[i] = *ctim;
-	       Wa->Ctim.Size = i +1;
+	    if (Wa->Ctim.Size < CtrDrvrCtimOBJECTS) {
+	       CtimAdd(ctim);
 	       return OK;
 	    }
 	    pseterr(ENOMEM);
@@ -3008,19 +3100,14 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
       case CtrDrvrDESTROY_CTIM_OBJECT:    /* Destroy a CTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  for (j=0; j<CtrDrvrRamTableSIZE; j++) {
-		     strg = &(mcon->Trigs[j]);
-		     if (strg->Ctim == ctim->EqpNum) {
-			pseterr(EBUSY);   /* In use by ptim object */
-			return SYSERR;
-		     }
-		  }
-		  Wa->Ctim.Objects[i] = Wa->Ctim.Objects[Wa->Ctim.Size -1];
-		  Wa->Ctim.Size--;
-		  return OK;
+	    i = CtimFind(ctim->EqpNum);
+	    if (i >= 0) {
+	       if (CtimInUse(mcon,ctim->EqpNum)) {
+		  pseterr(EBUSY);   /* In use by ptim object */
+		  return SYSERR;
 	       }
+	       CtimDel(i);
+	       return OK;
 	    }
 	 }
       break;
@@ -3028,18 +3115,14 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
       case CtrDrvrCHANGE_CTIM_FRAME:      /* Change the frame of an existing CTIM object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  for (j=0; j<CtrDrvrRamTableSIZE; j++) {
-		     strg = &(mcon->Trigs[j]);
-		     if (strg->Ctim == ctim->EqpNum) {
-			pseterr(EBUSY);   /* In use by ptim object */
-			return SYSERR;
-		     }
-		  }
-		  Wa->Ctim.Objects[i].Frame.Long = ctim->Frame.Long;
-		  return OK;
+	    i = CtimFind(ctim->EqpNum);
+	    if (i >= 0) {
+	       if (CtimInUse(mcon,ctim->EqpNum)) {
+		  pseterr(EBUSY);   /* In use by ptim object */
+		  return SYSERR;
 	       }
+	       Wa->Ctim.Objects[i].Frame.Long = ctim->Frame.Long;
+	       return OK;
 	    }
 	 }
       break;
@@ -3055,11 +3138,9 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
       case CtrDrvrCREATE_PTIM_OBJECT:     /* Create a new PTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrPtimBinding)) {
 	    ptim = (CtrDrvrPtimBinding *) arg;
-	    for (i=0; i<Wa->Ptim.Size; i++) {
-	       if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		  pseterr(EBUSY);        /* Already defined */
-		  return SYSERR;
-	       }
+	    if (PtimFind(ptim->EqpNum) >= 0) {
+	       pseterr(EBUSY);        /* Already defined */
+	       return SYSERR;
 	    }
 	    if (Wa->Ptim.Size >= CtrDrvrPtimOBJECTS) {
 	       pseterr(ENOMEM);          /* No more place in memory */
@@ -3072,7 +3153,7 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 	       /* Look for available space in trigger table for specified module */
 
 	       found = size = start = 0;
-	       for (i=0; i<CtrDrvrRamTableSIZE; i++) {
+	       for (i=mcon->FreeSlot; i<CtrDrvrRamTableSIZE; i++) {
 		  if (mcon->EqpNum[i] == 0) {
 		     if (size == 0) start = i;
 		     if (++size >= ptim->Size) {
@@ -3084,13 +3165,12 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 
 	       if (found) {
 		  for (i=start; i<start+ptim->Size; i++) {
-		     mcon->EqpNum[i]   = ptim->EqpNum;
-		     mcon->EqpClass[i] = CtrDrvrConnectionClassPTIM;
+		     SetSlotOwner(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM);
 		     mcon->Trigs[i].Counter = ptim->Counter;
 		  }
 
 		  ptim->StartIndex = start;
-		  Wa->Ptim.Objects[Wa->Ptim.Size++] = *ptim;
+		  PtimAdd(ptim);
 		  return OK;
 	       }
 	    }
@@ -3100,11 +3180,10 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
       case CtrDrvrGET_PTIM_BINDING:     /* Search for a PTIM object binding */
 	 if (rcnt >= sizeof(CtrDrvrPtimBinding)) {
 	    ptim = (CtrDrvrPtimBinding *) arg;
-	    for (i=0; i<Wa->Ptim.Size; i++) {
-	       if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		  *ptim = Wa->Ptim.Objects[i];
-		  return OK;
-	       }
+	    i = PtimFind(ptim->EqpNum);
+	    if (i >= 0) {
+	       *ptim = Wa->Ptim.Objects[i];
+	       return OK;
 	    }
 	    bzero((void *) ptim, sizeof(CtrDrvrPtimBinding));
 	 }
@@ -3120,44 +3199,33 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 	    mmap = (CtrDrvrMemoryMap *) mcon->Map;
 
 	    found = 0;
-	    for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	       if ((mcon->EqpNum[i]   == ptim->EqpNum)
-	       &&  (mcon->EqpClass[i] == CtrDrvrConnectionClassPTIM)) {
-		  if (mcon->Clients[i]) {
-		     pseterr(EBUSY);      /* Object is in use by connected client */
-		     return SYSERR;
-		  }
-		  found = 1;
+	    for (i=SlotNextOwned(mcon,-1,ptim->EqpNum,CtrDrvrConnectionClassPTIM); i>=0;
+		 i=SlotNextOwned(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM)) {
+	       if (mcon->Clients[i]) {
+		  pseterr(EBUSY);      /* Object is in use by connected client */
+		  return SYSERR;
 	       }
+	       found = 1;
 	    }
 
 	    if (found) {
-	       for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-		  if ((mcon->EqpNum[i]   == ptim->EqpNum)
-		  &&  (mcon->EqpClass[i] == CtrDrvrConnectionClassPTIM)) {
-
-		     htrg = &((CtrDrvrHwTrigger) {{0},0});
-		     Int32Copy((unsigned int *) &(mmap->Trigs[i]),
-			      (unsigned int *) htrg,
-			      (unsigned int  ) sizeof(CtrDrvrHwTrigger));
-
-		     mcon->EqpNum[i]   = 0;
-		     mcon->EqpClass[i] = 0;
-		     bzero((void *) &(mcon->Configs[i]),sizeof(CtrDrvrCounterConfiguration));
-		     bzero((void *) &(mcon->Trigs[i]  ),sizeof(CtrDrvrTrigger));
-		     Int32Copy((unsigned int *) &(mmap->Configs[i]),
-			      (unsigned int *) ConfigToHard(&(mcon->Configs[i])),
-			      (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
-		  }
-	       }
+	       for (i=SlotNextOwned(mcon,-1,ptim->EqpNum,CtrDrvrConnectionClassPTIM); i>=0; i=n) {
+		  n = SlotNextOwned(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM);
+		  htrg = &((CtrDrvrHwTrigger) {{0},0});
+		  Int32Copy((unsigned int *) &(mmap->Trigs[i]),
+			   (unsigned int *) htrg,
+			   (unsigned int  ) sizeof(CtrDrvrHwTrigger));
 
-	       for (i=0; i<Wa->Ptim.Size; i++) {
-		  if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		     Wa->Ptim.Objects[i] = Wa->Ptim.Objects[Wa->Ptim.Size -1];
-		     Wa->Ptim.Size--;
-		     break;
-		  }
+		  SetSlotOwner(mcon,i,0,0);
+		  bzero((void *) &(mcon->Configs[i]),sizeof(CtrDrvrCounterConfiguration));
+		  SetSlotTrigger(mcon,i,&((CtrDrvrTrigger) {0}));
+		  Int32Copy((unsigned int *) &(mmap->Configs[i]),
+			   (unsigned int *) ConfigToHard(&(mcon->Configs[i])),
+			   (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 	       }
+
+	       i = PtimFind(ptim->EqpNum);
+	       if (i >= 0) PtimDel(i);
 	       return OK;
 	    }
 	 }
@@ -3267,6 +3335,17 @@ unsigned int cntrl;      /* PLX9030 serial EEPROM control register */
 	 }
       break;
 
+      case CtrDrvrGET_ISR_STATS:          /* Interrupt handler duration */
+	 if (wcnt >= sizeof(CtrDrvrIsrStats)) {
+	    isrs = (CtrDrvrIsrStats *) arg;
+	    disable(ps);
+	    *isrs = mcon->IsrStats;
+	    mcon->IsrStats.MaxNs = 0;
+	    restore(ps);
+	    return OK;
+	 }
+      break;
+
       case CtrDrvrGET_OUT_MASK:           /* Counter output routing mask */
 	 if (wcnt >= sizeof(CtrDrvrCounterMaskBuf)) {
 	    cmsb = (CtrDrvrCounterMaskBuf *) arg;
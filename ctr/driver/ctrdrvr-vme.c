@@ -39,6 +39,7 @@ extern int first_module;
 
 #include <vmebus.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
 
 #ifndef VME_PG_SHARED
 #define VME_PG_SHARED 0
@@ -418,7 +419,7 @@ char *ioctl_names[CtrDrvrLAST_IOCTL] = {
 "JTAG_WRITE_BYTE", "JTAG_CLOSE", "HPTDC_OPEN", "HPTDC_IO", "HPTDC_CLOSE", "RAW_READ", "RAW_WRITE",
 "GET_RECEPTION_ERRORS", "GET_IO_STATUS", "GET_IDENTITY",
 "SET_DEBUG_HISTORY","SET_BRUTAL_PLL","GET_MODULE_STATS","SET_CABLE_ID",
-"IOCTL64","IOCTL65","IOCTL66","IOCTL67","IOCTL68","IOCTL69",
+"GET_ISR_STATS","SET_QUEUE_CONFIG","GET_QUEUE_STATS","IOCTL67","IOCTL68","IOCTL69",
 
 "GET_OUTPUT_BYTE",
 "SET_OUTPUT_BYTE",
@@ -1108,6 +1109,186 @@ unsigned int config;
    return &scnf;
 }
 
+/* ========================================================== */
+/* Hash indexes on EqpNum, so that objects and trigger table  */
+/* slots are found without scanning. The chains are threaded  */
+/* through Next arrays holding index+1, zero ends a chain.    */
+/* ========================================================== */
+
+static unsigned int EqpHash(unsigned int eqpnum) {
+   return (eqpnum * 2654435761U) >> (32 - CtrDrvrHASH_BITS);
+}
+
+static void ChainAdd(unsigned short *head, unsigned short *next, int i) {
+   next[i] = *head;
+   *head = i + 1;
+}
+
+static void ChainDel(unsigned short *head, unsigned short *next, int i) {
+unsigned short *p;
+
+   for (p = head; *p; p = &(next[*p - 1])) {
+      if (*p == i + 1) {
+	 *p = next[i];
+	 next[i] = 0;
+	 return;
+      }
+   }
+}
+
+/* ========================================================== */
+/* CTIM and PTIM objects: find returns the index or -1, and   */
+/* delete moves the last object into the freed place.         */
+/* ========================================================== */
+
+static int CtimFind(unsigned int eqpnum) {
+int i;
+
+   for (i = Wa->CtimHash[EqpHash(eqpnum)]; i; i = Wa->CtimNext[i - 1])
+      if (Wa->Ctim.Objects[i - 1].EqpNum == eqpnum) return i - 1;
+   return -1;
+}
+
+static void CtimAdd(CtrDrvrCtimBinding *ctim) {
+int i;
+
+   i = Wa->Ctim.Size++;
+   Wa->Ctim.Objects[i] = *ctim;
+   ChainAdd(&(Wa->CtimHash[EqpHash(ctim->EqpNum)]),Wa->CtimNext,i);
+}
+
+static void CtimDel(int i) {
+int last;
+
+   last = Wa->Ctim.Size - 1;
+   ChainDel(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[i].EqpNum)]),Wa->CtimNext,i);
+   if (i != last) {
+      ChainDel(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[last].EqpNum)]),Wa->CtimNext,last);
+      Wa->Ctim.Objects[i] = Wa->Ctim.Objects[last];
+      ChainAdd(&(Wa->CtimHash[EqpHash(Wa->Ctim.Objects[i].EqpNum)]),Wa->CtimNext,i);
+   }
+   Wa->Ctim.Size = last;
+}
+
+static int PtimFind(unsigned int eqpnum) {
+int i;
+
+   for (i = Wa->PtimHash[EqpHash(eqpnum)]; i; i = Wa->PtimNext[i - 1])
+      if (Wa->Ptim.Objects[i - 1].EqpNum == eqpnum) return i - 1;
+   return -1;
+}
+
+static void PtimAdd(CtrDrvrPtimBinding *ptim) {
+int i;
+
+   i = Wa->Ptim.Size++;
+   Wa->Ptim.Objects[i] = *ptim;
+   ChainAdd(&(Wa->PtimHash[EqpHash(ptim->EqpNum)]),Wa->PtimNext,i);
+}
+
+static void PtimDel(int i) {
+int last;
+
+   last = Wa->Ptim.Size - 1;
+   ChainDel(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[i].EqpNum)]),Wa->PtimNext,i);
+   if (i != last) {
+      ChainDel(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[last].EqpNum)]),Wa->PtimNext,last);
+      Wa->Ptim.Objects[i] = Wa->Ptim.Objects[last];
+      ChainAdd(&(Wa->PtimHash[EqpHash(Wa->Ptim.Objects[i].EqpNum)]),Wa->PtimNext,i);
+   }
+   Wa->Ptim.Size = last;
+}
+
+/* ========================================================== */
+/* Trigger table slots. All changes of a slot's EqpNum must   */
+/* go through SetSlotOwner to keep the index up to date.      */
+/* ========================================================== */
+
+static void SetSlotOwner(CtrDrvrModuleContext  *mcon,
+			 int                    i,
+			 unsigned int           eqpnum,
+			 CtrDrvrConnectionClass clss) {
+
+   if (mcon->EqpNum[i])
+      ChainDel(&(mcon->SlotHash[EqpHash(mcon->EqpNum[i])]),mcon->SlotNext,i);
+
+   mcon->EqpNum[i]   = eqpnum;
+   mcon->EqpClass[i] = clss;
+
+   if (eqpnum) ChainAdd(&(mcon->SlotHash[EqpHash(eqpnum)]),mcon->SlotNext,i);
+   else if (i < mcon->FreeSlot) mcon->FreeSlot = i;
+}
+
+/* Next slot after i owned by (eqpnum, clss), i = -1 for the */
+/* first one. Returns -1 when there are no more.             */
+
+static int SlotNextOwned(CtrDrvrModuleContext  *mcon,
+			 int                    i,
+			 unsigned int           eqpnum,
+			 CtrDrvrConnectionClass clss) {
+int k;
+
+   if (i < 0) k = mcon->SlotHash[EqpHash(eqpnum)];
+   else       k = mcon->SlotNext[i];
+
+   for (; k; k = mcon->SlotNext[k - 1]) {
+      if ((mcon->EqpNum[k - 1]   == eqpnum)
+      &&  (mcon->EqpClass[k - 1] == clss)) return k - 1;
+   }
+   return -1;
+}
+
+/* Lowest slot owned by (eqpnum, clss) or -1 */
+
+static int SlotFirstOwned(CtrDrvrModuleContext  *mcon,
+			  unsigned int           eqpnum,
+			  CtrDrvrConnectionClass clss) {
+int i, first;
+
+   first = -1;
+   for (i = SlotNextOwned(mcon,-1,eqpnum,clss); i >= 0; i = SlotNextOwned(mcon,i,eqpnum,clss))
+      if ((first < 0) || (i < first)) first = i;
+   return first;
+}
+
+/* Set the trigger of slot i. All changes of a slot's Ctim must */
+/* go through here to keep the CTIM users index up to date.     */
+
+static void SetSlotTrigger(CtrDrvrModuleContext *mcon,
+			   int                   i,
+			   CtrDrvrTrigger       *trig) {
+
+   if (mcon->Trigs[i].Ctim)
+      ChainDel(&(mcon->CtimSlotHash[EqpHash(mcon->Trigs[i].Ctim)]),mcon->CtimSlotNext,i);
+
+   mcon->Trigs[i] = *trig;
+
+   if (trig->Ctim) ChainAdd(&(mcon->CtimSlotHash[EqpHash(trig->Ctim)]),mcon->CtimSlotNext,i);
+}
+
+/* True if a slot of the module is triggered by the CTIM */
+
+static int CtimInUse(CtrDrvrModuleContext *mcon, unsigned int ctim) {
+int k;
+
+   for (k = mcon->CtimSlotHash[EqpHash(ctim)]; k; k = mcon->CtimSlotNext[k - 1])
+      if (mcon->Trigs[k - 1].Ctim == ctim) return 1;
+   return 0;
+}
+
+/* Lowest empty slot or -1 if the table is full */
+
+static int FindFreeSlot(CtrDrvrModuleContext *mcon) {
+int i;
+
+   for (i = mcon->FreeSlot; i < CtrDrvrRamTableSIZE; i++) {
+      if (mcon->EqpNum[i] == 0) break;
+   }
+   mcon->FreeSlot = i;
+   if (i < CtrDrvrRamTableSIZE) return i;
+   return -1;
+}
+
 /* ========================================================== */
 /* Get a PTIM module number                                   */
 /* ========================================================== */
@@ -1115,11 +1296,8 @@ unsigned int config;
 static unsigned int GetPtimModule(unsigned int eqpnum) {
 int i;
 
-   for (i=0; i<Wa->Ptim.Size; i++) {
-      if (eqpnum == Wa->Ptim.Objects[i].EqpNum) {
-	 return Wa->Ptim.Objects[i].ModuleIndex + 1;
-      }
-   }
+   i = PtimFind(eqpnum);
+   if (i >= 0) return Wa->Ptim.Objects[i].ModuleIndex + 1;
    return 0;
 }
 
@@ -1159,16 +1337,14 @@ int i, midx, cmsk, hmsk, count, valu;
       if (midx >= 0) {
 	 mcon = &(Wa->ModuleContexts[midx]);
 	 mmap = mcon->Map;
-	 for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	    if ((conx->EqpNum   == mcon->EqpNum[i])
-	    &&  (conx->EqpClass == mcon->EqpClass[i])) {
-	       count++;
-	       mcon->Clients[i]        |= cmsk;
-	       mcon->InterruptEnable   |= (1 << mcon->Trigs[i].Counter);
-	       valu = HRd(&mmap->Configs[i].Config);
-	       valu |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK, CtrDrvrCounterOnZeroBUS);
-	       HWr(valu,&mmap->Configs[i].Config);
-	    }
+	 for (i=SlotNextOwned(mcon,-1,conx->EqpNum,conx->EqpClass); i>=0;
+	      i=SlotNextOwned(mcon,i,conx->EqpNum,conx->EqpClass)) {
+	    count++;
+	    mcon->Clients[i]        |= cmsk;
+	    mcon->InterruptEnable   |= (1 << mcon->Trigs[i].Counter);
+	    valu = HRd(&mmap->Configs[i].Config);
+	    valu |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK, CtrDrvrCounterOnZeroBUS);
+	    HWr(valu,&mmap->Configs[i].Config);
 	 }
       }
 
@@ -1178,67 +1354,57 @@ int i, midx, cmsk, hmsk, count, valu;
 
       /* Check to see if there is already an instance, and connect to it */
 
-      for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	 if ((conx->EqpNum   == mcon->EqpNum[i])
-	 &&  (conx->EqpClass == mcon->EqpClass[i])) {
-	    mcon->Clients[i]        |= cmsk;
-	    mcon->InterruptEnable   |= CtrDrvrInterruptMaskCOUNTER_0;
-	    valu = HRd(&mmap->Configs[i].Config);
-	    valu |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK, CtrDrvrCounterOnZeroBUS);
-	    HWr(valu,&mmap->Configs[i].Config);
-	    count = 1;
-	    break;
-	 }
+      i = SlotFirstOwned(mcon,conx->EqpNum,conx->EqpClass);
+      if (i >= 0) {
+	 mcon->Clients[i]        |= cmsk;
+	 mcon->InterruptEnable   |= CtrDrvrInterruptMaskCOUNTER_0;
+	 valu = HRd(&mmap->Configs[i].Config);
+	 valu |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK, CtrDrvrCounterOnZeroBUS);
+	 HWr(valu,&mmap->Configs[i].Config);
+	 count = 1;
       }
 
       /* Need to create a new CTIM instance, so first find the CTIM object */
 
       if (count == 0) {
 	 frme.Struct = (CtrDrvrFrameStruct) {0,0,0};    /* No frame has been found yet */
-	 for (i=0; i<Wa->Ctim.Size; i++) {
-	    if (conx->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-	       frme = Wa->Ctim.Objects[i].Frame;
-	       break;
-	    }
-	 }
+	 i = CtimFind(conx->EqpNum);
+	 if (i >= 0) frme = Wa->Ctim.Objects[i].Frame;
 
 	 /* If we found the CTIM object, look for an empty slot and create the instance */
 
 	 if (frme.Struct.Header != 0) {
-	    for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	       if (mcon->EqpNum[i] == 0) {      /* Is the slot empty ? */
-		  mcon->EqpNum[i]   = conx->EqpNum;
-		  mcon->EqpClass[i] = CtrDrvrConnectionClassCTIM;
-
-		  trig.Ctim             = conx->EqpNum;
-		  trig.Frame            = frme;
-		  trig.TriggerCondition = CtrDrvrTriggerConditionNO_CHECK;
-		  trig.Machine          = CtrDrvrMachineNONE;
-		  trig.Counter          = CtrDrvrCounter0;
-		  trig.Group            = (CtrDrvrTgmGroup) {0,0}; /* Number and Value */
-		  mcon->Trigs[i]        = trig;
-
-		  conf.OnZero           = CtrDrvrCounterOnZeroBUS;
-		  conf.Start            = CtrDrvrCounterStartNORMAL;
-		  conf.Mode             = CtrDrvrCounterModeNORMAL;
-		  conf.Clock            = CtrDrvrCounterClock1KHZ;
-		  conf.Delay            = 0;
-		  conf.PulsWidth        = 0;
-		  mcon->Configs[i]      = conf;
+	    i = FindFreeSlot(mcon);
+	    if (i >= 0) {
+	       SetSlotOwner(mcon,i,conx->EqpNum,CtrDrvrConnectionClassCTIM);
+
+	       trig.Ctim             = conx->EqpNum;
+	       trig.Frame            = frme;
+	       trig.TriggerCondition = CtrDrvrTriggerConditionNO_CHECK;
+	       trig.Machine          = CtrDrvrMachineNONE;
+	       trig.Counter          = CtrDrvrCounter0;
+	       trig.Group            = (CtrDrvrTgmGroup) {0,0}; /* Number and Value */
+	       SetSlotTrigger(mcon,i,&trig);
+
+	       conf.OnZero           = CtrDrvrCounterOnZeroBUS;
+	       conf.Start            = CtrDrvrCounterStartNORMAL;
+	       conf.Mode             = CtrDrvrCounterModeNORMAL;
+	       conf.Clock            = CtrDrvrCounterClock1KHZ;
+	       conf.Delay            = 0;
+	       conf.PulsWidth        = 0;
+	       mcon->Configs[i]      = conf;
 
-		  Io32Write((unsigned int *) &(mmap->Trigs[i]),
-			    (unsigned int *) TriggerToHard(&trig),
-			    (unsigned int  ) sizeof(CtrDrvrHwTrigger));
+	       Io32Write((unsigned int *) &(mmap->Trigs[i]),
+			 (unsigned int *) TriggerToHard(&trig),
+			 (unsigned int  ) sizeof(CtrDrvrHwTrigger));
 
-		  Io32Write((unsigned int *) &(mmap->Configs[i]),
-			    (unsigned int *) ConfigToHard(&conf),
-			    (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
+	       Io32Write((unsigned int *) &(mmap->Configs[i]),
+			 (unsigned int *) ConfigToHard(&conf),
+			 (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 
-		  mcon->Clients[i]      |= cmsk;
-		  mcon->InterruptEnable |= CtrDrvrInterruptMaskCOUNTER_0;
-		  count = 1;
-		  break;
-	       }
+	       mcon->Clients[i]      |= cmsk;
+	       mcon->InterruptEnable |= CtrDrvrInterruptMaskCOUNTER_0;
+	       count = 1;
 	    }
 
 	    /* Give a NOMEM error if no empty slot available */
@@ -1311,8 +1477,7 @@ int valu;
 			 (unsigned int *) ConfigToHard(&conf),
 			 (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 
-	       mcon->EqpNum[tndx]   = 0;
-	       mcon->EqpClass[tndx] = 0;
+	       SetSlotOwner(mcon,tndx,0,0);
 
 	    } else {
 
@@ -1344,15 +1509,16 @@ static int DisConnect(CtrDrvrConnection    *conx,
 		      CtrDrvrClientContext *ccon) {
 
 CtrDrvrModuleContext *mcon;
-int i, midx;
+int i, n, midx;
 
    midx = conx->Module -1;
    mcon = &(Wa->ModuleContexts[midx]);
 
    if (conx->EqpClass != CtrDrvrConnectionClassHARD) {
-      for (i=0; i<CtrDrvrRamTableSIZE; i++)
-	 if ((conx->EqpNum   == mcon->EqpNum[i])
-	 &&  (conx->EqpClass == mcon->EqpClass[i])) DisConnectOne(i,midx,conx->EqpClass,ccon);
+      for (i=SlotNextOwned(mcon,-1,conx->EqpNum,conx->EqpClass); i>=0; i=n) {
+	 n = SlotNextOwned(mcon,i,conx->EqpNum,conx->EqpClass);
+	 DisConnectOne(i,midx,conx->EqpClass,ccon);
+      }
 
    } else for (i=0; i<CtrDrvrInterruptSOURCES; i++) DisConnectOne(i,midx,CtrDrvrConnectionClassHARD,ccon);
 
@@ -1380,6 +1546,138 @@ int i, midx;
    return OK;
 }
 
+/* ========================================================== */
+/* Client queues. QueuePut is called with interrupts disabled */
+/* ========================================================== */
+
+static void QueuePut(CtrDrvrClientContext *ccon, CtrDrvrReadBuf *rbf) {
+
+CtrDrvrQueue *queue;
+
+   queue = &(ccon->Queue);
+   if (queue->Depth == 0) return;        /* Client not open */
+
+   if (queue->Format == CtrDrvrQueueFormatCOMPACT) {
+      queue->Compact[queue->WrPntr].Frame      = rbf->Frame;
+      queue->Compact[queue->WrPntr].OnZeroTime = rbf->OnZeroTime;
+   } else
+      queue->Entries[queue->WrPntr] = *rbf;
+
+   queue->WrPntr = (queue->WrPntr + 1) % queue->Depth;
+   if (++queue->Burst > queue->Stats.MaxBurst) queue->Stats.MaxBurst = queue->Burst;
+
+   if (queue->Size < queue->Depth) {
+      queue->Size++;
+      if (queue->Size > queue->Stats.MaxSize) queue->Stats.MaxSize = queue->Size;
+      ssignal(&(ccon->Semaphore));
+   } else {
+      queue->Missed++;
+      if (queue->Stats.Missed++ == 0) queue->Stats.FirstMissed = rbf->OnZeroTime;
+      queue->Stats.LastMissed = rbf->OnZeroTime;
+      queue->RdPntr = (queue->RdPntr + 1) % queue->Depth;
+   }
+}
+
+/* Set the queue depth and entry format, anything on the queue is lost */
+
+static int QueueSetup(CtrDrvrClientContext *ccon, CtrDrvrQueueConfig *qcf) {
+
+CtrDrvrQueue *queue;
+unsigned int depth, size;
+unsigned long ps;
+char *mem, *old;
+unsigned int oldsize;
+
+   queue = &(ccon->Queue);
+
+   depth = qcf->Depth;
+   if (depth == 0) depth = CtrDrvrQUEUE_SIZE;
+   if ((depth > CtrDrvrQUEUE_MAX_DEPTH)
+   ||  ((qcf->Format != CtrDrvrQueueFormatFULL) && (qcf->Format != CtrDrvrQueueFormatCOMPACT))) {
+      pseterr(EINVAL);
+      return SYSERR;
+   }
+
+   if (qcf->Format == CtrDrvrQueueFormatCOMPACT) size = depth * sizeof(CtrDrvrCompactBuf);
+   else                                          size = depth * sizeof(CtrDrvrReadBuf);
+
+   mem = NULL;
+   if (size > sizeof(queue->Default)) {
+      mem = sysbrk(size);
+      if (mem == NULL) {
+	 pseterr(ENOMEM);
+	 return SYSERR;
+      }
+   }
+
+   disable(ps);
+   {
+      old     = queue->Alloc;
+      oldsize = queue->AllocSize;
+
+      queue->Alloc     = mem;
+      queue->AllocSize = mem ? size : 0;
+      if (mem == NULL) mem = (char *) queue->Default;
+      queue->Entries   = (CtrDrvrReadBuf    *) mem;
+      queue->Compact   = (CtrDrvrCompactBuf *) mem;
+      queue->Depth     = depth;
+      queue->Format    = qcf->Format;
+      queue->Size      = 0;
+      queue->RdPntr    = 0;
+      queue->WrPntr    = 0;
+      queue->Burst     = 0;
+      sreset(&(ccon->Semaphore));
+   }
+   restore(ps);
+
+   if (old) sysfree(old,oldsize);
+   return OK;
+}
+
+/* Stop queuing for a closed client and free its storage */
+
+static void QueueRelease(CtrDrvrClientContext *ccon) {
+
+CtrDrvrQueue *queue;
+unsigned long ps;
+char *old;
+unsigned int oldsize;
+
+   queue = &(ccon->Queue);
+
+   disable(ps);
+   {
+      old     = queue->Alloc;
+      oldsize = queue->AllocSize;
+
+      queue->Alloc     = NULL;
+      queue->AllocSize = 0;
+      queue->Depth     = 0;
+      queue->Size      = 0;
+   }
+   restore(ps);
+
+   if (old) sysfree(old,oldsize);
+}
+
+/* ========================================================== */
+/* Account the time spent in the ISR since t0                 */
+/* ========================================================== */
+
+static void IsrStatsUpdate(CtrDrvrModuleContext *mcon, ktime_t t0) {
+
+CtrDrvrIsrStats *isrs;
+unsigned int ns;
+
+   isrs = &(mcon->IsrStats);
+   ns = (unsigned int) ktime_to_ns(ktime_sub(ktime_get(),t0));
+
+   isrs->Interrupts++;
+   isrs->LastNs = ns;
+   if (ns > isrs->MaxNs) isrs->MaxNs = ns;
+   isrs->TotalUs += ns / 1000;
+}
+
 /* ========================================================== */
 /* The ISR                                                    */
 /* ========================================================== */
@@ -1392,17 +1690,19 @@ unsigned int isrc, clients, msk, i, hlock, tndx = 0;
 unsigned char inum;
 
 unsigned long ps;
+ktime_t       t0;
 
 CtrDrvrMemoryMap      *mmap = NULL;
 CtrDrvrFpgaCounter    *fpgc = NULL;
 CtrDrvrCounterHistory *hist = NULL;
 
-CtrDrvrQueue             *queue;
 CtrDrvrClientContext     *ccon;
 CtrDrvrReadBuf            rbf;
 
 irqreturn_t ret;
 
+   t0 = ktime_get();
+
    mmap = mcon->Map;
    isrc = IHRd(&mmap->InterruptSource);    /* Read and clear interrupt sources */
    if (isr_bus_error) {
@@ -1490,20 +1790,9 @@ irqreturn_t ret;
 	 for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) {
 	    if (clients & (1 << i)) {
 	       ccon = &(Wa->ClientContexts[i]);
-	       queue = &(ccon->Queue);
-
-	       disable(ps); {
-		  queue->Entries[queue->WrPntr] = rbf;
-		  queue->WrPntr = (queue->WrPntr + 1) % CtrDrvrQUEUE_SIZE;
-		  if (queue->Size < CtrDrvrQUEUE_SIZE) {
-		     queue->Size++;
-		     ssignal(&(ccon->Semaphore));
-		  } else {
-		     queue->Missed++;
-		     queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-		  }
-	       } restore(ps);
-
+	       disable(ps);
+	       QueuePut(ccon,&rbf);
+	       restore(ps);
 	    }
 	 }
 
@@ -1512,8 +1801,10 @@ irqreturn_t ret;
 		    (int) mcon->ModuleIndex +1,
 		    (int) isrc, (int) inum, tndx);
 	 }
+	 mcon->IsrStats.Sources++;
       }
    }
+   if (isrc) IsrStatsUpdate(mcon,t0);
    return ret;
 }
 
@@ -1558,6 +1849,9 @@ CtrDrvrClientContext * ccon;    /* Client context */
    ccon->Timeout     = CtrDrvrDEFAULT_TIMEOUT;
    ccon->InUse       = 1;
    ccon->Pid         = getpid();
+   ccon->Queue.Depth   = CtrDrvrQUEUE_SIZE;
+   ccon->Queue.Entries = ccon->Queue.Default;
+   ccon->Queue.Compact = (CtrDrvrCompactBuf *) ccon->Queue.Default;
    sreset(&(ccon->Semaphore));
    return OK;
 }
@@ -1599,6 +1893,10 @@ CtrDrvrClientContext *ccon; /* Client context */
 
       DisConnectAll(ccon);
 
+      /* Free the queue if it was made bigger */
+
+      QueueRelease(ccon);
+
       return(OK);
 
    } else {
@@ -1620,8 +1918,9 @@ int CtrDrvrRead(CtrDrvrWorkingArea *wa, struct LynxFile *flp, char *u_buf, int c
 
 CtrDrvrClientContext *ccon;    /* Client context */
 CtrDrvrQueue         *queue;
-CtrDrvrReadBuf       *rb;
 int                    cnum;    /* Client number */
+int                    esize;   /* Size of one queue entry */
+int                    i, k, n, max;
 unsigned long          ps;
 
    cnum = minor(flp->dev) -1;
@@ -1630,6 +1929,16 @@ unsigned long          ps;
    if (ccon->DebugOn) cprintf("CtrDrvrRead:Client Number:%d Count:%d\n",cnum,cnt);
 
    queue = &(ccon->Queue);
+   if (queue->Format == CtrDrvrQueueFormatCOMPACT) esize = sizeof(CtrDrvrCompactBuf);
+   else                                            esize = sizeof(CtrDrvrReadBuf);
+   if (cnt < esize) {
+
+      /* EINVAL = "Invalid argument" */
+
+      pseterr(EINVAL);  /* Buffer too small for one entry */
+      return 0;
+   }
+
    if (queue->QueueOff) {
       disable(ps); {
 	 queue->Size   = 0;
@@ -1679,14 +1988,34 @@ unsigned long          ps;
       }
    }
 
-   rb = (CtrDrvrReadBuf *) u_buf;
+   /* Return as many entries as are queued and fit in the buffer.  */
+   /* Interrupts are only held off for a limited number at a time. */
+
    if (queue->Size) {
-      disable(ps); {
-	 *rb = queue->Entries[queue->RdPntr];
-	 queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-	 queue->Size--;
-      } restore(ps);
-      return sizeof(CtrDrvrReadBuf);
+      max = cnt / esize;
+      n = 0;
+      do {
+	 disable(ps);
+	 if (n == 0) {
+	    queue->Stats.LastBurst = queue->Burst;
+	    queue->Burst = 0;
+	 }
+	 for (k=0; (k<CtrDrvrQUEUE_SIZE) && (n<max) && (queue->Size); k++, n++) {
+	    if (queue->Format == CtrDrvrQueueFormatCOMPACT)
+	       ((CtrDrvrCompactBuf *) u_buf)[n] = queue->Compact[queue->RdPntr];
+	    else
+	       ((CtrDrvrReadBuf *) u_buf)[n] = queue->Entries[queue->RdPntr];
+	    queue->RdPntr = (queue->RdPntr + 1) % queue->Depth;
+	    queue->Size--;
+	 }
+	 restore(ps);
+      } while ((k == CtrDrvrQUEUE_SIZE) && (n < max));
+
+      /* swait took the count for the first entry, take the others */
+
+      for (i=1; i<n; i++) tswait(&(ccon->Semaphore), SEM_SIGIGNORE, 0);
+
+      return n * esize;
    }
 
    if (ccon->DebugOn) cprintf("CtrDrvrRead:Client Number:%d Count:%d Queue empty\n",cnum,cnt);
@@ -1706,7 +2035,6 @@ int CtrDrvrWrite(CtrDrvrWorkingArea *wa, struct LynxFile *flp, char *u_buf, int
 
 CtrDrvrClientContext *ccon;    /* Client context */
 CtrDrvrModuleContext *mcon;
-CtrDrvrQueue         *queue;
 CtrDrvrConnection    *conx;
 CtrDrvrReadBuf        rb;
 CtrDrvrWriteBuf      *wb;
@@ -1733,17 +2061,14 @@ unsigned int          clients;
 
 	 /* This code provokes the first matching trigger */
 
-	 for (tndx=0; tndx<CtrDrvrRamTableSIZE; tndx++) {
-	    if ((mcon->EqpNum[tndx]   == conx->EqpNum)
-	    &&  (mcon->EqpClass[tndx] == conx->EqpClass)) {
-	       clients = mcon->Clients[tndx];
-	       rb.TriggerNumber = tndx +1;
-	       rb.Frame = mcon->Trigs[tndx].Frame;
-	       rb.Frame.Struct.Value = wb->Payload;
-	       rb.Ctim = mcon->Trigs[tndx].Ctim;
-	       rb.InterruptNumber = mcon->Trigs[tndx].Counter;
-	       break;
-	    }
+	 tndx = SlotFirstOwned(mcon,conx->EqpNum,conx->EqpClass);
+	 if (tndx >= 0) {
+	    clients = mcon->Clients[tndx];
+	    rb.TriggerNumber = tndx +1;
+	    rb.Frame = mcon->Trigs[tndx].Frame;
+	    rb.Frame.Struct.Value = wb->Payload;
+	    rb.Ctim = mcon->Trigs[tndx].Ctim;
+	    rb.InterruptNumber = mcon->Trigs[tndx].Counter;
 	 }
       } else {
 	 tndx = wb->TriggerNumber -1;
@@ -1775,19 +2100,9 @@ unsigned int          clients;
       for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) {
 	 if (clients & (1 << i)) {
 	    ccon = &(Wa->ClientContexts[i]);
-	    queue = &(ccon->Queue);
-
-	    disable(ps); {
-	       queue->Entries[queue->WrPntr] = rb;
-	       queue->WrPntr = (queue->WrPntr + 1) % CtrDrvrQUEUE_SIZE;
-	       if (queue->Size < CtrDrvrQUEUE_SIZE) {
-		  queue->Size++;
-		  ssignal(&(ccon->Semaphore));
-	       } else {
-		  queue->Missed++;
-		  queue->RdPntr = (queue->RdPntr + 1) % CtrDrvrQUEUE_SIZE;
-	       }
-	    } restore(ps);
+	    disable(ps);
+	    QueuePut(ccon,&rb);
+	    restore(ps);
 	 }
       }
    }
@@ -2062,7 +2377,6 @@ CtrDrvrVersion                 *ver;
 CtrDrvrModuleAddress           *moad;
 CtrDrvrCTime                   *ctod;
 CtrDrvrHwTrigger               *htrg;
-CtrDrvrTrigger                 *strg;
 CtrDrvrAction                  *act;
 CtrDrvrCtimBinding             *ctim;
 CtrDrvrPtimBinding             *ptim;
@@ -2080,6 +2394,8 @@ CtrDrvrEventHistory            *evhs;
 CtrDrvrReceptionErrors         *rcpe;
 CtrDrvrBoardId                 *bird;
 CtrDrvrModuleStats             *mods;
+CtrDrvrIsrStats                *isrs;
+CtrDrvrQueueStats              *qsts;
 
 CtrDrvrMemoryMap   *mmap;
 
@@ -2089,6 +2405,7 @@ int cnum;                 /* Client number */
 long lav, *lap;           /* Long Value pointed to by Arg */
 unsigned short sav;       /* Short argument and for Jtag IO */
 int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
+unsigned long ps;         /* Processor status for disable/restore */
 
    /* Check argument contains a valid address for reading or writing. */
    /* We can not allow bus errors to occur inside the driver due to   */
@@ -2240,6 +2557,25 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 	 }
       break;
 
+      case CtrDrvrSET_QUEUE_CONFIG:       /* Set queue depth and entry format */
+	 if (rcnt >= sizeof(CtrDrvrQueueConfig)) {
+	    return QueueSetup(ccon,(CtrDrvrQueueConfig *) arg);
+	 }
+      break;
+
+      case CtrDrvrGET_QUEUE_STATS:        /* Queue statistics, cleared on read */
+	 if (wcnt >= sizeof(CtrDrvrQueueStats)) {
+	    qsts = (CtrDrvrQueueStats *) arg;
+	    disable(ps);
+	    *qsts = ccon->Queue.Stats;
+	    qsts->Depth = ccon->Queue.Depth;
+	    qsts->Size  = ccon->Queue.Size;
+	    bzero((void *) &(ccon->Queue.Stats), sizeof(CtrDrvrQueueStats));
+	    restore(ps);
+	    return OK;
+	 }
+      break;
+
       case CtrDrvrGET_MODULE_DESCRIPTOR:
 	 if (wcnt >= sizeof(CtrDrvrModuleAddress)) {
 	    moad = (CtrDrvrModuleAddress *) arg;
@@ -2527,15 +2863,14 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 		  }
 
 	       } else {
-		  mcon->EqpNum[i] = act->EqpNum;
-		  mcon->EqpClass[i] = act->EqpClass;
+		  SetSlotOwner(mcon,i,act->EqpNum,act->EqpClass);
 		  mcon->Trigs[i].Counter = act->Trigger.Counter;
 	       }
 
 	       Io32Write((unsigned int *) &(mmap->Trigs[i]),
 			 (unsigned int *) TriggerToHard(&act->Trigger),
 			 (unsigned int  ) sizeof(CtrDrvrHwTrigger));
-	       mcon->Trigs[i] = act->Trigger;
+	       SetSlotTrigger(mcon,i,&(act->Trigger));
 
 	       /* Override bus interrupt settings for connected clients */
 
@@ -2557,16 +2892,12 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
       case CtrDrvrCREATE_CTIM_OBJECT:     /* Create a new CTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  pseterr(EBUSY);        /* Already defined */
-		  return SYSERR;
-	       }
+	    if (CtimFind(ctim->EqpNum) >= 0) {
+	       pseterr(EBUSY);        /* Already defined */
+	       return SYSERR;
 	    }
-	    i = Wa->Ctim.Size;
-	    if (i<CtrDrvrCtimOBJECTS) {
-	       Wa->Ctim.Objects[i] = *ctim;
-	       Wa->Ctim.Size = i +1;
+	    if (Wa->Ctim.Size < CtrDrvrCtimOBJECTS) {
+	       CtimAdd(ctim);
 	       return OK;
 	    }
 	    pseterr(ENOMEM);
@@ -2577,19 +2908,14 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
       case CtrDrvrDESTROY_CTIM_OBJECT:    /* Destroy a CTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  for (j=0; j<CtrDrvrRamTableSIZE; j++) {
-		     strg = &(mcon->Trigs[j]);
-		     if (strg->Ctim == ctim->EqpNum) {
-			pseterr(EBUSY);   /* In use by ptim object */
-			return SYSERR;
-		     }
-		  }
-		  Wa->Ctim.Objects[i] = Wa->Ctim.Objects[Wa->Ctim.Size -1];
-		  Wa->Ctim.Size--;
-		  return OK;
+	    i = CtimFind(ctim->EqpNum);
+	    if (i >= 0) {
+	       if (CtimInUse(mcon,ctim->EqpNum)) {
+		  pseterr(EBUSY);   /* In use by ptim object */
+		  return SYSERR;
 	       }
+	       CtimDel(i);
+	       return OK;
 	    }
 	 }
       break;
@@ -2597,18 +2923,14 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
       case CtrDrvrCHANGE_CTIM_FRAME:      /* Change the frame of an existing CTIM object */
 	 if (rcnt >= sizeof(CtrDrvrCtimBinding)) {
 	    ctim = (CtrDrvrCtimBinding *) arg;
-	    for (i=0; i<Wa->Ctim.Size; i++) {
-	       if (ctim->EqpNum == Wa->Ctim.Objects[i].EqpNum) {
-		  for (j=0; j<CtrDrvrRamTableSIZE; j++) {
-		     strg = &(mcon->Trigs[j]);
-		     if (strg->Ctim == ctim->EqpNum) {
-			pseterr(EBUSY);   /* In use by ptim object */
-			return SYSERR;
-		     }
-		  }
-		  Wa->Ctim.Objects[i].Frame.Long = ctim->Frame.Long;
-		  return OK;
+	    i = CtimFind(ctim->EqpNum);
+	    if (i >= 0) {
+	       if (CtimInUse(mcon,ctim->EqpNum)) {
+		  pseterr(EBUSY);   /* In use by ptim object */
+		  return SYSERR;
 	       }
+	       Wa->Ctim.Objects[i].Frame.Long = ctim->Frame.Long;
+	       return OK;
 	    }
 	 }
       break;
@@ -2624,11 +2946,9 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
       case CtrDrvrCREATE_PTIM_OBJECT:     /* Create a new PTIM timing object */
 	 if (rcnt >= sizeof(CtrDrvrPtimBinding)) {
 	    ptim = (CtrDrvrPtimBinding *) arg;
-	    for (i=0; i<Wa->Ptim.Size; i++) {
-	       if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		  pseterr(EBUSY);        /* Already defined */
-		  return SYSERR;
-	       }
+	    if (PtimFind(ptim->EqpNum) >= 0) {
+	       pseterr(EBUSY);        /* Already defined */
+	       return SYSERR;
 	    }
 	    if (Wa->Ptim.Size >= CtrDrvrPtimOBJECTS) {
 	       pseterr(ENOMEM);          /* No more place in memory */
@@ -2641,7 +2961,7 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 	       /* Look for available space in trigger table for specified module */
 
 	       found = size = start = 0;
-	       for (i=0; i<CtrDrvrRamTableSIZE; i++) {
+	       for (i=mcon->FreeSlot; i<CtrDrvrRamTableSIZE; i++) {
 		  if (mcon->EqpNum[i] == 0) {
 		     if (size == 0) start = i;
 		     if (++size >= ptim->Size) {
@@ -2653,13 +2973,12 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 
 	       if (found) {
 		  for (i=start; i<start+ptim->Size; i++) {
-		     mcon->EqpNum[i]   = ptim->EqpNum;
-		     mcon->EqpClass[i] = CtrDrvrConnectionClassPTIM;
+		     SetSlotOwner(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM);
 		     mcon->Trigs[i].Counter = ptim->Counter;
 		  }
 
 		  ptim->StartIndex = start;
-		  Wa->Ptim.Objects[Wa->Ptim.Size++] = *ptim;
+		  PtimAdd(ptim);
 		  return OK;
 	       }
 	    }
@@ -2669,11 +2988,10 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
       case CtrDrvrGET_PTIM_BINDING:     /* Search for a PTIM object binding */
 	 if (rcnt >= sizeof(CtrDrvrPtimBinding)) {
 	    ptim = (CtrDrvrPtimBinding *) arg;
-	    for (i=0; i<Wa->Ptim.Size; i++) {
-	       if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		  *ptim = Wa->Ptim.Objects[i];
-		  return OK;
-	       }
+	    i = PtimFind(ptim->EqpNum);
+	    if (i >= 0) {
+	       *ptim = Wa->Ptim.Objects[i];
+	       return OK;
 	    }
 	    bzero((void *) ptim, sizeof(CtrDrvrPtimBinding));
 	 }
@@ -2689,44 +3007,33 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 	    mmap = (CtrDrvrMemoryMap *) mcon->Map;
 
 	    found = 0;
-	    for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-	       if ((mcon->EqpNum[i]   == ptim->EqpNum)
-	       &&  (mcon->EqpClass[i] == CtrDrvrConnectionClassPTIM)) {
-		  if (mcon->Clients[i]) {
-		     pseterr(EBUSY);      /* Object is in use by connected client */
-		     return SYSERR;
-		  }
-		  found = 1;
+	    for (i=SlotNextOwned(mcon,-1,ptim->EqpNum,CtrDrvrConnectionClassPTIM); i>=0;
+		 i=SlotNextOwned(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM)) {
+	       if (mcon->Clients[i]) {
+		  pseterr(EBUSY);      /* Object is in use by connected client */
+		  return SYSERR;
 	       }
+	       found = 1;
 	    }
 
 	    if (found) {
-	       for (i=0; i<CtrDrvrRamTableSIZE; i++) {
-		  if ((mcon->EqpNum[i]   == ptim->EqpNum)
-		  &&  (mcon->EqpClass[i] == CtrDrvrConnectionClassPTIM)) {
-
-		     htrg = &((CtrDrvrHwTrigger) {{0},0});
-		     Io32Write((unsigned int *) &(mmap->Trigs[i]),
-			       (unsigned int *) htrg,
-			       (unsigned int  ) sizeof(CtrDrvrHwTrigger));
-
-		     mcon->EqpNum[i]   = 0;
-		     mcon->EqpClass[i] = 0;
-		     bzero((void *) &(mcon->Configs[i]),sizeof(CtrDrvrCounterConfiguration));
-		     bzero((void *) &(mcon->Trigs[i]  ),sizeof(CtrDrvrTrigger));
-		     Io32Write((unsigned int *) &(mmap->Configs[i]),
-			       (unsigned int *) ConfigToHard(&(mcon->Configs[i])),
-			       (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
-		  }
-	       }
+	       for (i=SlotNextOwned(mcon,-1,ptim->EqpNum,CtrDrvrConnectionClassPTIM); i>=0; i=n) {
+		  n = SlotNextOwned(mcon,i,ptim->EqpNum,CtrDrvrConnectionClassPTIM);
+		  htrg = &((CtrDrvrHwTrigger) {{0},0});
+		  Io32Write((unsigned int *) &(mmap->Trigs[i]),
+			    (unsigned int *) htrg,
+			    (unsigned int  ) sizeof(CtrDrvrHwTrigger));
 
-	       for (i=0; i<Wa->Ptim.Size; i++) {
-		  if (ptim->EqpNum == Wa->Ptim.Objects[i].EqpNum) {
-		     Wa->Ptim.Objects[i] = Wa->Ptim.Objects[Wa->Ptim.Size -1];
-		     Wa->Ptim.Size--;
-		     break;
-		  }
+		  SetSlotOwner(mcon,i,0,0);
+		  bzero((void *) &(mcon->Configs[i]),sizeof(CtrDrvrCounterConfiguration));
+		  SetSlotTrigger(mcon,i,&((CtrDrvrTrigger) {0}));
+		  Io32Write((unsigned int *) &(mmap->Configs[i]),
+			    (unsigned int *) ConfigToHard(&(mcon->Configs[i])),
+			    (unsigned int  ) sizeof(CtrDrvrHwCounterConfiguration));
 	       }
+
+	       i = PtimFind(ptim->EqpNum);
+	       if (i >= 0) PtimDel(i);
 	       return OK;
 	    }
 	 }
@@ -2861,6 +3168,17 @@ int rcnt, wcnt;           /* Readable, Writable byte counts at arg address */
 	 }
       break;
 
+      case CtrDrvrGET_ISR_STATS:          /* Interrupt handler duration */
+	 if (wcnt >= sizeof(CtrDrvrIsrStats)) {
+	    isrs = (CtrDrvrIsrStats *) arg;
+	    disable(ps);
+	    *isrs = mcon->IsrStats;
+	    mcon->IsrStats.MaxNs = 0;
+	    restore(ps);
+	    return OK;
+	 }
+      break;
+
       case CtrDrvrGET_OUT_MASK:           /* Counter output routing mask */
 	 if (wcnt >= sizeof(CtrDrvrCounterMaskBuf)) {
 	    cmsb = (CtrDrvrCounterMaskBuf *) arg;
@@ -80,6 +80,43 @@ typedef struct {
    CtrDrvrCTime      OnZeroTime;       /* Time of interrupt */
  } CtrDrvrReadBuf;
 
+/* A client can ask for compact queue entries, then each read returns */
+/* only the frame and the time of interrupt of each event.            */
+
+typedef struct {
+   CtrDrvrEventFrame Frame;            /* Triggering event frame */
+   CtrDrvrCTime      OnZeroTime;       /* Time of interrupt */
+ } CtrDrvrCompactBuf;
+
+typedef enum {
+   CtrDrvrQueueFormatFULL,             /* Read returns CtrDrvrReadBuf entries */
+   CtrDrvrQueueFormatCOMPACT           /* Read returns CtrDrvrCompactBuf entries */
+ } CtrDrvrQueueFormat;
+
+/* Per client queue configuration, a Depth of zero gives the default */
+/* depth. A read returns as many entries as fit in the callers buffer */
+/* and are available, waiting only for the first one.                */
+
+#define CtrDrvrQUEUE_MAX_DEPTH 8192
+
+typedef struct {
+   unsigned int       Depth;           /* Number of entries 0..CtrDrvrQUEUE_MAX_DEPTH */
+   CtrDrvrQueueFormat Format;          /* Full or compact entries */
+ } CtrDrvrQueueConfig;
+
+/* Queue statistics, all but Depth and Size are cleared on reading */
+
+typedef struct {
+   unsigned int      Depth;            /* Configured queue depth */
+   unsigned int      Size;             /* Entries on the queue now */
+   unsigned int      MaxSize;          /* Largest number of entries seen on the queue */
+   unsigned int      LastBurst;        /* Entries queued between the last two reads */
+   unsigned int      MaxBurst;         /* Largest number of entries queued between reads */
+   unsigned int      Missed;           /* Entries lost because the queue was full */
+   CtrDrvrCTime      FirstMissed;      /* Time of first lost entry */
+   CtrDrvrCTime      LastMissed;       /* Time of last lost entry */
+ } CtrDrvrQueueStats;
+
 typedef struct {
    unsigned int      TriggerNumber;    /* Trigger number 0..n 0=>First in connection */
    CtrDrvrConnection Connection;       /* Connection for trigger */
@@ -266,6 +303,18 @@ typedef struct {
    unsigned int IdMSL;         /* ID Chip value Most  Sig 32-bits */
  } CtrDrvrBoardId;
 
+/* ***************************************************** */
+/* Interrupt handler duration for the current module     */
+/* MaxNs is cleared each time the statistics are read.   */
+
+typedef struct {
+   unsigned int Interrupts;    /* Number of interrupts handled */
+   unsigned int Sources;       /* Number of interrupt sources handled */
+   unsigned int LastNs;        /* Duration of the last interrupt */
+   unsigned int MaxNs;         /* Longest interrupt since last read */
+   unsigned int TotalUs;       /* Sum of all durations, wraps around */
+ } CtrDrvrIsrStats;
+
 /* ***************************************************** */
 /* Very special ISR debug code                           */
 
@@ -372,9 +421,9 @@ typedef enum {
 
    CtrDrvrSET_CABLE_ID,           /* 63 Needed when no ID events sent */
 
-   CtrDrvrIOCTL_64,               /* 64 Spare */
-   CtrDrvrIOCTL_65,               /* 65 Spare */
-   CtrDrvrIOCTL_66,               /* 66 Spare */
+   CtrDrvrGET_ISR_STATS,          /* 64 Get interrupt handler duration statistics */
+   CtrDrvrSET_QUEUE_CONFIG,       /* 65 Set queue depth and entry format */
+   CtrDrvrGET_QUEUE_STATS,        /* 66 Get queue statistics */
    CtrDrvrIOCTL_67,               /* 67 Spare */
    CtrDrvrIOCTL_68,               /* 68 Spare */
    CtrDrvrIOCTL_69,               /* 69 Spare */
@@ -495,9 +544,9 @@ typedef enum {
 #define CtrIoctlSET_BRUTAL_PLL                 CIOWR(CtrDrvrSET_BRUTAL_PLL         ,unsigned long)
 #define CtrIoctlGET_MODULE_STATS               CIOWR(CtrDrvrGET_MODULE_STATS       ,CtrDrvrModuleStats)
 #define CtrIoctlSET_CABLE_ID                   CIOWR(CtrDrvrSET_CABLE_ID           ,unsigned long)
-#define CtrIoctlIOCTL_64                       CIOWR(CtrDrvrIOCTL_64               ,unsigned long)
-#define CtrIoctlIOCTL_65                       CIOWR(CtrDrvrIOCTL_65               ,unsigned long)
-#define CtrIoctlIOCTL_66                       CIOWR(CtrDrvrIOCTL_66               ,unsigned long)
+#define CtrIoctlGET_ISR_STATS                  CIOWR(CtrDrvrGET_ISR_STATS          ,CtrDrvrIsrStats)
+#define CtrIoctlSET_QUEUE_CONFIG               CIOWR(CtrDrvrSET_QUEUE_CONFIG       ,CtrDrvrQueueConfig)
+#define CtrIoctlGET_QUEUE_STATS                CIOWR(CtrDrvrGET_QUEUE_STATS        ,CtrDrvrQueueStats)
 #define CtrIoctlIOCTL_67                       CIOWR(CtrDrvrIOCTL_67               ,unsigned long)
 #define CtrIoctlIOCTL_68                       CIOWR(CtrDrvrIOCTL_68               ,unsigned long)
 #define CtrIoctlIOCTL_69                       CIOWR(CtrDrvrIOCTL_69               ,unsigned long)
@@ -595,9 +644,9 @@ typedef enum {
 #define CtrIoctlSET_BRUTAL_PLL                 CtrDrvrSET_BRUTAL_PLL
 #define CtrIoctlGET_MODULE_STATS               CtrDrvrGET_MODULE_STATS
 #define CtrIoctlSET_CABLE_ID                   CtrDrvrSET_CABLE_ID
-#define CtrIoctlIOCTL_64                       CtrDrvrIOCTL_64
-#define CtrIoctlIOCTL_65                       CtrDrvrIOCTL_65
-#define CtrIoctlIOCTL_66                       CtrDrvrIOCTL_66
+#define CtrIoctlGET_ISR_STATS                  CtrDrvrGET_ISR_STATS
+#define CtrIoctlSET_QUEUE_CONFIG               CtrDrvrSET_QUEUE_CONFIG
+#define CtrIoctlGET_QUEUE_STATS                CtrDrvrGET_QUEUE_STATS
 #define CtrIoctlIOCTL_67                       CtrDrvrIOCTL_67
 #define CtrIoctlIOCTL_68                       CtrDrvrIOCTL_68
 #define CtrIoctlIOCTL_69                       CtrDrvrIOCTL_69
@@ -0,0 +1,328 @@
+/* ============================================================ */
+/* CTR trigger and counter encoding, the ISR fan out of one     */
+/* interrupt source to the client queues, and the queues.       */
+/* This is shared by the PCI driver and the CtrEmu software     */
+/* emulator in the test directory. Hosts other than the driver  */
+/* define before including it:                                  */
+/*                                                              */
+/*    CTR_HISTORY_COPY(dst,src)  Copy a counter history         */
+/*    CTR_READ_CLEAR(reg)        Read a clear on read register  */
+/*    CTR_GET_TIME(mcon)         Module time now                */
+/*    CTR_DISABLE(ps)            Hold off the ISR               */
+/*    CTR_RESTORE(ps)            Let it run again               */
+/*    CTR_QUEUE_SIGNAL(ccon)     Wake up a reader               */
+/* ============================================================ */
+
+#ifndef CTR_ISR
+#define CTR_ISR
+
+#include "ctrdrvrP.h"
+
+#ifndef CTR_HISTORY_COPY
+#define CTR_HISTORY_COPY(dst,src) Int32Copy((unsigned int *) (dst), \
+					     (unsigned int *) (src), \
+					     (unsigned int  ) sizeof(CtrDrvrCounterHistory))
+#endif
+
+#ifndef CTR_READ_CLEAR
+#define CTR_READ_CLEAR(reg) (reg)
+#endif
+
+#ifndef CTR_GET_TIME
+#define CTR_GET_TIME(mcon) (*GetTime(mcon))
+#endif
+
+#ifndef CTR_DISABLE
+#define CTR_DISABLE(ps) disable(ps)
+#define CTR_RESTORE(ps) restore(ps)
+#endif
+
+#ifndef CTR_QUEUE_SIGNAL
+#define CTR_QUEUE_SIGNAL(ccon) ssignal(&((ccon)->Semaphore))
+#endif
+
+/* ========================================================== */
+/* Auto shift left  a value for a given mask                  */
+/* ========================================================== */
+
+static unsigned int AutoShiftLeft(unsigned int mask, unsigned int value) {
+int i,m;
+
+   m = mask;
+   for (i=0; i<32; i++) {
+      if (m & 1) break;
+      m >>= 1;
+   }
+   return (value << i) & mask;
+}
+
+/* ========================================================== */
+/* Auto shift right a value for a given mask                  */
+/* ========================================================== */
+
+static unsigned int AutoShiftRight(unsigned int mask, unsigned int value) {
+int i,m;
+
+   m = mask;
+   for (i=0; i<32; i++) {
+      if (m & 1) break;
+      m >>= 1;
+   }
+   return (value >> i) & m;
+}
+
+/* ========================================================== */
+/* Convert driver API trigger to compact hardware form.       */
+/* The API form for a trigger is too big to fit in the FPGA.  */
+/* We keep a propper structure for the driver API, and        */
+/* declare a second version packed into bit fields for the    */
+/* hardware representation.                                   */
+/* ========================================================== */
+
+static CtrDrvrHwTrigger *TriggerToHard(CtrDrvrTrigger *strg) {
+static CtrDrvrHwTrigger htrg;
+unsigned int trigger;
+
+   trigger  = AutoShiftLeft(CtrDrvrTrigGROUP_VALUE_MASK ,strg->Group.GroupValue);
+   trigger |= AutoShiftLeft(CtrDrvrTrigCONDITION_MASK   ,strg->TriggerCondition);
+   trigger |= AutoShiftLeft(CtrDrvrTrigMACHINE_MASK     ,strg->Machine);
+   trigger |= AutoShiftLeft(CtrDrvrTrigCOUNTER_MASK     ,strg->Counter);
+   trigger |= AutoShiftLeft(CtrDrvrTrigGROUP_NUMBER_MASK,strg->Group.GroupNumber);
+
+   htrg.Frame   = strg->Frame;
+   htrg.Trigger = trigger;
+
+   return &htrg;
+}
+
+/* ========================================================== */
+/* Convert compact hardware trigger to driver API trigger     */
+/* ========================================================== */
+
+static CtrDrvrTrigger *HardToTrigger(volatile CtrDrvrHwTrigger *htrg) {
+static CtrDrvrTrigger strg;
+unsigned int trigger;
+
+   strg.Frame = htrg->Frame;
+   trigger    = htrg->Trigger;
+
+   strg.Group.GroupValue  = AutoShiftRight(CtrDrvrTrigGROUP_VALUE_MASK ,trigger);
+   strg.TriggerCondition  = AutoShiftRight(CtrDrvrTrigCONDITION_MASK   ,trigger);
+   strg.Machine           = AutoShiftRight(CtrDrvrTrigMACHINE_MASK     ,trigger);
+   strg.Counter           = AutoShiftRight(CtrDrvrTrigCOUNTER_MASK     ,trigger);
+   strg.Group.GroupNumber = AutoShiftRight(CtrDrvrTrigGROUP_NUMBER_MASK,trigger);
+
+   return &strg;
+}
+
+/* ================================================================================== */
+/* Convert a soft counter configuration to compact hardware form.                     */
+/* ================================================================================== */
+
+static CtrDrvrHwCounterConfiguration *ConfigToHard(CtrDrvrCounterConfiguration *scnf) {
+static CtrDrvrHwCounterConfiguration hcnf;
+unsigned int config;
+
+   config  = AutoShiftLeft(CtrDrvrCounterConfigPULSE_WIDTH_MASK,scnf->PulsWidth);
+   config |= AutoShiftLeft(CtrDrvrCounterConfigCLOCK_MASK      ,scnf->Clock);
+   config |= AutoShiftLeft(CtrDrvrCounterConfigMODE_MASK       ,scnf->Mode);
+   config |= AutoShiftLeft(CtrDrvrCounterConfigSTART_MASK      ,scnf->Start);
+   config |= AutoShiftLeft(CtrDrvrCounterConfigON_ZERO_MASK    ,scnf->OnZero);
+
+   hcnf.Config = config;
+   hcnf.Delay  = scnf->Delay;
+
+   return &hcnf;
+}
+
+/* ================================================================================== */
+/* Convert a compacr hardware counter configuration to API form.                      */
+/* ================================================================================== */
+
+static CtrDrvrCounterConfiguration *HardToConfig(volatile CtrDrvrHwCounterConfiguration *hcnf) {
+static CtrDrvrCounterConfiguration scnf;
+unsigned int config;
+
+   config     = hcnf->Config;
+   scnf.Delay = hcnf->Delay;
+
+   scnf.OnZero    = AutoShiftRight(CtrDrvrCounterConfigON_ZERO_MASK    ,config);
+   scnf.Start     = AutoShiftRight(CtrDrvrCounterConfigSTART_MASK      ,config);
+   scnf.Mode      = AutoShiftRight(CtrDrvrCounterConfigMODE_MASK       ,config);
+   scnf.Clock     = AutoShiftRight(CtrDrvrCounterConfigCLOCK_MASK      ,config);
+   scnf.PulsWidth = AutoShiftRight(CtrDrvrCounterConfigPULSE_WIDTH_MASK,config);
+
+   return &scnf;
+}
+
+/* ========================================================== */
+/* Client queues. QueuePut is called with interrupts disabled */
+/* ========================================================== */
+
+static void QueuePut(CtrDrvrClientContext *ccon, CtrDrvrReadBuf *rbf) {
+
+CtrDrvrQueue *queue;
+
+   queue = &(ccon->Queue);
+   if (queue->Depth == 0) return;        /* Client not open */
+
+   if (queue->Format == CtrDrvrQueueFormatCOMPACT) {
+      queue->Compact[queue->WrPntr].Frame      = rbf->Frame;
+      queue->Compact[queue->WrPntr].OnZeroTime = rbf->OnZeroTime;
+   } else
+      queue->Entries[queue->WrPntr] = *rbf;
+
+   queue->WrPntr = (queue->WrPntr + 1) % queue->Depth;
+   if (++queue->Burst > queue->Stats.MaxBurst) queue->Stats.MaxBurst = queue->Burst;
+
+   if (queue->Size < queue->Depth) {
+      queue->Size++;
+      if (queue->Size > queue->Stats.MaxSize) queue->Stats.MaxSize = queue->Size;
+      CTR_QUEUE_SIGNAL(ccon);
+   } else {
+      queue->Missed++;
+      if (queue->Stats.Missed++ == 0) queue->Stats.FirstMissed = rbf->OnZeroTime;
+      queue->Stats.LastMissed = rbf->OnZeroTime;
+      queue->RdPntr = (queue->RdPntr + 1) % queue->Depth;
+   }
+}
+
+/* Take up to CtrDrvrQUEUE_SIZE entries into buf from entry n on,   */
+/* stopping at max or on an empty queue. The burst count restarts   */
+/* with the first entry. Call with interrupts disabled. Returns the */
+/* number of entries taken.                                         */
+
+static int QueueGet(CtrDrvrQueue *queue, char *buf, int n, int max) {
+
+int k;
+
+   if (n == 0) {
+      queue->Stats.LastBurst = queue->Burst;
+      queue->Burst = 0;
+   }
+   for (k=0; (k<CtrDrvrQUEUE_SIZE) && (n<max) && (queue->Size); k++, n++) {
+      if (queue->Format == CtrDrvrQueueFormatCOMPACT)
+	 ((CtrDrvrCompactBuf *) buf)[n] = queue->Compact[queue->RdPntr];
+      else
+	 ((CtrDrvrReadBuf *) buf)[n] = queue->Entries[queue->RdPntr];
+      queue->RdPntr = (queue->RdPntr + 1) % queue->Depth;
+      queue->Size--;
+   }
+   return k;
+}
+
+/* ========================================================== */
+/* Account ns spent in the ISR                                */
+/* ========================================================== */
+
+static void IsrStatsAdd(CtrDrvrModuleContext *mcon, unsigned int ns) {
+
+CtrDrvrIsrStats *isrs;
+
+   isrs = &(mcon->IsrStats);
+   isrs->Interrupts++;
+   isrs->LastNs = ns;
+   if (ns > isrs->MaxNs) isrs->MaxNs = ns;
+   isrs->TotalUs += ns / 1000;
+}
+
+/* ========================================================== */
+/* Handle one interrupt source of the ISR. Build the read     */
+/* buffer from the counter history and the module context,    */
+/* and place it on the queues of the connected clients.       */
+/* Returns the clients mask, the trigger index is in tndx.    */
+/* ========================================================== */
+
+static unsigned int IsrSource(CtrDrvrModuleContext *mcon,
+			      CtrDrvrClientContext *ccons,
+			      unsigned char         inum,
+			      unsigned int         *tndx) {
+
+unsigned int  clients, msk, i, hlock, hvalid;
+unsigned long ps;
+
+CtrDrvrMemoryMap      *mmap;
+CtrDrvrFpgaCounter    *fpgc = NULL;
+CtrDrvrCounterHistory  hist;                     /* Local copy of counter history */
+CtrDrvrReadBuf         rbf;
+
+   mmap = mcon->Map;
+   msk  = 1 << inum;
+
+   bzero((void *) &rbf, sizeof(CtrDrvrReadBuf));
+   clients = 0;                            /* No clients yet */
+   hvalid  = 0;                            /* No history copy yet */
+
+   if (inum < CtrDrvrCOUNTERS) {           /* Counter Interrupt ? */
+      fpgc = &(mmap->Counters[inum]);      /* Get counter FPGA configuration */
+
+      if (fpgc->Control.LockConfig == 0) {    /* If counter not in remote */
+
+	 *tndx = fpgc->History.Index;         /* Index into trigger table */
+	 if (*tndx < CtrDrvrRamTableSIZE) {
+
+	    clients = mcon->Clients[*tndx];   /* Clients connected to timing objects */
+	    if (clients) {
+
+	       /* Only copy the history when someone will read it, each */
+	       /* word is still a separate access across the bus.       */
+
+	       CTR_HISTORY_COPY(&hist,&(fpgc->History));
+	       hvalid = 1;
+
+	       rbf.TriggerNumber = *tndx +1;           /* Trigger that loaded counter */
+	       rbf.Frame         = hist.Frame;         /* Actual event that interrupted */
+	       rbf.TriggerTime   = hist.TriggerTime;   /* Time counter was loaded */
+	       rbf.StartTime     = hist.StartTime;     /* Time start arrived */
+	       rbf.OnZeroTime    = hist.OnZeroTime;    /* Time of interrupt */
+
+	       hlock = CTR_READ_CLEAR(fpgc->Control.LockHistory);   /* Unlock history count Read/Clear */
+	       if (hlock > 1)
+		  mcon->Status &= ~CtrDrvrStatusNO_LOST_INTERRUPTS;
+
+	       /* Copy the rest of the information from the module context */
+
+	       rbf.Ctim                = mcon->Trigs[*tndx].Ctim;
+	       rbf.Connection.Module   = mcon->ModuleIndex +1;
+	       rbf.Connection.EqpClass = mcon->EqpClass[*tndx];
+	       rbf.Connection.EqpNum   = mcon->EqpNum[*tndx];
+	    }
+	 }
+      }
+   }
+
+   if (clients == 0) {                     /* No object clients connections */
+      clients = mcon->HardClients[inum];   /* Hardware only connection */
+      if (clients) {
+	 if (hvalid)                      rbf.OnZeroTime = hist.OnZeroTime;
+	 else if (inum < CtrDrvrCOUNTERS) rbf.OnZeroTime = fpgc->History.OnZeroTime;
+	 else                             rbf.OnZeroTime = CTR_GET_TIME(mcon);
+	 rbf.Connection.Module   = mcon->ModuleIndex +1;
+	 rbf.Connection.EqpClass = CtrDrvrConnectionClassHARD;
+	 rbf.Connection.EqpNum   = msk;
+      }
+   }
+
+   /* If client is connected to a hardware interrupt, and   */
+   /* other clients are connected to a timing object on the */
+   /* same counter; the client needs the interrupt number   */
+   /* to know from where the interrupt came. */
+
+   rbf.InterruptNumber = inum; /* Source of interrupt, Counter or other */
+
+   /* Place read buffer on connected clients queues */
+
+   clients |= mcon->HardClients[inum];
+   for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) {
+      if (clients & (1 << i)) {
+	 CTR_DISABLE(ps);
+	 QueuePut(&(ccons[i]),&rbf);
+	 CTR_RESTORE(ps);
+      }
+   }
+
+   mcon->IsrStats.Sources++;
+   return clients;
+}
+
+#endif
@@ -47,15 +47,26 @@ typedef enum {
 /* ============================================================ */
 
 #define CtrDrvrDEFAULT_TIMEOUT 2000 /* In 10 ms ticks */
-#define CtrDrvrQUEUE_SIZE 64        /* Maximum queue size */
+#define CtrDrvrQUEUE_SIZE 64        /* Default queue size */
+
+/* The queue entries live in Default unless a client configures a */
+/* queue too big for it, then they are allocated with sysbrk.     */
 
 typedef struct {
-   unsigned short QueueOff;
-   unsigned short Missed;
-   unsigned short Size;
-   unsigned int   RdPntr;
-   unsigned int   WrPntr;
-   CtrDrvrReadBuf Entries[CtrDrvrQUEUE_SIZE];
+   unsigned short     QueueOff;
+   unsigned short     Missed;
+   unsigned short     Size;
+   unsigned int       RdPntr;
+   unsigned int       WrPntr;
+   unsigned int       Depth;      /* Number of entries */
+   CtrDrvrQueueFormat Format;     /* Full or compact entries */
+   CtrDrvrReadBuf    *Entries;    /* Full entries */
+   CtrDrvrCompactBuf *Compact;    /* Compact entries, same storage */
+   char              *Alloc;      /* Allocated storage or NULL */
+   unsigned int       AllocSize;
+   unsigned int       Burst;      /* Entries queued since the last read */
+   CtrDrvrQueueStats  Stats;
+   CtrDrvrReadBuf     Default[CtrDrvrQUEUE_SIZE];
  } CtrDrvrQueue;
 
 typedef struct {
@@ -76,6 +87,12 @@ typedef struct {
 
 #define CtrDrvrMAX_BUS_ERROR_COUNT 100
 
+/* Hash tables on EqpNum used to find objects and trigger slots. */
+/* Chains hold index+1 so that zero can end them.                */
+
+#define CtrDrvrHASH_BITS 10
+#define CtrDrvrHASH_SIZE (1 << CtrDrvrHASH_BITS)
+
 typedef struct {
 
 #ifdef CTR_PCI
@@ -119,6 +136,14 @@ typedef struct {
 
    unsigned int                HardClients[CtrDrvrInterruptSOURCES];   /* Clients interrupts HARD */
 
+   unsigned short              SlotHash[CtrDrvrHASH_SIZE];        /* Slot chains hashed on EqpNum */
+   unsigned short              SlotNext[CtrDrvrRamTableSIZE];     /* Next slot+1 on the chain */
+   int                         FreeSlot;                          /* No empty slot below this one */
+   unsigned short              CtimSlotHash[CtrDrvrHASH_SIZE];    /* Slot chains hashed on Trigs.Ctim */
+   unsigned short              CtimSlotNext[CtrDrvrRamTableSIZE];
+
+   CtrDrvrIsrStats             IsrStats;          /* Interrupt handler duration */
+
    int                         Timer;             /* Handel module time delay during reset */
    int                         Semaphore;
 
@@ -136,6 +161,10 @@ typedef struct {
 
    CtrDrvrCtimObjects        Ctim;
    CtrDrvrPtimObjects        Ptim;
+   unsigned short            CtimHash[CtrDrvrHASH_SIZE];    /* EqpNum to Ctim.Objects chains */
+   unsigned short            CtimNext[CtrDrvrCtimOBJECTS];
+   unsigned short            PtimHash[CtrDrvrHASH_SIZE];    /* EqpNum to Ptim.Objects chains */
+   unsigned short            PtimNext[CtrDrvrPtimOBJECTS];
    unsigned int              Modules;
    CtrDrvrModuleContext      ModuleContexts[CtrDrvrMODULE_CONTEXTS];
    CtrDrvrClientContext      ClientContexts[CtrDrvrCLIENT_CONTEXTS];
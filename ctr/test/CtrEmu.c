@@ -0,0 +1,476 @@
+/* ************************************************************************** */
+/*                                                                            */
+/* Software emulation of CTR modules, used for load testing without any      */
+/* hardware. Each emulated module has a CtrDrvrMemoryMap in ordinary memory   */
+/* holding the trigger RAM, counter configurations, counter histories and    */
+/* event history. Incomming frames are matched against the trigger table as  */
+/* the FPGA does it, the counters run in emulated time, and on reaching zero */
+/* they raise interrupt sources. The trigger encoding, the ISR fan out and   */
+/* the client queues are the PCI driver's own code from ctrdrvrIsr.h, run on */
+/* the driver's module and client contexts.                                  */
+/*                                                                            */
+/* Limitations: all counter starts behave like NORMAL (next millisecond),    */
+/* all modes like NORMAL (one output), external clocks have a fixed period,  */
+/* and telegrams are written directly into the active telegram buffer.      */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <CtrEmu.h>
+
+/* ========================================================== */
+/* Emulated time to CTR time stamp                            */
+/* ========================================================== */
+
+static CtrDrvrCTime EmuTime(CtrEmu *emu, CtrEmuNs ns) {
+CtrDrvrCTime t;
+
+   t.Time.Second     = ns / 1000000000ULL;
+   t.Time.TicksHPTDC = ((ns % 1000000000ULL) * 32) / 25;   /* 25/32 ns ticks */
+   t.CTrain          = (ns - emu->CycleNs) / 1000000ULL;
+   return t;
+}
+
+/* Clear on read hardware registers */
+
+static unsigned int EmuReadClear(unsigned int *reg) {
+unsigned int v;
+
+   v = *reg;
+   *reg = 0;
+   return v;
+}
+
+/* ========================================================== */
+/* The driver code, on the emulated map without locking       */
+/* ========================================================== */
+
+#define CTR_HISTORY_COPY(dst,src) (*(dst) = *(src))
+#define CTR_READ_CLEAR(reg)       EmuReadClear(&(reg))
+#define CTR_GET_TIME(mcon)        EmuTime(((CtrEmuModule *) (mcon))->Emu, \
+					  ((CtrEmuModule *) (mcon))->Emu->NowNs)
+#define CTR_DISABLE(ps)           ((ps) = 0)
+#define CTR_RESTORE(ps)           ((void) (ps))
+#define CTR_QUEUE_SIGNAL(ccon)
+
+#include <ctrdrvrIsr.h>
+
+/* ========================================================== */
+/* Create and destroy the emulator                            */
+/* ========================================================== */
+
+CtrEmu *CtrEmuCreate(unsigned int modules) {
+CtrEmu *emu;
+CtrEmuModule *emod;
+int i, j;
+
+   if ((modules == 0) || (modules > CtrEmuMODULES)) return NULL;
+
+   emu = (CtrEmu *) calloc(1,sizeof(CtrEmu));
+   if (emu == NULL) return NULL;
+
+   emu->ExtClockNs = 100;      /* 10MHz unless told otherwise */
+   for (i=0; i<modules; i++) {
+      emod = (CtrEmuModule *) calloc(1,sizeof(CtrEmuModule));
+      if (emod == NULL) break;
+      emod->Emu = emu;
+      emod->Drvr.Map = &(emod->Hard);
+      emod->Drvr.ModuleIndex = i;
+      emod->Drvr.Status = CtrDrvrStatusNO_LOST_INTERRUPTS;
+      emod->Hard.Status = CtrDrvrStatusGMT_OK | CtrDrvrStatusPLL_OK | CtrDrvrStatusENABLED;
+      for (j=0; j<CtrDrvrCOUNTERS; j++) emod->Counters[j].OnZeroNs = CtrEmuNO_TIME;
+      emu->ModuleContexts[i] = emod;
+      emu->Modules++;
+   }
+   return emu;
+}
+
+void CtrEmuDestroy(CtrEmu *emu) {
+int i;
+
+   if (emu == NULL) return;
+   for (i=0; i<emu->Modules; i++) free(emu->ModuleContexts[i]);
+   for (i=0; i<CtrDrvrCLIENT_CONTEXTS; i++) free(emu->ClientContexts[i].Queue.Alloc);
+   free(emu);
+}
+
+/* ========================================================== */
+/* Open a client queue with a given depth and entry format,   */
+/* as QueueSetup() in the driver                              */
+/* ========================================================== */
+
+int CtrEmuOpen(CtrEmu *emu, int cnum, CtrDrvrQueueConfig *qcf) {
+CtrDrvrQueue *queue;
+unsigned int depth, size;
+char *mem;
+
+   if ((cnum < 0) || (cnum >= CtrDrvrCLIENT_CONTEXTS)) return -1;
+   queue = &(emu->ClientContexts[cnum].Queue);
+
+   depth = qcf->Depth;
+   if (depth == 0) depth = CtrDrvrQUEUE_SIZE;
+   if (depth > CtrDrvrQUEUE_MAX_DEPTH) return -1;
+
+   if (qcf->Format == CtrDrvrQueueFormatCOMPACT) size = depth * sizeof(CtrDrvrCompactBuf);
+   else                                          size = depth * sizeof(CtrDrvrReadBuf);
+
+   free(queue->Alloc);
+   bzero((void *) queue, sizeof(CtrDrvrQueue));
+   if (size > sizeof(queue->Default)) {
+      queue->Alloc = (char *) malloc(size);
+      if (queue->Alloc == NULL) return -1;
+      queue->AllocSize = size;
+      mem = queue->Alloc;
+   } else
+      mem = (char *) queue->Default;
+
+   queue->Entries = (CtrDrvrReadBuf    *) mem;
+   queue->Compact = (CtrDrvrCompactBuf *) mem;
+   queue->Depth   = depth;
+   queue->Format  = qcf->Format;
+   emu->ClientContexts[cnum].InUse       = 1;
+   emu->ClientContexts[cnum].ClientIndex = cnum;
+   return 0;
+}
+
+/* ========================================================== */
+/* Create a PTIM style trigger on a module. Returns the       */
+/* trigger table index or -1 if the table is full.            */
+/* ========================================================== */
+
+int CtrEmuTrigger(CtrEmu                      *emu,
+		  unsigned int                 module,    /* 1..n */
+		  unsigned int                 eqpnum,
+		  CtrDrvrTrigger              *trig,
+		  CtrDrvrCounterConfiguration *conf) {
+
+CtrEmuModule *emod;
+CtrDrvrModuleContext *mcon;
+int i;
+
+   if ((module < 1) || (module > emu->Modules)) return -1;
+   emod = emu->ModuleContexts[module -1];
+   mcon = &(emod->Drvr);
+
+   for (i=0; i<CtrDrvrRamTableSIZE; i++) if (mcon->EqpNum[i] == 0) break;
+   if (i >= CtrDrvrRamTableSIZE) return -1;
+
+   if (i >= emod->TrigsUsed) emod->TrigsUsed = i +1;
+   mcon->EqpNum[i]   = eqpnum;
+   mcon->EqpClass[i] = CtrDrvrConnectionClassPTIM;
+   mcon->Trigs[i]    = *trig;
+   mcon->Configs[i]  = *conf;
+
+   emod->Hard.Trigs[i]   = *TriggerToHard(trig);
+   emod->Hard.Configs[i] = *ConfigToHard(conf);
+
+   return i;
+}
+
+/* ========================================================== */
+/* Connect a client to all triggers of an equipment, or to a  */
+/* hardware interrupt mask when the class is HARD.            */
+/* Returns the number of connections made.                    */
+/* ========================================================== */
+
+int CtrEmuConnect(CtrEmu *emu, int cnum, CtrDrvrConnection *conx) {
+CtrEmuModule *emod;
+CtrDrvrModuleContext *mcon;
+unsigned int cmsk;
+int i, count;
+
+   if ((conx->Module < 1) || (conx->Module > emu->Modules)) return 0;
+   if ((cnum < 0) || (cnum >= CtrDrvrCLIENT_CONTEXTS)) return 0;
+
+   emod = emu->ModuleContexts[conx->Module -1];
+   mcon = &(emod->Drvr);
+   cmsk = 1 << cnum;
+   count = 0;
+
+   if (conx->EqpClass == CtrDrvrConnectionClassHARD) {
+      for (i=0; i<CtrDrvrInterruptSOURCES; i++) {
+	 if (conx->EqpNum & (1 << i)) {
+	    mcon->HardClients[i] |= cmsk;
+	    emod->Hard.InterruptEnable |= (1 << i);
+	    count++;
+	 }
+      }
+      return count;
+   }
+
+   for (i=0; i<CtrDrvrRamTableSIZE; i++) {
+      if ((mcon->EqpNum[i]   == conx->EqpNum)
+      &&  (mcon->EqpClass[i] == conx->EqpClass)) {
+	 mcon->Clients[i] |= cmsk;
+	 emod->Hard.InterruptEnable |= (1 << mcon->Trigs[i].Counter);
+	 count++;
+      }
+   }
+   return count;
+}
+
+/* ========================================================== */
+/* The ISR, as IntrHandler() working on the emulated map      */
+/* ========================================================== */
+
+static void EmuIsr(CtrEmu *emu, CtrEmuModule *emod) {
+
+unsigned int  isrc, tndx = 0;
+unsigned char inum;
+unsigned int  ns;
+struct timespec t0, t1;
+
+   clock_gettime(CLOCK_MONOTONIC,&t0);
+
+   isrc = EmuReadClear((unsigned int *) &(emod->Hard.InterruptSource));
+   if (isrc == 0) return;
+
+   for (inum=0; inum<CtrDrvrInterruptSOURCES; inum++)
+      if ((1 << inum) & isrc) IsrSource(&(emod->Drvr),emu->ClientContexts,inum,&tndx);
+
+   clock_gettime(CLOCK_MONOTONIC,&t1);
+   ns = (t1.tv_sec - t0.tv_sec) * 1000000000 + (t1.tv_nsec - t0.tv_nsec);
+
+   IsrStatsAdd(&(emod->Drvr),ns);
+   emu->IsrNs += ns;
+}
+
+/* ========================================================== */
+/* Counter clock period in ns                                 */
+/* ========================================================== */
+
+static CtrEmuNs EmuClockNs(CtrEmu *emu, CtrDrvrCounterClock clk) {
+
+   switch (clk) {
+      case CtrDrvrCounterClock1KHZ:  return 1000000;
+      case CtrDrvrCounterClock10MHZ: return 100;
+      case CtrDrvrCounterClock40MHZ: return 25;
+      default:                       return emu->ExtClockNs;
+   }
+}
+
+/* ========================================================== */
+/* Does a trigger telegram condition hold                     */
+/* ========================================================== */
+
+static int EmuCondition(CtrEmuModule *emod, CtrDrvrHwTrigger *htrg) {
+CtrDrvrTrigger *strg;
+unsigned int mch, gnum, tval;
+
+   strg = HardToTrigger(htrg);
+   if (strg->TriggerCondition == CtrDrvrTriggerConditionNO_CHECK) return 1;
+
+   mch  = strg->Machine;
+   gnum = strg->Group.GroupNumber;
+   if ((mch < 1) || (mch > CtrDrvrMachineMACHINES)) return 0;
+   if ((gnum < 1) || (gnum > CtrDrvrTgmGROUP_VALUES)) return 0;
+
+   tval = emod->Hard.Telegrams[mch -1][gnum -1];
+   if (strg->TriggerCondition == CtrDrvrTriggerConditionEQUALITY) return (tval == strg->Group.GroupValue);
+   return ((tval & strg->Group.GroupValue) != 0);
+}
+
+/* ========================================================== */
+/* A trigger fired, load its counter                          */
+/* ========================================================== */
+
+static void EmuLoad(CtrEmu *emu, CtrEmuModule *emod, int tndx, CtrDrvrEventFrame frame) {
+CtrDrvrFpgaCounter *fpgc;
+CtrEmuCounter *cntr;
+CtrDrvrCounterConfiguration *conf;
+unsigned int cnum;
+CtrEmuNs start;
+
+   cnum = AutoShiftRight(CtrDrvrTrigCOUNTER_MASK,emod->Hard.Trigs[tndx].Trigger);
+   if (cnum >= CtrDrvrCOUNTERS) return;
+
+   fpgc = &(emod->Hard.Counters[cnum]);
+   cntr = &(emod->Counters[cnum]);
+   if (fpgc->Control.LockConfig) return;       /* Counter under remote control */
+
+   emu->Triggers++;
+   fpgc->Config = emod->Hard.Configs[tndx];
+   conf = HardToConfig(&(fpgc->Config));
+
+   cntr->History = (fpgc->Control.LockHistory == 0);
+   if (cntr->History) {
+      bzero((void *) &(fpgc->History), sizeof(CtrDrvrCounterHistory));
+      fpgc->History.Index       = tndx;
+      fpgc->History.Frame       = frame;
+      fpgc->History.TriggerTime = EmuTime(emu,emu->NowNs);
+   }
+
+   /* Counter zero is a direct action, the others start on the */
+   /* next millisecond and count down their delay.             */
+
+   if (cnum == CtrDrvrCounter0) start = emu->NowNs;
+   else                         start = ((emu->NowNs / 1000000ULL) + 1) * 1000000ULL;
+
+   cntr->StartNs  = start;
+   cntr->OnZeroNs = start;
+   if (cnum != CtrDrvrCounter0)
+      cntr->OnZeroNs += conf->Delay * EmuClockNs(emu,conf->Clock);
+}
+
+/* ========================================================== */
+/* Run the counters of all modules up to a given time         */
+/* ========================================================== */
+
+void CtrEmuAdvance(CtrEmu *emu, CtrEmuNs ns) {
+CtrEmuModule *emod;
+CtrDrvrFpgaCounter *fpgc;
+CtrEmuCounter *cntr;
+CtrEmuNs next;
+int m, c;
+
+   while (1) {
+
+      /* Earliest counter to reach zero */
+
+      next = CtrEmuNO_TIME;
+      for (m=0; m<emu->Modules; m++) {
+	 emod = emu->ModuleContexts[m];
+	 for (c=0; c<CtrDrvrCOUNTERS; c++)
+	    if (emod->Counters[c].OnZeroNs < next) next = emod->Counters[c].OnZeroNs;
+      }
+      if ((next == CtrEmuNO_TIME) || (next > ns)) break;
+      if (next > emu->NowNs) emu->NowNs = next;
+
+      /* All counters reaching zero now, then one interrupt per module */
+
+      for (m=0; m<emu->Modules; m++) {
+	 emod = emu->ModuleContexts[m];
+	 for (c=0; c<CtrDrvrCOUNTERS; c++) {
+	    cntr = &(emod->Counters[c]);
+	    if (cntr->OnZeroNs != next) continue;
+
+	    fpgc = &(emod->Hard.Counters[c]);
+	    if (cntr->History) {
+	       fpgc->History.StartTime  = EmuTime(emu,cntr->StartNs);
+	       fpgc->History.OnZeroTime = EmuTime(emu,next);
+	    }
+	    fpgc->Control.LockHistory++;
+	    cntr->OnZeroNs = CtrEmuNO_TIME;
+	    emu->Outputs++;
+
+	    if ((HardToConfig(&(fpgc->Config))->OnZero & CtrDrvrCounterOnZeroBUS)
+	    &&  (emod->Hard.InterruptEnable & (1 << c)))
+	       emod->Hard.InterruptSource |= (1 << c);
+	 }
+	 if (emod->Hard.InterruptSource) EmuIsr(emu,emod);
+      }
+   }
+   if (ns > emu->NowNs) emu->NowNs = ns;
+}
+
+/* ========================================================== */
+/* A frame arrives from the timing cable on all modules at    */
+/* the current emulated time. The trigger table is searched   */
+/* as the FPGA does it.                                       */
+/* ========================================================== */
+
+void CtrEmuFrame(CtrEmu *emu, CtrDrvrEventFrame frame) {
+CtrEmuModule *emod;
+CtrDrvrEventHistory *evhs;
+CtrDrvrHwTrigger *htrg;
+unsigned int hdr, mch, typ, m;
+int i;
+
+   emu->Frames++;
+
+   hdr = frame.Struct.Header;
+   mch = hdr >> 4;
+   typ = hdr & 0xF;
+
+   for (m=0; m<emu->Modules; m++) {
+      emod = emu->ModuleContexts[m];
+
+      if (hdr == CtrDrvrMILLISECOND_HEADER) continue;
+
+      if ((typ == CtrDrvrMachineEventTypeTELEGRAM) && (mch >= 1) && (mch <= CtrDrvrMachineMACHINES)) {
+	 if (frame.Struct.Code < CtrDrvrTgmGROUP_VALUES)
+	    emod->Hard.Telegrams[mch -1][frame.Struct.Code] = frame.Struct.Value;
+	 continue;
+      }
+
+      evhs = &(emod->Hard.EventHistory);
+      evhs->Entries[evhs->Index].Frame = frame;
+      evhs->Entries[evhs->Index].CTime = EmuTime(emu,emu->NowNs);
+      evhs->Index = (evhs->Index + 1) % CtrDrvrHISTORY_TABLE_SIZE;
+
+      if (emod->Hard.InterruptEnable & CtrDrvrInterruptMaskGMT_EVENT_IN)
+	 emod->Hard.InterruptSource |= CtrDrvrInterruptMaskGMT_EVENT_IN;
+
+      /* Search the trigger table, a WILD value matches any value */
+
+      for (i=0; i<emod->TrigsUsed; i++) {
+	 htrg = &(emod->Hard.Trigs[i]);
+	 if (htrg->Frame.Long == 0) continue;
+	 if (htrg->Frame.Long != frame.Long) {
+	    if (htrg->Frame.Struct.Value != 0xFFFF) continue;
+	    if ((htrg->Frame.Long & 0xFFFF0000) != (frame.Long & 0xFFFF0000)) continue;
+	 }
+	 if (EmuCondition(emod,htrg) == 0) continue;
+	 EmuLoad(emu,emod,i,frame);
+      }
+   }
+
+   /* Direct triggers on counter zero and the GMT event interrupt */
+
+   CtrEmuAdvance(emu,emu->NowNs);
+   for (m=0; m<emu->Modules; m++) {
+      emod = emu->ModuleContexts[m];
+      if (emod->Hard.InterruptSource) EmuIsr(emu,emod);
+   }
+}
+
+/* ========================================================== */
+/* Non blocking read of as many entries as are queued and fit */
+/* in the buffer, as CtrDrvrRead(). Returns the byte count.   */
+/* ========================================================== */
+
+int CtrEmuRead(CtrEmu *emu, int cnum, void *buf, int cnt) {
+CtrDrvrQueue *queue;
+int esize, k, n, max;
+
+   if ((cnum < 0) || (cnum >= CtrDrvrCLIENT_CONTEXTS)) return 0;
+   queue = &(emu->ClientContexts[cnum].Queue);
+   if (queue->Depth == 0) return 0;
+
+   if (queue->Format == CtrDrvrQueueFormatCOMPACT) esize = sizeof(CtrDrvrCompactBuf);
+   else                                            esize = sizeof(CtrDrvrReadBuf);
+   max = cnt / esize;
+
+   n = 0;
+   do {
+      k = QueueGet(queue,(char *) buf,n,max);
+      n += k;
+   } while ((k == CtrDrvrQUEUE_SIZE) && (n < max));
+   return n * esize;
+}
+
+/* ========================================================== */
+/* Statistics, cleared on reading as in the driver            */
+/* ========================================================== */
+
+void CtrEmuQueueStats(CtrEmu *emu, int cnum, CtrDrvrQueueStats *qsts) {
+CtrDrvrQueue *queue;
+
+   queue = &(emu->ClientContexts[cnum].Queue);
+   *qsts = queue->Stats;
+   qsts->Depth = queue->Depth;
+   qsts->Size  = queue->Size;
+   bzero((void *) &(queue->Stats), sizeof(CtrDrvrQueueStats));
+}
+
+void CtrEmuIsrStats(CtrEmu *emu, unsigned int module, CtrDrvrIsrStats *isrs) {
+CtrDrvrModuleContext *mcon;
+
+   mcon = &(emu->ModuleContexts[module -1]->Drvr);
+   *isrs = mcon->IsrStats;
+   mcon->IsrStats.MaxNs = 0;
+}
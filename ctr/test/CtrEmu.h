@@ -0,0 +1,67 @@
+/* ************************************************************************** */
+/*                                                                            */
+/* Software emulation of CTR modules, see CtrEmu.c                            */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CTR_EMU
+#define CTR_EMU
+
+#include <ctrdrvrP.h>
+
+#define CtrEmuMODULES  CtrDrvrMODULE_CONTEXTS
+#define CtrEmuNO_TIME  0xFFFFFFFFFFFFFFFFULL
+
+typedef unsigned long long CtrEmuNs;
+
+/* ========================================================== */
+/* Emulated module, the hardware and the driver's module      */
+/* context side by side.                                      */
+/* ========================================================== */
+
+typedef struct {
+   CtrEmuNs StartNs;        /* Time the counter starts */
+   CtrEmuNs OnZeroNs;       /* Time it reaches zero or CtrEmuNO_TIME */
+   int      History;        /* This load owns the counter history */
+ } CtrEmuCounter;
+
+struct CtrEmu;
+
+typedef struct {
+   CtrDrvrModuleContext   Drvr;                              /* Must come first, Drvr.Map points to Hard */
+   CtrDrvrMemoryMap       Hard;                              /* Emulated hardware */
+   CtrEmuCounter          Counters[CtrDrvrCOUNTERS];
+   unsigned int           TrigsUsed;                         /* Highest used trigger index +1 */
+   struct CtrEmu         *Emu;
+ } CtrEmuModule;
+
+typedef struct CtrEmu {
+   CtrEmuNs              NowNs;                         /* Emulated UTC time */
+   CtrEmuNs              CycleNs;                       /* Start of the current cycle, for CTrain */
+   CtrEmuNs              ExtClockNs;                    /* Period of the external clocks */
+   unsigned int          Modules;
+   CtrEmuModule         *ModuleContexts[CtrEmuMODULES];
+   CtrDrvrClientContext  ClientContexts[CtrDrvrCLIENT_CONTEXTS];
+
+   unsigned int          Frames;                        /* Frames received */
+   unsigned int          Triggers;                      /* Triggers fired */
+   unsigned int          Outputs;                       /* Counters reaching zero */
+   CtrEmuNs              IsrNs;                         /* Total time in the ISR, TotalUs rounds down */
+ } CtrEmu;
+
+CtrEmu *CtrEmuCreate(unsigned int modules);
+void    CtrEmuDestroy(CtrEmu *emu);
+
+int  CtrEmuOpen   (CtrEmu *emu, int cnum, CtrDrvrQueueConfig *qcf);
+int  CtrEmuTrigger(CtrEmu *emu, unsigned int module, unsigned int eqpnum,
+		   CtrDrvrTrigger *trig, CtrDrvrCounterConfiguration *conf);
+int  CtrEmuConnect(CtrEmu *emu, int cnum, CtrDrvrConnection *conx);
+
+void CtrEmuAdvance(CtrEmu *emu, CtrEmuNs ns);
+void CtrEmuFrame  (CtrEmu *emu, CtrDrvrEventFrame frame);
+int  CtrEmuRead   (CtrEmu *emu, int cnum, void *buf, int cnt);
+
+void CtrEmuQueueStats(CtrEmu *emu, int cnum, CtrDrvrQueueStats *qsts);
+void CtrEmuIsrStats  (CtrEmu *emu, unsigned int module, CtrDrvrIsrStats *isrs);
+
+#endif
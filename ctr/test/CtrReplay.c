@@ -0,0 +1,535 @@
+/***************************************************************************/
+/* Replay a CTR acquisition log, or a synthetic event stream, through the  */
+/* software CTR emulator in CtrEmu.c. No hardware or driver is needed so   */
+/* trigger matching, the ISR fan out and the client queues can be loaded   */
+/* and timed on any Linux machine.                                         */
+/*                                                                         */
+/* Log mode: each line of an AqLog.txt style file is an output of an LTIM  */
+/* at a known time after the event that loaded it. One PTIM trigger is    */
+/* made per line, events arriving at the same time share one frame, and   */
+/* the frames are sent so that the outputs fall where the log says. The   */
+/* outputs read back are checked against the log.                          */
+/*                                                                         */
+/* Synthetic mode: frames at a given rate each fire a given number of      */
+/* triggers, to find out how far the ISR and queues can be pushed.         */
+/*                                                                         */
+/* Julian Lewis.                                                           */
+/***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <CtrEmu.h>
+
+#define LINES 4096
+#define NAMES 256
+#define NAME_SIZE 32
+#define READ_ENTRIES 256
+
+/* One LTIM output from the log */
+
+typedef struct {
+   unsigned int EqpNum;
+   unsigned int Event;        /* Index in the event names */
+   CtrEmuNs     FrameNs;      /* Time the event frame is sent */
+   CtrEmuNs     OutNs;        /* Time of the counter output */
+   unsigned int Delay;        /* In milliseconds */
+   unsigned int Module;       /* Allocated module 1..n */
+   unsigned int Counter;      /* Allocated counter 1..8 */
+   unsigned int Value;        /* Frame value, one per event occurrence */
+   int          Tndx;         /* Trigger table index */
+ } Line;
+
+static Line  lines[LINES];
+static int   nlines = 0;
+static char  names[NAMES][NAME_SIZE];
+static int   nnames = 0;
+
+/* Busy until time for each counter of each module */
+
+static CtrEmuNs busy[CtrEmuMODULES][CtrDrvrCOUNTERS];
+
+/* Options */
+
+static char  *logname = "AqLog.txt";
+static double speed   = 0.0;      /* 0 as fast as possible, 1.0 real time */
+static int    loops   = 1;
+static int    clients = 1;
+static int    depth   = 0;
+static int    compact = 0;
+static int    rdms    = 0;        /* Read period in emulated ms, 0 after each frame */
+static int    rate    = 0;        /* Synthetic frames per second */
+static int    ntrigs  = 8;
+static int    seconds = 1;
+static int    verbose = 0;
+
+/* Results */
+
+static unsigned int entries = 0;
+static unsigned int errors  = 0;
+static CtrEmuNs     lastrd  = 0;
+
+/***************************************************************************/
+
+static void Usage(char *prog) {
+
+   printf("%s: Replay events through the CTR emulator\n",prog);
+   printf("   -f <file>    AqLog file to replay [%s]\n",logname);
+   printf("   -x <speed>   Speed, 1.0 is real time, 0 as fast as possible [0]\n");
+   printf("   -n <loops>   Number of times to replay the log [1]\n");
+   printf("   -c <clients> Number of clients sharing the LTIMs [1]\n");
+   printf("   -q <depth>   Client queue depth [64]\n");
+   printf("   -k           Use the compact queue format\n");
+   printf("   -r <ms>      Clients read every ms of emulated time, 0 after each frame [0]\n");
+   printf("   -s <hz>      Synthetic mode, frame rate in Hz\n");
+   printf("   -t <trigs>   Synthetic mode, triggers per frame [8]\n");
+   printf("   -d <secs>    Synthetic mode, duration in seconds [1]\n");
+   printf("   -v           Print each output read\n");
+   exit(1);
+}
+
+/***************************************************************************/
+/* Wall clock in ns                                                        */
+
+static CtrEmuNs WallNs() {
+struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC,&t);
+   return (CtrEmuNs) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/***************************************************************************/
+/* Pace the emulator against the wall clock                                */
+
+static CtrEmuNs wall0 = 0;
+
+static void Pace(CtrEmuNs ns) {
+CtrEmuNs due, now;
+
+   if (speed <= 0.0) return;
+   due = wall0 + (CtrEmuNs) ((double) ns / speed);
+   now = WallNs();
+   if (due > now + 1000) usleep((due - now) / 1000);
+}
+
+/***************************************************************************/
+/* Event name to index                                                     */
+
+static int EventIndex(char *name) {
+int i;
+
+   for (i=0; i<nnames; i++) if (strcmp(names[i],name) == 0) return i;
+   if (nnames >= NAMES) return -1;
+   snprintf(names[nnames],NAME_SIZE,"%s",name);
+   return nnames++;
+}
+
+/***************************************************************************/
+/* Read the log, returns the number of outputs found                       */
+
+static int ReadLog(char *name) {
+FILE *fp;
+char  ln[256], ltim[NAME_SIZE], cyc[NAME_SIZE], evt[NAME_SIZE];
+double tim, dly;
+unsigned int eqp, out, start, i;
+int ev;
+long long fns, mns;
+Line *lp;
+
+   fp = fopen(name,"r");
+   if (fp == NULL) {
+      perror(name);
+      return 0;
+   }
+
+   mns = 0;
+   while (fgets(ln,sizeof(ln),fp)) {
+      if (sscanf(ln,"%lf %u %31s %u %31s %31s %u %lf",
+		 &tim,&eqp,ltim,&out,cyc,evt,&start,&dly) != 8) continue;
+      if (nlines >= LINES) break;
+      ev = EventIndex(evt);
+      if (ev < 0) continue;
+
+      lp = &(lines[nlines++]);
+      lp->EqpNum = eqp;
+      lp->Event  = ev;
+      lp->Delay  = (unsigned int) (dly * 1000.0 + 0.5);
+      lp->OutNs  = (CtrEmuNs) (tim * 1000.0 + 0.5) * 1000000ULL;
+
+      /* The counter starts on the millisecond after the frame */
+
+      fns = (long long) lp->OutNs - (long long) lp->Delay * 1000000LL - 500000LL;
+      if (fns < mns) mns = fns;
+      lp->FrameNs = fns;
+   }
+   fclose(fp);
+
+   /* Shift everything by whole milliseconds so that the first */
+   /* frame is after 1 second.                                  */
+
+   mns = 1000000000LL - (mns / 1000000LL - 1) * 1000000LL;
+   for (i=0; i<nlines; i++) {
+      lp = &(lines[i]);
+      lp->FrameNs = (long long) lp->FrameNs + mns;
+      lp->OutNs   = (long long) lp->OutNs   + mns;
+   }
+   return nlines;
+}
+
+/***************************************************************************/
+/* Sort on frame time then event                                           */
+
+static int CmpFrame(const void *a, const void *b) {
+const Line *la = a, *lb = b;
+
+   if (la->FrameNs < lb->FrameNs) return -1;
+   if (la->FrameNs > lb->FrameNs) return  1;
+   return la->Event - lb->Event;
+}
+
+/***************************************************************************/
+/* Give each output a counter free between its frame and its output, and   */
+/* each event occurrence its own frame value. Returns the module count.    */
+
+static int Allocate() {
+Line *lp;
+int i, m, c, modules;
+unsigned int value;
+
+   qsort(lines,nlines,sizeof(Line),CmpFrame);
+
+   modules = 0;
+   value = 0;
+   for (i=0; i<nlines; i++) {
+      lp = &(lines[i]);
+
+      if ((i == 0)
+      ||  (lp->Event   != lines[i-1].Event)
+      ||  (lp->FrameNs != lines[i-1].FrameNs)) value++;
+      lp->Value = value;
+
+      for (m=0; m<CtrEmuMODULES; m++) {
+	 for (c=CtrDrvrCounter1; c<CtrDrvrCOUNTERS; c++)
+	    if (busy[m][c] < lp->FrameNs) break;
+	 if (c < CtrDrvrCOUNTERS) break;
+      }
+      if (m >= CtrEmuMODULES) {
+	 fprintf(stderr,"CtrReplay: Not enough counters for line:%d\n",i);
+	 return 0;
+      }
+      busy[m][c]  = lp->OutNs;
+      lp->Module  = m +1;
+      lp->Counter = c;
+      if (m >= modules) modules = m +1;
+   }
+   return modules;
+}
+
+/***************************************************************************/
+/* The frame an event occurrence is sent on                                */
+
+static CtrDrvrEventFrame Frame(unsigned int event, unsigned int value) {
+CtrDrvrEventFrame frame;
+
+   frame.Long = 0x24000000 | ((event & 0xFF) << 16) | (value & 0xFFFF);
+   return frame;
+}
+
+/***************************************************************************/
+/* Load the triggers and connect the clients                               */
+
+static int Setup(CtrEmu *emu) {
+CtrDrvrTrigger trig;
+CtrDrvrCounterConfiguration conf;
+CtrDrvrConnection conx;
+Line *lp;
+int i, j;
+
+   for (i=0; i<nlines; i++) {
+      lp = &(lines[i]);
+
+      bzero((void *) &trig, sizeof(CtrDrvrTrigger));
+      trig.Frame   = Frame(lp->Event,lp->Value);
+      trig.Ctim    = lp->Event +1;
+      trig.Counter = lp->Counter;
+
+      bzero((void *) &conf, sizeof(CtrDrvrCounterConfiguration));
+      conf.OnZero    = CtrDrvrCounterOnZeroBUS | CtrDrvrCounterOnZeroOUT;
+      conf.Start     = CtrDrvrCounterStartNORMAL;
+      conf.Mode      = CtrDrvrCounterModeNORMAL;
+      conf.Clock     = CtrDrvrCounterClock1KHZ;
+      conf.PulsWidth = 400;
+      conf.Delay     = lp->Delay;
+
+      lp->Tndx = CtrEmuTrigger(emu,lp->Module,lp->EqpNum,&trig,&conf);
+      if (lp->Tndx < 0) {
+	 fprintf(stderr,"CtrReplay: Trigger table full on module:%d\n",lp->Module);
+	 return 0;
+      }
+   }
+
+   /* One connection per LTIM and module, spread over the clients */
+
+   for (i=0; i<nlines; i++) {
+      lp = &(lines[i]);
+      for (j=0; j<i; j++)
+	 if ((lines[j].Module == lp->Module) && (lines[j].EqpNum == lp->EqpNum)) break;
+      if (j < i) continue;
+
+      conx.Module   = lp->Module;
+      conx.EqpClass = CtrDrvrConnectionClassPTIM;
+      conx.EqpNum   = lp->EqpNum;
+      CtrEmuConnect(emu,lp->EqpNum % clients,&conx);
+   }
+   return 1;
+}
+
+/***************************************************************************/
+/* Find the log line of an output, for checking                            */
+
+static Line *FindLine(unsigned int module, unsigned int tndx) {
+int i;
+
+   for (i=0; i<nlines; i++)
+      if ((lines[i].Module == module) && (lines[i].Tndx == tndx)) return &(lines[i]);
+   return NULL;
+}
+
+/***************************************************************************/
+/* Drain the client queues and check the outputs against the log           */
+
+static void ReadClients(CtrEmu *emu, CtrEmuNs base) {
+static CtrDrvrReadBuf buf[READ_ENTRIES];
+CtrDrvrReadBuf *rbf;
+CtrEmuNs ns;
+Line *lp;
+int i, n, cnt;
+
+   for (i=0; i<clients; i++) {
+      while ((cnt = CtrEmuRead(emu,i,buf,sizeof(buf))) > 0) {
+	 if (compact) {
+	    entries += cnt / sizeof(CtrDrvrCompactBuf);
+	    continue;
+	 }
+	 for (n=0; n<cnt/sizeof(CtrDrvrReadBuf); n++) {
+	    rbf = &(buf[n]);
+	    entries++;
+	    ns = (CtrEmuNs) rbf->OnZeroTime.Time.Second * 1000000000ULL
+	       + ((CtrEmuNs) rbf->OnZeroTime.Time.TicksHPTDC * 25) / 32;
+
+	    if (nlines) {
+	       lp = FindLine(rbf->Connection.Module,rbf->TriggerNumber -1);
+	       if ((lp == NULL)
+	       ||  (lp->EqpNum != rbf->Connection.EqpNum)
+	       ||  (base + lp->OutNs != ns)) {
+		  errors++;
+		  printf("Error: Client:%d Mod:%d Trig:%d Eqp:%d Out:%llu\n",
+			 i,rbf->Connection.Module,rbf->TriggerNumber,
+			 rbf->Connection.EqpNum,ns);
+		  continue;
+	       }
+	    }
+	    if (verbose)
+	       printf("Client:%02d Mod:%d Cnt:%d Eqp:%05d Frame:0x%08X C:%05d Out:%llu.%09llu\n",
+		      i,rbf->Connection.Module,rbf->InterruptNumber,
+		      rbf->Connection.EqpNum,(int) rbf->Frame.Long,
+		      rbf->OnZeroTime.CTrain,ns/1000000000ULL,ns%1000000000ULL);
+	 }
+      }
+   }
+}
+
+/***************************************************************************/
+/* Run the emulator up to a frame time, reading when it is due             */
+
+static void RunTo(CtrEmu *emu, CtrEmuNs ns, CtrEmuNs base) {
+CtrEmuNs period;
+
+   period = (CtrEmuNs) rdms * 1000000ULL;
+   if (period) {
+      while (lastrd + period <= ns) {
+	 lastrd += period;
+	 CtrEmuAdvance(emu,lastrd);
+	 ReadClients(emu,base);
+      }
+   }
+   Pace(ns);
+   CtrEmuAdvance(emu,ns);
+}
+
+/***************************************************************************/
+/* Replay the log                                                          */
+
+static void ReplayLog(CtrEmu *emu) {
+CtrEmuNs base, span;
+Line *lp;
+int l, i;
+
+   span = 0;
+   for (i=0; i<nlines; i++) if (lines[i].OutNs > span) span = lines[i].OutNs;
+   span += 1000000000ULL;
+
+   for (l=0; l<loops; l++) {
+      base = l * span;
+      emu->CycleNs = base + 1000000000ULL;
+      for (i=0; i<nlines; i++) {
+	 lp = &(lines[i]);
+	 if ((i) && (lp->Value == lines[i-1].Value)) continue;
+	 RunTo(emu,base + lp->FrameNs,base);
+	 CtrEmuFrame(emu,Frame(lp->Event,lp->Value));
+	 if (rdms == 0) ReadClients(emu,base);
+      }
+      RunTo(emu,base + span,base);
+      ReadClients(emu,base);
+   }
+}
+
+/***************************************************************************/
+/* Synthetic stream, every frame fires all the triggers through a wild    */
+/* card, with a one tick 40MHz delay. Frames arrive half way through the   */
+/* millisecond, above 1KHz the counters are reloaded before they start,    */
+/* just as on the hardware.                                                */
+
+static int ReplaySynthetic(CtrEmu *emu) {
+CtrDrvrTrigger trig;
+CtrDrvrCounterConfiguration conf;
+CtrDrvrConnection conx;
+CtrDrvrEventFrame frame;
+CtrEmuNs ns, step, end;
+unsigned int value;
+int i;
+
+   for (i=0; i<ntrigs; i++) {
+      bzero((void *) &trig, sizeof(CtrDrvrTrigger));
+      trig.Frame.Long = 0x2401FFFF;
+      trig.Ctim       = 1;
+      trig.Counter    = (i % (CtrDrvrCOUNTERS -1)) +1;
+
+      bzero((void *) &conf, sizeof(CtrDrvrCounterConfiguration));
+      conf.OnZero    = CtrDrvrCounterOnZeroBUS;
+      conf.Clock     = CtrDrvrCounterClock40MHZ;
+      conf.PulsWidth = 1;
+      conf.Delay     = 1;
+
+      if (CtrEmuTrigger(emu,(i / (CtrDrvrCOUNTERS -1)) +1,i +1,&trig,&conf) < 0) return 0;
+
+      conx.Module   = (i / (CtrDrvrCOUNTERS -1)) +1;
+      conx.EqpClass = CtrDrvrConnectionClassPTIM;
+      conx.EqpNum   = i +1;
+      CtrEmuConnect(emu,i % clients,&conx);
+   }
+
+   step  = 1000000000ULL / rate;
+   ns    = 1000500000ULL;
+   end   = ns + (CtrEmuNs) seconds * 1000000000ULL;
+   value = 0;
+   emu->CycleNs = 1000000000ULL;
+
+   while (ns < end) {
+      RunTo(emu,ns,0);
+      frame.Long = 0x24010000 | (value++ & 0xFFFF);
+      CtrEmuFrame(emu,frame);
+      if (rdms == 0) ReadClients(emu,0);
+      ns += step;
+   }
+   RunTo(emu,end + 1000000000ULL,0);
+   ReadClients(emu,0);
+   return 1;
+}
+
+/***************************************************************************/
+
+int main(int argc,char *argv[]) {
+
+CtrEmu *emu;
+CtrDrvrQueueConfig qcf;
+CtrDrvrQueueStats qsts;
+CtrDrvrIsrStats isrs;
+CtrEmuNs wall;
+unsigned int interrupts, missed, maxsize, maxburst, maxns;
+int c, i, modules;
+
+   while ((c = getopt(argc,argv,"f:x:n:c:q:kr:s:t:d:vh")) != -1) {
+      switch (c) {
+	 case 'f': logname = optarg;       break;
+	 case 'x': speed   = atof(optarg); break;
+	 case 'n': loops   = atoi(optarg); break;
+	 case 'c': clients = atoi(optarg); break;
+	 case 'q': depth   = atoi(optarg); break;
+	 case 'k': compact = 1;            break;
+	 case 'r': rdms    = atoi(optarg); break;
+	 case 's': rate    = atoi(optarg); break;
+	 case 't': ntrigs  = atoi(optarg); break;
+	 case 'd': seconds = atoi(optarg); break;
+	 case 'v': verbose = 1;            break;
+	 default:  Usage(argv[0]);
+      }
+   }
+   if ((clients < 1) || (clients > CtrDrvrCLIENT_CONTEXTS)) Usage(argv[0]);
+
+   if (rate) {
+      if ((ntrigs < 1) || (ntrigs > CtrEmuMODULES * (CtrDrvrCOUNTERS -1))) Usage(argv[0]);
+      modules = (ntrigs + CtrDrvrCOUNTERS -2) / (CtrDrvrCOUNTERS -1);
+   } else {
+      if (ReadLog(logname) == 0) {
+	 fprintf(stderr,"CtrReplay: No outputs in:%s\n",logname);
+	 exit(1);
+      }
+      modules = Allocate();
+      if (modules == 0) exit(1);
+      printf("CtrReplay: %d outputs, %d events, %d modules from:%s\n",
+	     nlines,nnames,modules,logname);
+   }
+
+   emu = CtrEmuCreate(modules);
+   if (emu == NULL) {
+      fprintf(stderr,"CtrReplay: Can't create %d modules\n",modules);
+      exit(1);
+   }
+
+   qcf.Depth  = depth;
+   qcf.Format = compact ? CtrDrvrQueueFormatCOMPACT : CtrDrvrQueueFormatFULL;
+   for (i=0; i<clients; i++) {
+      if (CtrEmuOpen(emu,i,&qcf) < 0) {
+	 fprintf(stderr,"CtrReplay: Bad queue depth:%d\n",depth);
+	 exit(1);
+      }
+   }
+
+   wall0 = WallNs();
+   if (rate) { if (ReplaySynthetic(emu) == 0) exit(1); }
+   else      { if (Setup(emu) == 0) exit(1); ReplayLog(emu); }
+   wall = WallNs() - wall0;
+
+   interrupts = 0; maxns = 0;
+   for (i=1; i<=modules; i++) {
+      CtrEmuIsrStats(emu,i,&isrs);
+      interrupts += isrs.Interrupts;
+      if (isrs.MaxNs > maxns) maxns = isrs.MaxNs;
+   }
+
+   missed = 0; maxsize = 0; maxburst = 0;
+   for (i=0; i<clients; i++) {
+      CtrEmuQueueStats(emu,i,&qsts);
+      missed += qsts.Missed;
+      if (qsts.MaxSize  > maxsize)  maxsize  = qsts.MaxSize;
+      if (qsts.MaxBurst > maxburst) maxburst = qsts.MaxBurst;
+   }
+
+   printf("Frames:%u Triggers:%u Outputs:%u Interrupts:%u\n",
+	  emu->Frames,emu->Triggers,emu->Outputs,interrupts);
+   printf("Read:%u Missed:%u Errors:%u QueueMaxSize:%u QueueMaxBurst:%u\n",
+	  entries,missed,errors,maxsize,maxburst);
+   printf("Isr: Mean:%lluns Max:%uns\n",
+	  interrupts ? emu->IsrNs / interrupts : 0,maxns);
+   printf("Emulated:%.3fs Wall:%.3fs Frames/s:%.0f Outputs/s:%.0f\n",
+	  (double) emu->NowNs / 1e9,(double) wall / 1e9,
+	  (double) emu->Frames  * 1e9 / (double) (wall ? wall : 1),
+	  (double) emu->Outputs * 1e9 / (double) (wall ? wall : 1));
+
+   CtrEmuDestroy(emu);
+   exit(errors ? 1 : 0);
+}
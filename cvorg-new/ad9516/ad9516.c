@@ -1,92 +1,173 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <ad9516.h>
 
+#define AD9516_DVCO_MIN	2
+#define AD9516_DVCO_MAX	6
+#define AD9516_DX_MAX	32
+#define AD9516_NR_DIVS	((AD9516_DVCO_MAX - AD9516_DVCO_MIN + 1) * \
+			 AD9516_DX_MAX * (AD9516_DX_MAX + 1) / 2)
+
 /*
- * given a desired output frequency and constant f_vco, check if just playing
- * with the output dividers can suffice. If it does, then return 0. Otherwise,
- * return -1, keeping the best dividers found.
+ * Total output divide ratio dvco * d1 * d2, and the dividers that give it.
+ * @order is the position of the dividers in the brute-force search this
+ * table replaces, which is used to pick among dividers with the same total.
  */
-static int ad9516_get_dividers(int freq, struct ad9516_pll *pll)
+struct ad9516_div {
+	int total;
+	int order;
+	int dvco;
+	int d1;
+	int d2;
+};
+
+/* distinct divide ratios, sorted in ascending order */
+static struct ad9516_div ad9516_divs[AD9516_NR_DIVS];
+static int ad9516_nr_divs;
+
+static int ad9516_div_cmp(const void *a, const void *b)
 {
-	double diff;
-	double mindiff = 1e10;
-	int dvco, d1, d2;
-	int i, j, k;
-	double f_vco;
+	const struct ad9516_div *x = a;
+	const struct ad9516_div *y = b;
 
-	f_vco = ((double)pll->input_freq/pll->r)*((double)pll->p * pll->b + pll->a);
+	if (x->total != y->total)
+		return x->total < y->total ? -1 : 1;
+	return x->order - y->order;
+}
 
-	/*
-	 * Note: this loop is sub-optimal, since sometimes combinations
-	 * that lead to the same result are tried.
-	 * For more info on this, check the octave (.m) files in /scripts.
-	 */
-	for (i = 2; i <= 6; i++) {
-		for (j = 1; j <= 32; j++) {
-			for (k = j; k <= 32; k++) {
-				diff = f_vco / i / j / k - freq;
-				if (fabs(diff) <= (double)AD9516_MAXDIFF)
-					goto found;
-				if (fabs(diff) < fabs(mindiff)) {
-					mindiff = diff;
-					dvco = i;
-					d1 = j;
-					d2 = k;
-				}
+/*
+ * Many (dvco, d1, d2) triples share the same total; only the first one
+ * tried by the previous search is kept, so that exact matches are programmed
+ * with the same dividers as before.
+ */
+static void ad9516_divs_init(void)
+{
+	struct ad9516_div *div;
+	int i, j, k, n;
+
+	if (ad9516_nr_divs)
+		return;
+
+	n = 0;
+	for (i = AD9516_DVCO_MIN; i <= AD9516_DVCO_MAX; i++) {
+		for (j = 1; j <= AD9516_DX_MAX; j++) {
+			for (k = j; k <= AD9516_DX_MAX; k++) {
+				div = &ad9516_divs[n];
+				div->total = i * j * k;
+				div->order = n;
+				div->dvco = i;
+				div->d1 = j;
+				div->d2 = k;
+				n++;
 			}
 		}
 	}
-	pll->dvco = dvco;
-	pll->d1 = d1;
-	pll->d2 = d2;
-	return -1;
-found:
-	pll->dvco = i;
-	pll->d1 = j;
-	pll->d2 = k;
-	return 0;
+	qsort(ad9516_divs, n, sizeof(ad9516_divs[0]), ad9516_div_cmp);
+
+	for (i = 1, j = 0; i < n; i++) {
+		if (ad9516_divs[i].total != ad9516_divs[j].total)
+			ad9516_divs[++j] = ad9516_divs[i];
+	}
+	ad9516_nr_divs = j + 1;
 }
 
+/* index of the first divide ratio >= @total */
+static int ad9516_divs_lookup(unsigned long long total)
+{
+	int lo = 0;
+	int hi = ad9516_nr_divs;
+	int mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ad9516_divs[mid].total < total)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* check that N can be expressed as P * B + A with the current prescaler */
+static int ad9516_n_valid(unsigned long long n, int p)
+{
+	unsigned long long b = n / p;
+	unsigned long long a = n % p;
+
+	return b > 0 && b <= 8191 && a <= b && a <= 63;
+}
 
 /*
- * Here we consider the dividers fixed, and play with N, R to calculate
- * a satisfactory f_vco, given a certain required output frequency @freq
+ * Find the dividers and N = P * B + A that get closest to @freq, keeping
+ * R and P fixed and f_vco = clk * N / R within the VCO's range.
+ *
+ * Everything is done with integers: for a total divide ratio D the output
+ * frequency is clk * N / (R * D), so |clk * N - freq * R * D| / D is
+ * proportional to the error and can be compared by cross-multiplying.
+ *
+ * The N that @pll comes with is the preferred f_vco: if it's within
+ * AD9516_MAXDIFF of @freq for some D, it's kept.
  */
-static void __ad9516_calc_pll_params(int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+static int ad9516_solve(unsigned int freq, struct ad9516_pll *pll,
+			unsigned long long clk)
 {
-	double n, nr;
-	double clk = AD9516_OSCILLATOR_FREQ;
-	/*
-	 * What's the required N / R ?
-	 * N / R = Dividers * freq / fref, where Dividers = dvco * d1 * d1
-	 * and fref = AD9516_OSCILLATOR_FREQ
-	 */
-	if (ext_clk)
-		clk = ext_clk_freq;
+	const unsigned long long vco_min = AD9516_VCO_FREQ_MIN;
+	const unsigned long long vco_max = AD9516_VCO_FREQ_MAX;
+	unsigned long long r = pll->r;
+	unsigned long long n0 = (unsigned long long)pll->p * pll->b + pll->a;
+	unsigned long long nmin, nmax, n, d, target, err;
+	unsigned long long best_n = 0, best_d = 0, best_err = 0;
+	const struct ad9516_div *div;
+	const struct ad9516_div *best = NULL;
+	int i;
 
-	nr = (double)pll->dvco * pll->d1 * pll->d2 * freq / clk;
+	ad9516_divs_init();
 
-	n = nr * pll->r;
-	/*
-	 * No need to touch R or P; let's just re-calculate B and A
-	 */
-	pll->b = ((int)n) / pll->p;
-	pll->a = ((int)n) % pll->p;
+	nmin = (vco_min * r + clk - 1) / clk;
+	nmax = vco_max * r / clk;
 
-}
+	/* only the divide ratios that keep f_vco in range can do */
+	i = ad9516_divs_lookup(vco_min / freq);
+	for (; i < ad9516_nr_divs; i++) {
+		div = &ad9516_divs[i];
+		d = div->total;
+		if (d > vco_max / freq + 1)
+			break;
 
+		/* the ideal N is target / clk; try its two neighbours */
+		target = d * freq * r;
+		for (n = target / clk; n <= target / clk + 1; n++) {
+			if (n < nmin || n > nmax || !ad9516_n_valid(n, pll->p))
+				continue;
 
-static void ad9516_calc_pll_params(int freq, struct ad9516_pll *pll)
-{
-    __ad9516_calc_pll_params(freq, pll, 0, 0);
-}
+			err = clk * n > target ? clk * n - target : target - clk * n;
 
-static void ad9516_calc_pll_params_ext_clk(int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq)
-{
-    pll->input_freq = ext_clk_freq;
-    __ad9516_calc_pll_params(freq, pll, ext_clk_freq, 1);
+			if (n == n0 && err <= AD9516_MAXDIFF * r * d) {
+				best = div;
+				best_n = n;
+				goto found;
+			}
+
+			if (best == NULL || err * best_d < best_err * d) {
+				best = div;
+				best_n = n;
+				best_d = d;
+				best_err = err;
+			}
+		}
+	}
+
+	if (best == NULL)
+		return -1;
+found:
+	pll->dvco = best->dvco;
+	pll->d1 = best->d1;
+	pll->d2 = best->d2;
+	pll->b = best_n / pll->p;
+	pll->a = best_n % pll->p;
+	return 0;
 }
 
 static int ad9516_check_pll(struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
@@ -193,24 +274,9 @@ found :
 	return 0;
 } 
 
-int __ad9516_fill_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+static int ad9516_calc_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
 {
-	if (!freq) {
-		pll->a = 0;
-		pll->b = 4375;
-		pll->p = 16;
-		pll->r = 1000;
-		pll->dvco = 1;
-		pll->d1 = 1;
-		pll->d2 = 1;
-		pll->external = 1;
-		return 0;
-	}
-
-	/* initial sanity check */
-	if (freq < AD9516_MINFREQ){
-		return -1;
-	}
+	unsigned long long clk = AD9516_OSCILLATOR_FREQ;
 
 	/*
 	 * Algorithm for adjusting the PLL
@@ -232,27 +298,86 @@ int __ad9516_fill_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned i
 		if (ad9516_get_fvco(freq, pll, ext_clk_freq)) {
 			return -1;
 		}
+		clk = ext_clk_freq;
 	}
 
 	/*
-	 * 2. check if playing with the dividers we can achieve the required
-	 *    output frequency (@freq) without changing the f_vco above.
-	 *    If a exact match is not possible, then return the closest result.
+	 * 2. pick the dividers and N that get closest to the required output
+	 *    frequency (@freq), keeping the f_vco above if it's exact.
 	 */
-	if (ad9516_get_dividers(freq, pll)) {
-		/*
-		 * 2.1 Playing with the dividers is not enough: tune the VCO
-		 *     by adjusting the relation N/R.
-		 */
-		if (ext_clk)
-			ad9516_calc_pll_params_ext_clk(freq, pll, ext_clk_freq);
-		else
-			ad9516_calc_pll_params(freq, pll);
-	}
+	if (ad9516_solve(freq, pll, clk))
+		return -1;
 
 	/* 3. Check the calculated PLL configuration is feasible */
 	return ad9516_check_pll(pll, ext_clk_freq, ext_clk);
-		
+}
+
+/*
+ * Results of previous calculations, indexed by a hash of the requested
+ * frequencies. Note that the cache is not thread-safe.
+ */
+#define AD9516_CACHE_SIZE	64
+
+struct ad9516_cache_entry {
+	int			valid;
+	unsigned int		freq;
+	unsigned int		ext_clk_freq;
+	int			ext_clk;
+	int			ret;
+	struct ad9516_pll	pll;
+};
+
+static struct ad9516_cache_entry ad9516_cache[AD9516_CACHE_SIZE];
+
+static struct ad9516_cache_entry *
+ad9516_cache_slot(unsigned int freq, unsigned int ext_clk_freq, int ext_clk)
+{
+	unsigned int hash = (freq ^ (ext_clk ? ext_clk_freq : 0)) * 2654435761u;
+
+	return &ad9516_cache[hash >> 26];
+}
+
+int __ad9516_fill_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+{
+	struct ad9516_cache_entry *entry;
+	int ret;
+
+	if (!freq) {
+		pll->a = 0;
+		pll->b = 4375;
+		pll->p = 16;
+		pll->r = 1000;
+		pll->dvco = 1;
+		pll->d1 = 1;
+		pll->d2 = 1;
+		pll->external = 1;
+		return 0;
+	}
+
+	/* initial sanity check */
+	if (freq < AD9516_MINFREQ){
+		return -1;
+	}
+
+	if (!ext_clk)
+		ext_clk_freq = 0;
+
+	entry = ad9516_cache_slot(freq, ext_clk_freq, ext_clk);
+	if (entry->valid && entry->freq == freq &&
+		entry->ext_clk_freq == ext_clk_freq && entry->ext_clk == ext_clk) {
+		*pll = entry->pll;
+		return entry->ret;
+	}
+
+	ret = ad9516_calc_pll_conf(freq, pll, ext_clk_freq, ext_clk);
+
+	entry->valid = 1;
+	entry->freq = freq;
+	entry->ext_clk_freq = ext_clk_freq;
+	entry->ext_clk = ext_clk;
+	entry->ret = ret;
+	entry->pll = *pll;
+	return ret;
 }
 
 int ad9516_fill_pll_conf(unsigned int freq, struct ad9516_pll *pll)
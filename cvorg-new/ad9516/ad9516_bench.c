@@ -0,0 +1,335 @@
+/*
+ * ad9516_bench.c
+ *
+ * Sweep a range of output frequencies through the AD9516 PLL solver,
+ * timing it and checking that, for every frequency, its result is at least
+ * as accurate as the one given by the original brute-force search below.
+ *
+ * usage: ad9516_bench [-f from] [-t to] [-s step] [-e ext_clk_freq] [-n]
+ *	-n	don't run the original search (it takes microseconds per call)
+ *
+ * By default all the frequencies from 1 Hz to 100 MHz are swept; those below
+ * AD9516_MINFREQ are rejected by both.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libad9516.h>
+
+extern int ad9516_get_fvco(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq);
+
+/*
+ * The original search, kept here as a reference
+ */
+static int legacy_get_dividers(int freq, struct ad9516_pll *pll)
+{
+	double diff;
+	double mindiff = 1e10;
+	int dvco = 2, d1 = 1, d2 = 1;
+	int i, j, k;
+	double f_vco;
+
+	f_vco = ((double)pll->input_freq/pll->r)*((double)pll->p * pll->b + pll->a);
+
+	/*
+	 * Note: this loop is sub-optimal, since sometimes combinations
+	 * that lead to the same result are tried.
+	 * For more info on this, check the octave (.m) files in /scripts.
+	 */
+	for (i = 2; i <= 6; i++) {
+		for (j = 1; j <= 32; j++) {
+			for (k = j; k <= 32; k++) {
+				diff = f_vco / i / j / k - freq;
+				if (fabs(diff) <= (double)AD9516_MAXDIFF)
+					goto found;
+				if (fabs(diff) < fabs(mindiff)) {
+					mindiff = diff;
+					dvco = i;
+					d1 = j;
+					d2 = k;
+				}
+			}
+		}
+	}
+	pll->dvco = dvco;
+	pll->d1 = d1;
+	pll->d2 = d2;
+	return -1;
+found:
+	pll->dvco = i;
+	pll->d1 = j;
+	pll->d2 = k;
+	return 0;
+}
+
+
+static void legacy_calc_pll_params(int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+{
+	double n, nr;
+	double clk = AD9516_OSCILLATOR_FREQ;
+	/*
+	 * What's the required N / R ?
+	 * N / R = Dividers * freq / fref, where Dividers = dvco * d1 * d1
+	 * and fref = AD9516_OSCILLATOR_FREQ
+	 */
+	if (ext_clk)
+		clk = ext_clk_freq;
+
+	nr = (double)pll->dvco * pll->d1 * pll->d2 * freq / clk;
+
+	n = nr * pll->r;
+	/*
+	 * No need to touch R or P; let's just re-calculate B and A
+	 */
+	pll->b = ((int)n) / pll->p;
+	pll->a = ((int)n) % pll->p;
+
+}
+
+
+static int legacy_check_pll(struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+{
+	int err = 0;
+	double clk = AD9516_OSCILLATOR_FREQ;
+	double fvco; 	
+
+	if (ext_clk)
+		clk = ext_clk_freq;
+	
+	fvco = clk * (pll->p * pll->b + pll->a) / pll->r;
+
+	if (pll->a > pll->b) {
+		err = -1;
+	}
+
+	if (pll->a > 63) {
+		err = -1;
+	}
+
+	/* valid values are powers of two in 2..32 range) */
+	if (pll->p < 2 || pll->p > 32 || (pll->p & (pll->p -1))) {
+		err = -1;
+	}
+
+	if (pll->b <= 0 || pll->b > 8191) {
+		err = -1;
+	}
+
+	if (pll->r <= 0 || pll->r > 16383) {
+		err = -1;
+	}
+
+	if (fvco < 2.55e9 || fvco > 2.95e9) {
+		err = -1;
+	}
+
+	return err;
+}
+
+static int legacy_fill_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq, int ext_clk)
+{
+	if (!freq) {
+		pll->a = 0;
+		pll->b = 4375;
+		pll->p = 16;
+		pll->r = 1000;
+		pll->dvco = 1;
+		pll->d1 = 1;
+		pll->d2 = 1;
+		pll->external = 1;
+		return 0;
+	}
+
+	/* initial sanity check */
+	if (freq < AD9516_MINFREQ){
+		return -1;
+	}
+
+	/*
+	 * Algorithm for adjusting the PLL
+	 */
+
+	if (!ext_clk) {
+		/*
+	 	 * 1. set f_vco = 2.8 GHz
+	 	 *	N = (p * b) + a -> N = 70000
+	 	 *	f_vco = f_ref * N / R = 40e6 * 70000 = 2.8e9 Hz
+	 	 */
+		pll->a = 0;
+		pll->b = 4375;
+		pll->p = 16;
+		pll->r = 1000;
+		pll->external = 0;
+	} else {
+		// Search for proper parameter values.
+		if (ad9516_get_fvco(freq, pll, ext_clk_freq)) {
+			return -1;
+		}
+	}
+
+	/*
+	 * 2. check if playing with the dividers we can achieve the required
+	 *    output frequency (@freq) without changing the f_vco above.
+	 *    If a exact match is not possible, then return the closest result.
+	 */
+	if (legacy_get_dividers(freq, pll)) {
+		/*
+		 * 2.1 Playing with the dividers is not enough: tune the VCO
+		 *     by adjusting the relation N/R.
+		 */
+		if (ext_clk)
+			{
+			pll->input_freq = ext_clk_freq;
+			legacy_calc_pll_params(freq, pll, ext_clk_freq, 1);
+		}
+		else
+			legacy_calc_pll_params(freq, pll, 0, 0);
+	}
+
+	/* 3. Check the calculated PLL configuration is feasible */
+	return legacy_check_pll(pll, ext_clk_freq, ext_clk);
+		
+}
+
+
+static int legacy_pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq)
+{
+	pll->ext_clk_pll = !!ext_clk_freq;
+	pll->external = 0;
+	pll->input_freq = ext_clk_freq ? ext_clk_freq : AD9516_OSCILLATOR_FREQ;
+	return legacy_fill_pll_conf(freq, pll, ext_clk_freq, !!ext_clk_freq);
+}
+
+static int pll_conf(unsigned int freq, struct ad9516_pll *pll, unsigned int ext_clk_freq)
+{
+	if (ext_clk_freq)
+		return ad9516_fill_pll_conf_ext_clk(freq, pll, ext_clk_freq);
+	return ad9516_fill_pll_conf(freq, pll);
+}
+
+/*
+ * The output frequency is clk * N / (R * D); return the numerator of its
+ * error, |clk * N - freq * R * D|, and the denominator R * D in @den.
+ */
+static unsigned long long pll_err(unsigned int freq, struct ad9516_pll *pll,
+				unsigned long long *den)
+{
+	unsigned long long n = (unsigned long long)pll->p * pll->b + pll->a;
+	unsigned long long clk = pll->input_freq;
+	unsigned long long target;
+
+	*den = (unsigned long long)pll->r * pll->dvco * pll->d1 * pll->d2;
+	target = (unsigned long long)freq * *den;
+	return clk * n > target ? clk * n - target : target - clk * n;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int from = 1, to = 100000000, step = 1, ext_clk_freq = 0;
+	unsigned long long err, den, legacy_err, legacy_den;
+	unsigned long nr = 0, ok = 0, legacy_ok = 0, exact = 0, legacy_exact = 0;
+	unsigned long better = 0, worse = 0;
+	double t_new = 0, t_legacy = 0, t_cached = 0, t;
+	struct ad9516_pll pll, legacy;
+	int legacy_run = 1;
+	unsigned int freq;
+	int ret, new_ret, c;
+
+	while ((c = getopt(argc, argv, "f:t:s:e:n")) != -1) {
+		switch (c) {
+		case 'f':
+			from = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			to = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			step = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			ext_clk_freq = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			legacy_run = 0;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f from] [-t to] [-s step] "
+				"[-e ext_clk_freq] [-n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!step || from > to || !from) {
+		fprintf(stderr, "invalid sweep\n");
+		return 1;
+	}
+
+	for (freq = from; freq <= to; freq += step) {
+		nr++;
+
+		t = now();
+		new_ret = pll_conf(freq, &pll, ext_clk_freq);
+		t_new += now() - t;
+
+		/* a repeated request is answered from the cache */
+		t = now();
+		pll_conf(freq, &pll, ext_clk_freq);
+		t_cached += now() - t;
+
+		if (!new_ret) {
+			ok++;
+			if (!pll_err(freq, &pll, &den))
+				exact++;
+		}
+
+		if (legacy_run) {
+			t = now();
+			ret = legacy_pll_conf(freq, &legacy, ext_clk_freq);
+			t_legacy += now() - t;
+			if (!ret) {
+				legacy_ok++;
+				legacy_err = pll_err(freq, &legacy, &legacy_den);
+				if (!legacy_err)
+					legacy_exact++;
+				err = pll_err(freq, &pll, &den);
+				if (!new_ret && err * legacy_den <= legacy_err * den) {
+					if (err * legacy_den < legacy_err * den)
+						better++;
+				} else {
+					worse++;
+					printf("%u Hz: less accurate than before "
+						"(%.6f Hz vs %.6f Hz off)\n", freq,
+						(double)err / den,
+						(double)legacy_err / legacy_den);
+				}
+			}
+		}
+
+		if (to - freq < step)
+			break;
+	}
+
+	printf("%lu frequencies in [%u, %u] Hz, step %u Hz, %s clock\n",
+		nr, from, to, step, ext_clk_freq ? "external" : "internal");
+	printf("solver:   %lu configured, %lu exact, %.3f us/call, "
+		"%.3f us/call repeated\n", ok, exact, t_new * 1e6 / nr,
+		t_cached * 1e6 / nr);
+	if (legacy_run) {
+		printf("original: %lu configured, %lu exact, %.3f us/call\n",
+			legacy_ok, legacy_exact, t_legacy * 1e6 / nr);
+		printf("solver more accurate for %lu, less accurate for %lu\n",
+			better, worse);
+	}
+	return !!worse;
+}
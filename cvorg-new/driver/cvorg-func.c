@@ -14,6 +14,8 @@
 #include <linux/cdev.h>
 #include <linux/fs.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/jhash.h>
 
 #include <vmebus.h>
 #include <cvorg.h>
@@ -52,6 +54,9 @@ static const struct cvorg_limit cvorg_freqlimits[] = {
 };
 #define CVORG_NR_FREQLIMITS	ARRAY_SIZE(cvorg_freqlimits)
 
+/* SRAM entries packed and sent per DMA transfer */
+#define CVORG_SRAM_CHUNK	16384
+
 static inline int __cvorg_channel_busy(struct cvorg_channel *channel)
 {
 	return cvorg_rchan(channel, CVORG_STATUS) & CVORG_STATUS_BUSY;
@@ -436,10 +441,18 @@ int cvorg_hw_version(struct cvorg *cvorg, char *mver)
 	return 0;
 }
 
+/* Forget what we know about a channel's SRAM and block descriptors */
+static inline void cvorg_forget_seq(struct cvorg_channel *channel)
+{
+	channel->nr_sram_wvs = 0;
+	channel->blks_valid = 0;
+}
+
 static void channel_reset(struct cvorg_channel *channel)
 {
 	cvorg_wchan(channel, CVORG_CTL, CVORG_CTL_CHAN_RESET);
 	udelay(5);
+	cvorg_forget_seq(channel);
 }
 
 static void disable_interrupts(struct cvorg *cvorg)
@@ -725,6 +738,7 @@ int cvorg_module_install(struct device *pdev, uint32_t lun, unsigned long base_a
 
         dev_set_drvdata(pdev, cvorg);
 
+	cvorg->vme_base = base_address;
 	cvorg->iomap = (void *)cvorg_map(base_address);
 	if (cvorg->iomap == NULL) {
 		printk(KERN_ERR PFX "Can't find virtual address of the module's registers\n");
@@ -935,16 +949,6 @@ static int seq_init(struct cvorg_seq *seq, struct cvorg_seq *user_seq)
 	return -1;
 }
 
-static ssize_t seq_size(struct cvorg_seq *seq)
-{
-	ssize_t size = 0;
-	int i;
-
-	for (i = 0; i < seq->n_waves; i++)
-		size += seq->waves[i].size;
-	return size;
-}
-
 static ssize_t avail_sram(struct cvorg_channel *channel)
 {
 	return CVORG_SRAM_SIZE;
@@ -959,12 +963,6 @@ static inline unsigned int block_offset(int blocknr)
 	return CVORG_BLKOFFSET + CVORG_BLKSIZE * blocknr;
 }
 
-/* get the offset of the previous descriptor block on mapped memory */
-static inline unsigned int prev_block_offset(int blocknr)
-{
-	return CVORG_BLKOFFSET + CVORG_BLKSIZE * (blocknr - 1);
-}
-
 /*
  * Given two 16-bit long values, convert to a 32-bit SRAM entry
  * Note: the module plays first the rightmost u16 of a 32-bit SRAM entry
@@ -1003,109 +1001,333 @@ static inline uint32_t cvorg_cpu_to_hw_single(uint16_t *data)
  * Since they might be of some use in the future, we set them
  * to zero here, rounding up 3 to 4.
  */
-static void normalize_wv(struct cvorg_wv *wave)
+static inline uint16_t normalize_point(uint16_t point)
 {
-	uint16_t *data = (uint16_t *)wave->form;
-	int len = wave->size / sizeof(uint16_t);
-	int i;
+	/* round up making sure there's no overflow */
+	if (point & 0x3 && point != 0xffff)
+		point += 1;
 
-	for (i = 0; i < len; i++) {
-		/* round up making sure there's no overflow */
-		if (data[i] & 0x3 && data[i] != 0xffff)
-			data[i] += 1;
+	return point & ~0x3;
+}
 
-		data[i] &= ~0x3;
+/*
+ * Pack @len points of @data into SRAM entries, normalising them on the way.
+ * Returns the number of 32-bit entries written to @to.
+ */
+static unsigned int
+pack_wv(uint32_t *to, const uint16_t *data, unsigned int len)
+{
+	uint16_t pair[2];
+	unsigned int i;
+	unsigned int n = 0;
+
+	/* each entry stores two points */
+	for (i = 0; i + 1 < len; i += 2) {
+		pair[0] = normalize_point(data[i]);
+		pair[1] = normalize_point(data[i + 1]);
+		to[n++] = cvorg_cpu_to_hw(pair);
+	}
+
+	if (len % 2) {
+		pair[0] = normalize_point(data[i]);
+		to[n++] = cvorg_cpu_to_hw_single(pair);
 	}
+	return n;
 }
 
 /*
- * Note. the caller has to make sure that he's going to write to a valid
- * location
+ * Write @n SRAM entries to the auto-incrementing SRAMDATA port with a single
+ * DMA transfer. The VME address is not incremented, so the module sees
+ * exactly the same sequence of writes as with PIO.
  */
+static int
+__sram_dma(struct cvorg_channel *chan, uint32_t *entries, unsigned int n)
+{
+	struct cvorg *cvorg = chan->parent;
+	struct vme_dma desc;
+
+	memset(&desc, 0, sizeof(desc));
+
+	desc.dir		= VME_DMA_TO_DEVICE;
+	desc.length		= n * sizeof(uint32_t);
+	desc.novmeinc		= 1;
+
+	desc.src.addrl		= (unsigned long)entries;
+
+	desc.dst.data_width	= VME_D32;
+	desc.dst.am		= CVORG_ADDRESS_MODIFIER;
+	desc.dst.addrl		= cvorg->vme_base + chan->reg_offset + CVORG_SRAMDATA;
+
+	desc.ctrl.pci_block_size	= VME_DMA_BSIZE_4096;
+	desc.ctrl.pci_backoff_time	= VME_DMA_BACKOFF_0;
+	desc.ctrl.vme_block_size	= VME_DMA_BSIZE_4096;
+	desc.ctrl.vme_backoff_time	= VME_DMA_BACKOFF_0;
+
+	return vme_do_dma_kernel(&desc);
+}
+
 static void
-__sram(struct cvorg_channel *chan, struct cvorg_wv *wave, unsigned dest)
+__sram_pio(struct cvorg_channel *chan, uint32_t *entries, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		cvorg_wchan_noswap(chan, CVORG_SRAMDATA, entries[i]);
+}
+
+/*
+ * Note. the caller has to make sure that he's going to write to a valid
+ * location.
+ * The waveform is packed into @bounce in chunks of CVORG_SRAM_CHUNK entries,
+ * and each chunk is sent by DMA. If the DMA fails we carry on by PIO.
+ * Returns 1 if the whole waveform went by DMA, 0 otherwise.
+ */
+static int
+__sram(struct cvorg_channel *chan, struct cvorg_wv *wave, unsigned dest,
+	uint32_t *bounce)
 {
 	uint16_t *data = (uint16_t *)wave->form;
-	int len = wave->size / 2;
-	int i;
+	unsigned int len = wave->size / 2;
+	unsigned int points, n;
+	int dma = 1;
 
 	/* the address auto-increments on every write */
 	cvorg_wchan(chan, CVORG_SRAMADDR, dest);
 
-	/* each write stores two points */
-	for (i = 0; i < len - 1; i += 2)
-		cvorg_wchan_noswap(chan, CVORG_SRAMDATA, cvorg_cpu_to_hw(&data[i]));
+	while (len) {
+		points = min_t(unsigned int, len, CVORG_SRAM_CHUNK * 2);
+		n = pack_wv(bounce, data, points);
 
-	if (len % 2) {
-		uint32_t lastpoint = cvorg_cpu_to_hw_single(&data[i]);
+		if (dma && __sram_dma(chan, bounce, n)) {
+			printk(KERN_WARNING PFX "SRAM DMA failed, falling back to PIO\n");
+			/* restart the chunk, the DMA may have been partial */
+			cvorg_wchan(chan, CVORG_SRAMADDR, dest);
+			dma = 0;
+		}
+		if (!dma)
+			__sram_pio(chan, bounce, n);
 
-		cvorg_wchan_noswap(chan, CVORG_SRAMDATA, lastpoint);
+		data += points;
+		len -= points;
+		dest += n * sizeof(uint32_t);
 	}
+	return dma;
 }
 
-static inline void
-cvorg_wv_mark_prev(struct cvorg_channel *channel, unsigned int prevblock,
-		unsigned int currblock_index)
+/* bits of WFNEXTBLK set up by the driver for each block */
+#define CVORG_WFNEXTBLK_DRV_MASK	(CVORG_WFNEXTBLK_NEXT_MASK |	\
+					CVORG_WFNEXTBLK_CONF_GAIN |	\
+					CVORG_WFNEXTBLK_GAIN_MASK)
+
+/* SRAM entries are 32 bits wide, so waveforms are placed at word boundaries */
+static inline uint32_t sram_footprint(uint32_t size)
 {
-	unsigned int offset = prevblock + CVORG_WFNEXTBLK;
+	return ALIGN(size, sizeof(uint32_t));
+}
 
-	cvorg_uchan(channel, offset, currblock_index, CVORG_WFNEXTBLK_NEXT_MASK);
+/*
+ * Content hash of a waveform. Two 32-bit hashes with different seeds,
+ * together with the size, make a collision between the few waveforms
+ * that a channel can hold negligible.
+ */
+static uint64_t cvorg_wv_hash(struct cvorg_wv *wv)
+{
+	uint32_t lo = jhash(wv->form, wv->size, 0);
+	uint32_t hi = jhash(wv->form, wv->size, 0x9e3779b9);
+
+	return ((uint64_t)hi << 32) | lo;
 }
 
-static inline void
-cvorg_wv_mark_last(struct cvorg_channel *channel, unsigned int block)
+static struct cvorg_sram_wv *
+sram_wv_lookup(struct cvorg_sram_wv *wvs, unsigned int n, uint64_t hash,
+		uint32_t size)
 {
-	unsigned int offset = block + CVORG_WFNEXTBLK;
+	unsigned int i;
 
-	/* write the magic number which marks the end of the sequence */
-	cvorg_uchan(channel, offset, CVORG_WFNEXTBLK_LAST, CVORG_WFNEXTBLK_NEXT_MASK);
+	for (i = 0; i < n; i++) {
+		if (wvs[i].hash == hash && wvs[i].size == size)
+			return &wvs[i];
+	}
+	return NULL;
 }
 
-static inline void
-cvorg_wv_gain_store(struct cvorg_channel *channel, unsigned int block,
-		struct cvorg_wv *wv)
+/*
+ * Find the lowest SRAM address where @size bytes don't overlap any of the
+ * placed waveforms in @wvs. Returns CVORG_SRAM_SIZE if there's no room.
+ */
+static uint32_t sram_first_fit(struct cvorg_sram_wv *wvs, const int *placed,
+			unsigned int n, uint32_t size)
 {
-	unsigned int offset = block + CVORG_WFNEXTBLK;
-	unsigned int val;
+	uint32_t addr = 0;
+	uint32_t start, end;
+	unsigned int i;
 
-	/* set to the default gain (unset the CONF_GAIN bit) */
-	cvorg_achan(channel, offset, ~CVORG_WFNEXTBLK_CONF_GAIN);
+ retry:
+	if (addr + size > CVORG_SRAM_SIZE)
+		return CVORG_SRAM_SIZE;
 
-	/* exit if the user didn't explicitly set the gain */
-	if (!wv->dynamic_gain)
-		return;
+	for (i = 0; i < n; i++) {
+		if (!placed[i])
+			continue;
+		start = wvs[i].addr;
+		end = start + sram_footprint(wvs[i].size);
+		if (addr < end && start < addr + size) {
+			addr = end;
+			goto retry;
+		}
+	}
+	return addr;
+}
 
-	wv->gain_val = 	cvorg_gain_approx(wv->gain_val);
-	val = cvorg_gain_to_hw(wv->gain_val);
+/**
+ * cvorg_seq_layout - place the waveforms of a sequence in SRAM
+ *
+ * @channel:	channel the sequence is for
+ * @seq:	sequence to be placed
+ * @wvs:	filled in with one entry per distinct waveform in @seq
+ * @write:	set for the entries of @wvs that have to be written to SRAM
+ * @idx:	filled in with the index in @wvs of each waveform in @seq
+ *
+ * Identical waveforms in @seq share a single copy in SRAM, and waveforms
+ * already stored in SRAM by a previous sequence are left where they are.
+ * The rest are placed first-fit in the remaining space; if they don't fit
+ * the whole SRAM is laid out again from address zero.
+ *
+ * return number of entries in @wvs on success, -ENOMEM if @seq doesn't fit
+ */
+static int cvorg_seq_layout(struct cvorg_channel *channel,
+			struct cvorg_seq *seq, struct cvorg_sram_wv *wvs,
+			int *write, int *idx)
+{
+	int placed[CVORG_MAX_SEQUENCES];
+	struct cvorg_sram_wv *found;
+	struct cvorg_wv *wv;
+	unsigned int n = 0;
+	uint64_t hash;
+	uint32_t addr;
+	int i;
 
-	/* set the CONF_GAIN bit */
-	cvorg_ochan(channel, offset, CVORG_WFNEXTBLK_CONF_GAIN);
+	for (i = 0; i < seq->n_waves; i++) {
+		wv = &seq->waves[i];
+		hash = cvorg_wv_hash(wv);
+
+		found = sram_wv_lookup(wvs, n, hash, wv->size);
+		if (found) {
+			idx[i] = found - wvs;
+			continue;
+		}
 
-	/* and write the specified gain to the module */
-	val <<= CVORG_WFNEXTBLK_GAIN_SHIFT;
-	cvorg_uchan(channel, offset, val, CVORG_WFNEXTBLK_GAIN_MASK);
+		idx[i] = n;
+		wvs[n].hash = hash;
+		wvs[n].size = wv->size;
+
+		found = sram_wv_lookup(channel->sram_wvs, channel->nr_sram_wvs,
+				hash, wv->size);
+		if (found)
+			wvs[n].addr = found->addr;
+		placed[n] = !!found;
+		write[n] = !found;
+		n++;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (placed[i])
+			continue;
+		addr = sram_first_fit(wvs, placed, n, sram_footprint(wvs[i].size));
+		if (addr >= CVORG_SRAM_SIZE)
+			goto compact;
+		wvs[i].addr = addr;
+		placed[i] = 1;
+	}
+	return n;
+
+ compact:
+	addr = 0;
+	for (i = 0; i < n; i++) {
+		wvs[i].addr = addr;
+		write[i] = 1;
+		addr += sram_footprint(wvs[i].size);
+	}
+	if (addr > avail_sram(channel)) {
+		printk(KERN_WARNING PFX "Not enough memory on the channel for the desired "
+			"waveform. Available/Requested: %zd/%u\n",
+			avail_sram(channel), addr);
+		return -ENOMEM;
+	}
+	return n;
+}
+
+static void cvorg_blk_fill(struct cvorg_blk *blk, struct cvorg_wv *wv,
+			uint32_t ramaddr, unsigned int next)
+{
+	blk->start	= ramaddr;
+	blk->len	= wv->size / 2;
+	blk->recurr	= wv->recurr;
+	blk->next	= next;
+
+	/* keep the default gain unless the user explicitly set it */
+	if (!wv->dynamic_gain)
+		return;
+
+	wv->gain_val = cvorg_gain_approx(wv->gain_val);
+	blk->next |= CVORG_WFNEXTBLK_CONF_GAIN;
+	blk->next |= cvorg_gain_to_hw(wv->gain_val) << CVORG_WFNEXTBLK_GAIN_SHIFT;
 }
 
-static inline void
-cvorg_wv_store(struct cvorg_channel *channel, unsigned int block,
-	struct cvorg_wv *wv)
+/*
+ * Write a block descriptor to the module, skipping the registers that
+ * already hold the desired value.
+ */
+static void cvorg_blk_store(struct cvorg_channel *channel, int blocknr,
+			struct cvorg_blk *blk)
 {
-	cvorg_wchan(channel, block + CVORG_WFLEN, wv->size / 2);
-	cvorg_wchan(channel, block + CVORG_WFRECURR, wv->recurr);
-	cvorg_wv_gain_store(channel, block, wv);
+	struct cvorg_blk *shadow = &channel->blks[blocknr];
+	unsigned int offset = block_offset(blocknr);
+	int valid = test_bit(blocknr, &channel->blks_valid);
+
+	if (!valid || shadow->start != blk->start)
+		cvorg_wchan(channel, offset + CVORG_WFSTART, blk->start);
+	if (!valid || shadow->len != blk->len)
+		cvorg_wchan(channel, offset + CVORG_WFLEN, blk->len);
+	if (!valid || shadow->recurr != blk->recurr)
+		cvorg_wchan(channel, offset + CVORG_WFRECURR, blk->recurr);
+	if (!valid || shadow->next != blk->next)
+		cvorg_uchan(channel, offset + CVORG_WFNEXTBLK, blk->next,
+			CVORG_WFNEXTBLK_DRV_MASK);
+
+	*shadow = *blk;
+	set_bit(blocknr, &channel->blks_valid);
 }
 
 /*
- * Note: The caller has to make sure that there's enough memory in the channel
- * and that the SRAM can be safely accessed.
+ * Note: The caller has to make sure that the SRAM can be safely accessed.
+ *
+ * Only the waveforms that aren't in SRAM yet are written, and only the
+ * descriptor registers that change are updated, so that reloading a sequence
+ * that differs from the previous one in a few blocks is cheap.
  */
-static void __cvorg_storeseq(struct cvorg_channel *channel,
+static int __cvorg_storeseq(struct cvorg_channel *channel,
 			struct cvorg_seq *seq)
 {
-	unsigned int currblock;
-	unsigned int ramaddr = 0;
+	struct cvorg_sram_wv wvs[CVORG_MAX_SEQUENCES];
+	int write[CVORG_MAX_SEQUENCES];
+	int idx[CVORG_MAX_SEQUENCES];
+	struct cvorg_sram_wv *sw;
+	struct cvorg_blk blk;
+	unsigned int bytes = 0;
+	unsigned int next;
 	struct cvorg_wv *wv;
-	int i;
+	uint32_t *bounce;
+	ktime_t start;
+	int dma = 1;
+	int n, i;
+
+	bounce = kmalloc(CVORG_SRAM_CHUNK * sizeof(uint32_t), GFP_KERNEL);
+	if (bounce == NULL) {
+		printk(KERN_ERR PFX "Not enough memory for the SRAM bounce buffer\n");
+		return -ENOMEM;
+	}
+	start = ktime_get();
 
 	/*
 	 * If there's only one waveform in the sequence, the hardware
@@ -1120,35 +1342,48 @@ static void __cvorg_storeseq(struct cvorg_channel *channel,
 		seq->nr = 1;
 	}
 
-	cvorg_wchan(channel, CVORG_SEQNR, seq->nr);
-
-	for (i = 0; i < seq->n_waves; i++) {
-		wv = &seq->waves[i];
-
-		normalize_wv(wv);
-
-		/* write to sram */
-		__sram(channel, wv, ramaddr);
+	n = cvorg_seq_layout(channel, seq, wvs, write, idx);
+	if (n < 0) {
+		kfree(bounce);
+		return n;
+	}
 
-		/* get the offset of the current block */
-		currblock = block_offset(i);
+	/* the SRAM's contents are about to change */
+	channel->nr_sram_wvs = 0;
 
-		/* point the previous block to the current one */
-		if (i > 0)
-			cvorg_wv_mark_prev(channel, prev_block_offset(i), i);
+	for (i = 0; i < seq->n_waves; i++) {
+		sw = &wvs[idx[i]];
+		if (!write[idx[i]])
+			continue;
 
-		/* point the block to the address in SRAM */
-		cvorg_wchan(channel, currblock + CVORG_WFSTART, ramaddr);
+		/* normalise and write to sram */
+		if (!__sram(channel, &seq->waves[i], sw->addr, bounce))
+			dma = 0;
+		write[idx[i]] = 0;
+		bytes += sram_footprint(sw->size);
+	}
 
-		/* fill the rest of the block descriptor */
-		cvorg_wv_store(channel, currblock, wv);
+	cvorg_wchan(channel, CVORG_SEQNR, seq->nr);
 
-		/* mark the last item of the sequence as such */
+	for (i = 0; i < seq->n_waves; i++) {
+		/* the last item of the sequence is marked as such */
 		if (i == seq->n_waves - 1)
-			cvorg_wv_mark_last(channel, currblock);
+			next = CVORG_WFNEXTBLK_LAST;
+		else
+			next = i + 1;
 
-		ramaddr += wv->size;
+		cvorg_blk_fill(&blk, &seq->waves[i], wvs[idx[i]].addr, next);
+		cvorg_blk_store(channel, i, &blk);
 	}
+
+	memcpy(channel->sram_wvs, wvs, n * sizeof(*wvs));
+	channel->nr_sram_wvs = n;
+
+	channel->upload_us = ktime_to_us(ktime_sub(ktime_get(), start));
+	channel->upload_bytes = bytes;
+	channel->upload_dma = dma;
+	kfree(bounce);
+	return 0;
 }
 
 /**
@@ -1159,21 +1394,14 @@ static void __cvorg_storeseq(struct cvorg_channel *channel,
  *
  * @seq is a descriptor containing the set of waveforms to be written. This
  * function checks if there's enough room in the module to host the waveforms
- * and if that's the case, the set of waveforms are written to the module.
+ * and if that's the case, the waveforms not already in SRAM are written to
+ * the module.
  *
  * return 0	- on success
  * return -1	- on failure
  */
 static int cvorg_storeseq(struct cvorg_channel *channel, struct cvorg_seq *seq)
 {
-	/* check there's enough space on SRAM */
-	if (seq_size(seq) > avail_sram(channel)) {
-		printk(KERN_WARNING PFX "Not enough memory on the channel for the desired "
-			"waveform. Available/Requested: %zd/%zd\n",
-			avail_sram(channel), seq_size(seq));
-		goto mem_err;
-	}
-
 	if (seq->n_waves <= 0 || seq->n_waves > CVORG_MAX_SEQUENCES) {
 		printk(KERN_WARNING PFX "Invalid number of desired blocks. Maximum=%d\n",
 			CVORG_MAX_SEQUENCES);
@@ -1185,14 +1413,10 @@ static int cvorg_storeseq(struct cvorg_channel *channel, struct cvorg_seq *seq)
 		goto sram_err;
 	}
 
-	__cvorg_storeseq(channel, seq);
-
-	return 0;
+	return __cvorg_storeseq(channel, seq);
 
  sram_err:
 	return -EAGAIN;
- mem_err:
-	return -ENOMEM;
  val_err:
 	return -EINVAL;
 }
@@ -1506,10 +1730,25 @@ int cvorg_chan_sram(struct cvorg_channel *channel, void *arg, int set)
 	}
 
 	cvorg_wchan_noswap(channel, CVORG_SRAMDATA, cvorg_cpu_to_hw(entry->data));
+	cvorg_forget_seq(channel);
 
 	return 0;
 }
 
+int cvorg_chan_upload_stats(struct cvorg_channel *channel, char *buf)
+{
+	struct cvorg *cvorg = channel->parent;
+	int ret;
+
+	if (mutex_lock_interruptible(&cvorg->lock))
+		return -EINTR;
+	ret = snprintf(buf, PAGE_SIZE, "%u us %u bytes %s\n",
+		channel->upload_us, channel->upload_bytes,
+		channel->upload_dma ? "dma" : "pio");
+	mutex_unlock(&cvorg->lock);
+	return ret;
+}
+
 int cvorg_chan_status(struct cvorg_channel *channel, void *arg)
 {
 	uint32_t *status = arg;
@@ -27,6 +27,32 @@ extern struct class *cvorg_class;
 extern dev_t cvorg_devno;
 
 
+/**
+ * struct cvorg_sram_wv - a waveform stored in a channel's SRAM
+ * @hash:	content hash of the waveform's points
+ * @size:	size of the waveform, in bytes
+ * @addr:	SRAM address of the waveform's first entry
+ */
+struct cvorg_sram_wv {
+	uint64_t	hash;
+	uint32_t	size;
+	uint32_t	addr;
+};
+
+/**
+ * struct cvorg_blk - shadow copy of a block descriptor
+ * @start:	WFSTART register
+ * @len:	WFLEN register
+ * @recurr:	WFRECURR register
+ * @next:	next block and gain fields of the WFNEXTBLK register
+ */
+struct cvorg_blk {
+	uint32_t	start;
+	uint32_t	len;
+	uint32_t	recurr;
+	uint32_t	next;
+};
+
 /**
  * struct cvorg_channel - internal channel structure
  * @inpol:	input polarity
@@ -35,6 +61,13 @@ extern dev_t cvorg_devno;
  * @reg_offset:	offset of the channel's registers within the @parent module.
  * @out_enabled:Set to 1 when the output is enabled. 0 otherwise.
  * @parent:	parent CVORG module
+ * @upload_us:	duration of the last SRAM upload, in microseconds
+ * @upload_bytes: bytes actually written to SRAM by the last upload
+ * @upload_dma:	1 if the last SRAM upload was done by DMA, 0 if by PIO
+ * @sram_wvs:	waveforms currently stored in SRAM
+ * @nr_sram_wvs: number of valid entries in @sram_wvs
+ * @blks:	shadow copies of the block descriptors
+ * @blks_valid:	bitmask of the entries in @blks that match the module
  */
 struct cvorg_channel {
 	struct kobject  kobj;
@@ -45,6 +78,13 @@ struct cvorg_channel {
 	int		out_enabled;
 	int		chan_nr;
 	struct cvorg	*parent;
+	unsigned int	upload_us;
+	unsigned int	upload_bytes;
+	int		upload_dma;
+	struct cvorg_sram_wv	sram_wvs[CVORG_MAX_SEQUENCES];
+	unsigned int	nr_sram_wvs;
+	struct cvorg_blk	blks[CVORG_MAX_SEQUENCES];
+	unsigned long	blks_valid;
 };
 
 /**
@@ -53,6 +93,7 @@ struct cvorg_channel {
  * @lock:	module's lock
  * @owner:	struct file that owns the module
  * @iomap:	kernel virtual address of the module's mapped I/O region
+ * @vme_base:	VME base address of the module, used for DMA
  * @pll:	PLL configuration
  * @channels:	array containing the contexts of the two channels
  */
@@ -64,6 +105,7 @@ struct cvorg {
 	uint32_t		hw_rev;
 	struct mutex		lock;
 	void			*iomap;
+	unsigned long		vme_base;
 	struct ad9516_pll	pll;
 	struct cvorg_channel	channels[CVORG_CHANNELS];
 	uint32_t		irq;
@@ -188,6 +230,7 @@ int cvorg_chan_adc_read(struct cvorg_channel *channel, void *arg);
 int cvorg_chan_loadseq(struct cvorg_channel *channel, void *arg);
 int cvorg_chan_test_mode(struct cvorg_channel *channel, void *arg, int set);
 int cvorg_chan_sram(struct cvorg_channel *channel, void *arg, int set);
+int cvorg_chan_upload_stats(struct cvorg_channel *channel, char *buf);
 int cvorg_pll(struct cvorg *cvorg, void *arg, int set);
 
 /* Functios used by cvorgdrv.c */
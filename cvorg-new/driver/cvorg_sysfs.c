@@ -279,6 +279,12 @@ cvorg_show_sampling_freq(struct cvorg_channel *channel, char *buf)
 	return cvorg_show_uint(card, buf, &val);
 }
 
+static ssize_t
+cvorg_show_upload_stats(struct cvorg_channel *channel, char *buf)
+{
+	return cvorg_chan_upload_stats(channel, buf);
+}
+
 static ssize_t
 cvorg_show_pll(struct kobject *kobj,
 		struct bin_attribute *bin_attr,
@@ -493,6 +499,7 @@ CVORG_CHAN_ATTR(dac_gain, S_IWUSR | S_IRUGO, cvorg_show_dac_gain, cvorg_store_da
 CVORG_CHAN_ATTR(dac_offset, S_IWUSR | S_IRUGO, cvorg_show_dac_offset, cvorg_store_dac_offset);
 CVORG_CHAN_ATTR(dac_value, S_IWUSR | S_IRUGO, cvorg_show_dac_value, cvorg_store_dac_value);
 CVORG_CHAN_ATTR(test_mode, S_IWUSR | S_IRUGO, cvorg_show_test_mode, cvorg_store_test_mode);
+CVORG_CHAN_ATTR(upload_stats, S_IRUGO, cvorg_show_upload_stats, NULL);
 
 /* default attributes of the CSROW<id> object */
 static struct cvorg_channel_attribute *default_cvorg_chan_attr[] = {
@@ -507,6 +514,7 @@ static struct cvorg_channel_attribute *default_cvorg_chan_attr[] = {
 	&attr_dac_offset,
 	&attr_dac_value,
 	&attr_test_mode,
+	&attr_upload_stats,
         NULL,
 };
 
@@ -45,7 +45,10 @@ static char *SpecificIoctlNames[] = {
 	[_IOC_NR(ICVVME_setio)]    	= "Set direction of i/o ports",
 	[_IOC_NR(ICVVME_intenmask)]	= "Read interrupt enable mask",
 	[_IOC_NR(ICVVME_reenflags)]	= "Read reenable flags for all lines",
-	[_IOC_NR(ICVVME_gethandleinfo)]	= "Get handle information"
+	[_IOC_NR(ICVVME_gethandleinfo)]	= "Get handle information",
+	[_IOC_NR(ICVVME_overflow)]	= "Read events dropped on a full ring",
+	[_IOC_NR(ICV196_GR_SNAPSHOT)]	= "Read several groups at once",
+	[_IOC_NR(ICV196_GR_BULKWRITE)]	= "Write several groups at once"
 };
 
 /**
@@ -127,6 +127,8 @@ struct T_LogLineHdl {
 	/* Subscriber table */
 	int SubscriberMxNb; /* size of subscriber table */
 	int SubscriberCurNb; /* current number of subscriber */
+	unsigned int SubsMap; /* bit map of the booked Subscriber[] entries,
+				 so that the isr only visits these */
 	struct T_Subscriber Subscriber[icv_SubscriberNb]; /* Where to cast
 							     the received
 							     trigger */
@@ -161,6 +163,7 @@ struct T_UserHdl {
 	int   WaitingTO;
 	short UserMode;
 	char  Cmap[ICV_mapByteSz]; /* bit map of connection */
+	unsigned long Overflow; /* events dropped on a full ring */
 	struct T_RingBuffer Ring; /* Ring buffer to manage events */
 	struct icvT_RingAtom Atom[Evt_nb]; /* Buffer of Ring buffer */
 };
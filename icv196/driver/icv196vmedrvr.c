@@ -62,6 +62,7 @@
 #define ICVDBG_cprintf  0x200
 #define ICVDBG_timeout  0x400
 #define ICVDBG_kkprintf 0x800
+#define ICVDBG_isr      0x1000
 
 #define ICVDBG_field  0x0000ffff
 
@@ -82,6 +83,9 @@
 #define DBG_TIMEOUT(a)  {if (G_dbgflag & ICVDBG_timeout)  {cprintf  a;}}
 #define DBG_INSTAL(a)   {if (G_dbgflag & ICVDBG_install)  {cprintf  a;}}
 
+/* the isr must not hit the console on every interrupt */
+#define DBG_ISR(a)      {if ((G_dbgflag & ICVDBG_isr) && printk_ratelimit()) {printk a;}}
+
 static char *Version       = "4.0";
 static char compile_date[] = __DATE__;
 static char compile_time[] = __TIME__;
@@ -389,27 +393,28 @@ static void Init_Ring(struct T_UserHdl *UHdl)
 /*
   Subroutine - to push value in ring and signal semaphore,
   -  callable from isr only: no disable done!
+  When the ring is full the oldest event is dropped to make room and
+  counted in the owner's overflow counter; the semaphore count is left
+  as it is, since the ring still holds Evt_nb events.
 */
 static struct icvT_RingAtom *PushTo_Ring(struct T_RingBuffer *Ring,
 					 struct icvT_RingAtom *atom)
 {
 	short I;
 	struct icvT_RingAtom *Atom;
-	struct T_UserHdl *UHdl;
+	struct T_Subscriber *Subs;
+	int full = 0;
 
 	if (Ring->Evtsem >= Evt_nb) { /* Ring buffer full */
-		sreset(&Ring->Evtsem); /* Clear semaphore, awake all
-					  process waiting on it */
-		Ring->reader = Ring->writer = 0;
-
-		/* push an event to signal purge of buffer */
-		Atom = &Ring->Buffer[0];
-		Atom->Subscriber = NULL;
-		Atom->Evt.All= 0;
-		Atom->Evt.Word.w1 = -1;
-		Ring->writer++;
-		ssignal(&Ring->Evtsem);
-		UHdl = Ring->UHdl;
+		Atom = &Ring->Buffer[Ring->reader];
+		if ((Subs = Atom->Subscriber) != NULL) {
+			/* cumulative event: nothing left in the ring */
+			Subs->CumulEvt = NULL;
+			Subs->EvtCounter = -1;
+		}
+		Ring->reader = (Ring->reader + 1) & Ring->mask;
+		Ring->UHdl->Overflow++;
+		full = 1;
 	}
 
 	/* now push the event in the ring */
@@ -418,7 +423,8 @@ static struct icvT_RingAtom *PushTo_Ring(struct T_RingBuffer *Ring,
 	Atom->Evt.All    = atom->Evt.All;
 	Atom->Subscriber = atom->Subscriber;
 	Ring->writer     = (++I & Ring->mask);
-	ssignal(&Ring->Evtsem); /* manage ring */
+	if (!full)
+		ssignal(&Ring->Evtsem); /* manage ring */
 
 	return Atom;
 }
@@ -468,6 +474,7 @@ static void Init_UserHdl(struct T_UserHdl *UHdl, int chanel)
 	UHdl->pid     = 0;
 	UHdl->inuse   = 0; /* not in use */
 	UHdl->sel_sem = NULL; /* clear the semaphore for the select */
+	UHdl->Overflow = 0;
 
 	/* clear up bit map of established connection */
 	bzero(UHdl->Cmap, ARRAY_SIZE(UHdl->Cmap));
@@ -548,6 +555,7 @@ static struct T_LogLineHdl *Init_LineHdl(int lli, struct T_LineCtxt *LCtxt)
 	LHdl->Event_Pattern.Word.w2 = UserLine.All;
 	LHdl->Event_Pattern.Word.w1 = 0;
 	LHdl->SubscriberCurNb = 0; /* Current Subscriber nb set to 0 */
+	LHdl->SubsMap = 0;
 
 	if (LCtxt->Type == icv_FpiLine)
 		/* Fpi line only one subscriber allowed */
@@ -589,6 +597,7 @@ static struct T_Subscriber* LineBooking(struct T_UserHdl *UHdl,
 
 		new = Subs; /* found free one, take it */
 		LHdl->SubscriberCurNb++; /* update current subscriber number */
+		LHdl->SubsMap |= 1 << i;
 		Subs->Ring = &UHdl->Ring; /* link to Ring buffer */
 		Subs->CumulEvt = NULL;
 
@@ -632,6 +641,7 @@ static struct T_Subscriber *LineUnBooking(struct T_UserHdl *UHdl,
 
 		/* subscriber found -- get rid of connection */
 		LHdl->SubscriberCurNb--; /* update current subscriber number */
+		LHdl->SubsMap &= ~(1 << i);
 		Init_SubscriberHdl(Subs, 0); /* init subscriber with
 						default mode */
 
@@ -1310,6 +1320,63 @@ int icv196_write(void *wa, struct cdcm_file *f, char *buff, int bcount)
         return SYSERR;
 }
 
+/*
+  Groups 2k + 1 and 2k share the 16-bit word at offset 2k + 2, the odd
+  group in the high byte. Each word holding a selected group is read
+  once, back to back with interrupts off, so that the groups are
+  sampled together.
+*/
+static void icv196_grp_snapshot(struct T_ModuleCtxt *MCtxt,
+				struct icv196T_GroupIO *gio)
+{
+	ulong ps;
+	struct timeval tv;
+	unsigned short words[icv196_GroupNb / 2];
+	int k;
+
+	disable(ps);
+	do_gettimeofday(&tv);
+	for (k = 0; k < icv196_GroupNb / 2; k++) {
+		if (gio->mask & (3 << (2 * k)))
+			words[k] = cdcm_ioread16be((void *)
+				((long)MCtxt->SYSVME_Add + 2 * k + 2));
+	}
+	restore(ps);
+
+	for (k = 0; k < icv196_GroupNb / 2; k++) {
+		if (gio->mask & (1 << (2 * k)))
+			gio->data[2 * k] = words[k] & 0xff;
+		if (gio->mask & (2 << (2 * k)))
+			gio->data[2 * k + 1] = words[k] >> 8;
+	}
+	gio->sec  = tv.tv_sec;
+	gio->usec = tv.tv_usec;
+}
+
+/* a pair of selected groups is written with one 16-bit access */
+static void icv196_grp_bulkwrite(struct T_ModuleCtxt *MCtxt,
+				 struct icv196T_GroupIO *gio)
+{
+	int k, even, odd;
+
+	for (k = 0; k < icv196_GroupNb / 2; k++) {
+		even = 2 * k;
+		odd  = even + 1;
+		switch ((gio->mask >> even) & 3) {
+		case 1:
+			icv196_grp_wr_8(gio->data[even], even);
+			break;
+		case 2:
+			icv196_grp_wr_8(gio->data[odd], odd);
+			break;
+		case 3:
+			icv196_grp_wr_16(gio->data[odd] << 8 |
+					 gio->data[even], odd);
+			break;
+		}
+	}
+}
+
 /* IOCTL Entry Point */
 int icv196_ioctl(int Chan, int fct, char *arg)
 {
@@ -1324,12 +1391,18 @@ int icv196_ioctl(int Chan, int fct, char *arg)
 	struct icv196T_HandleLines *HanLin;
 	struct icv196T_UserLine ULine;
 	struct icv196T_ModuleInfo *Infop;
+	struct icv196T_GroupIO *Gio;
 	int    Type, LogIx, grp, dir, group_mask, Iw1, Flag;
 	unsigned long *Data;
 
 	//printk("%s() function code = %x \n", __FUNCTION__, fct);
 
 	switch (fct) {
+	case ICVVME_overflow:
+		/* events this channel lost on a full ring */
+		UHdl = &icv196_statics.ICVHdl[Chan];
+		*((unsigned long *) arg) = UHdl->Overflow;
+		break;
 	case ICVVME_getmoduleinfo:
 		/* get device information */
 		Infop = (struct icv196T_ModuleInfo *)arg;
@@ -1890,6 +1963,25 @@ int icv196_ioctl(int Chan, int fct, char *arg)
 			icv196_grp_wr_16((short)*Data, grp);
 		break;
 		}
+	case ICV196_GR_SNAPSHOT:
+	case ICV196_GR_BULKWRITE:
+		Gio = (struct icv196T_GroupIO *)arg;
+		Module = Gio->module;
+		if (!WITHIN_RANGE(0, Module, icv_ModuleNb - 1) ||
+		    (Gio->mask & ~((1 << icv196_GroupNb) - 1))) {
+			pseterr(EINVAL);
+			return SYSERR;
+		}
+		if (!icv196_statics.ModuleCtxtDir[Module]) {
+			pseterr(EACCES);
+			return SYSERR;
+		}
+		MCtxt = &icv196_statics.ModuleCtxt[Module];
+		if (fct == ICV196_GR_SNAPSHOT)
+			icv196_grp_snapshot(MCtxt, Gio);
+		else
+			icv196_grp_bulkwrite(MCtxt, Gio);
+		break;
 	default: /* Ioctl function code out of range */
 #ifdef __ICV196_DEBUG__
 		printk("ioctl function code is out-of-range\n");
@@ -1946,83 +2038,56 @@ int icv196_isr(void *arg)
 	struct T_Subscriber   *Subs;
 	struct icvT_RingAtom  *RingAtom;
 	struct icvT_RingAtom   Atom;
-	int m, i, j, ns, cs;
+	int m, i, j;
 	short count;
 	unsigned short Sw1 = 0;
-	unsigned char mdev, mask, status;
-	static unsigned short input[16] = { 0 }; /* input array */
+	unsigned short input = 0; /* active lines bit map */
+	unsigned int smap;
+	unsigned char status;
 
 	m = MCtxt->Module; /* module index */
 
-	printk("--------------> %s() called <----------------\n", __FUNCTION__);
-
 	if (!(WITHIN_RANGE(0, m, icv_ModuleNb-1)))
 		return SYSERR;
 
 	if (!icv196_statics.ModuleCtxtDir[m])
 		return SYSERR;
 
-	if (!MCtxt->startflag) {
-		/* reset the input array the first
-		   time the routine is entered */
-		for (i = 0; i < ARRAY_SIZE(input); i++)
-			input[i] = 0;
-
-		MCtxt->startflag = 1;
-	}
-
 	status = z8536_rd(); /* force board to defined state */
 
 	/* read portA status reg */
 	status = z8536_rd_val(CSt_Areg);
 
-	if (status & CoSt_Ius) { /* did portA cause the interrupt? */
-		mask = 1;
-		mdev = z8536_rd_val(Data_Areg); /* read portA's data reg */
-		for (i = 0; i <= 7; i++) {
-			if (mdev & mask & MCtxt->int_en_mask)
-				/* mark port A's active interrupt lines */
-				input[i] = 1;
-			mask <<= 1;
-		}
-	}
+	if (status & CoSt_Ius) /* did portA cause the interrupt? */
+		/* mark port A's active interrupt lines */
+		input = z8536_rd_val(Data_Areg) & MCtxt->int_en_mask & 0xff;
 
 	 /* read portB status reg */
 	status = z8536_rd_val(CSt_Breg);
 
-	if (status & CoSt_Ius) { /* did portB cause the interrupt? */
-		mask = 1;
-		mdev = z8536_rd_val(Data_Breg); /* read portB's data reg */
-		for (i = 8; i <= 15; i++) {
-			if (mdev & mask & (MCtxt->int_en_mask >> 8))
-				/* mark port B's active interrupt lines */
-				input[i] = 1;
-			mask <<= 1;
-		}
-	}
+	if (status & CoSt_Ius) /* did portB cause the interrupt? */
+		/* mark port B's active interrupt lines */
+		input |= (z8536_rd_val(Data_Breg) << 8) &
+			MCtxt->int_en_mask & 0xff00;
+
+	DBG_ISR(("%s: module %d lines 0x%04hx\n", __FUNCTION__, m, input));
 
 	/* loop on active line */
-	for (i = 0; i < icv_LineNb; i++) {
-		if (!input[i])	/* line not active */
-			continue;
+	while (input) {
+		i = ffs(input) - 1;
+		input &= input - 1;
 
-		/* line is active */
-		input[i] = 0;
 		LCtxt = &MCtxt->LineCtxt[i];
 		LCtxt->loc_count++;
 		LHdl = LCtxt->LHdl;
 
 		/* Build the Event */
 		Atom.Evt.All = LHdl->Event_Pattern.All;
-		/* scan the subscriber table to send them the event */
-		ns   = LHdl->SubscriberMxNb;
-		cs   = LHdl->SubscriberCurNb;
-		Subs = LHdl->Subscriber;
 
-		for (j = 0; j < ns && cs > 0; j++, Subs++) {
-			if (!Subs->Ring) /* subscriber passive */
-				continue;
-			cs--; /* nb of subbscribers to find out in Subs table */
+		/* send the event to the booked subscribers only */
+		for (smap = LHdl->SubsMap; smap; smap &= smap - 1) {
+			j = ffs(smap) - 1;
+			Subs = &LHdl->Subscriber[j];
 			UHdl = Subs->Ring->UHdl;
 			if ((count = Subs->EvtCounter) != -1) {
 				Sw1 = (unsigned short) count;
@@ -137,6 +137,24 @@ struct icv196T_Service {
 	unsigned long data[icv_LineNb]; /**<  */
 };
 
+/**
+ * @brief several groups of a module read or written in one call
+ *
+ * @param module -- module index [0 - 7]
+ * @param mask   -- bit n selects group n [0 - 11]
+ * @param data   -- one byte per group, indexed by group number
+ * @param sec    -- time of the read (ICV196_GR_SNAPSHOT only)
+ * @param usec   -- microseconds of the read time
+ */
+#define icv196_GroupNb 12
+struct icv196T_GroupIO {
+	unsigned char  module;
+	unsigned short mask;
+	unsigned char  data[icv196_GroupNb];
+	unsigned long  sec;
+	unsigned long  usec;
+};
+
 /* structure of a user line Address */
 struct icv196T_LineUserAdd {
 	char group;		/**<  */
@@ -163,6 +181,9 @@ extern "C" {
 	int icv196_disconnect(int h, short module, short line);
 	int icv196_get_info(int h, int m, int buff_sz, struct icv196T_ModuleInfo *buff);
 	int icv196_set_to(int h, int *val);
+	int icv196_get_overflow(int h, unsigned long *count);
+	int icv196_read_groups(int h, struct icv196T_GroupIO *gio);
+	int icv196_write_groups(int h, struct icv196T_GroupIO *gio);
 /*@} end of group*/
 
 
@@ -49,7 +49,10 @@
 #define ICVVME_gethandleinfo ICV_IOR(19, struct icv196T_HandleInfo)
 #define ICV196_GR_READ       ICV_IOWR(20, struct icv196T_Service)
 #define ICV196_GR_WRITE      ICV_IOWR(21, struct icv196T_Service)
-#define SkelUserIoctlLAST    ICV_IO(22)
+#define ICVVME_overflow      ICV_IOR(22, unsigned long)
+#define ICV196_GR_SNAPSHOT   ICV_IOWR(23, struct icv196T_GroupIO)
+#define ICV196_GR_BULKWRITE  ICV_IOW(24, struct icv196T_GroupIO)
+#define SkelUserIoctlLAST    ICV_IO(25)
 
 #define SkelDrvrSPECIFIC_IOCTL_CALLS (_IOC_NR(SkelUserIoctlLAST) - \
 					_IOC_NR(SkelUserIoctlFIRST) + 1)
@@ -371,20 +371,71 @@ int icv196_set_to(int h, int *val)
 	return 0;
 }
 
+/**
+ * @brief Get the number of events lost by this handle
+ *
+ * @param h     -- library handle, returned by icv196_get_handle()
+ * @param count -- events dropped because the handle's ring was full
+ *
+ * When a burst of interrupts fills the ring, the oldest events are
+ * dropped to make room for the new ones. The counter is cleared when
+ * the handle is opened.
+ *
+ * @return   0 -- all OK
+ * @return < 0 -- failed
+ */
+int icv196_get_overflow(int h, unsigned long *count)
+{
+	int cc;
 
+	cc = ioctl(h, ICVVME_overflow, (char *)count);
+	if (cc < 0) {
+		perror("icv196_get_overflow ioctl failed");
+		return cc;
+	}
+	return 0;
+}
 
+/**
+ * @brief Read several groups of a module in one call
+ *
+ * @param h   -- library handle, returned by icv196_get_handle()
+ * @param gio -- @b module and @b mask of the groups to read at call,
+ *               the selected @b data bytes and the read time at return
+ *
+ * The selected groups are sampled together, so a poll of the whole
+ * board costs one system call instead of one per group.
+ * Groups should be set up with icv196_init_channel() beforehand.
+ *
+ * @return -1 -- failed
+ * @return  0 -- OK
+ */
+int icv196_read_groups(int h, struct icv196T_GroupIO *gio)
+{
+	if (ioctl(h, ICV196_GR_SNAPSHOT, gio) < 0) {
+		perror("ICV196_GR_SNAPSHOT ioctl failed");
+		return -1;
+	}
+	return 0;
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+/**
+ * @brief Write several groups of a module in one call
+ *
+ * @param h   -- library handle, returned by icv196_get_handle()
+ * @param gio -- @b module, @b mask of the groups to write and their
+ *               @b data bytes
+ *
+ * Groups should be set up as outputs with icv196_init_channel().
+ *
+ * @return -1 -- failed
+ * @return  0 -- OK
+ */
+int icv196_write_groups(int h, struct icv196T_GroupIO *gio)
+{
+	if (ioctl(h, ICV196_GR_BULKWRITE, gio) < 0) {
+		perror("ICV196_GR_BULKWRITE ioctl failed");
+		return -1;
+	}
+	return 0;
+}
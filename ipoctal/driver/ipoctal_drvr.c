@@ -80,6 +80,15 @@ typedef enum {
 #define IP_OCTAL_NB_BLOCKS          4
 #define DELAY_MICROSECONDS          1
 #define MAX_CHAR		    256
+#define RX_FIFO_SIZE		    4	/* 3 byte FIFO plus the shift register */
+
+static int tx_buffer_size = MAX_CHAR;
+module_param(tx_buffer_size, int, S_IRUGO);
+MODULE_PARM_DESC(tx_buffer_size, "Size in bytes of the transmit buffer of each channel (default 256).");
+
+static int loopback;
+module_param(loopback, int, S_IRUGO);
+MODULE_PARM_DESC(loopback, "Put all the channels in local loopback mode, for tests.");
 
 struct ipoctal {
 	struct slot_id			*slot_id;
@@ -93,9 +102,7 @@ struct ipoctal {
 	struct ipoctal_readwrite	read_write[NR_CHANNELS];
 	char				*buffer[NR_CHANNELS];
 	unsigned int			nb_bytes[NR_CHANNELS];
-	unsigned int			count_wr[NR_CHANNELS];
 	struct ipoctal_config		chan_config[NR_CHANNELS];
-	wait_queue_head_t		queue[NR_CHANNELS];
 	uart_error			error_flag[NR_CHANNELS];
 	unsigned int			minor[NR_CHANNELS];
 	spinlock_t			lock[NR_CHANNELS];
@@ -104,7 +111,6 @@ struct ipoctal {
 	unsigned int			pointer_write[NR_CHANNELS];		
 	unsigned int			open[NR_CHANNELS];
 	unsigned char			read;
-	unsigned char			write;
 	struct tty_struct 		*tty[NR_CHANNELS];
 	struct ktermios			oldtermios[NR_CHANNELS];
 	struct tty_driver		*tty_drv;
@@ -155,6 +161,10 @@ static int __init ipoctal_init(void)
 {
 
 	printk(KERN_ERR PFX "IP octal driver loading ( %s )...\n", MODULE_NAME);
+	if (tx_buffer_size <= 0) {
+		printk(KERN_ERR PFX "invalid tx_buffer_size %d.\n", tx_buffer_size);
+		return -EINVAL;
+	}
 	if (num_lun != num_irq || num_lun != num_carrier_number ||
 			num_lun != num_slot || num_lun >= IPOCTAL_MAX_BOARDS) {
 		printk(KERN_ERR PFX "the number of parameters doesn't match or are invalid.\n");
@@ -225,6 +235,7 @@ int ipoctal_open(struct tty_struct *tty, struct file *file)
 	}
 
 	ipoctal_installed[index].tty[channel] = tty;
+	ipoctal_installed[index].chan_status[channel] = CHAN_READ;
 	memcpy(&ipoctal_installed[index].oldtermios[channel], tty->termios, sizeof(struct ktermios));
 	ipoctal_write_io_reg(
 		&ipoctal_installed[index], 
@@ -290,6 +301,18 @@ int ipoctal_ioctl(struct tty_struct *tty, struct file *file, unsigned int cmd, u
 		}
 		break;
 	}
+	case IPOCTAL_GET_STATS :
+		if (channel < 0) {
+			res = channel;
+			goto out_ioctl;
+		}
+		if (copy_to_user(user_arg, &ipoctal->chan_stats[channel],
+					sizeof(struct ipoctal_stats))) {
+			res = -EFAULT;
+			goto out_ioctl;
+		}
+		res = 0;
+		break;
 	default:
 		res = -ENOIOCTLCMD;
 		goto out_ioctl;
@@ -318,9 +341,8 @@ static int ipoctal_inst_slot(struct ipoctal *ipoctal, unsigned int carrier_numbe
 		ipoctal->read_write[i].error_flag = UART_NOERROR;
 		ipoctal->read_write[i].nb_bytes = 0;
 		ipoctal->read_write[i].timeout = 0;
-		ipoctal->buffer[i] = kzalloc(MAX_CHAR*sizeof(unsigned char), GFP_KERNEL);
+		ipoctal->buffer[i] = kzalloc(tx_buffer_size*sizeof(unsigned char), GFP_KERNEL);
 		ipoctal->nb_bytes[i] = 0;
-		init_waitqueue_head(&ipoctal->queue[i]);
 		ipoctal->error_flag[i] = UART_NOERROR;
 		ipoctal->minor[i] = 0;
 	}
@@ -543,60 +565,56 @@ static int ipoctal_write_tty(struct tty_struct *tty, const unsigned char *buf, i
 	return ret;
 }
 
-static inline int ipoctal_copy_write_buffer(struct ipoctal *ipoctal, unsigned int channel, const unsigned char *buf, int count) 
+/*
+ * Append to the channel's circular TX buffer as much as fits, and
+ * tell whether the transmitter has to be started.
+ */
+static inline int ipoctal_copy_write_buffer(struct ipoctal *ipoctal, unsigned int channel, const unsigned char *buf, int count, int *start)
 {
 	unsigned long flags;
 	int i;
 	unsigned int *pointer_read = &ipoctal->pointer_read[channel];
 
-	for (i=0; i<count; i++) {
-		if ( i <= (MAX_CHAR - ipoctal->nb_bytes[channel])) {
-			spin_lock_irqsave(&ipoctal->lock[channel], flags);
-			ipoctal->buffer[channel][*pointer_read] = buf[i];
-			*pointer_read = (*pointer_read + 1) % MAX_CHAR;
-			ipoctal->nb_bytes[channel]++;
-			spin_unlock_irqrestore(&ipoctal->lock[channel], flags);
-		}
-		else {
-			break;
-		}
+	spin_lock_irqsave(&ipoctal->lock[channel], flags);
+	for (i=0; (i < count) && (ipoctal->nb_bytes[channel] < tx_buffer_size); i++) {
+		ipoctal->buffer[channel][*pointer_read] = buf[i];
+		*pointer_read = (*pointer_read + 1) % tx_buffer_size;
+		ipoctal->nb_bytes[channel]++;
 	}
+	*start = i && (ipoctal->chan_status[channel] != CHAN_WRITE);
+	if (*start)
+		ipoctal->chan_status[channel] = CHAN_WRITE;
+	spin_unlock_irqrestore(&ipoctal->lock[channel], flags);
 	return i;
 }
 
+/*
+ * Queue the data and return at once, the IRQ handler drains the buffer.
+ * Returns the number of bytes queued, 0 when the buffer is full; the tty
+ * layer then waits on write_room(), so O_NONBLOCK writers and poll()
+ * work as on any serial port.
+ */
 static int ipoctal_write(struct ipoctal *ipoctal, unsigned int channel, const unsigned char *buf, int count)
 {
-	ipoctal->nb_bytes[channel] = 0;
-	ipoctal->count_wr[channel] = 0;
+	int start;
+	int count_wr;
 
-	/* Copy the data to the write buffer */
-	ipoctal_copy_write_buffer(ipoctal, channel, buf, count);
+	count_wr = ipoctal_copy_write_buffer(ipoctal, channel, buf, count, &start);
+	if (!start)
+		return count_wr;
 
 	ipoctal->error_flag[channel] = UART_NOERROR;
 	ipoctal->read_write[channel].error_flag = UART_NOERROR;
 
-	/* Using half-duplex on transmission */
-	ipoctal->chan_status[channel] = CHAN_WRITE;
-	ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_RX);
-
+	/* RS-485 is half-duplex: no reception while transmitting */
 	if (ipoctal->board_id == IP_OCTAL_485_ID) {
+		ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_RX);
 		ipoctal_write_cr_cmd(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, 
 								CR_CMD_ASSERT_RTSN);
 	}
 
 	ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_ENABLE_TX);
-	wait_event_interruptible(ipoctal->queue[channel], ipoctal->write);
-
-	/* End Write operation */
-	ipoctal->write = 0;
-	ipoctal->chan_status[channel] = CHAN_READ;
-
-	if(ipoctal->board_id != IP_OCTAL_485_ID) {
-		ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_TX);
-		ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_ENABLE_RX);
-	}
-
-	return ipoctal->count_wr[channel];
+	return count_wr;
 }
 
 int ipoctal_write_room(struct tty_struct *tty)
@@ -605,7 +623,7 @@ int ipoctal_write_room(struct tty_struct *tty)
 	int channel = tty->index;
 	struct ipoctal *ipoctal = &ipoctal_installed[index];
 
-	return (MAX_CHAR - ipoctal->nb_bytes[channel]);
+	return (tx_buffer_size - ipoctal->nb_bytes[channel]);
 }
 
 int ipoctal_chars_in_buffer(struct tty_struct *tty)
@@ -642,50 +660,80 @@ static int ipoctal_irq_handler(void *arg)
 			isrRxRdy = isr & ISR_RxRDY_FFULL_A;
 		}
 
-		/* In case of RS-485, change from TX to RX. Half-duplex. */
-		if ((ipoctal->board_id == IP_OCTAL_485_ID) && (sr & SR_TX_EMPTY) && (ipoctal->nb_bytes[channel] == 0)) {
-			ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_TX);
-			ipoctal_write_cr_cmd(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_CMD_NEGATE_RTSN);
-			ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_ENABLE_RX);
-			ipoctal->write = 1;
-			wake_up_interruptible(&ipoctal->queue[channel]);
+		/* In case of RS-485, change from TX to RX once the last character is out. Half-duplex. */
+		if ((ipoctal->board_id == IP_OCTAL_485_ID) && isrTxRdy && (sr & SR_TX_EMPTY)) {
+			spin_lock(&ipoctal->lock[channel]);
+			if (ipoctal->nb_bytes[channel] == 0) {
+				ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_TX);
+				ipoctal_write_cr_cmd(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_CMD_NEGATE_RTSN);
+				ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_ENABLE_RX);
+				ipoctal->chan_status[channel] = CHAN_READ;
+			}
+			spin_unlock(&ipoctal->lock[channel]);
 		}
 
-		/* RX data */
-		if (isrRxRdy && (sr & SR_RX_READY) && (ipoctal->chan_status[channel] == CHAN_READ)) {
-			value = ipoctal_read_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.r.rhr);
-			tty_insert_flip_char(ipoctal->tty[channel], value, TTY_NORMAL);
+		/* RX data: drain the FIFO, push the flip buffer once */
+		if (isrRxRdy && (sr & SR_RX_READY) && (ipoctal->chan_status[channel] != CHAN_CLOSE)) {
+			unsigned char rx_sr = sr;
+			unsigned char flag;
+			int n = 0;
+
+			do {
+				/* the error bits belong to the character at the top of the FIFO */
+				flag = TTY_NORMAL;
+				if (rx_sr & SR_RECEIVED_BREAK)
+					flag = TTY_BREAK;
+				else if (rx_sr & SR_PARITY_ERROR)
+					flag = TTY_PARITY;
+				else if (rx_sr & SR_FRAMING_ERROR)
+					flag = TTY_FRAME;
+				sr |= rx_sr & SR_ERROR;
+
+				value = ipoctal_read_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.r.rhr);
+				tty_insert_flip_char(ipoctal->tty[channel], value, flag);
+				n++;
+				rx_sr = ipoctal_read_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.r.sr);
+			} while ((rx_sr & SR_RX_READY) && (n < RX_FIFO_SIZE));
+
+			if (rx_sr & SR_OVERRUN_ERROR) {
+				sr |= SR_OVERRUN_ERROR;
+				tty_insert_flip_char(ipoctal->tty[channel], 0, TTY_OVERRUN);
+			}
 			tty_flip_buffer_push(ipoctal->tty[channel]);
+			ipoctal->chan_stats[channel].rx += n;
+			ipoctal->chan_stats[channel].rx_irq++;
 		}
 
-		/* TX of each character */
+		/* TX: refill the holding register for as long as TxRDY stays set */
 		if (isrTxRdy && (sr & SR_TX_READY) && (ipoctal->chan_status[channel] == CHAN_WRITE)) {
 			unsigned int *pointer_write = &ipoctal->pointer_write[channel];
+			unsigned char tx_sr = sr;
+			int n = 0;
 
-			if(ipoctal->nb_bytes[channel] <= 0) {
-				ipoctal->nb_bytes[channel] = 0;
-				continue;
-			}
 			spin_lock(&ipoctal->lock[channel]);
-			value = ipoctal->buffer[channel][*pointer_write];
-			ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.thr, value);
-			ipoctal->chan_stats[channel].tx++;
-			ipoctal->count_wr[channel]++;
-			(*pointer_write)++;
-			*pointer_write = *pointer_write % MAX_CHAR;
-			ipoctal->nb_bytes[channel]--;
+			while ((tx_sr & SR_TX_READY) && (ipoctal->nb_bytes[channel] > 0)) {
+				value = ipoctal->buffer[channel][*pointer_write];
+				ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.thr, value);
+				(*pointer_write)++;
+				*pointer_write = *pointer_write % tx_buffer_size;
+				ipoctal->nb_bytes[channel]--;
+				n++;
+				tx_sr = ipoctal_read_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.r.sr);
+			}
+			ipoctal->chan_stats[channel].tx += n;
+			if (n)
+				ipoctal->chan_stats[channel].tx_irq++;
+
+			/* Buffer empty: stop the TxRDY interrupts. RS-485 waits for TX_EMPTY above. */
+			if ((ipoctal->nb_bytes[channel] == 0) && (ipoctal->board_id != IP_OCTAL_485_ID)) {
+				ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_TX);
+				ipoctal->chan_status[channel] = CHAN_READ;
+			}
 			spin_unlock(&ipoctal->lock[channel]);
 
-			if ((ipoctal->nb_bytes[channel] == 0) &&
-					(waitqueue_active(&ipoctal->queue[channel]))){
-
-				if (ipoctal->board_id != IP_OCTAL_485_ID) {
-					ipoctal->write = 1;
-					wake_up_interruptible(&ipoctal->queue[channel]);
-				} else {
-					ipoctal->chan_status[channel] = CHAN_OPEN;
-				}
-			}
+			/* room in the buffer: wake up writers and poll() */
+			if (n && ipoctal->tty[channel])
+				tty_wakeup(ipoctal->tty[channel]);
 		}
 
 		/* Error: count statistics */
@@ -708,10 +756,6 @@ static int ipoctal_irq_handler(void *arg)
 				ipoctal->error_flag[channel] |= UART_BREAK;
 				ipoctal->chan_stats[channel].rcv_break++;
 			}
-			if (waitqueue_active(&ipoctal->queue[channel])){
-				ipoctal->chan_status[channel] = CHAN_OPEN;
-				wake_up_interruptible(&ipoctal->queue[channel]);
-			}
 		}
 	}
 	return IRQ_HANDLED;
@@ -725,6 +769,8 @@ static void ipoctal_reset_stats(struct ipoctal_stats *stats)
 	stats->framing_err = 0;
 	stats->overrun_err = 0;
 	stats->parity_err = 0;
+	stats->rx_irq = 0;
+	stats->tx_irq = 0;
 }
 
 static void ipoctal_free_channel(struct tty_struct *tty)
@@ -732,15 +778,20 @@ static void ipoctal_free_channel(struct tty_struct *tty)
 	int index = *(int *)tty->driver_data;
 	int channel = tty->index;
 	struct ipoctal *ipoctal = &ipoctal_installed[index];
+	unsigned long flags;
 
 	if (ipoctal != NULL) {
 		ipoctal_reset_stats(&ipoctal->chan_stats[channel]);
-		ipoctal->chan_status[channel] = CHAN_CLOSE;
 		ipoctal->minor[channel] = 0;
 
+		/* drop what is left to send */
+		spin_lock_irqsave(&ipoctal->lock[channel], flags);
+		ipoctal_write_io_reg(ipoctal, &ipoctal->chan_regs[channel].u.w.cr, CR_DISABLE_TX);
+		ipoctal->chan_status[channel] = CHAN_CLOSE;
 		ipoctal->pointer_read[channel] = 0;
 		ipoctal->pointer_write[channel] = 0;
 		ipoctal->nb_bytes[channel] = 0;
+		spin_unlock_irqrestore(&ipoctal->lock[channel], flags);
 	}
 	else
 		printk(KERN_ERR PFX "ipoctal_free_channel : ipoctal == NULL, is it"
@@ -806,6 +857,12 @@ void ipoctal_set_termios(struct tty_struct *tty, struct ktermios *old_termios)
 	else
 		mr2 |= MR2_STOP_BITS_LENGTH_1;
 
+	/* Local loopback: TX is wired to RX inside the chip */
+	if (loopback)
+		mr2 |= MR2_CH_MODE_LOCAL;
+	else
+		mr2 |= MR2_CH_MODE_NORMAL;
+
 	/* Set the flow control */
 	switch(ipoctal->board_id) {
 		case IP_OCTAL_232_ID :
@@ -79,8 +79,13 @@ struct ipoctal_stats{
     unsigned long parity_err;  /* Number of parity error since last reset */
     unsigned long framing_err; /* Number of framing error since last reset */
     unsigned long rcv_break;   /* Number of break received since last reset */
+    unsigned long rx_irq;      /* Interrupts that received bytes (rx / rx_irq = bytes per interrupt) */
+    unsigned long tx_irq;      /* Interrupts that transmitted bytes (tx / tx_irq = bytes per interrupt) */
 };
 
+/* Read the struct ipoctal_stats of a channel, on its tty */
+#define IPOCTAL_GET_STATS _IOR('o', 1, struct ipoctal_stats)
+
 /**
  * \struct ipoctal_channel
  * \brief Ip Octal channel identification
@@ -0,0 +1,190 @@
+/**
+ * ipoctal_loopback.c
+ *
+ * Full-duplex throughput test for the IPOCTAL boards
+ * Copyright (c) 2011 CERN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Load the driver with loopback=1 (or wire TX to RX on each channel), then
+ *
+ *	ipoctal_loopback [-l lun] [-b baud] [-n bytes]
+ *
+ * sends a pattern on the 8 channels at once with non-blocking writes,
+ * reads it back with poll() and reports the throughput of each channel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+
+#include "libipoctal.h"
+#include "ipoctal_drvr.h"
+
+#define TIMEOUT_MS 2000
+
+struct channel {
+	int fd;
+	int sent;
+	int received;
+	int errors;
+	struct timeval done;
+};
+
+static speed_t baud_to_speed(int baud)
+{
+	switch (baud) {
+	case 9600:	return B9600;
+	case 19200:	return B19200;
+	case 38400:	return B38400;
+	default:	return 0;
+	}
+}
+
+static int open_channel(int lun, int line, speed_t speed)
+{
+	char name[64];
+	struct termios tio;
+	int fd;
+
+	ipoctal_get_device_name(lun, 0, line, name);
+	fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(name);
+		return -1;
+	}
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tcsetattr(fd, TCSANOW, &tio);
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+static double elapsed(struct timeval *t0, struct timeval *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) + (t1->tv_usec - t0->tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	struct channel chan[NR_CHANNELS];
+	struct pollfd pfd[NR_CHANNELS];
+	struct ipoctal_stats stats;
+	struct timeval t0, t1;
+	unsigned char *pattern, buf[256];
+	int lun = 0, baud = 38400, nbytes = 4096;
+	int i, j, n, c, busy;
+	speed_t speed;
+	double secs, total = 0;
+
+	while ((c = getopt(argc, argv, "l:b:n:")) != -1) {
+		switch (c) {
+		case 'l': lun = atoi(optarg); break;
+		case 'b': baud = atoi(optarg); break;
+		case 'n': nbytes = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-l lun] [-b baud] [-n bytes]\n", argv[0]);
+			return 1;
+		}
+	}
+	speed = baud_to_speed(baud);
+	if (!speed || nbytes <= 0) {
+		fprintf(stderr, "invalid baud rate or byte count\n");
+		return 1;
+	}
+
+	pattern = malloc(nbytes);
+	if (pattern == NULL)
+		return 1;
+	for (i = 0; i < nbytes; i++)
+		pattern[i] = i * 7 + (i >> 8);
+
+	for (i = 0; i < NR_CHANNELS; i++) {
+		memset(&chan[i], 0, sizeof(chan[i]));
+		chan[i].fd = open_channel(lun, i, speed);
+		if (chan[i].fd < 0)
+			return 1;
+		pfd[i].fd = chan[i].fd;
+	}
+
+	gettimeofday(&t0, NULL);
+	do {
+		busy = 0;
+		for (i = 0; i < NR_CHANNELS; i++) {
+			pfd[i].events = 0;
+			if (chan[i].received < nbytes) {
+				pfd[i].events |= POLLIN;
+				busy = 1;
+			}
+			if (chan[i].sent < nbytes)
+				pfd[i].events |= POLLOUT;
+		}
+		if (!busy)
+			break;
+		n = poll(pfd, NR_CHANNELS, TIMEOUT_MS);
+		if (n < 0) {
+			perror("poll");
+			return 1;
+		}
+		if (n == 0) {
+			fprintf(stderr, "timeout, data lost\n");
+			break;
+		}
+		for (i = 0; i < NR_CHANNELS; i++) {
+			if (pfd[i].revents & POLLOUT) {
+				n = write(chan[i].fd, pattern + chan[i].sent,
+					  nbytes - chan[i].sent);
+				if (n > 0)
+					chan[i].sent += n;
+				else if (n < 0 && errno != EAGAIN)
+					perror("write");
+			}
+			if (pfd[i].revents & POLLIN) {
+				int was = chan[i].received;
+
+				n = read(chan[i].fd, buf, sizeof(buf));
+				/* bytes past the pattern are noise: errors */
+				for (j = 0; j < n; j++, chan[i].received++)
+					if (chan[i].received >= nbytes ||
+					    buf[j] != pattern[chan[i].received])
+						chan[i].errors++;
+				if (was < nbytes && chan[i].received >= nbytes)
+					gettimeofday(&chan[i].done, NULL);
+			}
+		}
+	} while (1);
+	gettimeofday(&t1, NULL);
+
+	printf("channel      sent  received  errors    bytes/s  bytes/irq tx  rx\n");
+	for (i = 0; i < NR_CHANNELS; i++) {
+		secs = elapsed(&t0, chan[i].received >= nbytes ? &chan[i].done : &t1);
+		memset(&stats, 0, sizeof(stats));
+		ioctl(chan[i].fd, IPOCTAL_GET_STATS, &stats);
+		printf("%c       %9d %9d %7d %10.0f %8.2f %8.2f\n", 'a' + i,
+		       chan[i].sent, chan[i].received, chan[i].errors,
+		       secs > 0 ? chan[i].received / secs : 0.0,
+		       stats.tx_irq ? (double)stats.tx / stats.tx_irq : 0.0,
+		       stats.rx_irq ? (double)stats.rx / stats.rx_irq : 0.0);
+		total += chan[i].received;
+		close(chan[i].fd);
+	}
+	secs = elapsed(&t0, &t1);
+	printf("total %.0f bytes in %.3f s: %.0f bytes/s (line rate %d bytes/s per channel)\n",
+	       total, secs, secs > 0 ? total / secs : 0.0, baud / 10);
+
+	free(pattern);
+	return 0;
+}
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/time.h>
 
 #include <lenval.h>
 #include <micro.h>
@@ -20,7 +21,9 @@ void waitTime(long microsec);
 void pulseClock();
 
 static int xsvf_iDebugLevel = 0;
-static FILE *inp = NULL;
+static unsigned char *inpBuf = NULL;  /* Whole XSVF file */
+static long inpSize = 0;
+static long inpPos = 0;
 static short *jtagAddr = NULL;
 static unsigned short jtag = 0x0F; /* Keep all jtag bits   */
 
@@ -30,49 +33,98 @@ static unsigned short jtag = 0x0F; /* Keep all jtag bits   */
 #include <smemio.c>
 
 /* ********************************************* */
-/* Arguments: Filename VME-Address [Debug-Level] */
+/* Read the whole XSVF file into memory so that  */
+/* it is parsed once whatever the module count.  */
+
+static int LoadXsvf(char *fname) {
+
+FILE *inp;
+
+   inp = fopen(fname,"r");
+   if (inp == NULL) {
+      perror("fopen");
+      printf("Could not open the file: %s for reading\n",fname);
+      return 0;
+   }
+   fseek(inp,0,SEEK_END);
+   inpSize = ftell(inp);
+   fseek(inp,0,SEEK_SET);
+
+   inpBuf = (unsigned char *) malloc(inpSize);
+   if ((inpBuf == NULL) || (fread(inpBuf,1,inpSize,inp) != inpSize)) {
+      printf("Could not read the file: %s\n",fname);
+      fclose(inp);
+      return 0;
+   }
+   fclose(inp);
+   return 1;
+}
+
+/* ********************************************* */
+/* Arguments: Filename VME-Address[,VME-Address] */
+/*            [Debug-Level] [-o]                 */
 
 int main(int argc,char *argv[]) {
 
 char fname[128], *cp, *ep, yn;
-short *vmeAddress;
-int cc;
+short *vmeAddress, *port;
+struct timeval t0, t1;
+int cc, i, args;
 
-   if ((argc < 3) || (argc > 4)) {
-      printf("jtag: <filename> <vme address> [<debug level>]\n");
+   args = 0;
+   for (i=1; i<argc; i++) {
+      if (strcmp(argv[i],"-o") == 0) jtagSetBulk(0);
+      else argv[++args] = argv[i];
+   }
+
+   if ((args < 2) || (args > 3)) {
+      printf("jtag: <filename> <vme address>[,<vme address>...] [<debug level>] [-o]\n");
+      printf("      Several modules are programmed in parallel from one pass over the file\n");
+      printf("      -o Use the original bit by bit player for timing comparison\n");
       printf("Examples:\n");
       printf("         nouchi.xsvf 0x1000\n");
       printf("         nouchi.xsvf 0x1000 4\n");
+      printf("         nouchi.xsvf 0x1000,0x1100,0x1200\n");
       exit(0);
    }
 
    strcpy(fname,argv[1]);
-   cp = argv[2];
-   vmeAddress = (short *) strtoul(cp,&ep,0);
-   if (argc == 4) xsvf_iDebugLevel = strtoul(argv[3],&ep,0);
+   if (args == 3) xsvf_iDebugLevel = strtoul(argv[3],&ep,0);
 
-   printf("VHDL-Compiled BitStream Filename: %s VMEAddress: 0x%X DebugLevel: %d \n",
+   printf("VHDL-Compiled BitStream Filename: %s DebugLevel: %d \n",
 	  fname,
-	  (int) vmeAddress,
 	  (int) xsvf_iDebugLevel);
 
+   cp = argv[2];
+   while (*cp) {
+      vmeAddress = (short *) strtoul(cp,&ep,0);
+      if (ep == cp) break;
+      printf("VMEAddress: 0x%X\n",(int) vmeAddress);
+      port = GetJtagPort((unsigned short *) vmeAddress);
+      if (port == NULL) exit(1);
+      if (!jtagAddModule(port)) {
+	 printf("jtag: Too many modules, max:%d\n",JTAG_MODULES);
+	 exit(1);
+      }
+      cp = ep;
+      if (*cp == ',') cp++;
+   }
+
    printf("Continue (Y/N):"); yn = getchar();
    if ((yn != 'y') && (yn != 'Y')) exit(0);
 
-   inp = fopen(fname,"r");
-   if (inp) {
+   if (LoadXsvf(fname)) {
 
-      if (GetJtagPort(vmeAddress)) {
+      gettimeofday(&t0,NULL);
+      cc = xsvfExecute(); /* Play the xsvf file */
+      gettimeofday(&t1,NULL);
 
-	 cc = xsvfExecute(); /* Play the xsvf file */
-	 if (cc) printf("Jtag: xsvfExecute: ReturnCode: %d Error\n",cc);
-	 else    printf("Jtag: xsvfExecute: ReturnCode: %d All OK\n",cc);
-	 fclose(inp);
-	 exit(0);
-      }
-   } else {
-      perror("fopen");
-      printf("Could not open the file: %s for reading\n",fname);
+      printf("\n");
+      if (cc) printf("Jtag: xsvfExecute: ReturnCode: %d Error\n",cc);
+      else    printf("Jtag: xsvfExecute: ReturnCode: %d All OK\n",cc);
+      jtagReport((double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_usec - t0.tv_usec) / 1000000.0);
+      free(inpBuf);
+      exit(((cc) || (!jtagAllOk())) ? 1 : 0);
    }
    exit(0);
 }
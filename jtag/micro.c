@@ -721,12 +721,20 @@ void xsvfShiftOnly( long    lNumBits,
 
     /* assert( ( ( lNumBits + 7 ) / 8 ) == plvTdi->len ); */
 
+    /* Bulk mode: build the whole shift and play it out in one go */
+    if ( jtagIsBulk() )
+    {
+        jtagScan( lNumBits, plvTdi, plvTdoCaptured, iExitShift );
+        return;
+    }
+
     /* Initialize TDO storage len == TDI len */
     pucTdo  = 0;
     if ( plvTdoCaptured )
     {
         plvTdoCaptured->len = plvTdi->len;
         pucTdo              = plvTdoCaptured->val + plvTdi->len;
+        jtagTdoStart( plvTdi->len );
     }
 
     /* Shift LSB first.  val[N-1] == LSB.  val[0] == MSB. */
@@ -848,7 +856,7 @@ int xsvfShift( unsigned char*   pucTapState,
             if ( plvTdoExpected )
             {
                 /* Compare TDO data to expected TDO data */
-                iMismatch   = !EqualLenVal( plvTdoExpected,
+                iMismatch   = jtagMismatch( plvTdoExpected,
                                             plvTdoCaptured,
                                             plvTdoMask );
             }
@@ -1230,6 +1238,15 @@ int xsvfDoXREPEAT( SXsvfInfo* pXsvfInfo )
     readByte( &(pXsvfInfo->ucMaxRepeat) );
     XSVFDBG_PRINTF1( 3, "   XREPEAT = %d\n",
                      ((unsigned int)(pXsvfInfo->ucMaxRepeat)) );
+    /* Retries can't run in lockstep over several modules */
+    if ( pXsvfInfo->ucMaxRepeat && jtagIsParallel() )
+    {
+        printf( "\nJtag: XREPEAT %d needs TDO retries,"
+                " program the modules one at a time\n",
+                ((unsigned int)(pXsvfInfo->ucMaxRepeat)) );
+        pXsvfInfo->iErrorCode   = XSVF_ERROR_ILLEGALCMD;
+        return( pXsvfInfo->iErrorCode );
+    }
     return( XSVF_ERROR_NONE );
 }
 
@@ -5,6 +5,15 @@
 /*            the TDO bit, and to read a byte of data  */
 /*            from the prom                            */
 /*                                                     */
+/* The original player wrote the port once for every   */
+/* setPort call, three VME writes and a read per bit.  */
+/* In bulk mode (the default) TMS and TDI changes are  */
+/* held until the next TCK edge, and whole XSDR/XSIR   */
+/* shifts are encoded into a word buffer and played    */
+/* out in one loop by jtagScan, two writes per bit.    */
+/* The same words go to every module in the list, so  */
+/* one pass over the XSVF programs them all, and the   */
+/* XRUNTEST waits are paid once instead of per module. */
 /*******************************************************/
 #include "ports.h"
 
@@ -23,6 +32,26 @@
 static unsigned long dito = 0;
 #define DITO 200000
 
+/* Modules being programmed */
+
+static short *jtagAddrs[JTAG_MODULES];
+static int    jtagFailed[JTAG_MODULES];
+static lenVal jtagTdo[JTAG_MODULES];
+static long   jtagTdoBit = 0;
+static int    jtagModules = 0;
+static int    jtagBulk = 1;
+
+/* Scan buffer, one word per TCK edge */
+
+static unsigned short jtagWords[2 * 8 * (MAX_LEN +1)];
+
+/* Statistics */
+
+static unsigned long jtagWrites = 0;
+static unsigned long jtagReads  = 0;
+static unsigned long jtagScans  = 0;
+static unsigned long jtagWaitUs = 0;
+
 /*******************************************************/
 /* Swap bytes on little endian systems                 */
 
@@ -37,10 +66,64 @@ char l,r;
    return word;
 }
 
+/*******************************************************/
+/* Add a module to the list to be programmed           */
+
+int jtagAddModule(short *addr) {
+
+   if (jtagModules >= JTAG_MODULES) return 0;
+   jtagAddrs[jtagModules] = addr;
+   jtagFailed[jtagModules] = 0;
+   jtagModules++;
+   if (jtagAddr == NULL) jtagAddr = addr;
+   return 1;
+}
+
+/*******************************************************/
+/* Select the original one write per setPort player    */
+
+void jtagSetBulk(int flag) {
+   jtagBulk = flag;
+}
+
+int jtagIsBulk() {
+   return jtagBulk;
+}
+
+/*******************************************************/
+/* Non zero when several modules are shifted together  */
+
+int jtagIsParallel() {
+   return (jtagModules > 1);
+}
+
+/*******************************************************/
+/* Write the current jtag word to all working modules  */
+
+static void writePort() {
+
+unsigned short word;
+int m;
+
+   word = swap(jtag);
+   for (m=0; m<jtagModules; m++) {
+      if (jtagFailed[m]) continue;
+      *(jtagAddrs[m]) = word;
+      jtagWrites++;
+   }
+
+   if ((dito++ % DITO) == 0) {
+      printf("\7.");
+      fflush(stdout);
+   }
+}
+
 /*******************************************************/
 /* Write one bit to selected Jtag bit                  */
 /* p is the jtag port TMS, TDI or TCK                  */
 /* val contains the bit value one or zero              */
+/* In bulk mode only TCK changes are written, the TMS  */
+/* and TDI lines only matter on the TCK edge.          */
 
 void setPort(short p,short val) {
    if (val) {
@@ -60,32 +143,172 @@ void setPort(short p,short val) {
 			   jtag &= ~JTAG_TCK; }
       else return;
    }
-   if (jtagAddr) *jtagAddr = swap(jtag);
-
-   if ((dito++ % DITO) == 0) {
-      printf("\7.");
-      fflush(stdout);
-   }
+   if ((jtagBulk) && (p != TCK)) return;
+   writePort();
 }
 
 /*******************************************************/
 /* read in a byte of data from the input stream        */
+/* The XSVF file is read into memory once by the main  */
+/* program, and played from there.                     */
 
 void readByte(unsigned char *data) {
 
-    *data = (unsigned char) fgetc(inp);
+   if (inpPos < inpSize) *data = inpBuf[inpPos++];
+   else                  *data = 0;   /* XCOMPLETE */
+}
+
+/*******************************************************/
+/* Clear each module's TDO capture for a len byte shift */
+
+void jtagTdoStart(short len) {
+int m;
+
+   for (m=0; m<jtagModules; m++) {
+      jtagTdo[m].len = len;
+      bzero((void *) jtagTdo[m].val, len);
+   }
+   jtagTdoBit = 0;
 }
 
 /*******************************************************/
 /* read the TDO bit from port                          */
+/* Every working module is read and its bit captured   */
+/* for jtagMismatch, the first one's bit is returned.  */
 
 unsigned char readTDOBit() {
 unsigned short rback;
+unsigned char  tdo, first;
+int m, byte;
+
+   if (jtagModules == 0) {
+      rback = 0;
+      if (jtagAddr) rback = swap(*jtagAddr);
+      jtagReads++;
+      if (rback & JTAG_TDO)
+	 return (unsigned char) 1;
+      return (unsigned char) 0;
+   }
 
-   if (jtagAddr) rback = swap(*jtagAddr);
-   if (rback & JTAG_TDO)
-      return (unsigned char) 1;
-   return (unsigned char) 0;
+   first = 2;
+   for (m=0; m<jtagModules; m++) {
+      if (jtagFailed[m]) continue;
+      rback = swap(*(jtagAddrs[m]));
+      jtagReads++;
+      tdo = (rback & JTAG_TDO) ? 1 : 0;
+      byte = jtagTdo[m].len -1 - (jtagTdoBit >> 3);
+      if ((tdo) && (byte >= 0)) jtagTdo[m].val[byte] |= (1 << (jtagTdoBit & 7));
+      if (first == 2) first = tdo;
+   }
+   jtagTdoBit++;
+   if (first == 2) return (unsigned char) 0;
+   return first;
+}
+
+/*******************************************************/
+/* Shift a whole XSDR/XSIR, as xsvfShiftOnly but with  */
+/* the port words built first and then played out to  */
+/* all modules in one loop. TDO is captured into each  */
+/* module's lenVal, and the first working module's is  */
+/* copied to plvTdoCaptured for the normal compare.    */
+/* The bit by bit player does the same in readTDOBit.  */
+
+void jtagScan(long lNumBits, lenVal *plvTdi, lenVal *plvTdoCaptured, int iExitShift) {
+
+unsigned short *wp, low, high, rback, word;
+unsigned char  *pucTdi, ucTdiByte;
+long  n, bit;
+int   m, i;
+
+   /* Build the low/high TCK words for each bit, TDI and TMS are */
+   /* set up with TCK going low, and sampled on TCK going high.  */
+
+   wp = jtagWords;
+   pucTdi = plvTdi->val + plvTdi->len;
+   ucTdiByte = 0;
+   for (bit=0; bit<lNumBits; bit++) {
+      if ((bit & 7) == 0) ucTdiByte = *(--pucTdi);
+
+      if ((iExitShift) && (bit == lNumBits -1)) { jtag |=  JTAG_TMS;     jtag &= ~JTAG_TMS_BAR; }
+      if (ucTdiByte & 1)                        { jtag |=  JTAG_TDI;     jtag &= ~JTAG_TDI_BAR; }
+      else                                      { jtag |=  JTAG_TDI_BAR; jtag &= ~JTAG_TDI;     }
+      ucTdiByte >>= 1;
+
+      low  = (jtag | JTAG_TCK_BAR) & ~JTAG_TCK;
+      high = (jtag | JTAG_TCK) & ~JTAG_TCK_BAR;
+      *wp++ = swap(low);
+      *wp++ = swap(high);
+      jtag = high;
+   }
+
+   if (plvTdoCaptured) jtagTdoStart(plvTdi->len);
+
+   /* Play them out, reading TDO after the falling edge */
+
+   wp = jtagWords;
+   for (bit=0; bit<lNumBits; bit++) {
+      word = *wp++;
+      for (m=0; m<jtagModules; m++) if (!jtagFailed[m]) *(jtagAddrs[m]) = word;
+
+      if (plvTdoCaptured) {
+	 for (m=0; m<jtagModules; m++) {
+	    if (jtagFailed[m]) continue;
+	    rback = swap(*(jtagAddrs[m]));
+	    if (rback & JTAG_TDO)
+	       jtagTdo[m].val[plvTdi->len -1 - (bit >> 3)] |= (1 << (bit & 7));
+	 }
+      }
+
+      word = *wp++;
+      for (m=0; m<jtagModules; m++) if (!jtagFailed[m]) *(jtagAddrs[m]) = word;
+   }
+
+   /* Book keeping */
+
+   for (m=0, n=0; m<jtagModules; m++) if (!jtagFailed[m]) n++;
+   jtagWrites += 2 * lNumBits * n;
+   if (plvTdoCaptured) jtagReads += lNumBits * n;
+   jtagScans++;
+
+   if ((dito / DITO) != ((dito + 2 * lNumBits) / DITO)) {
+      printf("\7.");
+      fflush(stdout);
+   }
+   dito += 2 * lNumBits;
+
+   if (plvTdoCaptured) {
+      for (m=0; m<jtagModules; m++) if (!jtagFailed[m]) break;
+      if (m < jtagModules) {
+	 plvTdoCaptured->len = plvTdi->len;
+	 for (i=0; i<plvTdi->len; i++) plvTdoCaptured->val[i] = jtagTdo[m].val[i];
+      }
+   }
+}
+
+/*******************************************************/
+/* Compare the captured TDO with the expected value.   */
+/* With several modules, those that don't match are    */
+/* dropped and the rest carry on. There are no retries */
+/* then, xsvfDoXREPEAT refuses files that need them.   */
+/* Returns non zero on a mismatch.                     */
+
+int jtagMismatch(lenVal *plvTdoExpected, lenVal *plvTdoCaptured, lenVal *plvTdoMask) {
+
+int m, n;
+
+   if (jtagModules <= 1)
+      return !EqualLenVal(plvTdoExpected,plvTdoCaptured,plvTdoMask);
+
+   for (m=0, n=0; m<jtagModules; m++) {
+      if (jtagFailed[m]) continue;
+      if (!EqualLenVal(plvTdoExpected,&(jtagTdo[m]),plvTdoMask)) {
+	 printf("\nJtag: Module:%d TDO mismatch, dropped\n",m +1);
+	 jtagFailed[m] = 1;
+	 continue;
+      }
+      n++;
+   }
+   return (n == 0);
 }
 
 /*****************************************************************************/
@@ -94,6 +317,7 @@ unsigned short rback;
 void waitTime(long microsec) {
    setPort(TCK,0);  /* set the TCK port to low  */
    usleep(microsec);
+   jtagWaitUs += microsec;
 }
 
 /*******************************************************/
@@ -104,3 +328,35 @@ void pulseClock() {
     setPort(TCK,0);  /* set the TCK port to low  */
     setPort(TCK,1);  /* set the TCK port to high */
 }
+
+/*******************************************************/
+/* Print the statistics and module results             */
+
+void jtagReport(double secs) {
+double busy;
+int m;
+
+   busy = secs - (double) jtagWaitUs / 1000000.0;
+   if (busy < 0.0) busy = 0.0;
+
+   printf("Jtag: %s player, Modules:%d Time:%.3fs Waits:%.3fs\n",
+	  jtagBulk ? "Bulk" : "Bit-by-bit",
+	  jtagModules,secs,(double) jtagWaitUs / 1000000.0);
+   printf("Jtag: VME Writes:%lu Reads:%lu Scans:%lu, %.2fus per access\n",
+	  jtagWrites,jtagReads,jtagScans,
+	  (jtagWrites + jtagReads) ?
+	  (busy * 1000000.0) / (double) (jtagWrites + jtagReads) : 0.0);
+   for (m=0; m<jtagModules; m++)
+      printf("Jtag: Module:%d Address:0x%lX %s\n",
+	     m +1,(unsigned long) jtagAddrs[m],jtagFailed[m] ? "FAILED" : "OK");
+}
+
+/*******************************************************/
+/* Did all the modules get programmed                  */
+
+int jtagAllOk() {
+int m;
+
+   for (m=0; m<jtagModules; m++) if (jtagFailed[m]) return 0;
+   return 1;
+}
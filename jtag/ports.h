@@ -14,4 +14,14 @@
 #define TMS (short) 1
 #define TDI (short) 2
 
+/* maximum number of modules programmed in parallel */
+#define JTAG_MODULES 16
+
+/* bulk scan of a whole shift and the TDO compare over all modules */
+extern void jtagScan(long lNumBits, lenVal *plvTdi, lenVal *plvTdoCaptured, int iExitShift);
+extern int  jtagMismatch(lenVal *plvTdoExpected, lenVal *plvTdoCaptured, lenVal *plvTdoMask);
+extern void jtagTdoStart(short len);
+extern int  jtagIsBulk();
+extern int  jtagIsParallel();
+
 #endif
@@ -1,21 +1,24 @@
 /*******************************************************************/
 /* Map the JTAG physical VME adderss onto a virtual memory address */
-/* using a sharded memory segment.                                 */
+/* using a sharded memory segment. The A16 window is mapped once   */
+/* and shared by all the modules being programmed.                 */
 
 #include <libvmebus.h>
 
+static short *jtagBase = NULL; /* Mapped A16 window */
+
 static short *GetJtagPort(unsigned short *vmeAddress) { /* VME address */
 
 struct pdparam_master param; /* For CES PowerPC */
 
 unsigned long addr;          /* VME base address */
 
-   if (!jtagAddr) {
+   addr = (unsigned long) vmeAddress;
+   addr &= 0x0000ffff;                         /* A16 */
 
-      /* CES: build an address window (64 kbyte) for VME A16-D16 accesses */
+   if (!jtagBase) {
 
-      addr = (unsigned long) vmeAddress;
-      addr &= 0x0000ffff;                      /* A16 */
+      /* CES: build an address window (64 kbyte) for VME A16-D16 accesses */
 
       memset(&param, 0, sizeof(param));
       param.iack   = 1;                /* no iack */
@@ -26,18 +29,18 @@ unsigned long addr;          /* VME base address */
       param.dum[1] = 0;                /* XPC ADP-type */
       param.dum[2] = 0;                /* window is sharable */
 
-      jtagAddr = (void *) find_controller(
+      jtagBase = (void *) find_controller(
 				       0,                       /* Vme base address */
 				       (unsigned long) 0x10000, /* Module address space */
 				       (unsigned long) 0x29,    /* Address modifier A16 */
 				       0,                       /* Offset */
 				       2,                       /* Size is D16 */
 				       &param);                 /* Parameter block */
-      if (jtagAddr == (void *)(-1)) {
+      if (jtagBase == (void *)(-1)) {
 	 printf("GetJtagPort: find_controller: ERROR: JTAG Addr:%x\n",(int) vmeAddress);
-	 jtagAddr = NULL;
+	 jtagBase = NULL;
+	 return NULL;
       }
    }
-   jtagAddr = &(jtagAddr[addr >> 1]);
-   return jtagAddr;
+   return &(jtagBase[addr >> 1]);
 }
@@ -50,6 +50,7 @@ static char *mtt_ioctl_names[] = {
 	[_IOC_NR(MTT_IOCRAW_WRITE)]	= "Raw I/O Write",
 	[_IOC_NR(MTT_IOCRAW_READ)]	= "Raw I/O Read",
 	[_IOC_NR(MTT_IOCGVERSION)]	= "Get version",
+	[_IOC_NR(MTT_IOCSLOAD_TASK)]	= "Load a task program",
 	[_IOC_NR(SkelUserIoctlLAST)]	= "MTT Last IOCTL"
 };
 
@@ -644,7 +645,7 @@ mtt_gs_tasks_ioctl(SkelDrvrClientContext *ccon, void *arg, int reg, int set)
 	return SkelUserReturnOK;
 }
 
-/* call with the task's lock held */
+/* call with udata->lock and the task's lock held */
 static void
 __mtt_set_tcb(struct udata *udata, MttDrvrTaskBuf *taskbuf, uint32_t action)
 {
@@ -710,6 +711,12 @@ mtt_gs_tcb_ioctl(SkelDrvrClientContext *ccon, void *arg, int set)
 		return SkelUserReturnFAILED;
 	}
 
+	/*
+	 * The allocator and the name check of the task load scan all the
+	 * tasks under udata->lock only, so take it too when setting.
+	 */
+	if (set)
+		cdcm_mutex_lock(&udata->lock);
 	cdcm_mutex_lock(&localtask->lock);
 	if (set) {
 		for (i = 0; i < MttDrvrTBFbits; i++) {
@@ -722,6 +729,8 @@ mtt_gs_tcb_ioctl(SkelDrvrClientContext *ccon, void *arg, int set)
 		__mtt_get_tcb(udata, taskbuf);
 	}
 	cdcm_mutex_unlock(&localtask->lock);
+	if (set)
+		cdcm_mutex_unlock(&udata->lock);
 
 	return SkelUserReturnOK;
 }
@@ -856,6 +865,9 @@ static void __mtt_get_program(struct udata *udata, MttDrvrInstruction *to,
 	}
 }
 
+static int mtt_range_busy(struct udata *udata, unsigned int start,
+			unsigned int count);
+
 static SkelUserReturn
 mtt_gs_program(struct udata *udata, MttDrvrInstruction *u_prog,
 	MttDrvrInstruction *io_prog, unsigned int elems, int set)
@@ -876,7 +888,17 @@ mtt_gs_program(struct udata *udata, MttDrvrInstruction *u_prog,
 			goto out_err;
 		}
 
+		/*
+		 * Slot loaders write at fixed addresses before setting up
+		 * the TCB, don't let them overwrite a loaded task's program.
+		 */
 		cdcm_mutex_lock(&udata->lock);
+		if (mtt_range_busy(udata, io_prog - udata->iomap->ProgramMem,
+					elems)) {
+			cdcm_mutex_unlock(&udata->lock);
+			pseterr(EBUSY);
+			goto out_err;
+		}
 		__mtt_set_program(udata, io_prog, bounce, elems);
 		cdcm_mutex_unlock(&udata->lock);
 
@@ -906,12 +928,251 @@ mtt_gs_program_ioctl(SkelDrvrClientContext *ccon, void *arg, int set)
 	struct udata		*udata = get_udata_ccon(ccon);
 	MttDrvrMap		*map = udata->iomap;
 	MttDrvrProgramBuf	*prog = arg;
-	MttDrvrInstruction	*ioaddr = &map->ProgramMem[prog->LoadAddress];
+	MttDrvrInstruction	*ioaddr;
+
+	if (prog->LoadAddress >= MttDrvrINSTRUCTIONS ||
+	    prog->InstructionCount > MttDrvrINSTRUCTIONS - prog->LoadAddress) {
+		pseterr(EINVAL);
+		return SkelUserReturnFAILED;
+	}
+	ioaddr = &map->ProgramMem[prog->LoadAddress];
 
 	return mtt_gs_program(udata, prog->Program, ioaddr,
 			prog->InstructionCount, set);
 }
 
+/*
+ * Program memory allocator.
+ *
+ * The allocations are the programs of the loaded (named) tasks, each one
+ * owns [LoadAddress, LoadAddress + InstructionCount). The free list is
+ * built from the task table when it is needed, so tasks unloaded by
+ * clearing their name with MTT_IOCSTCB give their memory back, and
+ * several TCBs sharing one program (as older libmtt loads them) count once.
+ */
+struct mtt_range {
+	unsigned int	start;
+	unsigned int	end;	/* exclusive */
+	uint32_t	tasks;	/* bitmask of the tasks in the range */
+};
+
+/*
+ * Get the used ranges sorted by address, overlapping ranges are merged.
+ * Call with udata->lock held.
+ */
+static int mtt_used_ranges(struct udata *udata, struct mtt_range *used)
+{
+	struct mtt_task	*task;
+	struct mtt_range r;
+	int		i, j, n = 0;
+
+	for (i = 0; i < MttDrvrTASKS; i++) {
+		task = &udata->Tasks[i];
+		if (!task->Name[0] || !task->InstructionCount)
+			continue;
+		r.start	= task->LoadAddress;
+		r.end	= task->LoadAddress + task->InstructionCount;
+		r.tasks	= 1 << i;
+
+		for (j = n; j > 0 && used[j - 1].start > r.start; j--)
+			used[j] = used[j - 1];
+		used[j] = r;
+		n++;
+	}
+
+	for (i = 0, j = 1; j < n; j++) {
+		if (used[j].start < used[i].end) {
+			if (used[j].end > used[i].end)
+				used[i].end = used[j].end;
+			used[i].tasks |= used[j].tasks;
+		} else {
+			used[++i] = used[j];
+		}
+	}
+	return n ? i + 1 : 0;
+}
+
+/*
+ * Non zero if [@start, @start + @count) overlaps the program of a task.
+ * Call with udata->lock held.
+ */
+static int mtt_range_busy(struct udata *udata, unsigned int start,
+			unsigned int count)
+{
+	struct mtt_range used[MttDrvrTASKS];
+	int		i, n;
+
+	n = mtt_used_ranges(udata, used);
+	for (i = 0; i < n; i++) {
+		if (start < used[i].end && used[i].start < start + count)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * First fit allocation of @count instructions.
+ * Returns the load address, or -1 if there is no free range big enough.
+ * Call with udata->lock held.
+ */
+static int mtt_alloc(struct udata *udata, unsigned int count)
+{
+	struct mtt_range used[MttDrvrTASKS];
+	unsigned int	free = 0;
+	int		i, n;
+
+	n = mtt_used_ranges(udata, used);
+	for (i = 0; i < n; i++) {
+		if (used[i].start - free >= count)
+			return free;
+		free = used[i].end;
+	}
+	if (MttDrvrINSTRUCTIONS - free >= count)
+		return free;
+	return -1;
+}
+
+/*
+ * Slide the programs of stopped tasks down to merge the free ranges.
+ * Programs of running tasks stay where they are. A moved task only needs
+ * a new PcOffset, its Pc is relative.
+ * Call with udata->lock held, so that no task can be started meanwhile.
+ */
+static void mtt_compact(SkelDrvrModuleContext *mcon)
+{
+	struct udata		*udata = mcon->UserData;
+	MttDrvrMap		*map = udata->iomap;
+	struct mtt_range	used[MttDrvrTASKS];
+	struct mtt_task		*localtask;
+	MttDrvrInstruction	inst;
+	unsigned int		cursor = 0, delta, a;
+	uint32_t		running;
+	int			i, j, n;
+
+	running = mtt_readw(mcon, MTT_TASKS_CURR) & MttDrvrTASK_MASK;
+	n = mtt_used_ranges(udata, used);
+
+	for (i = 0; i < n; i++) {
+		if ((used[i].tasks & running) || used[i].start == cursor) {
+			cursor = used[i].end;
+			continue;
+		}
+		delta = used[i].start - cursor;
+		for (a = used[i].start; a < used[i].end; a++) {
+			__mtt_get_program(udata, &inst, &map->ProgramMem[a], 1);
+			__mtt_set_program(udata, &map->ProgramMem[a - delta],
+					&inst, 1);
+		}
+		for (j = 0; j < MttDrvrTASKS; j++) {
+			if (!(used[i].tasks & (1 << j)))
+				continue;
+			localtask = &udata->Tasks[j];
+			cdcm_mutex_lock(&localtask->lock);
+			localtask->LoadAddress -= delta;
+			localtask->PcOffset -= delta;
+			cdcm_iowrite32be(localtask->PcOffset,
+					&map->Tasks[j].PcOffset);
+			cdcm_mutex_unlock(&localtask->lock);
+		}
+		cursor = used[i].end - delta;
+	}
+}
+
+/*
+ * Load a program into a free task: allocate program memory, write the
+ * program and set up the TCB, all under the module lock.
+ */
+static SkelUserReturn
+mtt_load_task_ioctl(SkelDrvrClientContext *ccon, void *arg)
+{
+	SkelDrvrModuleContext	*mcon = get_mcon(ccon->ModuleNumber);
+	struct udata		*udata = mcon->UserData;
+	MttDrvrMap		*map = udata->iomap;
+	MttDrvrLoadTaskBuf	*lbuf = arg;
+	MttDrvrInstruction	*bounce;
+	struct mtt_task		*localtask;
+	unsigned int		count = lbuf->InstructionCount;
+	ssize_t			size;
+	int			i, tn, addr, err;
+
+	lbuf->Name[MttDrvrNameSIZE - 1] = '\0';
+	if (!WITHIN_RANGE(1, count, MttDrvrINSTRUCTIONS) || !lbuf->Name[0] ||
+	    !WITHIN_RANGE(1, lbuf->FirstTask, MttDrvrTASKS) ||
+	    !WITHIN_RANGE(lbuf->FirstTask, lbuf->LastTask, MttDrvrTASKS)) {
+		pseterr(EINVAL);
+		return SkelUserReturnFAILED;
+	}
+
+	size = count * sizeof(MttDrvrInstruction);
+	bounce = (void *)sysbrk(size);
+	if (bounce == NULL) {
+		SK_ERROR("%s: -ENOMEM", __FUNCTION__);
+		pseterr(ENOMEM);
+		return SkelUserReturnFAILED;
+	}
+	if (cdcm_copy_from_user(bounce, lbuf->Program, size)) {
+		sysfree((void *)bounce, size);
+		pseterr(EFAULT);
+		return SkelUserReturnFAILED;
+	}
+
+	err = 0;
+	cdcm_mutex_lock(&udata->lock);
+
+	tn = 0;
+	for (i = 0; i < MttDrvrTASKS; i++) {
+		localtask = &udata->Tasks[i];
+		if (!strncmp(localtask->Name, lbuf->Name, MttDrvrNameSIZE)) {
+			err = EEXIST;
+			goto out_unlock;
+		}
+		if (!tn && !localtask->Name[0] &&
+		    WITHIN_RANGE(lbuf->FirstTask, i + 1, lbuf->LastTask))
+			tn = i + 1;
+	}
+	if (!tn) {
+		err = ENOSPC;
+		goto out_unlock;
+	}
+
+	addr = mtt_alloc(udata, count);
+	if (addr < 0) {
+		mtt_compact(mcon);
+		addr = mtt_alloc(udata, count);
+	}
+	if (addr < 0) {
+		err = ENOMEM;
+		goto out_unlock;
+	}
+
+	mtt_writew(mcon, MTT_TASKS_STOP, 1 << (tn - 1));
+	__mtt_set_program(udata, &map->ProgramMem[addr], bounce, count);
+
+	localtask = &udata->Tasks[tn - 1];
+	cdcm_mutex_lock(&localtask->lock);
+	localtask->LoadAddress		= addr;
+	localtask->InstructionCount	= count;
+	localtask->PcStart		= 0;
+	localtask->PcOffset		= addr;
+	localtask->Pc			= 0;
+	strncpy(localtask->Name, lbuf->Name, MttDrvrNameSIZE);
+	cdcm_iowrite32be(addr, &map->Tasks[tn - 1].PcOffset);
+	cdcm_iowrite32be(0, &map->Tasks[tn - 1].Pc);
+	cdcm_mutex_unlock(&localtask->lock);
+
+	lbuf->Task		= tn;
+	lbuf->LoadAddress	= addr;
+
+out_unlock:
+	cdcm_mutex_unlock(&udata->lock);
+	sysfree((void *)bounce, size);
+	if (err) {
+		pseterr(err);
+		return SkelUserReturnFAILED;
+	}
+	return SkelUserReturnOK;
+}
+
 static SkelUserReturn mtt_status_ioctl(SkelDrvrClientContext *ccon, void *arg)
 {
 	SkelDrvrModuleContext	*mcon = get_mcon(ccon->ModuleNumber);
@@ -1009,6 +1270,8 @@ SkelUserIoctls(SkelDrvrClientContext *ccon, SkelDrvrModuleContext *mcon,
 		return mtt_rawio_ioctl(ccon, arg, 0);
 	case MTT_IOCGVERSION:
 		return mtt_version_ioctl(ccon, arg);
+	case MTT_IOCSLOAD_TASK:
+		return mtt_load_task_ioctl(ccon, arg);
 	default:
 		break;
 	}
@@ -70,6 +70,7 @@ typedef enum {
    MttLibErrorNAME,   /* Illegal task name */
    MttLibErrorLREG,   /* No such local register */
    MttLibErrorGREG,   /* No such global register */
+   MttLibErrorSYNTAX, /* Assembler source errors */
    MttLibERRORS
  } MttLibError;
 
@@ -105,6 +106,19 @@ char *MttLibErrorToString(MttLibError err);
 
 MttLibError MttLibLoadTaskObject(char *name, ProgramBuf *pbf);
 MttLibError MttLibLoadTask(char *name);
+
+/* ================================================================ */
+/* Assemble event table source text in memory, without running the  */
+/* asm program or using files. The Program array is allocated here  */
+/* and must be freed by the caller, also after a SYNTAX error. The  */
+/* error messages go to errs unless it is NULL, and the number of   */
+/* errors is returned in errors unless it is NULL.                  */
+
+MttLibError MttLibAssemble(char *text, ProgramBuf *pbf, FILE *errs, int *errors);
+
+/* Assemble source text and load it like MttLibLoadTask */
+
+MttLibError MttLibLoadTaskSource(char *name, char *text);
 MttLibError MttLibUnloadTask(char *name);
 MttLibError MttLibUnloadTasks(void);
 
@@ -76,6 +76,24 @@ typedef struct {
 	char             Name[MttDrvrNameSIZE]; /* Task name */
 } MttDrvrTaskBuf;
 
+/* ------------------------------------------------------------ */
+/* Load a relocatable program into a free task in one call. The */
+/* driver finds a free TCB between FirstTask and LastTask and a */
+/* free range of program memory, compacting the programs of     */
+/* stopped tasks if it must, writes the program and sets up the */
+/* TCB. Task and LoadAddress are returned. Program memory is    */
+/* freed again when the task name is cleared with MTT_IOCSTCB.  */
+
+typedef struct {
+	char               Name[MttDrvrNameSIZE]; /* Task name, must be unique */
+	unsigned long      FirstTask;             /* Task numbers to choose from */
+	unsigned long      LastTask;
+	unsigned long      InstructionCount;      /* Program size */
+	MttDrvrInstruction *Program;              /* Program to load */
+	unsigned long      Task;                  /* Returned task number */
+	unsigned long      LoadAddress;           /* Returned load address */
+} MttDrvrLoadTaskBuf;
+
 /* -------------- */
 /* Task registers */
 
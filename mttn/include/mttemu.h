@@ -0,0 +1,141 @@
+/**************************************************************************/
+/* MTT batch emulator library header file                                 */
+/*                                                                        */
+/* Runs MTT object programs in all the task slots at once against an      */
+/* emulated 1KHz/40MHz time base, with injected input events, so that     */
+/* event tables can be regression tested before they go on a module.      */
+/* Programs are predecoded once into a dispatch array, each instruction   */
+/* carries a pointer to its handler and its resolved operands.            */
+/**************************************************************************/
+
+#ifndef MTTEMU
+#define MTTEMU
+
+#include <libmtt.h>
+
+/* ================================================================ */
+/* Time base. One instruction is executed per 40MHz cycle, the     */
+/* running tasks take turns. The millisecond registers are updated */
+/* and input events arrive at the start of each millisecond.       */
+/*                                                                  */
+/* MSFR   Free running milliseconds                                */
+/* MSMR   Milliseconds modulo one second                           */
+/* TSYNC  Milliseconds since the last sync                         */
+/* SYNCFR Free running sync count                                  */
+
+#define MttEmuCYCLES_PER_MS 40000
+#define MttEmuNS_PER_CYCLE  25
+
+/* ================================================================ */
+/* A predecoded instruction                                         */
+
+struct MttEmu;
+struct MttEmuTask;
+struct MttEmuOp;
+
+typedef void (*MttEmuFn)(struct MttEmu *emu, struct MttEmuTask *task, struct MttEmuOp *op);
+
+typedef struct MttEmuOp {
+   MttEmuFn      Fn;      /* Handler, illegal op codes stop the task */
+   long          Src1;    /* Literal, address or register number */
+   unsigned char Src2;    /* Register number */
+   unsigned char Dest;    /* Register number */
+   unsigned char Number;  /* Op code number for traces */
+ } MttEmuOp;
+
+/* ================================================================ */
+/* A task slot                                                      */
+
+typedef struct MttEmuTask {
+   unsigned long          Pc;           /* Relative to PcOffset */
+   unsigned long          PcOffset;     /* Load address */
+   unsigned long          Size;         /* Instructions loaded */
+   MttDrvrTaskStatus      TaskStatus;
+   MttDrvrProcessorStatus ProcessorStatus;
+   unsigned long          Local[MttDrvrLRAM_SIZE];
+
+   long                   WaitValue;    /* Value latched by the first wait cycle */
+
+   unsigned long          Instructions; /* Executed including wait cycles */
+   unsigned long          WaitCycles;   /* Cycles spent in unsatisfied waits */
+   unsigned long          Outputs;      /* Events sent */
+ } MttEmuTask;
+
+/* ================================================================ */
+/* Input events and output events                                   */
+
+typedef struct {
+   unsigned long Ms;      /* Arrival millisecond */
+   unsigned long Event;   /* Written to EVIN */
+ } MttEmuInput;
+
+typedef struct {
+   unsigned long Ms;      /* Millisecond of the output */
+   unsigned long Cycle;   /* 40MHz cycle in the millisecond */
+   unsigned long Task;    /* Task number 1..MttDrvrTASKS */
+   unsigned long Event;   /* Written to EVOUTH or EVOUTL */
+   unsigned long High;    /* High priority */
+   unsigned long Latency; /* ns since the last input event, 0 if none */
+ } MttEmuOutput;
+
+typedef void (*MttEmuOutputFn)(struct MttEmu *emu, MttEmuOutput *out);
+typedef void (*MttEmuTraceFn) (struct MttEmu *emu, int task, int reg, unsigned long was, unsigned long val);
+
+/* ================================================================ */
+/* The emulated module                                              */
+
+typedef struct MttEmu {
+   unsigned long   Global[MttDrvrGRAM_SIZE];
+   MttEmuTask      Tasks[MttDrvrTASKS];
+   MttEmuOp        Program[MttDrvrINSTRUCTIONS];
+
+   unsigned long   Running;       /* Running task mask */
+   unsigned long   IrqSource;     /* INT op codes, halts and illegal op codes */
+   unsigned long   SyncPeriod;    /* Milliseconds, 0 for no sync */
+
+   unsigned long   Ms;            /* Current millisecond */
+   unsigned long   Cycle;         /* Current cycle in the millisecond */
+   unsigned long   Next;          /* Next task to run */
+
+   MttEmuInput    *Inputs;        /* Sorted on arrival */
+   unsigned long   InputCount;
+   unsigned long   InputNext;
+   unsigned long   InputNs;       /* Time of the last input, for latencies */
+   unsigned long   InputSeen;
+
+   unsigned char   TraceRegs[REGISTERS]; /* Registers whose writes are traced */
+   MttEmuTraceFn   TraceFn;
+   MttEmuOutputFn  OutputFn;
+
+   unsigned long long Cycles;     /* Total cycles run */
+   unsigned long long Idle;       /* Cycles skipped with all tasks waiting */
+   unsigned long      Outputs;
+   unsigned long      MaxLatency;
+   unsigned long long SumLatency;
+ } MttEmu;
+
+/* ================================================================ */
+/* Create, load, run                                                */
+
+MttEmu      *MttEmuCreate(unsigned long sync_period);
+void         MttEmuDestroy(MttEmu *emu);
+
+/* Predecode an object into the program memory of a task. Relocatable */
+/* objects need (Size + MttLibTASK_SIZE - 1) / MttLibTASK_SIZE slots  */
+/* starting at task, like MttLibLoadTaskObject does.                  */
+
+MttLibError  MttEmuLoadTask(MttEmu *emu, int task, ProgramBuf *pbf);
+
+void         MttEmuStartTask(MttEmu *emu, int task);
+MttLibError  MttEmuAddInput(MttEmu *emu, unsigned long ms, unsigned long event);
+void         MttEmuTrace(MttEmu *emu, int reg);
+
+/* Run for a number of milliseconds */
+
+void         MttEmuRun(MttEmu *emu, unsigned long ms);
+
+/* Register names for reports */
+
+char        *MttEmuRegName(int reg);
+
+#endif
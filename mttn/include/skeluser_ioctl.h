@@ -64,7 +64,8 @@
 #define MTT_IOCRAW_WRITE	MTT_IOW(26, MttDrvrRawIoBlock)
 #define MTT_IOCRAW_READ		MTT_IOWR(27, MttDrvrRawIoBlock)
 #define MTT_IOCGVERSION		MTT_IOR(28, MttDrvrVersion)
-#define SkelUserIoctlLAST	MTT_IO(29)
+#define MTT_IOCSLOAD_TASK	MTT_IOWR(29, MttDrvrLoadTaskBuf)
+#define SkelUserIoctlLAST	MTT_IO(30)
 
 #define SkelDrvrSPECIFIC_IOCTL_CALLS (_IOC_NR(SkelUserIoctlLAST) - \
 					_IOC_NR(SkelUserIoctlFIRST) + 1)
@@ -58,7 +58,8 @@ static char *errstrings[MttLibERRORS] = {
 /*  MttLibErrorISLOAD, */"Task is already loaded",
 /*  MttLibErrorNAME,   */"Illegal task name",
 /*  MttLibErrorLREG,   */"No such local register",
-/*  MttLibErrorGREG,   */"No such global register"
+/*  MttLibErrorGREG,   */"No such global register",
+/*  MttLibErrorSYNTAX, */"Assembler source errors"
 
 };
 
@@ -429,9 +430,10 @@ MttLibReadTaskObject(char *name, ProgramBuf *pbf, Instruction **instructions)
 }
 
 /* ================================================================ */
-/* Load task program object into MTT program memory                 */
+/* Load into consecutive MttLibTASK_SIZE task slots, for drivers    */
+/* without MTT_IOCSLOAD_TASK.                                       */
 
-MttLibError MttLibLoadTaskObject(char *name, ProgramBuf *pbf) {
+static MttLibError LoadTaskSlots(char *name, ProgramBuf *pbf) {
 
 	int i;
 	MttDrvrTaskBuf tbuf;
@@ -439,27 +441,6 @@ MttLibError MttLibLoadTaskObject(char *name, ProgramBuf *pbf) {
 	unsigned long tn, ftn, tcnt, tval;
 	uint32_t tmsk;
 
-	if (mtt == 0)
-		return MttLibErrorINIT;
-
-	if ((name == NULL) || (strlen(name) == 0) || (strlen(name)
-			>= MttLibMAX_NAME_SIZE) || (strcmp(name, "ALL") == 0) || (isalpha(
-			(int) name[0]) == 0))
-		return MttLibErrorNAME;
-
-	for (i = 1; i < strlen(name); i++) {
-		if ((name[i] != '_') && (name[i] != '.') && (isalnum((int) name[i])
-				== 0))
-			return MttLibErrorNAME;
-	}
-	if (strlen(name) < MttLibMIN_NAME_SIZE)
-		return MttLibErrorNAME;
-
-	if (pbf->LoadAddress != 0)
-		return MttLibErrorNORELO;
-	if (pbf->InstructionCount == 0)
-		return MttLibErrorEMPTY;
-
 	tcnt = (pbf->InstructionCount / (max_size + 1)) + 1;
 	tval = 0;
 
@@ -511,6 +492,62 @@ MttLibError MttLibLoadTaskObject(char *name, ProgramBuf *pbf) {
 	return MttLibErrorNONE;
 }
 
+/* ================================================================ */
+/* Load task program object into MTT program memory. The driver     */
+/* finds a free task and program memory, moving stopped tasks down  */
+/* if it has to, and sets up the TCB in one call.                   */
+
+MttLibError MttLibLoadTaskObject(char *name, ProgramBuf *pbf) {
+
+	int i;
+	MttDrvrLoadTaskBuf lbuf;
+
+	if (mtt == 0)
+		return MttLibErrorINIT;
+
+	if ((name == NULL) || (strlen(name) == 0) || (strlen(name)
+			>= MttLibMAX_NAME_SIZE) || (strcmp(name, "ALL") == 0) || (isalpha(
+			(int) name[0]) == 0))
+		return MttLibErrorNAME;
+
+	for (i = 1; i < strlen(name); i++) {
+		if ((name[i] != '_') && (name[i] != '.') && (isalnum((int) name[i])
+				== 0))
+			return MttLibErrorNAME;
+	}
+	if (strlen(name) < MttLibMIN_NAME_SIZE)
+		return MttLibErrorNAME;
+
+	if (pbf->LoadAddress != 0)
+		return MttLibErrorNORELO;
+	if (pbf->InstructionCount == 0)
+		return MttLibErrorEMPTY;
+
+	bzero((void *) &lbuf, sizeof(MttDrvrLoadTaskBuf));
+	strncpy(lbuf.Name, name, MttDrvrNameSIZE);
+	lbuf.FirstTask = first_task;
+	lbuf.LastTask = last_task;
+	lbuf.InstructionCount = pbf->InstructionCount;
+	lbuf.Program = (MttDrvrInstruction *) pbf->Program;
+
+	if (ioctl(mtt, MTT_IOCSLOAD_TASK, &lbuf) < 0) {
+		switch (errno) {
+		case ENOTTY:
+			return LoadTaskSlots(name, pbf);
+		case EEXIST:
+			return MttLibErrorISLOAD;
+		case ENOSPC:
+			return MttLibErrorFULL;
+		case ENOMEM:
+			return MttLibErrorNOMEM;
+		default:
+			return MttLibErrorIO;
+		}
+	}
+	pbf->LoadAddress = lbuf.LoadAddress;
+	return MttLibErrorNONE;
+}
+
 /* ================================================================ */
 /* Load/UnLoad a compiled table object from the path specified in   */
 /* the initialization routine into a spare task slot if one exists. */
@@ -557,6 +594,24 @@ MttLibError MttLibLoadTask(char *name) {
 	return err;
 }
 
+/* ================================================================ */
+/* Assemble source text in memory and load it                       */
+
+MttLibError MttLibLoadTaskSource(char *name, char *text) {
+
+	ProgramBuf pbf;
+	MttLibError err;
+
+	if (mtt == 0)
+		return MttLibErrorINIT;
+
+	err = MttLibAssemble(text, &pbf, NULL, NULL);
+	if (err == MttLibErrorNONE)
+		err = MttLibLoadTaskObject(name, &pbf);
+	free(pbf.Program);
+	return err;
+}
+
 /* ================================================================ */
 
 MttLibError MttLibUnloadTask(char *name) {
@@ -0,0 +1,1073 @@
+/**************************************************************************/
+/* MTT assembler library                                                  */
+/*                                                                        */
+/* The assembler from tools/asm.c as a library, so that event tables can  */
+/* be assembled in memory by libmtt clients without running the asm tool  */
+/* or going through files. Op codes and register names are looked up in  */
+/* hash tables built once from InstructionSet and Regs, and the symbol    */
+/* table, forward references and program buffer grow as needed. The      */
+/* syntax and the object code produced are the same as before.           */
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmtt.h>
+
+#include "asmP.h"
+
+/* ================================================================ */
+/* Assembler state, one per call                                    */
+
+typedef struct Symbol {
+	char *Name;
+	long Value;
+	long Defined;
+	struct Symbol *Next;	/* Hash chain */
+} Symbol;
+
+typedef struct {
+	Symbol *SymbolRef;
+	long LiteralValue;
+} Operand;
+
+typedef struct {
+	Symbol *Symb;
+	unsigned long Index;	/* Instruction index, the program moves */
+} ForwardReference;
+
+#define OPERAND_STACK  64
+#define OPERATOR_STACK 32
+#define MAX_ERROR_COUNT 10
+
+typedef struct {
+	FILE *Errs;
+	int ErrorCount;
+	int Fatal;
+	int NoMem;
+
+	Symbol **Buckets;
+	unsigned long BucketCount;
+	unsigned long SymbolCount;
+
+	ForwardReference *Forward;
+	unsigned long ForwardCount;
+	unsigned long ForwardSize;
+
+	Operand Operands[OPERAND_STACK];
+	OprId Operators[OPERATOR_STACK];
+	long OperandCount;
+	long OperatorCount;
+
+	ProgramBuf *Code;
+	unsigned long ProgramSize;
+} AsmContext;
+
+/* ================================================================ */
+/* Print error messages                                             */
+
+typedef enum {
+	FATAL_RUN_TIME, RUN_TIME, FATAL_SYNTAX, SYNTAX
+} ErrorType;
+
+static void Error(AsmContext *ac, ErrorType et, Atom *atom, char *text) {
+
+	FILE *fp = ac->Errs;
+	char *p, c;
+	int i;
+
+	if ((et == FATAL_RUN_TIME) || (et == FATAL_SYNTAX))
+		ac->Fatal = 1;
+
+	if (ac->ErrorCount++ >= MAX_ERROR_COUNT) {
+		if (fp)
+			fprintf(fp, "Error reporting suppressed after: %d errors\n", MAX_ERROR_COUNT);
+		ac->Fatal = 1;
+		return;
+	}
+	if (fp == NULL)
+		return;
+
+	switch (et) {
+	case RUN_TIME:
+		fprintf(fp, "Run time error:");
+		break;
+	case SYNTAX:
+		fprintf(fp, "Syntax error:");
+		break;
+	case FATAL_RUN_TIME:
+		fprintf(fp, "Fatal: Run time error:");
+		break;
+	default:
+		fprintf(fp, "Fatal: Syntax Error:");
+		break;
+	}
+
+	fprintf(fp, "%s", text);
+
+	if (atom) {
+		fprintf(fp, ": at Line %d.%d\n", (int) atom->LineNumber, (int) atom->Position);
+		fprintf(fp, "\t\t");
+		for (i = 0; i < atom->Position; i++)
+			fputc('.', fp);
+		fprintf(fp, "v");
+		if (atom->pbFilePos != NULL) {
+			p = atom->pbFilePos;
+			fprintf(fp, "\n\t\t");
+			while (*p != 0 && *p != '\n') {
+				c = *(p++);
+				if (c == '\t')
+					c = ' ';
+				fputc(c, fp);
+			}
+			fputc('\n', fp);
+		}
+	}
+	fputc('\n', fp);
+}
+
+static void NoMemory(AsmContext *ac) {
+
+	ac->NoMem = 1;
+	Error(ac, FATAL_RUN_TIME, NULL, "No more dynamic memory available");
+}
+
+/* ================================================================ */
+/* Hash a string, upper case for op codes and registers             */
+
+static unsigned long Hash(char *cp, int len, int upper) {
+
+	unsigned long h = 5381;
+	unsigned char c;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		c = cp[i];
+		if ((upper) && (c >= 'a') && (c <= 'z'))
+			c -= ' ';
+		h = (h * 33) ^ c;
+	}
+	return h;
+}
+
+static int SameUpper(char *txt, int len, char *name) {
+
+	int i;
+	char c;
+
+	for (i = 0; i < len; i++) {
+		c = txt[i];
+		if ((c >= 'a') && (c <= 'z'))
+			c -= ' ';
+		if (c != name[i])
+			return 0;
+	}
+	return (name[len] == 0);
+}
+
+/* ================================================================ */
+/* Op code and register name tables, open addressing, built once.   */
+/* Entries hold the table index plus one.                           */
+
+#define NAME_HASH 128
+
+static short opHash[NAME_HASH];
+static short regHash[NAME_HASH];
+static int hashed = 0;
+
+static void HashNames(void) {
+
+	unsigned long h;
+	int i;
+
+	if (hashed)
+		return;
+
+	for (i = 0; i < OPCODES; i++) {
+		h = Hash(InstructionSet[i].Name, strlen(InstructionSet[i].Name), 1) % NAME_HASH;
+		while (opHash[h])
+			h = (h + 1) % NAME_HASH;
+		opHash[h] = i + 1;
+	}
+	for (i = 0; i < REGNAMES; i++) {
+		h = Hash(Regs[i].Name, strlen(Regs[i].Name), 1) % NAME_HASH;
+		while (regHash[h])
+			h = (h + 1) % NAME_HASH;
+		regHash[h] = i + 1;
+	}
+	hashed = 1;
+}
+
+static int FindOpCode(char *txt, int len) {
+
+	unsigned long h;
+	int i;
+
+	h = Hash(txt, len, 1) % NAME_HASH;
+	while ((i = opHash[h])) {
+		if (SameUpper(txt, len, InstructionSet[i - 1].Name))
+			return i - 1;
+		h = (h + 1) % NAME_HASH;
+	}
+	return -1;
+}
+
+static int FindRegister(char *txt, int len) {
+
+	unsigned long h;
+	int i;
+
+	h = Hash(txt, len, 1) % NAME_HASH;
+	while ((i = regHash[h])) {
+		if (SameUpper(txt, len, Regs[i - 1].Name))
+			return i - 1;
+		h = (h + 1) % NAME_HASH;
+	}
+	return -1;
+}
+
+/* ================================================================ */
+/* Look up an atom to see if its special                            */
+
+static long LookUpOpCode(Atom *atom) {
+
+	char *cp;
+	int i;
+
+	cp = atom->Text;
+	if ((cp) && (strlen(cp) <= MAX_OP_CODE_STRING_LENGTH)) {
+		i = FindOpCode(cp, strlen(cp));
+		if (i >= 0) {
+			atom->Type = Op_code;
+			atom->Value = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Registers match exactly, or else the first entry in Regs whose  */
+/* name starts the atom, with an index in range for a register     */
+/* range. Each prefix of the atom is looked up rather than each    */
+/* entry of Regs, keeping the lowest matching entry as before.     */
+
+static long LookUpRegister(Atom *atom) {
+
+	int i, l, len, best;
+	unsigned long rn, en, st, of, value;
+	char *cp, *ep;
+
+	cp = atom->Text;
+	if ((cp == NULL) || ((len = strlen(cp)) > MAX_REGISTER_STRING_LENGTH))
+		return 0;
+
+	i = FindRegister(cp, len);
+	if (i >= 0) {
+		atom->Type = Register;
+		atom->Value = Regs[i].Start;
+		return 1;
+	}
+
+	best = REGNAMES;
+	value = 0;
+	for (l = 1; l < len; l++) {
+		i = FindRegister(cp, l);
+		if ((i < 0) || (i >= best))
+			continue;
+
+		st = Regs[i].Start;
+		en = Regs[i].End;
+		of = Regs[i].Offset;
+
+		if (st < en) {
+			rn = strtoul(cp + l, &ep, 0);
+			if ((ep == cp + l) || (rn < of) || (rn > en - st + of))
+				continue;
+			value = st + rn - of;
+		} else
+			value = st;
+		best = i;
+	}
+	if (best < REGNAMES) {
+		atom->Type = Register;
+		atom->Value = value;
+		return 1;
+	}
+	return 0;
+}
+
+static long LookUpOperator(Atom *atom) {
+
+	int i;
+
+	for (i = 0; i < OprOPRS; i++) {
+		if (strcmp(atom->Text, OprNames[i].Name) == 0) {
+			atom->Type = Operator;
+			atom->Value = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* ================================================================ */
+/* Atom lists                                                       */
+
+static Atom *NewAtom(AsmContext *ac, Atom *prev) {
+
+	Atom *atom;
+
+	atom = (Atom *) calloc(1, sizeof(Atom));
+	if (atom == NULL) {
+		NoMemory(ac);
+		return NULL;
+	}
+	if (prev)
+		prev->Next = atom;
+	return atom;
+}
+
+static char *NewText(AsmContext *ac, char *text) {
+
+	char *cp;
+
+	cp = strdup(text);
+	if (cp == NULL)
+		NoMemory(ac);
+	return cp;
+}
+
+static void DisposeAtoms(Atom *list) {
+
+	Atom *next;
+
+	while (list) {
+		next = list->Next;
+		if (list->Text)
+			free(list->Text);
+		free(list);
+		list = next;
+	}
+}
+
+/* ================================================================ */
+/* Chop up a source text into atoms                                 */
+
+#define TEXT 128
+
+#define HASH(c) ((AtomType) atomhash[(unsigned char) (c)])
+
+static Atom *GetAtoms(AsmContext *ac, char *buf) {
+
+	char *cp, *ep, text[TEXT];
+	AtomType at;
+	Atom *head, *atom;
+	int nb, pos, line, newline;
+	char *pbFilePos = buf;
+
+	if ((buf == NULL) || (*buf == '.'))
+		return NULL;
+
+	head = atom = NewAtom(ac, NULL);
+	pos = 1;
+	line = 1;
+
+	cp = &buf[0];
+
+	while ((atom) && (!ac->Fatal)) {
+		at = HASH(*cp);
+
+		switch (at) {
+
+			/* Numeric atom types have their value set to the value of   */
+			/* the text string. The number of bytes field corresponds to */
+			/* the number of characters in the number.                   */
+
+		case Numeric:
+			atom->Value = (int) strtoul(cp, &ep, 0);
+			nb = ep - cp;
+			cp = ep;
+			atom->Type = Numeric;
+			atom->Position = pos;
+			atom->LineNumber = line;
+			atom->pbFilePos = pbFilePos;
+			pos += nb;
+			atom = NewAtom(ac, atom);
+			break;
+
+			/* Alpha atom types are strings of letters and numbers starting */
+			/* with a letter, the text is placed in the text field.         */
+
+		case Alpha:
+			nb = 0;
+			bzero((void *) text, TEXT);
+			while (((at == Alpha) || (at == Numeric)) && (nb < TEXT - 1)) {
+				text[nb] = *cp;
+				nb++;
+				cp++;
+				at = HASH(*cp);
+			}
+			atom->Text = NewText(ac, text);
+			atom->Type = Alpha;
+			atom->Position = pos;
+			atom->LineNumber = line;
+			atom->pbFilePos = pbFilePos;
+			if (!LookUpOpCode(atom))
+				LookUpRegister(atom);
+			pos += nb;
+			atom = NewAtom(ac, atom);
+			break;
+
+			/* Seperators can be as long as they like, the only interesting */
+			/* data about them is their byte counts.                        */
+
+		case Seperator:
+			newline = 0;
+			while (at == Seperator) {
+				if (*cp == '\n') {
+					atom->Type = Seperator;
+					atom->Position = pos;
+					pos = 0;
+					newline = 1;
+					atom->LineNumber = line;
+					atom->Text = NULL;
+					atom->pbFilePos = NULL;
+					atom = NewAtom(ac, atom);
+					cp++;
+					pbFilePos = cp;
+					break;
+				}
+				at = HASH(*(++cp));
+				pos++;
+			}
+			line += newline;
+			break;
+
+			/* Comments run to the next comment character or the end of */
+			/* the line, just incase someone has forgotten to end one.  */
+
+		case Comment:
+			at = HASH(*(++cp));
+			atom->Type = Comment;
+			bzero((void *) text, TEXT);
+			nb = 0;
+			newline = 0;
+			while (at != Comment) {
+				if ((*cp == '\n') || (*cp == 0)) {
+					atom->Type = Seperator;
+					if (*cp)
+						cp++;
+					newline = 1;
+					break;
+				}
+				if (nb < TEXT - 1)
+					text[nb] = *cp;
+				nb++;
+				cp++;
+				at = HASH(*cp);
+			}
+			atom->Text = NewText(ac, text);
+			atom->Position = pos;
+			atom->LineNumber = line;
+			atom->pbFilePos = pbFilePos;
+			pos += nb;
+			atom = NewAtom(ac, atom);
+			line += newline;
+			if (newline)
+				pbFilePos = cp;
+			break;
+
+			/* Operator atoms have the atom value set to indicate which */
+			/* operator the atom is.                                    */
+
+		case Operator:
+			nb = 0;
+			bzero((void *) text, TEXT);
+			while ((at == Operator) && (nb < TEXT - 1)) {
+				text[nb] = *cp;
+				nb++;
+				cp++;
+				at = HASH(*cp);
+			}
+			atom->Text = NewText(ac, text);
+			atom->Type = Operator;
+			atom->Position = pos;
+			atom->LineNumber = line;
+			atom->pbFilePos = pbFilePos;
+			if (atom->Text)
+				LookUpOperator(atom);
+			pos += nb;
+			atom = NewAtom(ac, atom);
+			break;
+
+			/* These are simple single byte operators */
+
+		case Open:
+		case Close:
+		case Open_index:
+		case Close_index:
+		case Bit:
+			atom->Type = at;
+			atom->Position = pos;
+			atom->LineNumber = line;
+			atom->pbFilePos = pbFilePos;
+			cp++;
+			pos++;
+			atom = NewAtom(ac, atom);
+			break;
+
+		case Illegal_char:
+			Error(ac, SYNTAX, atom, "Illegal character");
+
+		default:
+			return head;
+		}
+	}
+	return head;
+}
+
+/* ================================================================ */
+/* Symbol table, chained hash that doubles as it fills              */
+
+static Symbol *GetSymbol(AsmContext *ac, char *name) {
+
+	Symbol *sym, *next, **bkts;
+	unsigned long h, i, cnt;
+
+	if (ac->SymbolCount >= 2 * ac->BucketCount) {
+		cnt = ac->BucketCount ? 2 * ac->BucketCount : 256;
+		bkts = (Symbol **) calloc(cnt, sizeof(Symbol *));
+		if (bkts == NULL) {
+			NoMemory(ac);
+			return NULL;
+		}
+		for (i = 0; i < ac->BucketCount; i++) {
+			for (sym = ac->Buckets[i]; sym; sym = next) {
+				next = sym->Next;
+				h = Hash(sym->Name, strlen(sym->Name), 0) % cnt;
+				sym->Next = bkts[h];
+				bkts[h] = sym;
+			}
+		}
+		free(ac->Buckets);
+		ac->Buckets = bkts;
+		ac->BucketCount = cnt;
+	}
+
+	h = Hash(name, strlen(name), 0) % ac->BucketCount;
+	for (sym = ac->Buckets[h]; sym; sym = sym->Next)
+		if (strcmp(name, sym->Name) == 0)
+			return sym;
+
+	sym = (Symbol *) calloc(1, sizeof(Symbol));
+	if (sym == NULL) {
+		NoMemory(ac);
+		return NULL;
+	}
+	sym->Name = name;
+	sym->Next = ac->Buckets[h];
+	ac->Buckets[h] = sym;
+	ac->SymbolCount++;
+	return sym;
+}
+
+static void DisposeSymbols(AsmContext *ac) {
+
+	Symbol *sym, *next;
+	unsigned long i;
+
+	for (i = 0; i < ac->BucketCount; i++) {
+		for (sym = ac->Buckets[i]; sym; sym = next) {
+			next = sym->Next;
+			free(sym);
+		}
+	}
+	free(ac->Buckets);
+	ac->Buckets = NULL;
+	ac->BucketCount = 0;
+}
+
+static void AddForward(AsmContext *ac, Symbol *sym, unsigned long index) {
+
+	ForwardReference *fw;
+	unsigned long cnt;
+
+	if (ac->ForwardCount >= ac->ForwardSize) {
+		cnt = ac->ForwardSize ? 2 * ac->ForwardSize : 128;
+		fw = (ForwardReference *) realloc(ac->Forward, cnt * sizeof(ForwardReference));
+		if (fw == NULL) {
+			NoMemory(ac);
+			return;
+		}
+		ac->Forward = fw;
+		ac->ForwardSize = cnt;
+	}
+	ac->Forward[ac->ForwardCount].Symb = sym;
+	ac->Forward[ac->ForwardCount].Index = index;
+	ac->ForwardCount++;
+}
+
+/* ================================================================ */
+/* Expression stacks, reverse polish                                */
+
+static long PushOperand(AsmContext *ac, Operand *operand) {
+
+	if (ac->OperandCount < OPERAND_STACK) {
+		ac->Operands[ac->OperandCount++] = *operand;
+		return 1;
+	}
+	Error(ac, FATAL_RUN_TIME, NULL, "Operand stack overflow");
+	return 0;
+}
+
+static long PushOperator(AsmContext *ac, OprId *oprId) {
+
+	if (ac->OperatorCount < OPERATOR_STACK) {
+		ac->Operators[ac->OperatorCount++] = *oprId;
+		return 1;
+	}
+	Error(ac, FATAL_RUN_TIME, NULL, "Operator stack overflow");
+	return 0;
+}
+
+static long PopOperand(AsmContext *ac, Operand *operand) {
+
+	if (ac->OperandCount > 0) {
+		*operand = ac->Operands[--ac->OperandCount];
+		return 1;
+	}
+	Error(ac, RUN_TIME, NULL, "Operand stack underflow");
+	return 0;
+}
+
+static long PopOperator(AsmContext *ac, OprId *oprId) {
+
+	if (ac->OperatorCount > 0) {
+		*oprId = ac->Operators[--ac->OperatorCount];
+		return 1;
+	}
+	Error(ac, RUN_TIME, NULL, "Operator stack underflow");
+	return 0;
+}
+
+static long GetValue(Operand operand) {
+
+	if (operand.SymbolRef)
+		return operand.SymbolRef->Value;
+	return operand.LiteralValue;
+}
+
+/* ================================================================ */
+/* Evaluate expression                                              */
+
+static long DoExpression(AsmContext *ac) {
+
+	OprId operator;
+	Operand left, right, temp;
+	long lv, rv;
+
+	static Operand true_operand = { NULL, 0xFFFFFFFF };
+	static Operand false_operand = { NULL, 0x00000000 };
+	static Operand zero_operand = { NULL, 0x00000000 };
+
+	while (1) {
+
+		if (!PopOperator(ac, &operator))
+			return 0;
+
+		switch (operator) {
+
+		/* Unary operators */
+
+		case OprNOT:
+		case OprNEG:
+		case OprINC:
+		case OprDECR:
+			if (!PopOperand(ac, &left))
+				return 0;
+			lv = GetValue(left);
+			temp = zero_operand;
+			if (operator == OprNOT)
+				temp.LiteralValue = ~lv;
+			else if (operator == OprNEG)
+				temp.LiteralValue = -lv;
+			else {
+				temp.LiteralValue = (operator == OprINC) ? lv + 1 : lv - 1;
+				if (left.SymbolRef == NULL) {
+					Error(ac, RUN_TIME, NULL, (operator == OprINC)
+					      ? "Increment: Attempt to write to a literal"
+					      : "Decrement: Attempt to write to a literal");
+					break;
+				}
+				left.SymbolRef->Value = temp.LiteralValue;
+			}
+			PushOperand(ac, &temp);
+			break;
+
+		case OprPOP:
+			if (!PopOperand(ac, &right))
+				return 0;
+			return right.LiteralValue;
+
+		case OprAS:
+			if (!PopOperand(ac, &right))
+				return 0;
+			if (!PopOperand(ac, &left))
+				return 0;
+			rv = GetValue(right);
+			if (left.SymbolRef) {
+				left.SymbolRef->Value = rv;
+				left.SymbolRef->Defined = 1;
+				PushOperand(ac, &right);
+			} else
+				Error(ac, RUN_TIME, NULL, "Becomes Equal: Attempt to write to a literal");
+			break;
+
+		case OprSTM:
+			if (ac->OperandCount >= OPERAND_STACK)
+				return 0;
+			return ac->Operands[ac->OperandCount].LiteralValue;
+
+		/* Binary operators */
+
+		case OprNE: case OprEQ: case OprGT: case OprGE: case OprLT: case OprLE:
+		case OprPL: case OprMI: case OprTI: case OprDI:
+		case OprAND: case OprOR: case OprXOR: case OprLSH: case OprRSH:
+			if (!PopOperand(ac, &right))
+				return 0;
+			if (!PopOperand(ac, &left))
+				return 0;
+			lv = GetValue(left);
+			rv = GetValue(right);
+			temp = zero_operand;
+			switch (operator) {
+			case OprNE:  temp = (lv != rv) ? true_operand : false_operand; break;
+			case OprEQ:  temp = (lv == rv) ? true_operand : false_operand; break;
+			case OprGT:  temp = (lv >  rv) ? true_operand : false_operand; break;
+			case OprGE:  temp = (lv >= rv) ? true_operand : false_operand; break;
+			case OprLT:  temp = (lv <  rv) ? true_operand : false_operand; break;
+			case OprLE:  temp = (lv <= rv) ? true_operand : false_operand; break;
+			case OprPL:  temp.LiteralValue = lv + rv;  break;
+			case OprMI:  temp.LiteralValue = lv - rv;  break;
+			case OprTI:  temp.LiteralValue = lv * rv;  break;
+			case OprAND: temp.LiteralValue = lv & rv;  break;
+			case OprOR:  temp.LiteralValue = lv | rv;  break;
+			case OprXOR: temp.LiteralValue = lv ^ rv;  break;
+			case OprLSH: temp.LiteralValue = lv << rv; break;
+			case OprRSH: temp.LiteralValue = lv >> rv; break;
+			case OprDI:
+				if (rv == 0) {
+					Error(ac, RUN_TIME, NULL, "Divide by zero");
+					return 0;
+				}
+				temp.LiteralValue = lv / rv;
+				break;
+			default:
+				break;
+			}
+			PushOperand(ac, &temp);
+			break;
+
+		default:
+			return 0;
+		}
+	}
+}
+
+/* ================================================================ */
+/* Check syntax is what we expect                                   */
+
+static int CompareAtomTypes(AtomType x, AtomType y) {
+
+	if (x == y)
+		return 1;
+
+	if ((x == Not_set) || (y == Not_set))
+		return 1;
+
+	if (x == Expression)
+		if ((y == Numeric) || (y == Alpha))
+			return 1;
+
+	if (y == Expression)
+		if ((x == Numeric) || (x == Alpha))
+			return 1;
+
+	if ((x == Seperator) && (y == Comment))
+		return 1;
+
+	if ((y == Seperator) && (x == Comment))
+		return 1;
+
+	return 0;
+}
+
+static Atom *SkipSeperators(Atom *atom) {
+
+	do {
+		if (atom->Next)
+			atom = (Atom *) atom->Next;
+		else
+			break;
+	} while (CompareAtomTypes(atom->Type, Seperator));
+	return atom;
+}
+
+static long GetConfirm(AsmContext *ac, Atom *atom, OpCode *opcd,
+		       int *expect_sr1, int *expect_sr2, int *expect_lit, int *expect_dst) {
+
+	*expect_lit = (opcd->Src1 == AtLiteral) || (opcd->Src1 == AtAddress);
+	*expect_sr1 = (opcd->Src1 == AtRegister);
+	*expect_sr2 = (opcd->Src2 == AtRegister);
+	*expect_dst = (opcd->Dest == AtRegister);
+
+	if (atom->Next)
+		atom = (Atom *) atom->Next;
+	while (CompareAtomTypes(atom->Type, Seperator)) {
+		if (atom->Next)
+			atom = (Atom *) atom->Next;
+		else
+			break;
+	}
+
+	if (*expect_lit) {
+		if (CompareAtomTypes(atom->Type, Expression) == 0) {
+			Error(ac, SYNTAX, atom, "Expected: Symbol or literal value");
+			return 0;
+		}
+		atom = SkipSeperators(atom);
+	}
+	if (*expect_sr1) {
+		if (CompareAtomTypes(atom->Type, Register) == 0) {
+			Error(ac, SYNTAX, atom, "Expected: Register");
+			return 0;
+		}
+		atom = SkipSeperators(atom);
+	}
+	if (*expect_sr2) {
+		if (CompareAtomTypes(atom->Type, Register) == 0) {
+			Error(ac, SYNTAX, atom, "Expected: Register");
+			return 0;
+		}
+		atom = SkipSeperators(atom);
+	}
+	if (*expect_dst) {
+		if (CompareAtomTypes(atom->Type, Register) == 0) {
+			Error(ac, SYNTAX, atom, "Expected: Register");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* ================================================================ */
+/* Make room for one more instruction                               */
+
+static Instruction *NewInstruction(AsmContext *ac, unsigned long index) {
+
+	Instruction *prog;
+	unsigned long cnt;
+
+	if (index >= ac->ProgramSize) {
+		cnt = 2 * ac->ProgramSize;
+		prog = (Instruction *) realloc(ac->Code->Program, cnt * sizeof(Instruction));
+		if (prog == NULL) {
+			NoMemory(ac);
+			return NULL;
+		}
+		ac->Code->Program = prog;
+		ac->ProgramSize = cnt;
+	}
+	bzero((void *) &(ac->Code->Program[index]), sizeof(Instruction));
+	return &(ac->Code->Program[index]);
+}
+
+/* ================================================================ */
+/* Compile the atoms into object code                               */
+
+static void Assemble(AsmContext *ac, Atom *atom) {
+
+	Atom *patom;
+	AtomType at;
+	Symbol *symbol;
+	Operand operand;
+	OprId oprId;
+	Instruction *inst;
+	OpCode *opcd;
+	unsigned long index, pc;
+
+	int expect_lit = 0;
+	int expect_sr1 = 0;
+	int expect_sr2 = 0;
+	int expect_dst = 0;
+
+	ProgramBuf *code = ac->Code;
+
+	pc = 0;
+	index = 0;
+	patom = NULL;
+	inst = NewInstruction(ac, 0);
+
+	while ((atom) && (!ac->Fatal)) {
+		at = atom->Type;
+		switch (at) {
+		case Numeric:
+			operand.SymbolRef = NULL;
+			operand.LiteralValue = atom->Value;
+			if (expect_lit) {
+				inst->Src1 = atom->Value;
+				expect_lit = 0;
+			} else if (!PushOperand(ac, &operand))
+				return;
+			break;
+
+		case Alpha:
+			symbol = GetSymbol(ac, atom->Text);
+			if (symbol == NULL)
+				return;
+			operand.SymbolRef = symbol;
+			operand.LiteralValue = 0;
+			if (expect_lit) {
+				inst->Src1 = symbol->Value;
+				expect_lit = 0;
+				if (inst->Src1 == 0)
+					AddForward(ac, symbol, inst - code->Program);
+			} else if (!PushOperand(ac, &operand))
+				return;
+			break;
+
+		case Operator:
+			oprId = atom->Value;
+			if (oprId == OprLBL) {
+				if ((patom) && (patom->Type == Alpha)) {
+					symbol = GetSymbol(ac, patom->Text);
+					if (symbol == NULL)
+						return;
+					if (symbol->Value)
+						Error(ac, SYNTAX, atom, "Label: double definition");
+					symbol->Value = pc;
+					symbol->Defined = 1;
+				} else if ((patom) && (patom->Type == Numeric)) {
+					if (!pc) {
+						pc = patom->Value;
+						code->LoadAddress = pc;
+					} else
+						Error(ac, SYNTAX, atom, "Code block must be contiguous, one start address only");
+				}
+			} else if (!PushOperator(ac, &oprId))
+				return;
+			break;
+
+		case Op_code:
+			inst = NewInstruction(ac, index);
+			if (inst == NULL)
+				return;
+
+			opcd = &(InstructionSet[atom->Value]);
+			GetConfirm(ac, atom, opcd, &expect_sr1, &expect_sr2, &expect_lit, &expect_dst);
+			inst->Number = opcd->Number;
+			pc++;
+			index++;
+			code->InstructionCount = index;
+			break;
+
+		case Register:
+			if (expect_sr1) {
+				inst->Src1 = atom->Value;
+				expect_sr1 = 0;
+			} else if (expect_sr2) {
+				inst->Src2 = atom->Value;
+				expect_sr2 = 0;
+			} else if (expect_dst) {
+				inst->Dest = atom->Value;
+				expect_dst = 0;
+			}
+			break;
+
+		case Open:
+		case Open_index:
+			oprId = OprSTM;
+			if (!PushOperator(ac, &oprId))
+				return;
+			expect_lit = 0;
+			break;
+
+		case Close:
+		case Close_index:
+			inst->Src1 = DoExpression(ac);
+			expect_lit = 0;
+			break;
+
+		case Seperator:
+			ac->OperandCount = 0;
+			ac->OperatorCount = 0;
+			if (expect_lit) {
+				Error(ac, SYNTAX, atom, "Unexpected seperator");
+				expect_lit = 0;
+			}
+			break;
+
+		default:
+			break;
+		}
+		patom = atom;
+		atom = (Atom *) atom->Next;
+	}
+}
+
+/* ================================================================ */
+/* Assemble source text into a program in memory                    */
+
+MttLibError MttLibAssemble(char *text, ProgramBuf *pbf, FILE *errs, int *errors) {
+
+	AsmContext ac;
+	Atom *atoms;
+	ForwardReference *fw;
+	unsigned long i;
+	MttLibError err;
+
+	HashNames();
+
+	bzero((void *) &ac, sizeof(AsmContext));
+	bzero((void *) pbf, sizeof(ProgramBuf));
+	ac.Errs = errs;
+	ac.Code = pbf;
+	ac.ProgramSize = 256;
+
+	pbf->Program = (Instruction *) malloc(ac.ProgramSize * sizeof(Instruction));
+	if (pbf->Program == NULL)
+		return MttLibErrorNOMEM;
+
+	atoms = GetAtoms(&ac, text);
+	if (atoms == NULL)
+		Error(&ac, FATAL_SYNTAX, NULL, "Null buffer, or garbage source code");
+	else if (!ac.Fatal)
+		Assemble(&ac, atoms);
+
+	/* Pass 2: forward references */
+
+	if (ac.ErrorCount == 0) {
+		for (i = 0; i < ac.ForwardCount; i++) {
+			fw = &(ac.Forward[i]);
+			pbf->Program[fw->Index].Src1 = fw->Symb->Value;
+		}
+	}
+
+	DisposeAtoms(atoms);
+	DisposeSymbols(&ac);
+	free(ac.Forward);
+
+	if (errors)
+		*errors = ac.ErrorCount;
+
+	err = MttLibErrorNONE;
+	if (ac.ErrorCount)
+		err = MttLibErrorSYNTAX;
+	if (ac.NoMem) {
+		free(pbf->Program);
+		bzero((void *) pbf, sizeof(ProgramBuf));
+		err = MttLibErrorNOMEM;
+	}
+	return err;
+}
@@ -0,0 +1,553 @@
+/**************************************************************************/
+/* MTT batch emulator library                                             */
+/*                                                                        */
+/* The interactive emulator in tools/emu.c single steps one program and   */
+/* looks each op code up in InstructionSet for every instruction. Here    */
+/* programs are predecoded once into a dispatch array and all the task    */
+/* slots run together against an emulated time base, see mttemu.h.       */
+/* The op code semantics are those of tools/emu.c Execute().              */
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <libmtt.h>
+#include <mttemu.h>
+
+/* ================================================================ */
+/* Registers, globals are shared and locals belong to the task     */
+
+static inline unsigned long *Reg(MttEmu *emu, MttEmuTask *task, int reg) {
+
+	if (reg < MttDrvrGRAM_SIZE)
+		return &(emu->Global[reg]);
+	return &(task->Local[reg - MttDrvrGRAM_SIZE]);
+}
+
+static inline int32_t RdReg(MttEmu *emu, MttEmuTask *task, int reg) {
+	return (int32_t) *Reg(emu, task, reg);
+}
+
+/* ================================================================ */
+/* Current time in ns                                               */
+
+static inline unsigned long long NowNs(MttEmu *emu) {
+	return (unsigned long long) emu->Ms * 1000000ULL
+	     + (unsigned long long) emu->Cycle * MttEmuNS_PER_CYCLE;
+}
+
+/* ================================================================ */
+/* Write a register, writes to EVOUTH/EVOUTL send an event          */
+
+static void WrReg(MttEmu *emu, MttEmuTask *task, int reg, int32_t val) {
+
+	unsigned long *rp, was;
+	unsigned long long lat;
+	MttEmuOutput out;
+
+	rp = Reg(emu, task, reg);
+	was = *rp;
+	*rp = (uint32_t) val;
+
+	if ((emu->TraceRegs[reg]) && (emu->TraceFn) && (was != *rp))
+		emu->TraceFn(emu, (task - emu->Tasks) + 1, reg, was, *rp);
+
+	if ((reg == GAdrEVOUTH) || (reg == GAdrEVOUTL)) {
+		emu->Global[GAdrEVOUTCNT]++;
+		emu->Global[GAdrEVOUTFB] = *rp;
+
+		lat = 0;
+		if (emu->InputSeen)
+			lat = NowNs(emu) - emu->InputNs;
+
+		out.Ms = emu->Ms;
+		out.Cycle = emu->Cycle;
+		out.Task = (task - emu->Tasks) + 1;
+		out.Event = *rp;
+		out.High = (reg == GAdrEVOUTH);
+		out.Latency = lat;
+
+		emu->Outputs++;
+		task->Outputs++;
+		emu->SumLatency += lat;
+		if (lat > emu->MaxLatency)
+			emu->MaxLatency = lat;
+		if (emu->OutputFn)
+			emu->OutputFn(emu, &out);
+	}
+}
+
+/* ================================================================ */
+/* Processor status word, carry is ignored as in emu.c              */
+
+static inline void SetPSwd(MttEmuTask *task, int32_t val) {
+
+	if (val == 0)
+		task->ProcessorStatus = MttDrvrProcessorStatusEQ;
+	else if (val > 0)
+		task->ProcessorStatus = MttDrvrProcessorStatusGT;
+	else
+		task->ProcessorStatus = MttDrvrProcessorStatusLT;
+}
+
+static inline void Result(MttEmu *emu, MttEmuTask *task, int reg, int32_t val) {
+
+	WrReg(emu, task, reg, val);
+	SetPSwd(task, val);
+	task->Pc++;
+}
+
+/* ================================================================ */
+/* Stop a task with a reason                                        */
+
+static void Stop(MttEmu *emu, MttEmuTask *task, MttDrvrTaskStatus why, MttDrvrInt irq) {
+
+	task->TaskStatus = why;
+	emu->Running &= ~(1 << (task - emu->Tasks));
+	emu->IrqSource |= irq;
+}
+
+/* ================================================================ */
+/* Op code handlers                                                 */
+
+static void OpHALT(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Stop(emu, task, MttDrvrTaskStatusSTOPPED, MttDrvrIntPROGRAM_HALT);
+}
+
+static void OpNOOP(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	task->Pc++;
+}
+
+static void OpINT(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	emu->IrqSource |= 1 << ((op->Src1 - 1) & 0xF);
+	task->Pc++;
+}
+
+static void OpIllegal(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Stop(emu, task, MttDrvrTaskStatusILLEGAL_OP_CODE, MttDrvrIntILLEGAL_OP_CODE);
+}
+
+static void OpIllegalReg(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Stop(emu, task, MttDrvrTaskStatusILLEGAL_REGISTER, MttDrvrIntILLEGAL_OP_CODE);
+}
+
+/* Waits latch their value on the first cycle and stay on the same */
+/* instruction with the WAITING status until it is satisfied.      */
+
+static inline void Wait(MttEmuTask *task, int done) {
+
+	if (done) {
+		task->TaskStatus &= ~MttDrvrTaskStatusWAITING;
+		task->Pc++;
+	} else
+		task->WaitCycles++;
+}
+
+static inline int Latch(MttEmuTask *task, long val) {
+
+	if ((task->TaskStatus & MttDrvrTaskStatusWAITING) == 0) {
+		task->TaskStatus |= MttDrvrTaskStatusWAITING;
+		task->WaitValue = val;
+	}
+	return task->WaitValue;
+}
+
+static void OpWEQV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Latch(task, op->Src1);
+	Wait(task, RdReg(emu, task, op->Src2) == (int32_t) op->Src1);
+}
+
+static void OpWEQR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Latch(task, RdReg(emu, task, op->Src1));
+	Wait(task, RdReg(emu, task, op->Src2) == RdReg(emu, task, op->Src1));
+}
+
+static void OpWRLV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	int32_t w = Latch(task, RdReg(emu, task, op->Src2) + op->Src1);
+	Wait(task, RdReg(emu, task, op->Src2) >= w);
+}
+
+static void OpWRLR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	int32_t w = Latch(task, RdReg(emu, task, op->Src2) + RdReg(emu, task, op->Src1));
+	Wait(task, RdReg(emu, task, op->Src2) >= w);
+}
+
+static void OpWORV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Latch(task, op->Src1);
+	Wait(task, (RdReg(emu, task, op->Src2) & op->Src1) != 0);
+}
+
+static void OpWORR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Latch(task, RdReg(emu, task, op->Src1));
+	Wait(task, (RdReg(emu, task, op->Src2) & RdReg(emu, task, op->Src1)) != 0);
+}
+
+static void OpMOVV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Result(emu, task, op->Dest, op->Src1);
+}
+
+static void OpMOVR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	Result(emu, task, op->Dest, RdReg(emu, task, op->Src1));
+}
+
+/* The index register is the first local register */
+
+static void OpMOVIR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+
+	int32_t irg = task->Local[0];
+
+	if ((irg >= 0) && (irg < REGISTERS))
+		Result(emu, task, op->Dest, RdReg(emu, task, irg));
+	else
+		task->Pc++;
+}
+
+static void OpMOVRI(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+
+	int32_t irg = task->Local[0];
+
+	if ((irg >= 0) && (irg < REGISTERS))
+		Result(emu, task, irg, RdReg(emu, task, op->Dest));
+	else
+		task->Pc++;
+}
+
+static inline int32_t Shl(int32_t v, int32_t n) { return ((n >= 0) && (n < 32)) ? (int32_t) ((uint32_t) v << n) : 0; }
+static inline int32_t Shr(int32_t v, int32_t n) { return ((n >= 0) && (n < 32)) ? (int32_t) ((uint32_t) v >> n) : 0; }
+
+#define R1 RdReg(emu, task, op->Src1)
+#define R2 RdReg(emu, task, op->Src2)
+#define V1 ((int32_t) op->Src1)
+
+static void OpADDR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R1 + R2); }
+static void OpSUBR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 - R1); }
+static void OpLORR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 | R1); }
+static void OpANDR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 & R1); }
+static void OpXORR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 ^ R1); }
+static void OpLSR (MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, Shl(R2, R1)); }
+static void OpRSR (MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, Shr(R2, R1)); }
+
+static void OpADDV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 + V1); }
+static void OpSUBV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 - V1); }
+static void OpLORV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 | V1); }
+static void OpANDV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 & V1); }
+static void OpXORV(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, R2 ^ V1); }
+static void OpLSV (MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, Shl(R2, V1)); }
+static void OpRSV (MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Result(emu, task, op->Dest, Shr(R2, V1)); }
+
+#undef R1
+#undef R2
+#undef V1
+
+static void OpJMP(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) {
+	task->Pc = op->Src1;
+}
+
+static inline void Branch(MttEmuTask *task, MttEmuOp *op, int cond) {
+
+	if (cond)
+		task->Pc = op->Src1;
+	else
+		task->Pc++;
+}
+
+#define PS(x) (task->ProcessorStatus & MttDrvrProcessorStatus##x)
+
+static void OpBEQ(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(EQ)); }
+static void OpBNE(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, !PS(EQ)); }
+static void OpBLT(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(LT)); }
+static void OpBGT(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(GT)); }
+static void OpBLE(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(EQ) || PS(LT)); }
+static void OpBGE(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(EQ) || PS(GT)); }
+static void OpBCR(MttEmu *emu, MttEmuTask *task, MttEmuOp *op) { Branch(task, op, PS(CR)); }
+
+#undef PS
+
+/* ================================================================ */
+/* Op code number to handler, built once                            */
+
+static MttEmuFn handlers[256];
+static OpCode  *opcodes[256];
+
+static void InitHandlers(void) {
+
+	int i;
+
+	if (handlers[HALT])
+		return;
+
+	handlers[HALT] = OpHALT;   handlers[NOOP] = OpNOOP;   handlers[INT]  = OpINT;
+	handlers[WEQV] = OpWEQV;   handlers[WEQR] = OpWEQR;
+	handlers[WRLV] = OpWRLV;   handlers[WRLR] = OpWRLR;
+	handlers[WORV] = OpWORV;   handlers[WORR] = OpWORR;
+	handlers[MOVV] = OpMOVV;   handlers[MOVR] = OpMOVR;
+	handlers[MOVIR]= OpMOVIR;  handlers[MOVRI]= OpMOVRI;
+	handlers[ADDV] = OpADDV;   handlers[ADDR] = OpADDR;
+	handlers[SUBV] = OpSUBV;   handlers[SUBR] = OpSUBR;
+	handlers[LORV] = OpLORV;   handlers[LORR] = OpLORR;
+	handlers[ANDV] = OpANDV;   handlers[ANDR] = OpANDR;
+	handlers[XORV] = OpXORV;   handlers[XORR] = OpXORR;
+	handlers[LSV]  = OpLSV;    handlers[LSR]  = OpLSR;
+	handlers[RSV]  = OpRSV;    handlers[RSR]  = OpRSR;
+	handlers[WDOG] = OpNOOP;   handlers[JMP]  = OpJMP;
+	handlers[BEQ]  = OpBEQ;    handlers[BNE]  = OpBNE;
+	handlers[BLT]  = OpBLT;    handlers[BGT]  = OpBGT;
+	handlers[BLE]  = OpBLE;    handlers[BGE]  = OpBGE;
+	handlers[BCR]  = OpBCR;
+
+	for (i = 0; i < OPCODES; i++)
+		opcodes[InstructionSet[i].Number & 0xFF] = &(InstructionSet[i]);
+}
+
+/* ================================================================ */
+/* Create and destroy an emulated module                            */
+
+MttEmu *MttEmuCreate(unsigned long sync_period) {
+
+	MttEmu *emu;
+
+	InitHandlers();
+
+	emu = (MttEmu *) calloc(1, sizeof(MttEmu));
+	if (emu == NULL)
+		return NULL;
+
+	emu->SyncPeriod = sync_period;
+	return emu;
+}
+
+void MttEmuDestroy(MttEmu *emu) {
+
+	if (emu) {
+		free(emu->Inputs);
+		free(emu);
+	}
+}
+
+/* ================================================================ */
+/* Predecode an object into the task slots                          */
+
+MttLibError MttEmuLoadTask(MttEmu *emu, int task, ProgramBuf *pbf) {
+
+	MttEmuTask *tsk;
+	MttEmuOp *op;
+	Instruction *inst;
+	OpCode *opcd;
+	unsigned long tcnt, addr, i;
+
+	if ((task < 1) || (task > MttDrvrTASKS))
+		return MttLibErrorNAME;
+	if (pbf->LoadAddress != 0)
+		return MttLibErrorNORELO;
+	if (pbf->InstructionCount == 0)
+		return MttLibErrorEMPTY;
+
+	tcnt = (pbf->InstructionCount + MttLibTASK_SIZE - 1) / MttLibTASK_SIZE;
+	if (task - 1 + tcnt > MttDrvrTASKS)
+		return MttLibErrorTOOBIG;
+
+	addr = MttLibTASK_SIZE * (task - 1);
+	if (addr + pbf->InstructionCount > MttDrvrINSTRUCTIONS)
+		return MttLibErrorTOOBIG;
+	for (i = 0; i < pbf->InstructionCount; i++) {
+		inst = &(pbf->Program[i]);
+		op = &(emu->Program[addr + i]);
+
+		op->Number = inst->Number;
+		op->Src1 = inst->Src1;
+		op->Src2 = inst->Src2;
+		op->Dest = inst->Dest;
+		op->Fn = handlers[inst->Number];
+		opcd = opcodes[inst->Number];
+
+		if ((op->Fn == NULL) || (opcd == NULL))
+			op->Fn = OpIllegal;
+		else if ((opcd->Src1 == AtRegister)
+		     &&  ((inst->Src1 < 0) || (inst->Src1 >= REGISTERS)))
+			op->Fn = OpIllegalReg;
+	}
+
+	tsk = &(emu->Tasks[task - 1]);
+	bzero((void *) tsk, sizeof(MttEmuTask));
+	tsk->PcOffset = addr;
+	tsk->Size = pbf->InstructionCount;
+	return MttLibErrorNONE;
+}
+
+/* ================================================================ */
+
+void MttEmuStartTask(MttEmu *emu, int task) {
+
+	if ((task < 1) || (task > MttDrvrTASKS))
+		return;
+	if (emu->Tasks[task - 1].Size == 0)
+		return;
+	emu->Tasks[task - 1].TaskStatus = MttDrvrTaskStatusRUNNING;
+	emu->Running |= 1 << (task - 1);
+}
+
+/* ================================================================ */
+/* Inputs are kept sorted on arrival time                           */
+
+MttLibError MttEmuAddInput(MttEmu *emu, unsigned long ms, unsigned long event) {
+
+	MttEmuInput *inp;
+	unsigned long i;
+
+	if ((emu->InputCount & 0xFF) == 0) {
+		inp = realloc(emu->Inputs, (emu->InputCount + 256) * sizeof(MttEmuInput));
+		if (inp == NULL)
+			return MttLibErrorNOMEM;
+		emu->Inputs = inp;
+	}
+
+	for (i = emu->InputCount; i > emu->InputNext; i--) {
+		if (emu->Inputs[i - 1].Ms <= ms)
+			break;
+		emu->Inputs[i] = emu->Inputs[i - 1];
+	}
+	emu->Inputs[i].Ms = ms;
+	emu->Inputs[i].Event = event;
+	emu->InputCount++;
+	return MttLibErrorNONE;
+}
+
+void MttEmuTrace(MttEmu *emu, int reg) {
+
+	if ((reg >= 0) && (reg < REGISTERS))
+		emu->TraceRegs[reg] = 1;
+}
+
+/* ================================================================ */
+/* Millisecond tick: time registers and input events, hardware      */
+/* writes are traced as task 0                                      */
+
+static void SetGlobal(MttEmu *emu, int reg, unsigned long val) {
+
+	unsigned long was;
+
+	was = emu->Global[reg];
+	emu->Global[reg] = val;
+	if ((emu->TraceRegs[reg]) && (emu->TraceFn) && (was != val))
+		emu->TraceFn(emu, 0, reg, was, val);
+}
+
+static void Tick(MttEmu *emu) {
+
+	MttEmuInput *inp;
+
+	SetGlobal(emu, GAdrMSFR, emu->Ms);
+	SetGlobal(emu, GAdrMSMR, emu->Ms % 1000);
+
+	if (emu->SyncPeriod) {
+		if ((emu->Ms % emu->SyncPeriod) == 0) {
+			SetGlobal(emu, GAdrTSYNC, 0);
+			SetGlobal(emu, GAdrSYNCFR, emu->Global[GAdrSYNCFR] + 1);
+		} else
+			SetGlobal(emu, GAdrTSYNC, emu->Global[GAdrTSYNC] + 1);
+	}
+
+	while (emu->InputNext < emu->InputCount) {
+		inp = &(emu->Inputs[emu->InputNext]);
+		if (inp->Ms > emu->Ms)
+			break;
+		SetGlobal(emu, GAdrEVIN, inp->Event);
+		SetGlobal(emu, GAdrEVINCNT, emu->Global[GAdrEVINCNT] + 1);
+		emu->InputNs = NowNs(emu);
+		emu->InputSeen = 1;
+		emu->InputNext++;
+	}
+}
+
+/* ================================================================ */
+/* Run. The running tasks execute one instruction each in turn, one */
+/* per cycle. Once every running task has failed its wait in a row  */
+/* nothing can change before the next tick, so the rest of the      */
+/* millisecond is skipped.                                          */
+
+static int CountTasks(unsigned long msk) {
+
+	int n;
+
+	for (n = 0; msk; msk &= msk - 1)
+		n++;
+	return n;
+}
+
+void MttEmuRun(MttEmu *emu, unsigned long ms) {
+
+	MttEmuTask *task;
+	MttEmuOp *op;
+	unsigned long end, running, pc;
+	int i, tn, nrun, waits;
+
+	end = emu->Ms + ms;
+	while (emu->Ms < end) {
+		if (emu->Cycle == 0)
+			Tick(emu);
+
+		running = emu->Running;
+		nrun = CountTasks(running);
+		waits = 0;
+
+		while ((emu->Cycle < MttEmuCYCLES_PER_MS) && (running)) {
+
+			for (i = 0; i < MttDrvrTASKS; i++) {
+				tn = (emu->Next + i) % MttDrvrTASKS;
+				if (running & (1 << tn))
+					break;
+			}
+			emu->Next = tn + 1;
+			task = &(emu->Tasks[tn]);
+
+			pc = task->Pc;
+			if (pc < task->Size) {
+				op = &(emu->Program[task->PcOffset + pc]);
+				op->Fn(emu, task, op);
+			} else
+				Stop(emu, task, MttDrvrTaskStatusILLEGAL_VALUE, MttDrvrIntILLEGAL_OP_CODE);
+
+			task->Instructions++;
+			emu->Cycle++;
+
+			if (emu->Running != running) {
+				running = emu->Running;
+				nrun = CountTasks(running);
+				waits = 0;
+			} else if ((task->TaskStatus & MttDrvrTaskStatusWAITING) && (task->Pc == pc)) {
+				if (++waits >= nrun)
+					break;
+			} else
+				waits = 0;
+		}
+
+		emu->Idle += MttEmuCYCLES_PER_MS - emu->Cycle;
+		emu->Cycles += MttEmuCYCLES_PER_MS;
+		emu->Cycle = 0;
+		emu->Ms++;
+	}
+}
+
+/* ================================================================ */
+/* Register number to name, as RegToString in emu.c                 */
+
+char *MttEmuRegName(int reg) {
+
+	static char name[MAX_REGISTER_STRING_LENGTH + 8];
+	RegisterDsc *rd;
+	int i;
+
+	for (i = 0; i < REGNAMES; i++) {
+		rd = &(Regs[i]);
+		if ((reg >= rd->Start) && (reg <= rd->End)) {
+			if (rd->Start < rd->End)
+				sprintf(name, "%s%1d", rd->Name, (reg - rd->Start) + rd->Offset);
+			else
+				sprintf(name, "%s", rd->Name);
+			return name;
+		}
+	}
+	return "???";
+}
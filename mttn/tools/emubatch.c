@@ -0,0 +1,241 @@
+/**************************************************************************/
+/* Batch MTT emulator                                                     */
+/*                                                                        */
+/* Runs compiled event table objects in consecutive task slots for a      */
+/* number of emulated milliseconds, with input events read from a file,   */
+/* and prints the output events with their latencies, register traces,    */
+/* and a cycle report. No module is needed, see mttemu.h.                 */
+/*                                                                        */
+/* emubatch [-d ms] [-e events] [-s sync] [-t reg[,reg..]] [-q] obj..     */
+/*                                                                        */
+/* -d Milliseconds to run, default 1000                                   */
+/* -s Sync period in ms for TSYNC and SYNCFR, default 1200, 0 for none    */
+/* -t Trace writes to the named or numbered registers                     */
+/*                                                                        */
+/* The events file has one "ms event" pair per line, # starts a comment.  */
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+
+#include <libmtt.h>
+#include <mttemu.h>
+
+#define LN 128
+
+static int quiet = 0;
+
+/**************************************************************************/
+/* Output event and trace call backs                                      */
+/**************************************************************************/
+
+static void PrintOutput(MttEmu *emu, MttEmuOutput *out) {
+
+   if (quiet) return;
+   printf("%6lu.%05lu Task:%02lu %s Event:0x%08lX Latency:%luns\n",
+	  out->Ms,out->Cycle,out->Task,
+	  out->High ? "EVOUTH" : "EVOUTL",
+	  out->Event,out->Latency);
+}
+
+static void PrintTrace(MttEmu *emu, int task, int reg, unsigned long was, unsigned long val) {
+
+   if (quiet) return;
+   printf("%6lu.%05lu Task:%02d %-8s 0x%08lX -> 0x%08lX\n",
+	  emu->Ms,emu->Cycle,task,MttEmuRegName(reg),was,val);
+}
+
+/**************************************************************************/
+/* Register name or number to register number                             */
+/**************************************************************************/
+
+static int RegNumber(char *cp) {
+
+int reg;
+char *ep;
+
+   reg = strtoul(cp,&ep,0);
+   if (ep != cp) return reg;
+
+   for (reg=0; reg<REGISTERS; reg++)
+      if (strcasecmp(cp,MttEmuRegName(reg)) == 0) return reg;
+   return -1;
+}
+
+/**************************************************************************/
+/* Read the input events file                                             */
+/**************************************************************************/
+
+static int ReadEvents(MttEmu *emu, char *path) {
+
+FILE *fp;
+char ln[LN], *cp, *ep;
+unsigned long ms, event;
+int cnt;
+
+   fp = fopen(path,"r");
+   if (fp == NULL) {
+      perror("emubatch");
+      fprintf(stderr,"emubatch: Can't open events file: %s\n",path);
+      return -1;
+   }
+
+   cnt = 0;
+   while (fgets(ln,LN,fp)) {
+      cp = ln;
+      while ((*cp == ' ') || (*cp == '\t')) cp++;
+      if ((*cp == '#') || (*cp == '\n') || (*cp == 0)) continue;
+
+      ms = strtoul(cp,&ep,0);
+      if (ep == cp) continue;
+      cp = ep;
+      event = strtoul(cp,&ep,0);
+      if (ep == cp) continue;
+
+      if (MttEmuAddInput(emu,ms,event) != MttLibErrorNONE) break;
+      cnt++;
+   }
+   fclose(fp);
+   return cnt;
+}
+
+/**************************************************************************/
+/* Load an object file into a task slot, returns the slots used           */
+/**************************************************************************/
+
+static int LoadObject(MttEmu *emu, int task, char *path) {
+
+FILE *fp;
+ProgramBuf pbf;
+MttLibError err;
+
+   fp = fopen(path,"r");
+   if (fp == NULL) {
+      perror("emubatch");
+      fprintf(stderr,"emubatch: Can't open object file: %s\n",path);
+      return 0;
+   }
+   bzero((void *) &pbf,sizeof(ProgramBuf));
+   err = MttLibReadObject(fp,&pbf);
+   fclose(fp);
+   if (err == MttLibErrorNONE) {
+      err = MttEmuLoadTask(emu,task,&pbf);
+      free(pbf.Program);
+   }
+   if (err != MttLibErrorNONE) {
+      fprintf(stderr,"emubatch: %s: %s\n",path,MttLibErrorToString(err));
+      return 0;
+   }
+   MttEmuStartTask(emu,task);
+   if (!quiet) printf("Task:%02d %s Instructions:%lu\n",
+		      task,path,emu->Tasks[task -1].Size);
+   return (emu->Tasks[task -1].Size + MttLibTASK_SIZE -1) / MttLibTASK_SIZE;
+}
+
+/**************************************************************************/
+/* Task status to string                                                  */
+/**************************************************************************/
+
+static char *TaskStatus(MttDrvrTaskStatus sts) {
+
+   if (sts & MttDrvrTaskStatusILLEGAL_OP_CODE)  return "IllegalOpCode";
+   if (sts & MttDrvrTaskStatusILLEGAL_VALUE)    return "IllegalPc";
+   if (sts & MttDrvrTaskStatusILLEGAL_REGISTER) return "IllegalRegister";
+   if (sts & MttDrvrTaskStatusWAITING)          return "Waiting";
+   if (sts & MttDrvrTaskStatusSTOPPED)          return "Stopped";
+   if (sts & MttDrvrTaskStatusRUNNING)          return "Running";
+   return "Unloaded";
+}
+
+/**************************************************************************/
+/* Main                                                                   */
+/**************************************************************************/
+
+int main(int argc, char *argv[]) {
+
+MttEmu *emu;
+MttEmuTask *task;
+struct timeval t0, t1;
+unsigned long ms, sync, instructions;
+double secs;
+char *events, *cp, *ep;
+int i, tn, reg, used;
+
+   ms = 1000; sync = 1200; events = NULL; tn = 1;
+
+   emu = MttEmuCreate(0);
+   if (emu == NULL) {
+      fprintf(stderr,"emubatch: Not enough memory\n");
+      exit(1);
+   }
+   emu->OutputFn = PrintOutput;
+   emu->TraceFn  = PrintTrace;
+
+   for (i=1; i<argc; i++) {
+      if      (strcmp(argv[i],"-q") == 0)             quiet = 1;
+      else if ((strcmp(argv[i],"-d") == 0) && (i+1 < argc)) ms = strtoul(argv[++i],NULL,0);
+      else if ((strcmp(argv[i],"-s") == 0) && (i+1 < argc)) sync = strtoul(argv[++i],NULL,0);
+      else if ((strcmp(argv[i],"-e") == 0) && (i+1 < argc)) events = argv[++i];
+      else if ((strcmp(argv[i],"-t") == 0) && (i+1 < argc)) {
+	 for (cp=argv[++i]; cp && *cp; cp=ep) {
+	    ep = strchr(cp,',');
+	    if (ep) *ep++ = 0;
+	    reg = RegNumber(cp);
+	    if (reg < 0) fprintf(stderr,"emubatch: No such register: %s\n",cp);
+	    else         MttEmuTrace(emu,reg);
+	 }
+      }
+      else if (argv[i][0] == '-') {
+	 fprintf(stderr,"Usage: emubatch [-d ms] [-e events] [-s sync] [-t reg[,reg..]] [-q] obj..\n");
+	 exit(1);
+      }
+      else {
+	 if (tn > MttDrvrTASKS) {
+	    fprintf(stderr,"emubatch: No more task slots for: %s\n",argv[i]);
+	    exit(1);
+	 }
+	 used = LoadObject(emu,tn,argv[i]);
+	 if (used == 0) exit(1);
+	 tn += used;
+      }
+   }
+   emu->SyncPeriod = sync;
+
+   if (tn == 1) {
+      fprintf(stderr,"emubatch: No object files\n");
+      exit(1);
+   }
+   if ((events) && (ReadEvents(emu,events) < 0)) exit(1);
+
+   gettimeofday(&t0,NULL);
+   MttEmuRun(emu,ms);
+   gettimeofday(&t1,NULL);
+   secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1000000.0;
+
+   /* Report */
+
+   for (i=0, instructions=0; i<MttDrvrTASKS; i++) {
+      task = &(emu->Tasks[i]);
+      if (task->Size == 0) continue;
+      instructions += task->Instructions;
+      printf("Task:%02d %-15s Pc:%04lu Instructions:%lu Waits:%lu Outputs:%lu\n",
+	     i+1,TaskStatus(task->TaskStatus),task->Pc,
+	     task->Instructions,task->WaitCycles,task->Outputs);
+   }
+   printf("Emulated:%lums Cycles:%llu Instructions:%lu Idle:%llu (%.1f%%) IrqSource:0x%lX\n",
+	  ms,emu->Cycles,instructions,emu->Idle,
+	  emu->Cycles ? (100.0 * emu->Idle) / emu->Cycles : 0.0,
+	  emu->IrqSource);
+   printf("Inputs:%lu Outputs:%lu Latency mean:%.0fns max:%luns\n",
+	  emu->InputNext,emu->Outputs,
+	  emu->Outputs ? (double) emu->SumLatency / emu->Outputs : 0.0,
+	  emu->MaxLatency);
+   printf("Run time:%.3fs %.1f emulated ms per second\n",
+	  secs,secs > 0.0 ? ms / secs : 0.0);
+
+   MttEmuDestroy(emu);
+   exit(0);
+}
@@ -35,6 +35,29 @@
  */
 #define SIS3320_MAX_NR_SEGMENTS	2
 
+/**
+ * struct sis3320_evcache - event directory cache of a segment
+ * @events:	arena of events, @size events per channel
+ * @prevticks:	arena of prevticks (sis3302 only), @size elements
+ * @raw:	bounce buffer for the raw timestamps, 2 * @size elements
+ * @dirs:	raw event directories, @size elements per channel
+ * @size:	maximum number of events the arena can hold
+ * @read:	bitmask of the channels whose directory is in @dirs
+ * @valid:	bitmask of the channels whose directory has been decoded
+ *
+ * The arena is allocated when configuring an acquisition, so that the
+ * acquisition-complete path doesn't allocate any memory.
+ */
+struct sis3320_evcache {
+	struct sis33_event	*events;
+	u64			*prevticks;
+	u32			*raw;
+	u32			*dirs;
+	unsigned int		size;
+	unsigned long		read;
+	unsigned long		valid;
+};
+
 /**
  * struct sis3320 - sis3320 device
  * @vme_base:	VME base address of the module
@@ -42,6 +65,7 @@
  * @completion:	completion to signal when an acquisition has finished
  * @pdev:	parent (physical) device
  * @curr_page:	caches the current ADC memory page.
+ * @evcache:	per-segment cache of the event directories
  *
  * NOTE: when printing to the kernel log, we use card->dev (the device that
  * user-space sees) only when we're sure that is already there. Otherwise,
@@ -53,6 +77,7 @@ struct sis3320 {
 	struct completion	completion;
 	struct device		*pdev;
 	unsigned int		curr_page;
+	struct sis3320_evcache	evcache[SIS3320_MAX_NR_SEGMENTS];
 };
 
 static long base[SIS33_MAX_DEVICES];
@@ -211,13 +236,10 @@ sis3320_process_event(struct sis33_card *card, int segment_nr, int channel,
 }
 
 static int
-sis3320_read_events_dir(struct sis33_card *card, int segment_nr, int channel,
-			u32 *raw_events, int nr_events)
+sis3320_read_events_dir(struct sis33_card *card, int channel, u32 *raw_events, int nr_events)
 {
 	struct sis3320 *priv = card->private_data;
 	unsigned int vme_addr;
-	int ret;
-	int i;
 
 	/*
 	 * All the event descriptors for this channel are fetched in a single
@@ -226,62 +248,141 @@ sis3320_read_events_dir(struct sis33_card *card, int segment_nr, int channel,
 	 * Note that the boards don't support MBLT on the event directory.
 	 */
 	vme_addr = priv->vme_base + SIS3320_EV_DIR(channel);
-	ret = sis33_dma_read32be_blt(card->dev, vme_addr, raw_events, nr_events);
-	if (ret)
-		return ret;
-
-	for (i = 0; i < nr_events; i++)
-		sis3320_process_event(card, segment_nr, channel, raw_events, i);
-	return 0;
+	return sis33_dma_read32be_blt(card->dev, vme_addr, raw_events, nr_events);
 }
 
-static void sis3320_read_segment(struct sis33_card *card, int segment_nr)
+static void sis3320_evcache_free(struct sis33_card *card, int segment_nr)
 {
 	struct sis3320 *priv = card->private_data;
+	struct sis3320_evcache *cache = &priv->evcache[segment_nr];
 	struct sis33_segment *segment = &card->segments[segment_nr];
-	u32 *raw_events;
+
+	kfree(cache->events);
+	kfree(cache->prevticks);
+	kfree(cache->raw);
+	kfree(cache->dirs);
+	memset(cache, 0, sizeof(*cache));
+	segment->events = NULL;
+	segment->prevticks = NULL;
+	segment->nr_events = 0;
+}
+
+static void sis3320_evcache_free_all(struct sis33_card *card)
+{
 	int i;
 
-	if (segment->events && !IS_ERR(segment->events)) {
-		kfree(segment->events);
-		segment->events = NULL;
-		segment->nr_events = 0;
-	}
+	for (i = 0; i < SIS3320_MAX_NR_SEGMENTS; i++)
+		sis3320_evcache_free(card, i);
+}
 
-	segment->nr_events = sis3320_readw(priv, SIS3320_EV_COUNTER);
-	segment->nr_events &= EV_COUNTER_MASK;
-	if (!segment->nr_events)
-		return;
+/*
+ * Make sure the segment's arena can hold @nr_events events for every channel.
+ * This is called when configuring an acquisition, so that the completion
+ * path never has to allocate memory. The arena is only ever grown.
+ * Whatever was cached for the segment is stale from now on, since the new
+ * acquisition overwrites the segment's memory.
+ */
+static int sis3320_evcache_reserve(struct sis33_card *card, int segment_nr, unsigned int nr_events)
+{
+	struct sis3320 *priv = card->private_data;
+	struct sis3320_evcache *cache = &priv->evcache[segment_nr];
+	struct sis33_segment *segment = &card->segments[segment_nr];
 
-	raw_events = kmalloc(segment->nr_events * sizeof(*raw_events), GFP_KERNEL);
-	if (raw_events == NULL) {
-		segment->events = ERR_PTR(-ENOMEM);
-		dev_warn(card->dev, "Couldn't allocate raw events' buffer for handling the ev. directory\n");
-		return;
+	cache->read = 0;
+	cache->valid = 0;
+	segment->nr_events = 0;
+	segment->prevticks = NULL;
+	if (nr_events <= cache->size)
+		return 0;
+
+	sis3320_evcache_free(card, segment_nr);
+	cache->events = kcalloc(nr_events * card->n_channels, sizeof(*cache->events), GFP_KERNEL);
+	if (cache->events == NULL)
+		goto alloc_failed;
+	/* NOTE: on the sis3302, timestamps take two u32's in the raw buffer */
+	cache->raw = kmalloc(nr_events * 2 * sizeof(*cache->raw), GFP_KERNEL);
+	if (cache->raw == NULL)
+		goto alloc_failed;
+	cache->dirs = kmalloc(nr_events * card->n_channels * sizeof(*cache->dirs), GFP_KERNEL);
+	if (cache->dirs == NULL)
+		goto alloc_failed;
+	if (priv->version == 3302) {
+		cache->prevticks = kmalloc(nr_events * sizeof(*cache->prevticks), GFP_KERNEL);
+		if (cache->prevticks == NULL)
+			goto alloc_failed;
 	}
+	cache->size = nr_events;
+	segment->events = cache->events;
+	return 0;
+
+ alloc_failed:
+	dev_info(card->dev, "Couldn't allocate memory for handling segment's %d acquisitions\n", segment_nr);
+	sis3320_evcache_free(card, segment_nr);
+	return -ENOMEM;
+}
+
+/*
+ * Return the events of the given channel, decoding the channel's event
+ * directory from the snapshot taken at the end of the acquisition if it
+ * hasn't been decoded yet.
+ * Concurrent fetches on the same segment are prevented by the core through
+ * segment->transferring, so there's no need for extra locking here.
+ */
+static int sis3320_evcache_get(struct sis33_card *card, int segment_nr, int channel)
+{
+	struct sis3320 *priv = card->private_data;
+	struct sis3320_evcache *cache = &priv->evcache[segment_nr];
+	struct sis33_segment *segment = &card->segments[segment_nr];
+	u32 *raw;
+	int i;
+
+	if (!segment->nr_events || cache->events == NULL)
+		return -ENODATA;
+	if (test_bit(channel, &cache->valid))
+		return 0;
+	if (!test_bit(channel, &cache->read))
+		return -EIO;
+	raw = &cache->dirs[channel * cache->size];
+	for (i = 0; i < segment->nr_events; i++)
+		sis3320_process_event(card, segment_nr, channel, raw, i);
+	set_bit(channel, &cache->valid);
+	return 0;
+}
+
+/*
+ * Called from the IRQ work. The event directory registers are shared by all
+ * the segments, so every channel's directory is copied into the arena now,
+ * before another acquisition overwrites it. Decoding is left to the first
+ * fetch of each channel.
+ */
+static void sis3320_read_segment(struct sis33_card *card, int segment_nr)
+{
+	struct sis3320 *priv = card->private_data;
+	struct sis3320_evcache *cache = &priv->evcache[segment_nr];
+	struct sis33_segment *segment = &card->segments[segment_nr];
+	unsigned int nr_events;
+	int i;
 
-	segment->events = kcalloc(segment->nr_events * card->n_channels, sizeof(struct sis33_event), GFP_KERNEL);
-	if (segment->events == NULL) {
-		segment->events = ERR_PTR(-ENOMEM);
-		dev_warn(card->dev, "Couldn't allocate memory for handling the acquisition\n");
-		goto events_alloc_failed;
+	cache->read = 0;
+	cache->valid = 0;
+	nr_events = sis3320_readw(priv, SIS3320_EV_COUNTER);
+	nr_events &= EV_COUNTER_MASK;
+	if (nr_events > cache->size) {
+		dev_warn(card->dev, "Event counter (%u) exceeds the configured number of events (%u)\n",
+			nr_events, cache->size);
+		nr_events = cache->size;
 	}
+	segment->nr_events = nr_events;
+	if (!nr_events || cache->dirs == NULL)
+		return;
 
 	for (i = 0; i < card->n_channels; i++) {
-		if (sis3320_read_events_dir(card, segment_nr, i, raw_events, segment->nr_events)) {
-			dev_warn(card->dev, "Failed to read the channel's %i events' directory\n", i);
-			goto read_events_failed;
+		if (sis3320_read_events_dir(card, i, &cache->dirs[i * cache->size], nr_events)) {
+			dev_info(card->dev, "Failed to read the channel's %i events' directory\n", i);
+			continue;
 		}
+		set_bit(i, &cache->read);
 	}
-	kfree(raw_events);
-	return;
-
- read_events_failed:
-	kfree(segment->events);
-	segment->events = NULL;
-	segment->nr_events = 0;
- events_alloc_failed:
-	kfree(raw_events);
 }
 
 /*
@@ -324,8 +425,7 @@ static void sis3320_read_prevticks(struct sis33_card *card, int segment_nr)
 {
 	struct sis33_segment *segment = &card->segments[segment_nr];
 	struct sis3320 *priv = card->private_data;
-	u32 *raw_pt_cache;
-	u64 *pt_cache;
+	struct sis3320_evcache *cache = &priv->evcache[segment_nr];
 	int elems;
 	int err;
 
@@ -333,43 +433,21 @@ static void sis3320_read_prevticks(struct sis33_card *card, int segment_nr)
 	if (priv->version != 3302 || !segment->nr_events)
 		return;
 
-	if (segment->prevticks && !IS_ERR(segment->prevticks))
-		kfree(segment->prevticks);
 	segment->prevticks = NULL;
+	if (cache->prevticks == NULL)
+		return;
 
 	elems = segment->nr_events;
 	/* NOTE: on the sis3302, timestamps are 48 bits long */
-	raw_pt_cache = kmalloc(elems * 2 * sizeof(u32), GFP_KERNEL);
-	if (raw_pt_cache == NULL) {
-		segment->prevticks = ERR_PTR(-ENOMEM);
-		dev_info(card->dev, "Cannot allocate raw prevtick's cache buffer\n");
-		return;
-	}
-
-	pt_cache = kmalloc(elems * sizeof(u64), GFP_KERNEL);
-	if (pt_cache == NULL) {
-		segment->prevticks = ERR_PTR(-ENOMEM);
-		dev_info(card->dev, "Cannot allocate prevtick's cache buffer\n");
-		goto pt_cache_alloc_failed;
-	}
-
-	err = sis3302_pt_cache_rawfill(card, segment_nr, raw_pt_cache, elems * 2);
+	err = sis3302_pt_cache_rawfill(card, segment_nr, cache->raw, elems * 2);
 	if (err) {
 		dev_info(card->dev, "Failed to fill segment's %u prevtick's cache buffer, err %d\n", segment_nr, err);
-		goto fill_pt_cache_failed;
+		return;
 	}
 
-	sis3302_pt_cache_fill(pt_cache, raw_pt_cache, elems);
-	sis3302_pt_cache_normalize(pt_cache, elems);
-
-	segment->prevticks = pt_cache;
-	kfree(raw_pt_cache);
-	return;
-
- fill_pt_cache_failed:
-	kfree(pt_cache);
- pt_cache_alloc_failed:
-	kfree(raw_pt_cache);
+	sis3302_pt_cache_fill(cache->prevticks, cache->raw, elems);
+	sis3302_pt_cache_normalize(cache->prevticks, elems);
+	segment->prevticks = cache->prevticks;
 }
 
 /*
@@ -915,16 +993,14 @@ sis3320_read_event(struct sis33_card *card, int segment_nr, struct sis33_acq *ac
 {
 	struct sis33_segment *segment = &card->segments[segment_nr];
 	struct sis33_event *event;
+	int ret;
 
-	if (!segment->nr_events || segment->events == NULL)
-		return -ENODATA;
-	if (IS_ERR(segment->events))
-		return PTR_ERR(segment->events);
+	ret = sis3320_evcache_get(card, segment_nr, channel);
+	if (ret)
+		return ret;
 	if (segment->prevticks) {
 		const u64 *pt_cache = segment->prevticks;
 
-		if (IS_ERR(segment->prevticks))
-			return PTR_ERR(segment->prevticks);
 		acq->prevticks = pt_cache[event_nr];
 	} else {
 		acq->prevticks = 0;
@@ -973,6 +1049,11 @@ static int sis3320_conf_ev(struct sis33_card *card, struct sis33_acq_desc *desc)
 	struct sis3320 *priv = card->private_data;
 	struct sis33_cfg *cfg = &card->cfg;
 	u32 val;
+	int ret;
+
+	ret = sis3320_evcache_reserve(card, desc->segment, desc->nr_events);
+	if (ret)
+		return ret;
 
 	/* single or multi-event mode */
 	val = desc->nr_events == 1 ? ACQ_DI_MEV : ACQ_EN_MEV;
@@ -1217,17 +1298,9 @@ static int __devinit sis3320_probe(struct device *pdev, unsigned int ndev)
 static int __devexit sis3320_remove(struct device *pdev, unsigned int ndev)
 {
 	struct sis33_card *card = dev_get_drvdata(pdev);
-	int i;
 
 	sis3320_device_exit(card, ndev);
-	for (i = 0; i < SIS3320_MAX_NR_SEGMENTS; i++) {
-		struct sis33_segment *segment = &card->segments[i];
-
-		if (segment->events && !IS_ERR(segment->events))
-			kfree(segment->events);
-		if (segment->prevticks && !IS_ERR(segment->prevticks))
-			kfree(segment->prevticks);
-	}
+	sis3320_evcache_free_all(card);
 	kfree(card->segments);
 	kfree(card->channels);
 	kfree(card->private_data);
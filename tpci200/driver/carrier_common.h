@@ -84,10 +84,29 @@ struct slot_irq{
     char         name[SLOT_IRQ_NAME_SIZE];
 };
 
+/**
+ * struct slot_irq_stats - slot IRQ dispatch statistics.
+ * @count	Interrupts dispatched to the slot handler
+ * @acks	Interrupt space acknowledge cycles still needed after the handler
+ * @latency_sum	Sum of the dispatch latencies in ns
+ * @latency_max	Worst dispatch latency in ns
+ *
+ * The dispatch latency runs from the entry of the carrier interrupt
+ * to the call of the slot handler, so it grows with the time spent
+ * in the handlers of the other slots on the same carrier.
+ */
+struct slot_irq_stats {
+    unsigned long      count;
+    unsigned long      acks;
+    unsigned long long latency_sum;
+    unsigned long      latency_max;
+};
+
 /**
  * struct carrier_slot - data specific to the carrier slot.
  * @slot_id	Slot identification gived to external interface
- * @irq		Slot IRQ infos
+ * @irq		Slot IRQ infos, RCU protected, read without lock in the ISR
+ * @irq_stats	Slot IRQ dispatch statistics
  * @io_phys	IO physical base address register of the slot
  * @id_phys	ID physical base address register of the slot
  * @mem_phys	MEM physical base address register of the slot
@@ -96,6 +115,7 @@ struct slot_irq{
 struct carrier_slot {
     struct slot_id*       slot_id;
     struct slot_irq*      irq;
+    struct slot_irq_stats irq_stats;
     struct slot_addr_space io_phys;
     struct slot_addr_space id_phys;
     struct slot_addr_space mem_phys;
@@ -12,11 +12,15 @@
  */
 
 #include <asm/io.h>
+#include <asm/div64.h>
 #include <linux/pci.h>
 #include <linux/spinlock.h>
 #include <linux/interrupt.h>
+#include <linux/rcupdate.h>
+#include <linux/ktime.h>
 #include <linux/moduleparam.h>
 #include <linux/fs.h>
+#include <linux/proc_fs.h>
 #include <linux/byteorder/swabb.h>
 
 #include "carrier.h"
@@ -65,7 +69,7 @@ MODULE_PARM_DESC(lun, "PCI SubVendor ID");
  * @interface_regs	Pointer to IP interface space (Bar 2)
  * @ioidint_space	Pointer to IP ID, IO and INT space (Bar 3)
  * @mem8_space		Pointer to MEM space (Bar 4)
- * @access_lock		Mutex lock for simultaneous access
+ * @access_lock		Lock for the control registers of the slots
  *  
  */
 struct carrier_infos {
@@ -92,6 +96,7 @@ static int slot_write_vector(unsigned char vector, struct slot_id *slot_id, slot
 static int carrier_open(struct inode *inode, struct file *filp);
 static int carrier_release(struct inode *inode, struct file *filp);
 static int carrier_install_all(void);
+static unsigned long slot_irq_latency_mean(struct slot_irq_stats *stats);
 
 struct file_operations carrierFops =
 {
@@ -419,36 +424,75 @@ static irqreturn_t carrier_interrupt(int irq, void *dev_id)
 {
 	struct carrier_board *carrier = (struct carrier_board *) dev_id;
 	struct carrier_infos *pci_carrier = (struct carrier_infos *) carrier->carrier_specific;
+	struct slot_irq *slot_irq;
+	struct slot_irq_stats *stats;
 	int i;
-	unsigned short status_reg, reg_value;
-	unsigned short unhandled_ints = 0;
+	unsigned short status_reg, reg_value, slot_ints;
+	unsigned short pending, handled_ints = 0;
+	unsigned long latency;
+	ktime_t entry;
 	irqreturn_t ret = IRQ_NONE;
 
 	unsigned short dummy;
 
-	spin_lock(&pci_carrier->access_lock);
+	entry = ktime_get();
+
+	/* The status register is read once, only the slots with a pending
+	 * INT0 or INT1 line are visited. The handlers are looked up under
+	 * RCU so that the slots of a carrier never serialize on a lock. */
 
 	status_reg = readw((unsigned short *)(pci_carrier->interface_regs + TPCI200_STATUS_REG));
-	if (status_reg & TPCI200_SLOT_INT_MASK) {
-		unhandled_ints = status_reg & TPCI200_SLOT_INT_MASK;
+	pending = status_reg & TPCI200_SLOT_INT_MASK;
+	if (pending == 0)
+		return IRQ_NONE;
+
+	rcu_read_lock();
+	while (pending) {
+		i = (ffs(pending) - 1) / 2;
+		slot_ints = (TPCI200_A_INT0 | TPCI200_A_INT1) << (2*i);
+		pending &= ~slot_ints;
+
+		slot_irq = rcu_dereference(carrier->slots[i].irq);
+		if (slot_irq == NULL)
+			continue;
+
+		stats = &carrier->slots[i].irq_stats;
+		latency = (unsigned long) ktime_to_ns(ktime_sub(ktime_get(), entry));
+		stats->count++;
+		stats->latency_sum += latency;
+		if (latency > stats->latency_max)
+			stats->latency_max = latency;
+
+		(slot_irq->handler)(slot_irq->arg);
+		handled_ints |= status_reg & slot_ints;
+	}
+	rcu_read_unlock();
 
-		for (i=0 ; i<TPCI200_NB_SLOT ; i++){
-			if ((carrier->slots[i].irq != NULL) &&
-					(status_reg & ((TPCI200_A_INT0 | TPCI200_A_INT1) << (2*i)))){
-				(carrier->slots[i].irq->handler)(carrier->slots[i].irq->arg);
+	if (handled_ints) {
+		ret = IRQ_HANDLED;
 
+		/* Modules that release their request on a register access
+		 * have dropped the line in their handler, the acknowledge
+		 * cycle in the INT space is only run for the lines that are
+		 * still asserted. */
+
+		pending = readw((unsigned short *)(pci_carrier->interface_regs + TPCI200_STATUS_REG));
+		pending &= handled_ints;
+		for (i=0 ; pending && i<TPCI200_NB_SLOT ; i++){
+			if (pending & (TPCI200_A_INT0 << (2*i)))
 				dummy = readw((unsigned short *)(carrier->slots[i].slot_id->io_space.address + 0xC0));
+			if (pending & (TPCI200_A_INT1 << (2*i)))
 				dummy = readw((unsigned short *)(carrier->slots[i].slot_id->io_space.address + 0xC2));
-	
-				unhandled_ints &= ~(((TPCI200_A_INT0 | TPCI200_A_INT1) << (2*i)));
-				ret = IRQ_HANDLED;
-			}
+			if (pending & ((TPCI200_A_INT0 | TPCI200_A_INT1) << (2*i)))
+				carrier->slots[i].irq_stats.acks++;
 		}
 	}
 
-	if (unhandled_ints){
+	slot_ints = (status_reg & TPCI200_SLOT_INT_MASK) & ~handled_ints;
+	if (slot_ints){
+		spin_lock(&pci_carrier->access_lock);
 		for (i=0 ; i<TPCI200_NB_SLOT ; i++){
-			if (unhandled_ints & ((TPCI200_INT0_EN | TPCI200_INT1_EN) << (2*i))){
+			if (slot_ints & ((TPCI200_INT0_EN | TPCI200_INT1_EN) << (2*i))){
 				printk(KERN_ERR PFX "No registered ISR for interrupt on slot [%s %d:%d]!. Interrupt will be disabled.\n",
 						TPCI200_SHORTNAME,
 						carrier->carrier_number, i);
@@ -457,9 +501,9 @@ static irqreturn_t carrier_interrupt(int irq, void *dev_id)
 				writew(reg_value, (unsigned short*)(pci_carrier->interface_regs + control_reg[i]));
 			}
 		}
+		spin_unlock(&pci_carrier->access_lock);
 	}
 
-	spin_unlock(&pci_carrier->access_lock);
 	return ret;
 }
 
@@ -881,7 +925,8 @@ int ip_slot_request_irq(struct slot_id *slot_id, int vector, int (*handler)(void
 		strcpy(slot_irq->name, "Unknown");
 	}
 
-	carrier->slots[slot_id->slot_position].irq = slot_irq;
+	memset(&carrier->slots[slot_id->slot_position].irq_stats, 0, sizeof(struct slot_irq_stats));
+	rcu_assign_pointer(carrier->slots[slot_id->slot_position].irq, slot_irq);
 	res = slot_request_irq(carrier, slot_id);
 	printk(KERN_ERR PFX "IRQ registered.\n");
 
@@ -902,6 +947,7 @@ int ip_slot_free_irq(struct slot_id *slot_id)
 {
 	int res = 0;
 	struct slot_irq *slot_irq = NULL;
+	struct slot_irq_stats *stats;
 	struct carrier_board *carrier = NULL;
 
 	if (slot_id != NULL)
@@ -928,11 +974,19 @@ int ip_slot_free_irq(struct slot_id *slot_id)
 
 	slot_free_irq(carrier, slot_id);
 	slot_irq = carrier->slots[slot_id->slot_position].irq;
-	carrier->slots[slot_id->slot_position].irq = NULL;
+	rcu_assign_pointer(carrier->slots[slot_id->slot_position].irq, NULL);
 
+	/* Wait for an interrupt still running the handler on another CPU */
+	synchronize_rcu();
 	kfree(slot_irq);
 
-	printk(KERN_INFO PFX "IRQ unregistered.\n");
+	stats = &carrier->slots[slot_id->slot_position].irq_stats;
+	printk(KERN_INFO PFX "IRQ unregistered. Slot [%s %d:%d] interrupts:%lu acks:%lu latency mean:%luns max:%luns\n",
+			TPCI200_SHORTNAME,
+			slot_id->carrier_number, slot_id->slot_position,
+			stats->count, stats->acks,
+			slot_irq_latency_mean(stats),
+			stats->latency_max);
 
 out_unlock:
 	mutex_unlock(&carrier->carrier_mutex);
@@ -1200,6 +1254,87 @@ int ip_slot_write_vector(unsigned char vector, struct slot_id *slot_id, slot_spa
 }
 EXPORT_SYMBOL(ip_slot_write_vector);
 
+/**
+ * slot_irq_latency_mean - Mean dispatch latency of a slot in ns.
+ *
+ * @stats	Slot IRQ dispatch statistics
+ *
+ */
+static unsigned long slot_irq_latency_mean(struct slot_irq_stats *stats)
+{
+	u64 latency_mean;
+
+	latency_mean = stats->latency_sum;
+	if (stats->count)
+		do_div(latency_mean, stats->count);
+	return (unsigned long) latency_mean;
+}
+
+#ifdef CONFIG_PROC_FS
+/*
+ * /proc/tpci200 shows the IRQ dispatch statistics of the slots with a
+ * registered handler while they run. The counters are cleared when the
+ * slot IRQ is requested.
+ */
+static int carrier_irq_proc_show(char *page, char **start, off_t off, int count,
+			int *eof, void *data)
+{
+	char *p = page;
+	struct carrier_board *carrier;
+	struct slot_irq *slot_irq;
+	struct slot_irq_stats *stats;
+	int i, j;
+
+	p += sprintf(p, "Carrier Slot Name             Interrupts       Acks  Mean(ns)   Max(ns)\n");
+
+	for (i = 0; i < nb_installed_boards; i++) {
+		carrier = &carrier_boards[i];
+		if ((carrier->carrier_specific == NULL) || (carrier->slots == NULL))
+			continue;
+
+		for (j = 0; j < TPCI200_NB_SLOT; j++) {
+			if (p - page > PAGE_SIZE - 128)
+				break;
+
+			rcu_read_lock();
+			slot_irq = rcu_dereference(carrier->slots[j].irq);
+			if (slot_irq != NULL) {
+				stats = &carrier->slots[j].irq_stats;
+				p += sprintf(p, "%7d %4d %-16s %10lu %10lu %9lu %9lu\n",
+					     carrier->carrier_number, j,
+					     slot_irq->name,
+					     stats->count, stats->acks,
+					     slot_irq_latency_mean(stats),
+					     stats->latency_max);
+			}
+			rcu_read_unlock();
+		}
+	}
+
+	*eof = 1;
+	return p - page;
+}
+
+static struct proc_dir_entry *carrier_proc = NULL;
+
+static void carrier_procfs_register(void)
+{
+	carrier_proc = create_proc_entry("tpci200", S_IFREG | S_IRUGO, NULL);
+	if (!carrier_proc) {
+		printk(KERN_WARNING PFX "Failed to create proc tpci200 node\n");
+		return;
+	}
+	carrier_proc->read_proc = carrier_irq_proc_show;
+}
+
+static void carrier_procfs_unregister(void)
+{
+	if (carrier_proc)
+		remove_proc_entry("tpci200", NULL);
+	carrier_proc = NULL;
+}
+#endif /* CONFIG_PROC_FS */
+
 static int carrier_open(struct inode *inode, struct file *filp)
 {
 	return 0;
@@ -1212,10 +1347,15 @@ static int carrier_release(struct inode *inode, struct file *filp)
 
 static int __init carrier_drvr_init_module(void)
 {
+	int res;
 
 	printk(KERN_INFO PFX "Carrier driver loading...\n");
-	carrier_install_all();
+	res = carrier_install_all();
 	nb_installed_boards = num_lun;
+#ifdef CONFIG_PROC_FS
+	if (res == 0)
+		carrier_procfs_register();
+#endif
 	printk(KERN_INFO PFX "Carrier driver loaded.\n");
 
 	return 0;
@@ -1241,7 +1381,9 @@ static void __exit carrier_drvr_exit_module(void)
 	int i;
 
 	printk(KERN_INFO PFX "Carrier driver unloading...\n");
-
+#ifdef CONFIG_PROC_FS
+	carrier_procfs_unregister();
+#endif
 
 	for (i=0;i<nb_installed_boards;i++) {
 		carrierUninstall(&carrier_boards[i]);
@@ -41,7 +41,7 @@ void display_version(char *name)
  */
 void display_usage(char *name)
 {
-	printf("Usage: %s <*.xml> [-] [-v | -h] [ -fall | -fexclude ] \\\n"
+	printf("Usage: %s <*.xml> [-] [-c<file>] [-v | -h] [ -fall | -fexclude ] \\\n"
 	       "       [-s]<name> -o\"option string\" -n<noden> ... \\\n"
 	       "       [-s]<name> -o\"option string\" -n<noden> ...\n\n"
 	       "Installing the driver based on it's xml description.\n"
@@ -51,6 +51,10 @@ void display_usage(char *name)
 	       "          Default is %s/etc/drivers.xml%s\n\n"
 	       "   -      %soptional%s\n"
 	       "          Read the XML file from standard input\n\n"
+	       "   -c<file> %soptional%s\n"
+	       "          Binary install cache. Used instead of parsing\n"
+	       "          the XML file if it was written for its current\n"
+	       "          contents, written again otherwise.\n\n"
 	       "   -v -- display version\n\n"
 	       "   -h -- show help\n\n"
 	       "   <name> %soptional%s\n"
@@ -117,7 +121,7 @@ void display_usage(char *name)
 	       WHITE_CLR, END_CLR, WHITE_CLR, END_CLR, WHITE_CLR, END_CLR,
 	       WHITE_CLR, END_CLR, WHITE_CLR, END_CLR, WHITE_CLR, END_CLR,
 	       WHITE_CLR, END_CLR, WHITE_CLR, END_CLR, WHITE_CLR, END_CLR,
-	       WHITE_CLR, END_CLR);
+	       WHITE_CLR, END_CLR, WHITE_CLR, END_CLR);
 }
 
 /**
@@ -132,6 +136,8 @@ void display_usage(char *name)
  *                              command line (--exclude option)
  * @param cf   -- .xml config file name goes here. Should be freed by the
  *                caller afterwards.
+ * @param cache -- install cache file name goes here, NULL if none. Should be
+ *                 freed by the caller afterwards.
  * @param head -- list head to hold all driver descriptions
  *                (of type struct drvrd)
  *
@@ -144,16 +150,17 @@ void display_usage(char *name)
  * @return -ENOMEM    -- can't allocate memory for driver description table
  */
 int parse_prog_args(int argc, char* argv[], int *flg, char **cf,
-		    struct list_head *head)
+		    char **cache, struct list_head *head)
 {
 	int opt;
 	struct drvrd *ddp;
 
 	INIT_LIST_HEAD(head);
 	*cf = NULL;
+	*cache = NULL;
 	*flg = 0; /* nothing set yet */
 	/* Scan params of the command line */
-	while ( (opt = getopt(argc, argv, "-s:f:o:n:hv")) != EOF) {
+	while ( (opt = getopt(argc, argv, "-s:f:o:n:c:hv")) != EOF) {
 		switch (opt) {
 		case 's':	/* special installation mode (Linux only)
 				   All driver parameters are passed to the
@@ -186,6 +193,10 @@ int parse_prog_args(int argc, char* argv[], int *flg, char **cf,
 			if (ddp)
 				asprintf(&ddp->slnn, "%s", optarg);
 			break;
+		case 'c':	/* binary install cache */
+			if (!*cache)
+				asprintf(cache, "%s", optarg);
+			break;
 		case 'v': /* current version */
 			display_version(argv[0]);
 			return -ECANCELED; /* Operation canceled */
@@ -83,7 +83,8 @@ int cdv_install(char *path, int driver_id, int extra);
 int cdv_uninstall(int id);
 
 /* inst-utils.c */
-int   parse_prog_args(int, char *[], int *, char **, struct list_head *);
+int   parse_prog_args(int, char *[], int *, char **, char **,
+		      struct list_head *);
 int   create_driver_nodes(int, char *, char *, int);
 char *create_info_file(char *, void *);
 char *create_usr_option_string(int, char *[], int);
@@ -172,6 +172,7 @@ int main(int argc, char *argv[], char *envp[])
 	int drvrcntr = 0;
 	int flg;		/* I_ALL/I_CHOSEN/I_EXCLUDED */
 	char *xmlfn = NULL;	/* config filename */
+	char *cachefn = NULL;	/* install cache filename */
 	LIST_HEAD(head);	/* command line drivers linked list */
 	InsLibHostDesc *hostd = NULL;
 	InsLibDrvrDesc *drvrd = NULL;
@@ -180,12 +181,12 @@ int main(int argc, char *argv[], char *envp[])
 	umask(0000); /* we need _exact_ mode for mknod */
 
 	/* parse command line */
-	rc = parse_prog_args(argc, argv, &flg, &xmlfn, &head);
+	rc = parse_prog_args(argc, argv, &flg, &xmlfn, &cachefn, &head);
 
 	if (IS_ERR_VALUE(rc))
 		goto inst_exit;
 
-	hostd = InsLibParseInstallFile(xmlfn, 0);
+	hostd = InsLibParseInstallFileCached(xmlfn, cachefn, 0);
 	if (!hostd) {
 		rc = EXIT_FAILURE;
 		goto inst_exit;
@@ -225,6 +226,7 @@ int main(int argc, char *argv[], char *envp[])
  inst_exit:
 	free_drvrd(&head);
 	if (xmlfn) free(xmlfn);
+	if (cachefn) free(cachefn);
 
 	exit(rc);
 }
@@ -13,8 +13,14 @@
  *          Released under the GPL
  */
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
@@ -136,6 +142,8 @@ static InsLibVmeAddressSpace* handle_vme_space_node(xmlNode *, int,
 						    InsLibVmeModuleAddress *,
 						    InsLibModlDesc *);
 
+static int unmap_cache(InsLibHostDesc *);
+
 /* ========================================== */
 /* Indenter to print spaces if printing is on */
 
@@ -771,6 +779,8 @@ void InsLibFreeDriver(InsLibDrvrDesc *drvrd)
  */
 void InsLibFreeHost(InsLibHostDesc *hostd)
 {
+	if (unmap_cache(hostd))
+		return;	/* came from InsLibLoadCache */
 	if (hostd) {
 		InsLibFreeDriver(hostd->Drivers);
 		free(hostd);
@@ -915,6 +925,475 @@ void InsLibPrintHost(InsLibHostDesc *hostd)
 	}
 }
 
+/* ================================================================== */
+/* Binary install cache                                               */
+/*                                                                    */
+/* The parsed host description is written as one flat image: a header */
+/* holding the key of the XML file it came from, all the descriptors  */
+/* with their pointers stored as offsets from the start of the image, */
+/* and the list of those pointer fields. Loading maps the image       */
+/* private, adds the map address to each pointer and uses it as is.   */
+/* ================================================================== */
+
+#define CACHE_MAGIC   0x496e734cUL /* "InsL" */
+#define CACHE_VERSION 1
+#define CACHE_ALIGN   8
+#define CACHE_IMAGES  8	/**< images mapped at the same time */
+
+typedef struct {
+	unsigned long      Magic;
+	unsigned long      Version;
+	unsigned long      PtrSize;
+	unsigned long      ImageSize;  /**< whole file */
+	unsigned long      Host;       /**< host description offset */
+	unsigned long      Relocs;     /**< pointer field offsets offset */
+	unsigned long      RelocCount;
+	unsigned long long XmlSize;    /**< key of the XML file */
+	unsigned long long XmlMtime;
+	unsigned long long XmlHash;
+} CacheHeader;
+
+/** Image under construction, offsets are relative to Buf */
+typedef struct {
+	char          *Buf;
+	unsigned long  Len;
+	unsigned long  Size;
+	unsigned long *Reloc;
+	unsigned long  RelocCount;
+	unsigned long  RelocSize;
+	int            Error;
+} CacheImage;
+
+/** Loaded images, to unmap them from InsLibFreeHost */
+static struct {
+	void           *Base;
+	unsigned long   Size;
+	InsLibHostDesc *Host;
+} cache_maps[CACHE_IMAGES];
+
+/**
+ * @brief Get the cache key of an XML file
+ *
+ * @param fname -- XML install file name
+ * @param ch    -- header to fill XmlSize, XmlMtime and XmlHash in
+ *
+ * The hash is the 64 bit FNV-1a of the file contents.
+ *
+ * @return 0  - OK
+ * @return -1 - can't read the file
+ */
+static int cache_key(char *fname, CacheHeader *ch)
+{
+	struct stat st;
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	unsigned char *cp;
+	void *map = NULL;
+	off_t i;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		goto out_bad;
+	if (st.st_size) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+			goto out_bad;
+	}
+	close(fd);
+
+	for (i = 0, cp = map; i < st.st_size; i++) {
+		hash ^= cp[i];
+		hash *= 0x100000001b3ULL;
+	}
+	if (map)
+		munmap(map, st.st_size);
+
+	ch->XmlSize  = st.st_size;
+	ch->XmlMtime = st.st_mtime;
+	ch->XmlHash  = hash;
+	return 0;
+
+ out_bad:
+	close(fd);
+	return -1;
+}
+
+/**
+ * @brief Append an object to the image
+ *
+ * @param im  -- image
+ * @param src -- object to copy
+ * @param len -- its size
+ *
+ * @return 0      - no memory, Error is set
+ * @return offset - where the copy starts
+ */
+static unsigned long cache_put(CacheImage *im, void *src, unsigned long len)
+{
+	unsigned long off = (im->Len + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1);
+	char *buf;
+
+	if (im->Error)
+		return 0;
+	while (off + len > im->Size) {
+		buf = realloc(im->Buf, im->Size ? 2 * im->Size : 4096);
+		if (!buf) {
+			im->Error = 1;
+			return 0;
+		}
+		im->Size = im->Size ? 2 * im->Size : 4096;
+		im->Buf = buf;
+	}
+	bzero(im->Buf + im->Len, off - im->Len);
+	if (len)
+		memcpy(im->Buf + off, src, len);
+	im->Len = off + len;
+	return off;
+}
+
+/**
+ * @brief Set a pointer field of an object in the image
+ *
+ * @param im     -- image
+ * @param at     -- offset of the pointer field
+ * @param target -- offset it points to, 0 for NULL
+ */
+static void cache_ptr(CacheImage *im, unsigned long at, unsigned long target)
+{
+	unsigned long *rel;
+
+	if (im->Error)
+		return;
+	memcpy(im->Buf + at, &target, sizeof(target));
+	if (!target)
+		return;
+	if (im->RelocCount == im->RelocSize) {
+		rel = realloc(im->Reloc, (im->RelocSize + 64) * sizeof(*rel));
+		if (!rel) {
+			im->Error = 1;
+			return;
+		}
+		im->RelocSize += 64;
+		im->Reloc = rel;
+	}
+	im->Reloc[im->RelocCount++] = at;
+}
+
+/**
+ * @brief Append an address space list
+ *
+ * All the address space types start with their Mapped and Next
+ * pointers, like InsLibAnyAddressSpace. Mapped is not kept.
+ */
+static unsigned long cache_space(CacheImage *im, InsLibAnyAddressSpace *as,
+				 unsigned long len)
+{
+	unsigned long off;
+
+	if (!as)
+		return 0;
+	off = cache_put(im, as, len);
+	if (!off)
+		return 0;
+	cache_ptr(im, off + offsetof(InsLibAnyAddressSpace, Mapped), 0);
+	cache_ptr(im, off + offsetof(InsLibAnyAddressSpace, Next),
+		  cache_space(im, as->Next, len));
+	return off;
+}
+
+/**
+ * @brief Append a module address and its address spaces
+ *
+ * All the module address types start with their address space list,
+ * like InsLibAnyModuleAddress.
+ */
+static unsigned long cache_address(CacheImage *im, InsLibAnyModuleAddress *ma,
+				   unsigned long len, unsigned long aslen)
+{
+	unsigned long off;
+
+	if (!ma)
+		return 0;
+	off = cache_put(im, ma, len);
+	if (!off)
+		return 0;
+	cache_ptr(im, off + offsetof(InsLibAnyModuleAddress, AnyAddressSpace),
+		  cache_space(im, ma->AnyAddressSpace, aslen));
+	return off;
+}
+
+static unsigned long cache_module(CacheImage *im, InsLibModlDesc *modld)
+{
+	unsigned long off, ma = 0, isr = 0, extra = 0;
+
+	if (!modld)
+		return 0;
+	off = cache_put(im, modld, sizeof(*modld));
+	if (!off)
+		return 0;
+
+	if (modld->Isr)
+		isr = cache_put(im, modld->Isr, sizeof(InsLibIntrDesc));
+	if (modld->Extra)
+		extra = cache_put(im, modld->Extra, strlen(modld->Extra) + 1);
+
+	if (modld->BusType == InsLibBusTypeCARRIER)
+		ma = cache_address(im, modld->ModuleAddress,
+				   sizeof(InsLibCarModuleAddress),
+				   sizeof(InsLibCarAddressSpace));
+	else if (modld->BusType == InsLibBusTypeVME)
+		ma = cache_address(im, modld->ModuleAddress,
+				   sizeof(InsLibVmeModuleAddress),
+				   sizeof(InsLibVmeAddressSpace));
+	else if ( (modld->BusType == InsLibBusTypePMC) ||
+		  (modld->BusType == InsLibBusTypePCI) )
+		ma = cache_address(im, modld->ModuleAddress,
+				   sizeof(InsLibPciModuleAddress),
+				   sizeof(InsLibPciAddressSpace));
+	else if (modld->ModuleAddress)
+		im->Error = 1;	/* don't know what it is */
+
+	cache_ptr(im, off + offsetof(InsLibModlDesc, Isr), isr);
+	cache_ptr(im, off + offsetof(InsLibModlDesc, Extra), extra);
+	cache_ptr(im, off + offsetof(InsLibModlDesc, ModuleAddress), ma);
+	cache_ptr(im, off + offsetof(InsLibModlDesc, Next),
+		  cache_module(im, modld->Next));
+	return off;
+}
+
+static unsigned long cache_driver(CacheImage *im, InsLibDrvrDesc *drvrd)
+{
+	unsigned long off;
+
+	if (!drvrd)
+		return 0;
+	off = cache_put(im, drvrd, sizeof(*drvrd));
+	if (!off)
+		return 0;
+	cache_ptr(im, off + offsetof(InsLibDrvrDesc, Modules),
+		  cache_module(im, drvrd->Modules));
+	cache_ptr(im, off + offsetof(InsLibDrvrDesc, Next),
+		  cache_driver(im, drvrd->Next));
+	return off;
+}
+
+/**
+ * @brief Unmap a host description loaded from a cache image
+ *
+ * @param hostd -- host description
+ *
+ * @return 1 - it was a cache image, it is gone
+ * @return 0 - it was not
+ */
+static int unmap_cache(InsLibHostDesc *hostd)
+{
+	int i;
+
+	if (!hostd)
+		return 0;
+	for (i = 0; i < CACHE_IMAGES; i++) {
+		if (cache_maps[i].Host == hostd) {
+			munmap(cache_maps[i].Base, cache_maps[i].Size);
+			cache_maps[i].Host = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Write a host description into a binary install cache
+ *
+ * @param hostd -- host description, as returned by InsLibParseInstallFile
+ * @param fname -- XML install file it was parsed from
+ * @param cname -- cache file name
+ *
+ * The image is written to a temporary file and renamed, so that readers
+ * never see half of it.
+ *
+ * @return 0  - OK
+ * @return -1 - failed
+ */
+int InsLibSaveCache(InsLibHostDesc *hostd, char *fname, char *cname)
+{
+	CacheImage im;
+	CacheHeader ch, *chp;
+	char *tmp = NULL;
+	unsigned long host;
+	int fd, cc = -1;
+
+	if (!hostd)
+		return -1;
+
+	bzero((void *) &ch, sizeof(ch));
+	if (cache_key(fname, &ch) < 0)
+		return -1;
+	ch.Magic   = CACHE_MAGIC;
+	ch.Version = CACHE_VERSION;
+	ch.PtrSize = sizeof(void *);
+
+	bzero((void *) &im, sizeof(im));
+	cache_put(&im, &ch, sizeof(ch));
+	host = cache_put(&im, hostd, sizeof(*hostd));
+	if (host)
+		cache_ptr(&im, host + offsetof(InsLibHostDesc, Drivers),
+			  cache_driver(&im, hostd->Drivers));
+	ch.Host       = host;
+	ch.RelocCount = im.RelocCount;
+	ch.Relocs     = cache_put(&im, im.Reloc,
+				  im.RelocCount * sizeof(unsigned long));
+	if (im.Error)
+		goto out;
+	ch.ImageSize = im.Len;
+	chp = (CacheHeader *) im.Buf;
+	*chp = ch;
+
+	tmp = malloc(strlen(cname) + 16);
+	if (!tmp)
+		goto out;
+	sprintf(tmp, "%s.%d", cname, (int) getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto out;
+	if (write(fd, im.Buf, im.Len) != (ssize_t) im.Len) {
+		close(fd);
+		unlink(tmp);
+		goto out;
+	}
+	close(fd);
+	if (rename(tmp, cname) < 0) {
+		unlink(tmp);
+		goto out;
+	}
+	cc = 0;
+
+ out:
+	free(tmp);
+	free(im.Buf);
+	free(im.Reloc);
+	return cc;
+}
+
+/**
+ * @brief Get a host description from a binary install cache
+ *
+ * @param fname -- XML install file the cache must have been written for
+ * @param cname -- cache file name
+ *
+ * The image is checked against the size, modification time and contents
+ * hash of @ref fname and used in place, nothing is allocated. It is
+ * released with InsLibFreeHost like a parsed one.
+ *
+ * @return NULL                     - no cache, stale or broken cache
+ * @return host description pointer - OK
+ */
+InsLibHostDesc *InsLibLoadCache(char *fname, char *cname)
+{
+	CacheHeader key, *ch;
+	struct stat st;
+	unsigned long i, *rel, val;
+	char *base;
+	int fd, slot;
+
+	for (slot = 0; slot < CACHE_IMAGES; slot++)
+		if (!cache_maps[slot].Host)
+			break;
+	if (slot == CACHE_IMAGES)
+		return NULL;
+
+	if (cache_key(fname, &key) < 0)
+		return NULL;
+
+	fd = open(cname, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(*ch)) {
+		close(fd);
+		return NULL;
+	}
+	base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	ch = (CacheHeader *) base;
+	if (ch->Magic != CACHE_MAGIC || ch->Version != CACHE_VERSION ||
+	    ch->PtrSize != sizeof(void *) ||
+	    ch->ImageSize != (unsigned long) st.st_size ||
+	    ch->XmlSize != key.XmlSize || ch->XmlMtime != key.XmlMtime ||
+	    ch->XmlHash != key.XmlHash)
+		goto out_bad;
+	if (ch->Host < sizeof(*ch) ||
+	    ch->Host + sizeof(InsLibHostDesc) > ch->ImageSize ||
+	    ch->Relocs < sizeof(*ch) || ch->Relocs > ch->ImageSize ||
+	    ch->RelocCount > (ch->ImageSize - ch->Relocs) / sizeof(*rel))
+		goto out_bad;
+
+	/* every pointer must lie in the descriptors, and point there */
+	rel = (unsigned long *) (base + ch->Relocs);
+	for (i = 0; i < ch->RelocCount; i++) {
+		if (rel[i] < sizeof(*ch) || rel[i] % sizeof(void *) ||
+		    rel[i] + sizeof(void *) > ch->Relocs)
+			goto out_bad;
+		memcpy(&val, base + rel[i], sizeof(val));
+		if (val < sizeof(*ch) || val >= ch->Relocs)
+			goto out_bad;
+		val += (unsigned long) base;
+		memcpy(base + rel[i], &val, sizeof(val));
+	}
+
+	cache_maps[slot].Base = base;
+	cache_maps[slot].Size = st.st_size;
+	cache_maps[slot].Host = (InsLibHostDesc *) (base + ch->Host);
+	return cache_maps[slot].Host;
+
+ out_bad:
+	munmap(base, st.st_size);
+	return NULL;
+}
+
+/**
+ * @brief Build the driver descriptors, going through a binary install cache
+ *
+ * @param fname -- XML install file name to parse
+ * @param cname -- cache file name. If NULL - just parse @ref fname
+ * @param pflag -- Debug print flag to print the tree
+ *
+ * The cache is used if it was written for the current contents of
+ * @ref fname, else the file is parsed and, if there were no errors,
+ * the cache is written again for the next time.
+ *
+ * @return NULL                     - failed
+ * @return host description pointer - OK
+ */
+InsLibHostDesc *InsLibParseInstallFileCached(char *fname, char *cname,
+					     int pflag)
+{
+	InsLibHostDesc *hostd;
+	int errs;
+
+	if (!cname || !strcmp(fname, "-"))
+		return InsLibParseInstallFile(fname, pflag);
+
+	hostd = InsLibLoadCache(fname, cname);
+	if (hostd) {
+		if (pflag)
+			InsLibPrintHost(hostd);
+		return hostd;
+	}
+
+	errs = InsLibErrorCount;
+	hostd = InsLibParseInstallFile(fname, pflag);
+	if (hostd && errs == InsLibErrorCount &&
+	    InsLibSaveCache(hostd, fname, cname) < 0)
+		fprintf(stderr, WARNING_MSG"Can't write install cache %s\n",
+			cname);
+	return hostd;
+}
+
 /**
  * @brief Parse PCI module description
  *
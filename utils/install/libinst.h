@@ -22,6 +22,9 @@ extern int InsLibErrorCount;	/**< Counter for errors */
  *@{
  */
 InsLibHostDesc *InsLibParseInstallFile(char *, int);
+InsLibHostDesc *InsLibParseInstallFileCached(char *, char *, int);
+InsLibHostDesc *InsLibLoadCache(char *, char *);
+int             InsLibSaveCache(InsLibHostDesc *, char *, char *);
 InsLibDrvrDesc *InsLibGetDriver(InsLibHostDesc *, char *);
 InsLibModlDesc *InsLibGetModule(InsLibDrvrDesc *, int);
 void            InsLibFreeCarSpace(InsLibCarAddressSpace *);
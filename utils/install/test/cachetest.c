@@ -0,0 +1,138 @@
+/**
+ * @file cachetest.c
+ *
+ * @brief Check and time the binary install cache against the XML parser
+ *
+ * cachetest [-n loops] <xml_file> <cache_file>
+ *    Parse the XML file, write the cache, load it back and check that the
+ *    loaded tree writes the very same image. Then report the mean time of
+ *    a parse and of a cache load over [loops] runs.
+ *
+ * cachetest -p fresh|cache <xml_file> <cache_file>
+ *    Print the parsed tree, or the tree loaded from the cache. Fails if
+ *    the cache is missing or stale.
+ *
+ * @section license_sec License
+ *          Released under the GPL
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <libinst.h>
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* 0 if both files hold the same bytes */
+static int compare_files(char *a, char *b)
+{
+	FILE *fa, *fb;
+	int ca, cb;
+
+	fa = fopen(a, "r");
+	fb = fopen(b, "r");
+	if (!fa || !fb)
+		return -1;
+	do {
+		ca = getc(fa);
+		cb = getc(fb);
+	} while (ca == cb && ca != EOF);
+	fclose(fa);
+	fclose(fb);
+	return ca == cb ? 0 : -1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: cachetest [-n loops] [-p fresh|cache]"
+		" <xml_file> <cache_file>\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	InsLibHostDesc *hostd, *cached;
+	char *xml, *cache, *print = NULL, check[256];
+	double t0, parse, load;
+	int i, opt, loops = 100;
+
+	while ((opt = getopt(argc, argv, "n:p:")) != EOF) {
+		switch (opt) {
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		case 'p':
+			print = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind != 2 || loops < 1)
+		usage();
+	xml   = argv[optind];
+	cache = argv[optind + 1];
+
+	if (print) {
+		if (!strcmp(print, "fresh"))
+			hostd = InsLibParseInstallFile(xml, 0);
+		else
+			hostd = InsLibLoadCache(xml, cache);
+		if (!hostd)
+			exit(1);
+		InsLibPrintHost(hostd);
+		InsLibFreeHost(hostd);
+		exit(0);
+	}
+
+	/* round trip */
+	unlink(cache);
+	hostd = InsLibParseInstallFile(xml, 0);
+	if (!hostd || InsLibErrorCount) {
+		fprintf(stderr, "cachetest: %s: parse failed\n", xml);
+		exit(1);
+	}
+	if (InsLibSaveCache(hostd, xml, cache) < 0) {
+		fprintf(stderr, "cachetest: %s: can't write\n", cache);
+		exit(1);
+	}
+	cached = InsLibLoadCache(xml, cache);
+	if (!cached) {
+		fprintf(stderr, "cachetest: %s: can't load\n", cache);
+		exit(1);
+	}
+	snprintf(check, sizeof(check), "%s.check", cache);
+	if (InsLibSaveCache(cached, xml, check) < 0 ||
+	    compare_files(cache, check)) {
+		fprintf(stderr, "cachetest: %s: cached and parsed trees"
+			" differ\n", xml);
+		unlink(check);
+		exit(1);
+	}
+	unlink(check);
+	InsLibFreeHost(cached);
+	InsLibFreeHost(hostd);
+
+	/* timing */
+	t0 = now();
+	for (i = 0; i < loops; i++)
+		InsLibFreeHost(InsLibParseInstallFile(xml, 0));
+	parse = (now() - t0) / loops;
+
+	t0 = now();
+	for (i = 0; i < loops; i++)
+		InsLibFreeHost(InsLibLoadCache(xml, cache));
+	load = (now() - t0) / loops;
+
+	printf("%s: parse %.1fus cache %.1fus (%.1fx)\n", xml,
+	       parse * 1000000.0, load * 1000000.0,
+	       load > 0.0 ? parse / load : 0.0);
+	exit(0);
+}
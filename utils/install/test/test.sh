@@ -4,6 +4,7 @@
 set -e
 
 VMEDESC=../vmedesc
+CACHETEST=${CACHETEST:-./cachetest.$CPU}
 
 # each .out file has the command to build it in its first line as a comment
 for file in *.out
@@ -12,4 +13,21 @@ do
     diff -I'^#' --ignore-all-space --ignore-blank-lines $file -
 done
 
+# the same descriptions, parsed and through the install cache
+TMP=`mktemp -d`
+trap "rm -rf $TMP" EXIT
+for file in *.out
+do
+    xml=$TMP/${file%.out}.xml
+    sed 1d $file > $xml
+    $CACHETEST $xml $TMP/cache
+    $CACHETEST -p fresh $xml $TMP/cache > $TMP/fresh
+    $CACHETEST -p cache $xml $TMP/cache | diff $TMP/fresh -
+    echo "<!-- changed -->" >> $xml
+    if $CACHETEST -p cache $xml $TMP/cache > /dev/null; then
+	echo "$file: stale cache used"
+	exit 1
+    fi
+done
+
 echo "test OK"
@@ -19,6 +19,7 @@
 #include <linux/mm.h>
 #include <linux/page-flags.h>
 #include <linux/pagemap.h>
+#include <asm/uaccess.h>
 #else
 #include <vme_am.h>
 #define VME_A24_USER_DATA_SCT AM_A24_UDA
@@ -330,6 +331,115 @@ void wait_for_idle(SkelDrvrModuleContext *mcon, int maxdelay)
 	cprintf("vd80: wait_for_idle timed out after %d us\n", maxdelay);
 }
 
+/* =========================================================== */
+/* Stop the module and set up the read window for the last     */
+/* acquisition. The window is the same for every channel, so   */
+/* this only needs doing once per shot. On entry tpos holds    */
+/* the requested trigger position, on return tpos and samples  */
+/* hold the actual trigger position and samples to be read.    */
+
+static SkelUserReturn SetReadWindow(SkelDrvrClientContext *ccon,
+				    SkelDrvrModuleContext *mcon,
+				    U32                   *regs,
+				    int                    bsze,
+				    int                   *tpos,
+				    int                   *samples,
+				    int                   *ptsr) {
+
+int tval;
+int actpostrig = 0; /* The actual number of post trigger samples */
+int actpretrig = 0; /* The actual number of pre  trigger samples */
+int shotlength = 0; /* The total number od sample both pre and post trigger */
+int samplestrt = 0; /* Start position for reading */
+
+   /* Check that the requested post samples have been set */
+
+   tval = GetReg(regs,VD80_TCR2,mcon);
+   if (tval == 0) {
+      report_client(ccon, SkelDrvrDebugFlagWARNING, "No postsamples have been set:No data to read");
+      return SkelUserReturnFAILED;
+   }
+
+   /* Force the module into the idle state */
+
+   tval = VD80_COMMAND_SUBSTOP;
+   SetReg(regs,VD80_GCR1,tval,mcon);
+   tval = VD80_COMMAND_STOP;
+   SetReg(regs,VD80_GCR1,tval,mcon);
+   wait_for_idle(mcon, VD80_KLUDGE_DELAY);
+
+   /* actpostrig is the number of actual post trigger samples */
+   /* shotlength is the total number of pre and post trigger samples */
+
+   actpostrig = (GetReg(regs,VD80_TSR,mcon) << VD80_ACTPOSTSAMPLES_SHIFT) & VD80_ACTPOSTSAMPLES_MASK;
+   shotlength = (GetReg(regs,VD80_SSR,mcon) << VD80_SHOTLEN_SHIFT) & VD80_SHOTLEN_MASK;
+
+   *ptsr = GetReg(regs,VD80_PTSR,mcon); /* 100K ticks since start */
+
+   /* actpretrig is the actual number of pre trigger samples */
+
+   actpretrig =  shotlength - actpostrig;
+   if (*tpos > actpretrig) { /* User asked for too many pre trigger samples */
+      *tpos = actpretrig;    /* so give him what we have */
+   }
+
+   /* samplestrt is the position in buffer to start reading from */
+
+   samplestrt =  shotlength - (actpostrig + *tpos); /* This has to be posative from above */
+
+   /* samples is the total number we are going to read */
+
+   *samples = bsze;
+   if (samplestrt + bsze > shotlength) { /* User asked for too many post samples */
+      *samples = (shotlength - samplestrt);
+   }
+
+   /* Set up the readstart and readlength registers */
+
+   tval = samplestrt / 32;             /* Start Address divided by 32 */
+   tval = (tval << VD80_READSTART_SHIFT) & VD80_READSTART_MASK;
+   SetReg(regs,VD80_MCR1,tval,mcon);
+
+   *tpos = actpretrig - (tval*32); /* The real actual trigger position in buffer */
+
+   if (*samples < 32) tval = 0;                      /* Reads 32 samples */
+   else               tval = (*samples - 1) / 32;    /* Divide by 32 */
+   tval = (tval << VD80_READLEN_SHIFT) & VD80_READLEN_MASK;
+   SetReg(regs,VD80_MCR2,tval,mcon);
+
+   return SkelUserReturnOK;
+}
+
+/* =========================================================== */
+/* Read one channel through the read window set up above.      */
+/* Returns the number of samples transfered, or -1 on error.   */
+
+static int ReadChannelSamples(SkelDrvrModuleContext *mcon,
+			      U32                   *regs,
+			      int                    chn,
+			      short                 *buf,
+			      int                    samples) {
+
+Vd80SampleBuf sbuf;
+int tval;
+
+   /* Start the read for the given channel */
+
+   tval = VD80_COMMAND_READ | (((chn -1)<<VD80_OPERANT_SHIFT) & VD80_OPERANT_MASK);
+   SetReg(regs,VD80_GCR1,tval,mcon);
+
+   sbuf.Channel   = chn;
+   sbuf.SampleBuf = buf;
+   sbuf.Samples   = samples;
+
+   tval = Vd80CopyToUser(&sbuf, mcon);
+   if (tval < 0) {
+      report_module(mcon, SkelDrvrDebugFlagASSERTION, "SkelUserIoctl:Error reading channel %d", chn);
+      return -1;
+   }
+   return tval;
+}
+
 /**
  * @brief ioctl vector
  *
@@ -348,25 +458,15 @@ SkelUserReturn SkelUserIoctls(SkelDrvrClientContext *ccon,
 			      char                  *arg)
 {
 
-#ifdef __linux__
-struct vme_dma dma_desc;    /* Vme driver DMA structure */
-int    tcnt, psze;          /* Transfer count and short page size */
-#endif
-
 U32 *regs = NULL;   /* Mapped A24D32 address space for Vd80 module */
 int *lap  = NULL;   /* Long-Value pointer to argument */
 int lval, tval, bms;/* Long-Value from argument, temp-value, bit-mask */
 int i;
 
-int actpostrig = 0; /* The actual number of post trigger samples */
-int actpretrig = 0; /* The actual number of pre  trigger samples */
-int shotlength = 0; /* The total number od sample both pre and post trigger */
-int samplestrt = 0; /* Start position for reading */
-
-int remaining  = 0; /* Samples remaining to be transfered */
 int samples    = 0; /* Samples transfered so far */
 
-Vd80SampleBuf *sbuf = NULL; /* Users sample buffer */
+Vd80SampleBuf  *sbuf = NULL; /* Users sample buffer */
+Vd80SampleBufs *mbuf = NULL; /* Users sample buffers for many channels */
 Vd80Num num;                /* Enumeration over ioctl codes */
 
 Vd80DrvrAnalogTrig *atrg;   /* Analog trigger */
@@ -724,91 +824,63 @@ int lvalue;                 /* For when arg is NULL */
 	    return SkelUserReturnOK;
 	 }
 
-	 /* Check that the requested post samples have been set */
-
-	 tval = GetReg(regs,VD80_TCR2,mcon);
-	 if (tval == 0) {
-	    report_client(ccon, SkelDrvrDebugFlagWARNING, "No postsamples have been set:No data to read");
+	 if (SetReadWindow(ccon,mcon,regs,sbuf->BufSizeSamples,
+			   &sbuf->TrigPosition,&sbuf->Samples,&sbuf->PreTrigStat) != SkelUserReturnOK)
 	    return SkelUserReturnFAILED;
-	 }
 
-	 /* Force the module into the idle state */
+	 samples = ReadChannelSamples(mcon,regs,sbuf->Channel,sbuf->SampleBuf,sbuf->Samples);
+	 if (samples < 0) return SkelUserReturnFAILED;
 
-	 tval = VD80_COMMAND_SUBSTOP;
-	 SetReg(regs,VD80_GCR1,tval,mcon);
-	 tval = VD80_COMMAND_STOP;
-	 SetReg(regs,VD80_GCR1,tval,mcon);
-	 wait_for_idle(mcon, VD80_KLUDGE_DELAY);
-
-	 /* actpostrig is the number of actual post trigger samples */
-	 /* shotlength is the total number of pre and post trigger samples */
-
-	 actpostrig = (GetReg(regs,VD80_TSR,mcon) << VD80_ACTPOSTSAMPLES_SHIFT) & VD80_ACTPOSTSAMPLES_MASK;
-	 shotlength = (GetReg(regs,VD80_SSR,mcon) << VD80_SHOTLEN_SHIFT) & VD80_SHOTLEN_MASK;
+	 sbuf->Samples = samples; /* The actual number we successfully transfered */
+	 return SkelUserReturnOK;
+      break;
 
-	 sbuf->PreTrigStat = GetReg(regs,VD80_PTSR,mcon); /* 100K ticks since start */
+      case Vd80NumREAD_SAMPLES: /* => Vd80SampleBufs <= */
 
-	 /* actpretrig is the actual number of pre trigger samples */
+	 mbuf = (Vd80SampleBufs *) arg;
 
-	 actpretrig =  shotlength - actpostrig;
-	 if (sbuf->TrigPosition > actpretrig) { /* User asked for too many pre trigger samples */
-	    sbuf->TrigPosition = actpretrig;    /* so give him what we have */
+	 bms = mbuf->ChannelMask & ((1 << VD80_CHANNELS) -1);
+	 if (bms == 0) {
+	    report_client(ccon, SkelDrvrDebugFlagWARNING, "No channels in mask");
+	    return SkelUserReturnFAILED;
 	 }
-
-	 /* samplestrt is the position in buffer to start reading from */
-
-	 samplestrt =  shotlength - (actpostrig + sbuf->TrigPosition); /* This has to be posative from above */
-
-	 /* sbuf->samples is the total number we are going to read */
-
-	 sbuf->Samples = sbuf->BufSizeSamples;
-	 if (samplestrt + sbuf->BufSizeSamples > shotlength) { /* User asked for too many post samples */
-	    sbuf->Samples = (shotlength - samplestrt);
+	 for (i=0; i<VD80_CHANNELS; i++) {
+	    if ((bms & (1 << i)) && (mbuf->SampleBufs[i] == NULL)) {
+	       report_client(ccon, SkelDrvrDebugFlagWARNING, "Null sample buffer");
+	       return SkelUserReturnFAILED;
+	    }
 	 }
 
-	 /* Set up the readstart and readlength registers */
-
-	 tval = samplestrt / 32;             /* Start Address divided by 32 */
-	 tval = (tval << VD80_READSTART_SHIFT) & VD80_READSTART_MASK;
-	 SetReg(regs,VD80_MCR1,tval,mcon);
-
-	 sbuf->TrigPosition = actpretrig - (tval*32); /* The real actual trigger position in buffer */
-
-	 if (sbuf->Samples < 32) tval = 0;                          /* Reads 32 samples */
-	 else                    tval = (sbuf->Samples - 1) / 32;   /* Divide by 32 */
-	 tval = (tval << VD80_READLEN_SHIFT) & VD80_READLEN_MASK;
-	 SetReg(regs,VD80_MCR2,tval,mcon);
-
-	 /* Start the read for the given channel */
-
-	 tval = VD80_COMMAND_READ | (((sbuf->Channel -1)<<VD80_OPERANT_SHIFT) & VD80_OPERANT_MASK);
-	 SetReg(regs,VD80_GCR1,tval,mcon);
-
-	 remaining = sbuf->Samples; /* Samples remaining to be transfered by dma */
-	 samples = 0;               /* Samples transfered so far */
+	 if (mcon->StandardStatus & SkelDrvrStandardStatusEMULATION) {
+	    for (i=0; i<VD80_CHANNELS; i++) {
+	       if (bms & (1 << i)) {
+		  for (tval=0; tval<mbuf->BufSizeSamples; tval++)
+		     mbuf->SampleBufs[i][tval] = tval & 0xFF; /* Saw tooth */
+	       }
+	    }
+	    mbuf->Samples = mbuf->BufSizeSamples;
+	    return SkelUserReturnOK;
+	 }
 
-#ifdef __linux__
-	 psze = remaining;
+	 /* Stop the module and set up the read window once for all channels */
 
-	 while (remaining > 0) {
+	 if (SetReadWindow(ccon,mcon,regs,mbuf->BufSizeSamples,
+			   &mbuf->TrigPosition,&mbuf->Samples,&mbuf->PreTrigStat) != SkelUserReturnOK)
+	    return SkelUserReturnFAILED;
 
-	    if (remaining > psze) tcnt = psze;
-	    else                  tcnt = remaining;
+	 /* Then stream the channels back to back, each one only costs */
+	 /* a READ command followed by its DMA transfer.               */
 
-	    BuildDmaReadDesc(mcon,&(sbuf->SampleBuf[samples]),tcnt*sizeof(short),&dma_desc);
-	    if (vme_do_dma(&dma_desc)) {
-	       report_module(mcon, SkelDrvrDebugFlagASSERTION, "SkelUserIoctl:Error vme_do_dma");
-	       return SkelUserReturnFAILED;
+	 samples = mbuf->Samples;
+	 for (i=0; i<VD80_CHANNELS; i++) {
+	    if (bms & (1 << i)) {
+	       tval = ReadChannelSamples(mcon,regs,i+1,mbuf->SampleBufs[i],mbuf->Samples);
+	       if (tval < 0) return SkelUserReturnFAILED;
+	       if (tval < samples) samples = tval;
 	    }
-
-	    remaining -= tcnt;
-	    samples   += tcnt;
 	 }
-#else
-	 samples = Vd80CopyToUser(sbuf, mcon);  /* LynxOs ppc4 */
-#endif
 
-	 sbuf->Samples = samples; /* The actual number we successfully transfered */
+	 mbuf->Samples = samples; /* Transfered for every channel in the mask */
 	 return SkelUserReturnOK;
       break;
 
@@ -0,0 +1,49 @@
+/* ===================================================== */
+/* Unpack the VD80 memory FIFO into a sample buffer.     */
+/* Every 32-bit word read from VD80_MRWR holds two       */
+/* samples. This is shared by the driver PIO path and    */
+/* the test program benchmark, which provide their own   */
+/* VD80_FIFO_READ to access the (simulated) register.    */
+/* ===================================================== */
+
+#ifndef VD80_FIFO
+#define VD80_FIFO
+
+#ifndef VD80_FIFO_READ
+#define VD80_FIFO_READ(fifo) (*(fifo))
+#endif
+
+/* The high order sample comes first on Linux, second on LynxOs */
+
+#ifdef __linux__
+#define VD80_FIFO_HI 0
+#define VD80_FIFO_LO 1
+#else
+#define VD80_FIFO_HI 1
+#define VD80_FIFO_LO 0
+#endif
+
+/* ===================================================== */
+/* Read samples from the FIFO into buf without any delay */
+/* between accesses, the VME handshake paces the reads.  */
+/* Returns the number of samples stored.                 */
+
+static inline int Vd80FifoUnpack(short *buf, int samples, volatile unsigned int *fifo) {
+
+unsigned int tval;
+int i;
+
+   for (i=0; i+1<samples; i+=2) {
+      tval = VD80_FIFO_READ(fifo);
+      buf[i + VD80_FIFO_HI] = (short) ((tval >> 16) & 0xFFFF);
+      buf[i + VD80_FIFO_LO] = (short) ((tval >> 00) & 0xFFFF);
+   }
+   if (i < samples) {   /* Odd sample count, the last word is half used */
+      tval = VD80_FIFO_READ(fifo);
+      buf[i] = (short) ((tval >> (VD80_FIFO_HI ? 0 : 16)) & 0xFFFF);
+      i++;
+   }
+   return i;
+}
+
+#endif
@@ -44,5 +44,7 @@ static char *Vd80IoctlNames[] __attribute__((unused)) = {
    "GET_TRIGGER_CONFIG",
    "SET_TRIGGER_CONFIG",
 
+   "READ_SAMPLES",
+
    "LAST"                                    /* The last IOCTL */
  };
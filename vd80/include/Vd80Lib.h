@@ -362,6 +362,15 @@ Vd80Err vd80SimulateInterrupt(int fd, Vd80Intr *intr);
 
 Vd80Err vd80GetBuffer(int fd, int module, int channel, Vd80Buffer *buffer);
 
+/* ==================================================================== */
+/* Read the buffers of many channels of a module in one call. The array */
+/* buffers is indexed by channel-1, only the channels in the mask are   */
+/* read. All selected buffers must have the same size and post samples. */
+/* This is much faster than calling vd80GetBuffer for each channel as   */
+/* the module is stopped and set up only once for all of them.          */
+
+Vd80Err vd80GetBuffers(int fd, int module, Vd80Chn channels, Vd80Buffer *buffers);
+
 /* ==================================================================== */
 /* Set/Get the trigger analogue levels                                  */
 
@@ -53,6 +53,7 @@
 #define Vd80IoctlSET_POSTSAMPLES                        SKELU_IOW(Vd80NumSET_POSTSAMPLES,uint32_t)
 #define Vd80IoctlGET_TRIGGER_CONFIG                     SKELU_IOWR(Vd80NumGET_TRIGGER_CONFIG,Vd80DrvrTrigConfig)
 #define Vd80IoctlSET_TRIGGER_CONFIG                     SKELU_IOW(Vd80NumSET_TRIGGER_CONFIG,Vd80DrvrTrigConfig)
+#define Vd80IoctlREAD_SAMPLES                           SKELU_IOWR(Vd80NumREAD_SAMPLES,Vd80SampleBufs)
 #define Vd80IoctlLAST                                   SKELU_IO(Vd80NumLAST)
 
 #define SkelUserIoctlFIRST Vd80IoctlFIRST
@@ -7,6 +7,7 @@
 #define VD80DRVR
 
 #include <skeluser.h>
+#include <vd80hard.h>
 
 /* ============================================= */
 
@@ -28,6 +29,19 @@ typedef struct {
    short *SampleBuf;   /* RO Buffer where samples will be stored */
  } Vd80SampleBuf;
 
+/* Read many channels of the same acquisition in one call. The module */
+/* is stopped once and the read window is the same for all channels,  */
+/* so TrigPosition and Samples apply to every buffer in SampleBufs.   */
+
+typedef struct {
+   int ChannelMask;    /* WO Channels to read, bit 0 is channel 1 */
+   int BufSizeSamples; /* WO Size of each target buffer (In samples) */
+   int TrigPosition;   /* RW Position of trigger in the buffers */
+   int Samples;        /* RO On return: The number of samples read per channel */
+   int PreTrigStat;    /* RO Pre-Trigger Status Register */
+   short *SampleBufs[VD80_CHANNELS]; /* RO One buffer per channel in ChannelMask */
+ } Vd80SampleBufs;
+
 typedef enum {
    Vd80DrvrClockINTERNAL,
    Vd80DrvrClockEXTERNAL,
@@ -138,6 +152,8 @@ typedef enum {
    Vd80NumGET_TRIGGER_CONFIG,     /* Get Trig delay and min pre trig samples */
    Vd80NumSET_TRIGGER_CONFIG,     /* Set Trig delay and min pre trig samples */
 
+   Vd80NumREAD_SAMPLES,           /* Vd80SampleBufs, read many channels at once */
+
    Vd80NumLAST                                    /* The last IOCTL */
 
  } Vd80Num;
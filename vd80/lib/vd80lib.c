@@ -632,6 +632,49 @@ int tps;
    return Vd80ErrSUCCESS;
 }
 
+/* ==================================================================== */
+/* Transfer many channels by DMA to users buffers in one call           */
+
+Vd80Err vd80GetBuffers(int fd, int mod, Vd80Chn chns, Vd80Buffer *bufs) {
+
+Vd80SampleBufs mbuf;
+Vd80Buffer *buf = NULL;
+Vd80Err err;
+int i, tps;
+
+   if (chns == Vd80ChnNONE) return Vd80ErrCHANNEL;
+
+   err = SetModule(fd,mod);
+   if (err != Vd80ErrSUCCESS) return err;
+
+   bzero((void *) &mbuf, sizeof(mbuf));
+   for (i=0; i<Vd80CHANNELS; i++) {
+      if (chns & (1 << i)) {
+	 if (buf == NULL) buf = &bufs[i];
+	 mbuf.SampleBufs[i] = bufs[i].Addr;
+      }
+   }
+
+   tps = buf->BSze - buf->Post -1;
+   if (tps < 0) tps = 0;
+
+   mbuf.ChannelMask    = chns;
+   mbuf.BufSizeSamples = buf->BSze;
+   mbuf.TrigPosition   = tps;
+   mbuf.Samples        = 0;
+
+   if (ioctl(fd,Vd80IoctlREAD_SAMPLES,&mbuf) < 0) return Vd80ErrIO;
+
+   for (i=0; i<Vd80CHANNELS; i++) {
+      if (chns & (1 << i)) {
+	 bufs[i].Tpos = mbuf.TrigPosition;
+	 bufs[i].ASze = mbuf.Samples;
+	 bufs[i].Ptsr = mbuf.PreTrigStat;
+      }
+   }
+   return Vd80ErrSUCCESS;
+}
+
 /* ==================================================================== */
 /* Set the trigger analogue levels                                      */
 
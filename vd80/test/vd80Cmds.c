@@ -4,11 +4,13 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/ioctl.h>
+#include <time.h>
 
 #include <skeluser_ioctl.h>
 #include <extest.h>
 #include <vd80Drvr.h>
 #include <vd80hard.h>
+#include <vd80Fifo.h>
 
 
 void swab(const void *from, void *to, ssize_t n);
@@ -683,3 +685,77 @@ unsigned int i, val, arg;
    printf("\n%4d: EOF\n",i);
    return arg;
 }
+
+/* ========================================================== */
+/* Benchmark the FIFO readout. The PIO loop used by the       */
+/* driver is run against a simulated FIFO register to give    */
+/* its CPU cost, followed by the real READ_SAMPLE path on the */
+/* current channel which times the device access.             */
+
+static volatile unsigned int sim_fifo = 0x12345678;
+
+static double BenchTime() {
+struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return ts.tv_sec + ts.tv_nsec * 1.0E-9;
+}
+
+static void BenchReport(char *name, int samples, double secs) {
+
+   if (secs <= 0.0) secs = 1.0E-9;
+   printf("%-24s: %9d samples in %10.6f s = %8.3f MS/s\n",
+	  name, samples, secs, samples / secs / 1.0E6);
+}
+
+int FifoBench(struct cmd_desc *cmddint, struct atom *atoms) {
+
+unsigned int arg;
+int i, j, its;
+short *bbuf;
+double t0;
+Vd80SampleBuf bsbuf;
+
+   arg = cmddint->pa + 1;
+
+   if (atoms == (struct atom *) VERBOSE_HELP) {
+      printf("Iterations: default 100, each of %d samples\n",BUF_SHORTS);
+      return(arg);
+   }
+
+   its = 100;
+   if ((++atoms)->type == Numeric) {
+      its = atoms->val;
+      if (its <= 0) its = 1;
+   }
+
+   bbuf = (short *) malloc(BUF_SHORTS*sizeof(short));
+   if (bbuf == NULL) {
+      perror("Cant allocate buffer");
+      return arg;
+   }
+
+   t0 = BenchTime();
+   for (i=0; i<its; i++)
+      Vd80FifoUnpack(bbuf,BUF_SHORTS,&sim_fifo);
+   BenchReport("Simulated FIFO",its*BUF_SHORTS,BenchTime() - t0);
+
+   bsbuf.SampleBuf      = bbuf;
+   bsbuf.BufSizeSamples = BUF_SHORTS;
+   bsbuf.Channel        = chan + 1;
+
+   t0 = BenchTime();
+   for (i=0, j=0; i<its; i++) {
+      bsbuf.TrigPosition = 0;
+      bsbuf.Samples      = 0;
+      if (ioctl(_DNFD,Vd80IoctlREAD_SAMPLE,&bsbuf) < 0) {
+	 IErr("READ_SAMPLE",(unsigned int *)&bsbuf.Samples);
+	 break;
+      }
+      j += bsbuf.Samples;
+   }
+   if (i == its) BenchReport("READ_SAMPLE",j,BenchTime() - t0);
+
+   free(bbuf);
+   return arg;
+}
@@ -47,6 +47,8 @@ struct cmd_desc user_cmds[] = {
 
 	{ 1, CmdPOST,  "post",  "Get/Set post samples",      "samples", 1, GetSetPostSamples },
 
+	{ 1, CmdFBENCH, "fbench", "FIFO readout throughput",  "its",    1, FifoBench },
+
 	{ 0, } /* list termination */
 };
 //@}
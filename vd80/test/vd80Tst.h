@@ -42,6 +42,8 @@ int PrintSamp(struct cmd_desc *cmddint, struct atom *atoms);
 
 int GetSetPostSamples(struct cmd_desc *cmddint, struct atom *atoms);
 
+int FifoBench(struct cmd_desc *cmddint, struct atom *atoms);
+
 //@}
 
 /*! @name specific test commands
@@ -77,6 +79,7 @@ typedef enum _tag_cmd_id {
 
 	CmdPOST,
 	CmdBURST,
+	CmdFBENCH,
 
 	CmdLAST		//!< last one
 } cmd_id_t;
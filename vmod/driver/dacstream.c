@@ -0,0 +1,222 @@
+/**
+ * @file dacstream.c
+ *
+ * @brief timer-paced waveform streaming for the VMOD DAC mezzanines,
+ * linked into the vmod16a2 and vmod12a2 drivers like lunargs.c
+ *
+ * Copyright (c) 2011 CERN
+ *
+ * @section license_sec License
+ * Released under the GPL v2. (and only v2, not any later version)
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/time.h>
+#include <asm/io.h>
+#include <asm/uaccess.h>
+#include "dacstream.h"
+
+/* one sample per period, from the block being played */
+static enum hrtimer_restart dacstream_tick(struct hrtimer *timer)
+{
+	struct dacstream *s = container_of(timer, struct dacstream, timer);
+	unsigned long overruns;
+	int play, next;
+	u16 value;
+
+	spin_lock(&s->lock);
+	if (!s->running) {
+		spin_unlock(&s->lock);
+		return HRTIMER_NORESTART;
+	}
+
+	play = s->play;
+	if (s->len[play] == 0) {
+		/* nothing queued, the DAC holds its last value */
+		s->underruns++;
+	} else {
+		value = s->buf[play][s->pos++];
+		iowrite16be(value, s->data);
+		if (s->load)
+			iowrite16be(value, s->load);
+		s->played++;
+
+		if (s->pos == s->len[play]) {
+			s->pos = 0;
+			next = play ^ 1;
+			if (s->len[next] || !(s->flags & VMOD_DAC_STREAM_LOOP)) {
+				/* hand the block back to write() */
+				s->len[play] = 0;
+				s->play = next;
+				wake_up_interruptible(&s->wait);
+			}
+		}
+	}
+
+	overruns = hrtimer_forward(timer, ktime_get(), s->period);
+	if (overruns > 1)
+		s->missed += overruns - 1;
+	spin_unlock(&s->lock);
+	return HRTIMER_RESTART;
+}
+
+void dacstream_init(struct dacstream *s)
+{
+	memset(s, 0, sizeof(*s));
+	init_MUTEX(&s->sem);
+	spin_lock_init(&s->lock);
+	init_waitqueue_head(&s->wait);
+	hrtimer_init(&s->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	s->timer.function = dacstream_tick;
+}
+
+/* with s->sem held */
+static void stop(struct dacstream *s)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s->lock, flags);
+	s->running = 0;
+	spin_unlock_irqrestore(&s->lock, flags);
+	hrtimer_cancel(&s->timer);
+
+	vfree(s->buf[0]);
+	vfree(s->buf[1]);
+	s->buf[0] = s->buf[1] = NULL;
+	s->len[0] = s->len[1] = 0;
+	s->timer_started = 0;
+	s->owner = NULL;
+	wake_up_interruptible(&s->wait);
+}
+
+int dacstream_start(struct dacstream *s, struct file *owner,
+		struct vmod_dac_stream *arg,
+		void __iomem *data, void __iomem *load)
+{
+	if (arg->period_us < VMOD_DAC_STREAM_MIN_PERIOD ||
+	    arg->block_size == 0 || arg->block_size > VMOD_DAC_STREAM_MAX_BLOCK)
+		return -EINVAL;
+
+	if (down_interruptible(&s->sem))
+		return -ERESTARTSYS;
+	if (s->running) {
+		up(&s->sem);
+		return -EBUSY;
+	}
+
+	s->buf[0] = vmalloc(arg->block_size * sizeof(u16));
+	s->buf[1] = vmalloc(arg->block_size * sizeof(u16));
+	if (s->buf[0] == NULL || s->buf[1] == NULL) {
+		vfree(s->buf[0]);
+		vfree(s->buf[1]);
+		s->buf[0] = s->buf[1] = NULL;
+		up(&s->sem);
+		return -ENOMEM;
+	}
+
+	s->owner      = owner;
+	s->data       = data;
+	s->load       = load;
+	s->flags      = arg->flags;
+	s->block_size = arg->block_size;
+	s->period     = ktime_set(arg->period_us / USEC_PER_SEC,
+				(arg->period_us % USEC_PER_SEC) * NSEC_PER_USEC);
+	s->len[0] = s->len[1] = 0;
+	s->play = s->fill = 0;
+	s->pos  = 0;
+	s->played = s->underruns = s->missed = 0;
+	s->timer_started = 0;
+	s->running = 1;
+	up(&s->sem);
+	return 0;
+}
+
+void dacstream_stop(struct dacstream *s)
+{
+	down(&s->sem);
+	if (s->running)
+		stop(s);
+	up(&s->sem);
+}
+
+/* a stream does not outlive the file that started it */
+void dacstream_release(struct dacstream *s, struct file *filp)
+{
+	down(&s->sem);
+	if (s->running && s->owner == filp)
+		stop(s);
+	up(&s->sem);
+}
+
+/*
+ * Queue up to one block of samples. The playback starts with the first
+ * block, so that the stream can be primed before the first tick.
+ */
+ssize_t dacstream_write(struct dacstream *s, struct file *filp,
+		const char __user *buf, size_t count)
+{
+	unsigned long flags;
+	unsigned int n;
+	int fill, err;
+
+	n = count / sizeof(u16);
+	if (n == 0)
+		return -EINVAL;
+
+	for (;;) {
+		if (down_interruptible(&s->sem))
+			return -ERESTARTSYS;
+		if (!s->running) {
+			up(&s->sem);
+			return -EINVAL;
+		}
+		fill = s->fill;
+		if (s->len[fill] == 0)
+			break;
+		up(&s->sem);
+
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(s->wait,
+				!s->running || s->len[s->fill] == 0);
+		if (err)
+			return -ERESTARTSYS;
+	}
+
+	/* the timer does not look at a block while its len is 0 */
+	if (n > s->block_size)
+		n = s->block_size;
+	if (copy_from_user(s->buf[fill], buf, n * sizeof(u16))) {
+		up(&s->sem);
+		return -EFAULT;
+	}
+
+	spin_lock_irqsave(&s->lock, flags);
+	s->len[fill] = n;
+	s->fill = fill ^ 1;
+	spin_unlock_irqrestore(&s->lock, flags);
+
+	if (!s->timer_started) {
+		s->timer_started = 1;
+		hrtimer_start(&s->timer, s->period, HRTIMER_MODE_REL);
+	}
+	up(&s->sem);
+	return n * sizeof(u16);
+}
+
+void dacstream_status(struct dacstream *s, struct vmod_dac_stream_status *st)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s->lock, flags);
+	st->running   = s->running;
+	st->queued    = s->len[0] + s->len[1];
+	if (s->len[s->play])
+		st->queued -= s->pos;
+	st->played    = s->played;
+	st->underruns = s->underruns;
+	st->missed    = s->missed;
+	spin_unlock_irqrestore(&s->lock, flags);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file dacstream.h
+ *
+ * @brief timer-paced waveform streaming for the VMOD DAC mezzanines
+ *
+ * User space queues blocks of samples with write() after setting the
+ * channel and the playback period with the driver's STREAM ioctl. An
+ * hrtimer writes one sample per period to the DAC channel. Two blocks
+ * are buffered, so that one is refilled while the other plays; a tick
+ * with no sample to play holds the last value and counts an underrun.
+ *
+ * Copyright (c) 2011 CERN
+ *
+ * @section license_sec License
+ * Released under the GPL v2. (and only v2, not any later version)
+ */
+
+#ifndef _DACSTREAM_H_
+#define _DACSTREAM_H_
+
+#include <linux/types.h>
+
+/** replay the last block while no new one is queued */
+#define VMOD_DAC_STREAM_LOOP	0x1
+
+/** shortest period, in microseconds: each tick writes the DAC from hard IRQ */
+#define VMOD_DAC_STREAM_MIN_PERIOD	50
+
+/** largest block, in samples */
+#define VMOD_DAC_STREAM_MAX_BLOCK	(1<<16)
+
+/** @brief ioctl arg for IOCSTREAM */
+struct vmod_dac_stream {
+	unsigned int	channel;	/**< output channel */
+	unsigned int	period_us;	/**< playback period in microseconds, at least VMOD_DAC_STREAM_MIN_PERIOD */
+	unsigned int	block_size;	/**< samples per block, at most VMOD_DAC_STREAM_MAX_BLOCK */
+	unsigned int	flags;		/**< VMOD_DAC_STREAM_LOOP */
+};
+
+/** @brief ioctl arg for IOCSTREAMSTATUS */
+struct vmod_dac_stream_status {
+	unsigned int	running;	/**< 1 between IOCSTREAM and IOCSTOP */
+	unsigned int	queued;		/**< samples queued and not yet played */
+	unsigned long	played;		/**< samples written to the DAC */
+	unsigned long	underruns;	/**< ticks with no sample to play */
+	unsigned long	missed;		/**< ticks the timer ran too late for */
+};
+
+#ifdef __KERNEL__
+
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/semaphore.h>
+#include <linux/wait.h>
+#include <linux/fs.h>
+
+/**
+ * @brief streaming state of a DAC module
+ *
+ * The timer only reads a block whose len is not zero and write() only
+ * fills a block whose len is zero, len changes under the lock.
+ */
+struct dacstream {
+	struct semaphore	sem;		/**< locks start/stop against write() */
+	spinlock_t		lock;		/**< blocks and counters, taken by the timer */
+	struct hrtimer		timer;
+	ktime_t			period;
+	wait_queue_head_t	wait;		/**< writers wait for a free block */
+	struct file		*owner;		/**< file that started the stream */
+
+	void __iomem		*data;		/**< DAC input register */
+	void __iomem		*load;		/**< DAC load register, NULL if none */
+
+	unsigned int		flags;
+	unsigned int		block_size;
+	u16			*buf[2];
+	unsigned int		len[2];		/**< samples in the block, 0 if free */
+	int			play;		/**< block the timer plays */
+	unsigned int		pos;		/**< next sample in it */
+	int			fill;		/**< block write() fills next */
+	int			running;
+	int			timer_started;	/**< on the first queued block */
+
+	unsigned long		played;
+	unsigned long		underruns;
+	unsigned long		missed;
+};
+
+extern void dacstream_init(struct dacstream *s);
+extern int dacstream_start(struct dacstream *s, struct file *owner,
+		struct vmod_dac_stream *arg,
+		void __iomem *data, void __iomem *load);
+extern void dacstream_stop(struct dacstream *s);
+extern void dacstream_release(struct dacstream *s, struct file *filp);
+extern ssize_t dacstream_write(struct dacstream *s, struct file *filp,
+		const char __user *buf, size_t count);
+extern void dacstream_status(struct dacstream *s,
+		struct vmod_dac_stream_status *st);
+
+#endif /* __KERNEL__ */
+#endif /* _DACSTREAM_H_ */
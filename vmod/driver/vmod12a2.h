@@ -1,6 +1,8 @@
 #ifndef _VMOD12A2_H_
 #define _VMOD12A2_H_
 
+#include "dacstream.h"
+
 
 
 /* VMOD 12A2 channels */
@@ -22,6 +24,9 @@
 #define	VMOD12A2_IOC_MAGIC	'J'
 #define VMOD12A2_IOCSELECT 	_IOW(VMOD12A2_IOC_MAGIC, 1, struct vmod12a2_select)
 #define	VMOD12A2_IOCPUT		_IOW(VMOD12A2_IOC_MAGIC, 2, int)
+#define	VMOD12A2_IOCSTREAM	_IOW(VMOD12A2_IOC_MAGIC, 3, struct vmod_dac_stream)
+#define	VMOD12A2_IOCSTOP	_IO(VMOD12A2_IOC_MAGIC, 4)
+#define	VMOD12A2_IOCSTREAMSTATUS	_IOR(VMOD12A2_IOC_MAGIC, 5, struct vmod_dac_stream_status)
 
 struct vmod12a2_output {
 	int	channel;
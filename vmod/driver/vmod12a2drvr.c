@@ -20,6 +20,13 @@ static dev_t		devno;
 /* module config tables */
 static struct vmod_devices	config;
 
+/* per-module state, geographical info and waveform stream */
+struct vmod12a2_dev {
+	struct vmod_dev		*config;
+	struct dacstream	stream;
+};
+static struct vmod12a2_dev	device_list[VMOD12A2_MAX_MODULES];
+
 static int vmod12a2_offsets[VMOD_12A2_CHANNELS] = {
 	VMOD_12A2_CHANNEL0,
 	VMOD_12A2_CHANNEL1,
@@ -38,7 +45,7 @@ static int vmod12a2_open(struct inode *ino, struct file *filp)
 		printk(KERN_ERR PFX "could not open, bad lun %d\n", lun);
 		return -ENODEV;
 	}
-	filp->private_data = &config.module[idx];
+	filp->private_data = &device_list[idx];
 	return 0;
 }
 
@@ -46,13 +53,16 @@ static int vmod12a2_open(struct inode *ino, struct file *filp)
  *  @brief release the struct vmod12a2_select struct */
 static int vmod12a2_release(struct inode *ino, struct file *filp)
 {
+	struct vmod12a2_dev *dev = filp->private_data;
+
+	dacstream_release(&dev->stream, filp);
 	return 0;
 }
 
 static int do_iocput(struct file *fp, struct vmod12a2_output *argp)
 {
 	/* get lun, channel and value to output */
-	struct vmod_dev	*dev = fp->private_data;
+	struct vmod_dev	*dev = ((struct vmod12a2_dev *)fp->private_data)->config;
 	unsigned int		channel = argp->channel;
 	u16			value = argp->value;
 	void __iomem		*addr;
@@ -69,13 +79,39 @@ static int do_iocput(struct file *fp, struct vmod12a2_output *argp)
 	return 0;
 }
 
+static int do_iocstream(struct file *fp, struct vmod_dac_stream *argp)
+{
+	struct vmod12a2_dev	*dev = fp->private_data;
+	void __iomem		*addr;
+
+	if (argp->channel != 0 && argp->channel != 1) {
+		printk(KERN_ERR PFX "invalid channel %d in ioctl\n", argp->channel);
+		return -EINVAL;
+	}
+
+	/* the 12A2 converts on the write, there is no load register */
+	addr = (void __iomem *)(dev->config->address + vmod12a2_offsets[argp->channel]);
+	return dacstream_start(&dev->stream, fp, argp, addr, NULL);
+}
+
+static ssize_t vmod12a2_write(struct file *fp, const char __user *buf,
+			size_t count, loff_t *offp)
+{
+	struct vmod12a2_dev *dev = fp->private_data;
+
+	return dacstream_write(&dev->stream, fp, buf, count);
+}
+
 /* @brief file operations for this driver */
 static int vmod12a2_ioctl(struct inode *inode, 
 			struct file *fp, 
 			unsigned op, 
 			unsigned long arg)
 {
+	struct vmod12a2_dev	*dev = fp->private_data;
 	struct vmod12a2_output	myarg, *myargp = &myarg;
+	struct vmod_dac_stream	stream;
+	struct vmod_dac_stream_status	status;
 
 	switch (op) {
 
@@ -85,6 +121,24 @@ static int vmod12a2_ioctl(struct inode *inode,
 		return do_iocput(fp, myargp);
 		break;
 
+	case VMOD12A2_IOCSTREAM:
+		if (copy_from_user(&stream, (const void __user *)arg, sizeof(stream)) != 0)
+			return -EINVAL;
+		return do_iocstream(fp, &stream);
+		break;
+
+	case VMOD12A2_IOCSTOP:
+		dacstream_stop(&dev->stream);
+		return 0;
+		break;
+
+	case VMOD12A2_IOCSTREAMSTATUS:
+		dacstream_status(&dev->stream, &status);
+		if (copy_to_user((void __user *)arg, &status, sizeof(status)) != 0)
+			return -EINVAL;
+		return 0;
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -96,12 +150,13 @@ static struct file_operations vmod12a2_fops = {
 	.ioctl =    vmod12a2_ioctl,
 	.open =     vmod12a2_open,
 	.release =  vmod12a2_release,
+	.write =    vmod12a2_write,
 };
 
 /* module initialization and cleanup */
 static int __init vmod12a2_init(void)
 {
-	int err;
+	int i, err;
 
 	printk(KERN_INFO PFX "reading parameters\n");
 
@@ -111,6 +166,10 @@ static int __init vmod12a2_init(void)
 	printk(KERN_INFO PFX 
 		"initialized driver for %d (max %d) cards\n",
 		config.num_modules, VMOD_MAX_BOARDS);
+	for (i = 0; i < config.num_modules; i++) {
+		device_list[i].config = &config.module[i];
+		dacstream_init(&device_list[i].stream);
+	}
 
 	err = alloc_chrdev_region(&devno, 0, VMOD12A2_MAX_MODULES, DRIVER_NAME);
 	if (err != 0) 
@@ -135,8 +194,12 @@ fail_chrdev:	return -1;
 
 static void __exit vmod12a2_exit(void)
 {
+	int i;
+
 	cdev_del(&cdev);
 	unregister_chrdev_region(devno, VMOD12A2_MAX_MODULES);
+	for (i = 0; i < config.num_modules; i++)
+		dacstream_stop(&device_list[i].stream);
 }
 
 
@@ -20,6 +20,10 @@
 
 #include <linux/types.h>
 #include <linux/ioctl.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <asm/atomic.h>
 #include "vmod12e16drvr.h"
 
 /* VMOD 12E16 registers */
@@ -36,6 +40,10 @@
 #define VMOD_12E16_CONVERSION_TIME	2	/* two microseconds, up to 30 */
 #define VMOD_12E16_MAX_CONVERSION_TIME	30	
 
+/* worst case of one conversion: the full wait plus the delay after the read */
+#define VMOD_12E16_MAX_CONVERSION_COST	(VMOD_12E16_MAX_CONVERSION_TIME + \
+					 VMOD_12E16_CONVERSION_TIME)
+
 
 /**
  * @brief map of vmod12e16 register layout
@@ -57,11 +65,36 @@ struct vmod12e16_registers {
 /**
  * @brief vmod12e16 device information consists of ordinary vmod
  * geographical info plus a semaphore for mutexing during conversion
- * cycle
+ * cycle, and the state of a streaming scan
+ *
+ * A scan is paced by an hrtimer that queues the conversions of one scan
+ * on the device workqueue, the conversions poll the ready bit as the
+ * single conversion ioctl does and must not run in interrupt context.
  */
 struct vmod12e16_dev {
 	struct vmod_dev		*config;	/**< vmod lunargs */
 	struct semaphore	sem;		/**< locks conversion */
+
+	struct semaphore	scan_sem;	/**< locks scan start/stop */
+	struct vmod12e16_scan	scan;		/**< scan in progress */
+	struct file		*scan_owner;	/**< file that started it */
+	struct hrtimer		timer;		/**< scan cadence */
+	ktime_t			period;
+	struct workqueue_struct	*wq;
+	struct work_struct	work;		/**< runs one scan */
+	atomic_t		scan_busy;	/**< a scan is queued or running */
+	int			running;	/**< 1 while a scan is in progress */
+	u32			overruns;	/**< samples dropped on a full ring */
+	u32			missed;		/**< scan periods missed */
+	u32			scans;		/**< scans completed */
+	u32			timeouts;	/**< conversions that timed out */
+
+	struct vmod12e16_ring	*ring;		/**< vmalloc_user()ed, mmap()able */
+	unsigned int		ring_size;	/**< samples, the ring header copy is not trusted */
+	u32			ring_head;	/**< samples produced, published in ring->head */
+	unsigned long		ring_bytes;
+	struct semaphore	read_sem;	/**< serializes readers */
+	wait_queue_head_t	wait;		/**< readers wait for samples */
 };
 
 #endif /* _VMOD12E16_H_ */
@@ -20,6 +20,11 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/semaphore.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/poll.h>
+#include <linux/time.h>
 #include "modulbus_register.h"
 #include "lunargs.h"
 #include "vmod12e16.h"
@@ -36,6 +41,13 @@ static struct cdev	cdev;
 static struct vmod_devices	config;
 static struct vmod12e16_dev	device_list[VMOD12E16_MAX_MODULES];
 
+/** scan ring size in samples, rounded up to a power of two */
+static int ring_size = 4096;
+module_param(ring_size, int, S_IRUGO);
+MODULE_PARM_DESC(ring_size, "Scan ring size in samples (default 4096)");
+
+static void scan_stop(struct vmod12e16_dev *dev);
+
 static int vmod12e16_open(struct inode *ino, struct file  *filp)
 {
 	unsigned int lun = iminor(ino);
@@ -51,9 +63,40 @@ static int vmod12e16_open(struct inode *ino, struct file  *filp)
 
 static int vmod12e16_release(struct inode *ino, struct file  *filp)
 {
+	struct vmod12e16_dev *dev = filp->private_data;
+
+	/* a scan does not outlive the file that started it */
+	down(&dev->scan_sem);
+	if (dev->scan_owner == filp)
+		scan_stop(dev);
+	up(&dev->scan_sem);
 	return 0;
 }
 
+/* start a conversion and poll for its end, with dev->sem held */
+static int convert(struct vmod12e16_registers __iomem *regs,
+			int channel, int ampli, int *data)
+{
+	int us_elapsed;
+
+	iowrite16be((ampli<<4) | channel, &regs->control);
+
+	/* wait at most the manufacturer-supplied max time */
+	us_elapsed = 0;
+	while (us_elapsed < VMOD_12E16_MAX_CONVERSION_TIME) {
+		udelay(VMOD_12E16_CONVERSION_TIME);
+		if ((ioread16be(&regs->ready) & VMOD_12E16_RDY_BIT) == 0) {
+			*data = ioread16be(&regs->data) & VMOD_12E16_ADC_DATA_MASK;
+			udelay(VMOD_12E16_CONVERSION_TIME);
+			return 0;
+		}
+		us_elapsed += VMOD_12E16_CONVERSION_TIME;
+	}
+
+	/* timeout */
+	return -ETIME;
+}
+
 static int do_conversion(struct file *filp,
 			struct vmod12e16_conversion *conversion)
 {
@@ -63,7 +106,7 @@ static int do_conversion(struct file *filp,
 
 	int channel = conversion->channel;
 	int ampli   = conversion->amplification;
-	int us_elapsed;
+	int err;
 
 	if (down_interruptible(&dev->sem))
 		return -ERESTARTSYS;
@@ -76,24 +119,234 @@ static int do_conversion(struct file *filp,
 		up(&dev->sem);
 		return -EINVAL;
 	}
-	iowrite16be((ampli<<4) | channel, &regs->control);
+	err = convert(regs, channel, ampli, &conversion->data);
+	up(&dev->sem);
+	return err;
+}
 
-	/* wait at most the manufacturer-supplied max time */
-	us_elapsed = 0;
-	while (us_elapsed < VMOD_12E16_MAX_CONVERSION_TIME) {
-		udelay(VMOD_12E16_CONVERSION_TIME);
-		if ((ioread16be(&regs->ready) & VMOD_12E16_RDY_BIT) == 0) {
-			conversion->data = ioread16be(&regs->data) & VMOD_12E16_ADC_DATA_MASK;
-			udelay(VMOD_12E16_CONVERSION_TIME);
-			up(&dev->sem);
+static inline struct vmod12e16_sample *ring_data(struct vmod12e16_ring *ring)
+{
+	return (struct vmod12e16_sample *)((char *)ring + VMOD12E16_RING_DATA);
+}
+
+/*
+ * single producer, the scan work; the ring header may be written by an
+ * mmap() reader, so the head is kept in dev->ring_head and only
+ * published in the header, and only dev->ring_size indexes the ring
+ */
+static void ring_put(struct vmod12e16_dev *dev, struct vmod12e16_sample *sample)
+{
+	struct vmod12e16_ring *ring = dev->ring;
+	u32 head = dev->ring_head;
+
+	if (head - ACCESS_ONCE(ring->tail) >= dev->ring_size) {
+		dev->overruns++;
+		return;
+	}
+	smp_mb();
+	ring_data(ring)[head & (dev->ring_size - 1)] = *sample;
+	smp_wmb();
+	dev->ring_head = head + 1;
+	ring->head = head + 1;
+}
+
+/* one scan of the channel list, from the device workqueue */
+static void scan_work(struct work_struct *work)
+{
+	struct vmod12e16_dev *dev =
+		container_of(work, struct vmod12e16_dev, work);
+	struct vmod12e16_registers __iomem *regs = 
+		(struct vmod12e16_registers __iomem *)dev->config->address;
+	struct vmod12e16_sample sample;
+	struct timespec ts;
+	int i, data, err;
+
+	if (!dev->running)
+		goto out;
+
+	down(&dev->sem);
+	iowrite16be(VMOD_12E16_ADC_INTERRUPT_MASK, &regs->interrupt);
+	for (i = 0; i < dev->scan.nchans; i++) {
+		data = 0;
+		err = convert(regs, dev->scan.channels[i],
+				dev->scan.amplification, &data);
+		getnstimeofday(&ts);
+		sample.sec     = ts.tv_sec;
+		sample.nsec    = ts.tv_nsec;
+		sample.scan    = dev->scans;
+		sample.channel = dev->scan.channels[i];
+		sample.timeout = (err != 0);
+		sample.data    = data;
+		sample.unused  = 0;
+		if (err)
+			dev->timeouts++;
+		ring_put(dev, &sample);
+	}
+	up(&dev->sem);
+
+	dev->scans++;
+	if (dev->scan.nscans && dev->scans >= dev->scan.nscans)
+		dev->running = 0;
+	wake_up_interruptible(&dev->wait);
+out:
+	atomic_set(&dev->scan_busy, 0);
+}
+
+/*
+ * scan cadence; scan_busy is set here and cleared when the work is done,
+ * so a scan still queued or running when the next one is due is missed
+ */
+static enum hrtimer_restart scan_tick(struct hrtimer *timer)
+{
+	struct vmod12e16_dev *dev =
+		container_of(timer, struct vmod12e16_dev, timer);
+	unsigned long overruns;
+
+	if (!dev->running)
+		return HRTIMER_NORESTART;
+	if (atomic_xchg(&dev->scan_busy, 1))
+		dev->missed++;
+	else
+		queue_work(dev->wq, &dev->work);
+	overruns = hrtimer_forward(timer, ktime_get(), dev->period);
+	if (overruns > 1)
+		dev->missed += overruns - 1;
+	return HRTIMER_RESTART;
+}
+
+/* with dev->scan_sem held */
+static void scan_stop(struct vmod12e16_dev *dev)
+{
+	dev->running = 0;
+	hrtimer_cancel(&dev->timer);
+	cancel_work_sync(&dev->work);
+	atomic_set(&dev->scan_busy, 0);
+	dev->scan_owner = NULL;
+	wake_up_interruptible(&dev->wait);
+}
+
+static int do_scan(struct file *filp, struct vmod12e16_scan *scan)
+{
+	struct vmod12e16_dev *dev = filp->private_data;
+	struct vmod12e16_ring *ring = dev->ring;
+	int i;
+
+	if (scan->amplification & ~((1<<2)-1))
+		return -EINVAL;
+	if (scan->nchans < 1 || scan->nchans > VMOD_12E16_CHANNELS)
+		return -EINVAL;
+	for (i = 0; i < scan->nchans; i++)
+		if (scan->channels[i] >= VMOD_12E16_CHANNELS)
+			return -EINVAL;
+	/* a scan must fit in its period even with the slowest conversions */
+	if (scan->period_us < scan->nchans * VMOD_12E16_MAX_CONVERSION_COST)
+		return -EINVAL;
+
+	if (down_interruptible(&dev->scan_sem))
+		return -ERESTARTSYS;
+	if (dev->running) {
+		up(&dev->scan_sem);
+		return -EBUSY;
+	}
+	/* a finished scan leaves the timer and work to be collected */
+	scan_stop(dev);
+
+	dev->scan = *scan;
+	dev->scan_owner = filp;
+	dev->period = ktime_set(scan->period_us / USEC_PER_SEC,
+				(scan->period_us % USEC_PER_SEC) * NSEC_PER_USEC);
+	ring->size     = dev->ring_size;
+	ring->head     = 0;
+	ring->tail     = 0;
+	dev->ring_head = 0;
+	dev->overruns  = 0;
+	dev->missed    = 0;
+	dev->scans     = 0;
+	dev->timeouts  = 0;
+	smp_wmb();
+	dev->running   = 1;
+	hrtimer_start(&dev->timer, dev->period, HRTIMER_MODE_REL);
+	up(&dev->scan_sem);
+	return 0;
+}
+
+static ssize_t vmod12e16_read(struct file *filp, char __user *buf,
+			size_t count, loff_t *offp)
+{
+	struct vmod12e16_dev *dev = filp->private_data;
+	struct vmod12e16_ring *ring = dev->ring;
+	size_t want = count / sizeof(struct vmod12e16_sample);
+	size_t avail, first, slot;
+	u32 head, tail;
+	int err;
+
+	if (want == 0)
+		return -EINVAL;
+	if (down_interruptible(&dev->read_sem))
+		return -ERESTARTSYS;
+
+	while ((head = ACCESS_ONCE(dev->ring_head)) == ring->tail) {
+		if (!dev->running) {
+			up(&dev->read_sem);
 			return 0;
 		}
-		us_elapsed += VMOD_12E16_CONVERSION_TIME;
+		if (filp->f_flags & O_NONBLOCK) {
+			up(&dev->read_sem);
+			return -EAGAIN;
+		}
+		err = wait_event_interruptible(dev->wait,
+				dev->ring_head != ring->tail || !dev->running);
+		if (err) {
+			up(&dev->read_sem);
+			return -ERESTARTSYS;
+		}
 	}
+	smp_rmb();
 
-	/* timeout */
-	up(&dev->sem);
-	return -ETIME;
+	tail  = ring->tail;
+	avail = min_t(size_t, min_t(u32, head - tail, dev->ring_size), want);
+	slot  = tail & (dev->ring_size - 1);
+	first = min_t(size_t, avail, dev->ring_size - slot);
+	if (copy_to_user(buf, &ring_data(ring)[slot],
+			first * sizeof(struct vmod12e16_sample)))
+		goto fault;
+	if (avail > first && copy_to_user(buf + first * sizeof(struct vmod12e16_sample),
+			ring_data(ring), (avail - first) * sizeof(struct vmod12e16_sample)))
+		goto fault;
+
+	smp_mb();
+	ring->tail = tail + avail;
+	up(&dev->read_sem);
+	return avail * sizeof(struct vmod12e16_sample);
+
+fault:
+	up(&dev->read_sem);
+	return -EFAULT;
+}
+
+static unsigned int vmod12e16_poll(struct file *filp, poll_table *wait)
+{
+	struct vmod12e16_dev *dev = filp->private_data;
+	struct vmod12e16_ring *ring = dev->ring;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &dev->wait, wait);
+	if (dev->ring_head != ring->tail)
+		mask |= POLLIN | POLLRDNORM;
+	else if (!dev->running)
+		mask |= POLLHUP;
+	return mask;
+}
+
+/* the ring header and samples, the reader advances tail itself */
+static int vmod12e16_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct vmod12e16_dev *dev = filp->private_data;
+
+	if (vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start > PAGE_ALIGN(dev->ring_bytes))
+		return -EINVAL;
+	return remap_vmalloc_range(vma, dev->ring, 0);
 }
 
 static int vmod12e16_ioctl(struct inode *ino,
@@ -101,7 +354,10 @@ static int vmod12e16_ioctl(struct inode *ino,
 		    unsigned int cmd,
 		    unsigned long arg)
 {
+	struct vmod12e16_dev *dev = filp->private_data;
 	struct vmod12e16_conversion cnv, *cnvp = &cnv;
+	struct vmod12e16_scan scan;
+	struct vmod12e16_scan_status status;
 	int err;
 
 	switch (cmd) {
@@ -117,6 +373,34 @@ static int vmod12e16_ioctl(struct inode *ino,
 		return 0;
 		break;
 
+	case VMOD12E16_IOCSCAN:
+		if (copy_from_user(&scan, (const void __user*)arg, sizeof(scan)))
+			return -EINVAL;
+		return do_scan(filp, &scan);
+		break;
+
+	case VMOD12E16_IOCSTOP:
+		if (down_interruptible(&dev->scan_sem))
+			return -ERESTARTSYS;
+		scan_stop(dev);
+		up(&dev->scan_sem);
+		return 0;
+		break;
+
+	case VMOD12E16_IOCSCANSTATUS:
+		status.size     = dev->ring_size;
+		status.head     = dev->ring_head;
+		status.tail     = dev->ring->tail;
+		status.running  = dev->running;
+		status.overruns = dev->overruns;
+		status.missed   = dev->missed;
+		status.scans    = dev->scans;
+		status.timeouts = dev->timeouts;
+		if (copy_to_user((void __user *)arg, &status, sizeof(status)))
+			return -EINVAL;
+		return 0;
+		break;
+
 	default:
 		return -ENOTTY;
 		break;
@@ -129,12 +413,52 @@ static struct file_operations fops = {
 	.ioctl =    vmod12e16_ioctl,
 	.open =     vmod12e16_open,
 	.release =  vmod12e16_release,
+	.read =     vmod12e16_read,
+	.poll =     vmod12e16_poll,
+	.mmap =     vmod12e16_mmap,
 };
 
+/* scan state of a device, ring and workqueue */
+static int scan_init(struct vmod12e16_dev *dev, unsigned int size)
+{
+	dev->ring_bytes = VMOD12E16_RING_DATA + size * sizeof(struct vmod12e16_sample);
+	dev->ring = vmalloc_user(dev->ring_bytes);
+	if (dev->ring == NULL)
+		return -ENOMEM;
+	dev->ring_size = size;
+	dev->ring->size = size;
+
+	dev->wq = create_singlethread_workqueue(DRIVER_NAME);
+	if (dev->wq == NULL) {
+		vfree(dev->ring);
+		dev->ring = NULL;
+		return -ENOMEM;
+	}
+	INIT_WORK(&dev->work, scan_work);
+	atomic_set(&dev->scan_busy, 0);
+	hrtimer_init(&dev->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->timer.function = scan_tick;
+	init_MUTEX(&dev->scan_sem);
+	init_MUTEX(&dev->read_sem);
+	init_waitqueue_head(&dev->wait);
+	return 0;
+}
+
+static void scan_exit(struct vmod12e16_dev *dev)
+{
+	if (dev->ring == NULL)
+		return;
+	scan_stop(dev);
+	destroy_workqueue(dev->wq);
+	vfree(dev->ring);
+	dev->ring = NULL;
+}
+
 /* module initialization and cleanup */
 static int __init init(void)
 {
 	int i, err;
+	unsigned int size;
 
 	printk(KERN_INFO PFX "reading parameters\n");
 	err = read_params(DRIVER_NAME, &config);
@@ -144,10 +468,21 @@ static int __init init(void)
 		"initializing driver for %d (max %d) cards\n",
 		config.num_modules, VMOD_MAX_BOARDS);
 
-	/* fill in config data and semaphore */
+	if (ring_size <= 0) {
+		printk(KERN_ERR PFX "bad ring_size %d\n", ring_size);
+		return -EINVAL;
+	}
+	size = roundup_pow_of_two(ring_size);
+
+	/* fill in config data, semaphore and scan ring */
 	for (i = 0; i < config.num_modules; i++) {
 		device_list[i].config = &config.module[i];
 		init_MUTEX(&device_list[i].sem);
+		if (scan_init(&device_list[i], size) != 0) {
+			printk(KERN_ERR PFX
+				"could not allocate a %d samples ring\n", size);
+			goto fail_scan;
+		}
 	}
 
 	err = alloc_chrdev_region(&devno, 0, VMOD12E16_MAX_MODULES, DRIVER_NAME);
@@ -168,13 +503,20 @@ static int __init init(void)
 fail_cdev:	
 	unregister_chrdev_region(devno, VMOD12E16_MAX_MODULES);
 fail_chrdev:	
+fail_scan:
+	for (i = 0; i < config.num_modules; i++)
+		scan_exit(&device_list[i]);
 	return -1;
 }
 
 static void __exit exit(void)
 {
+	int i;
+
 	cdev_del(&cdev);
 	unregister_chrdev_region(devno, VMOD12E16_MAX_MODULES);
+	for (i = 0; i < config.num_modules; i++)
+		scan_exit(&device_list[i]);
 }
 
 
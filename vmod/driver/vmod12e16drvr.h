@@ -31,9 +31,74 @@ struct vmod12e16_conversion {
 	int data;               /**< digital value after conversion	*/
 };                             
 
+/**
+ * @brief user argument for ioctl VMOD12E16_IOCSCAN
+ *
+ * Starts a scan of the listed channels, one scan every period_us
+ * microseconds, each scan converting every channel in the list once.
+ * The samples are appended to the ring of the device, which is drained
+ * with read() or mapped with mmap(). A zero nscans runs until
+ * VMOD12E16_IOCSTOP or until the file that started the scan is closed.
+ */
+struct vmod12e16_scan {
+	int amplification;	/**< amplification factor (0..3) for all channels */
+	int nchans;		/**< number of entries in channels (1..16) */
+	unsigned char channels[16];	/**< analog channels to convert, in order */
+	unsigned int period_us;	/**< scan period in microseconds */
+	unsigned int nscans;	/**< number of scans, 0 for continuous */
+};
+
+/**
+ * @brief a timestamped sample from a scan
+ */
+struct vmod12e16_sample {
+	__u32 sec;		/**< conversion time, seconds */
+	__u32 nsec;		/**< conversion time, nanoseconds */
+	__u16 scan;		/**< scan number, modulo 2^16 */
+	__u8  channel;		/**< channel converted */
+	__u8  timeout;		/**< 1 if the conversion timed out */
+	__u16 data;		/**< digital value after conversion */
+	__u16 unused;
+};
+
+/**
+ * @brief scan ring header, the first bytes of the mmap() area
+ *
+ * The samples follow at VMOD12E16_RING_DATA offset. The driver
+ * advances head, the reader advances tail, both count samples and wrap
+ * at 2^32; the slot of a sample is its count modulo size. A read()
+ * advances tail too, so a device is drained by one method only.
+ * The scan state and counters are not in the mapping, they are read
+ * with VMOD12E16_IOCSCANSTATUS.
+ */
+struct vmod12e16_ring {
+	__u32 size;		/**< ring size in samples, a power of two */
+	__u32 head;		/**< samples produced (driver) */
+	__u32 tail;		/**< samples consumed (reader) */
+};
+
+/**
+ * @brief ioctl arg for VMOD12E16_IOCSCANSTATUS
+ */
+struct vmod12e16_scan_status {
+	__u32 size;		/**< ring size in samples */
+	__u32 head;		/**< samples produced */
+	__u32 tail;		/**< samples consumed */
+	__u32 running;		/**< 1 while a scan is in progress */
+	__u32 overruns;		/**< samples dropped on a full ring */
+	__u32 missed;		/**< scan periods missed, previous scan still busy */
+	__u32 scans;		/**< scans completed */
+	__u32 timeouts;		/**< conversions that timed out */
+};
+
+#define VMOD12E16_RING_DATA	64
+
 /* IOCTLS for this driver */
 #define VMOD12E16_IOCMAGIC	'm'
 #define	VMOD12E16_IOCSELECT	_IOW (VMOD12E16_IOCMAGIC, 1, struct vmod12e16_state)
 #define	VMOD12E16_IOCCONVERT	_IOWR(VMOD12E16_IOCMAGIC, 2, struct vmod12e16_conversion)
+#define	VMOD12E16_IOCSCAN	_IOW (VMOD12E16_IOCMAGIC, 3, struct vmod12e16_scan)
+#define	VMOD12E16_IOCSTOP	_IO  (VMOD12E16_IOCMAGIC, 4)
+#define	VMOD12E16_IOCSCANSTATUS	_IOR (VMOD12E16_IOCMAGIC, 5, struct vmod12e16_scan_status)
 
 #endif /* _VMOD12E16DRVR_H_ */
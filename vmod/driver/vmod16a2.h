@@ -1,3 +1,5 @@
+#include "dacstream.h"
+
 /* channels per card */
 #define	VMOD16A2_CHANNELS	2
 
@@ -37,3 +39,6 @@ struct vmod16a2_convert {
 
 #define	VMOD16A2_IOC_MAGIC	'J'
 #define	VMOD16A2_IOCPUT		_IOW(VMOD16A2_IOC_MAGIC, 2, struct vmod16a2_convert)
+#define	VMOD16A2_IOCSTREAM	_IOW(VMOD16A2_IOC_MAGIC, 3, struct vmod_dac_stream)
+#define	VMOD16A2_IOCSTOP	_IO(VMOD16A2_IOC_MAGIC, 4)
+#define	VMOD16A2_IOCSTREAMSTATUS	_IOR(VMOD16A2_IOC_MAGIC, 5, struct vmod_dac_stream_status)
@@ -20,6 +20,13 @@ static struct cdev cdev;
 /* module config tables */
 static struct vmod_devices 	config;
 
+/* per-module state, geographical info and waveform stream */
+struct vmod16a2_dev {
+	struct vmod_dev		*config;
+	struct dacstream	stream;
+};
+static struct vmod16a2_dev	device_list[VMOD16A2_MAX_MODULES];
+
 static int open(struct inode *ino, struct file *filp)
 {
 	unsigned int lun = iminor(ino);
@@ -30,12 +37,15 @@ static int open(struct inode *ino, struct file *filp)
 			"cannot open, invalid lun %d\n", lun);
 		return -EINVAL;
 	}
-	filp->private_data = &config.module[idx];
+	filp->private_data = &device_list[idx];
 	return 0;
 }
 
 static int release(struct inode *ino, struct file *filp)
 {
+	struct vmod16a2_dev *dev = filp->private_data;
+
+	dacstream_release(&dev->stream, filp);
 	return 0;
 }
 
@@ -60,20 +70,64 @@ static int do_output(struct vmod_dev *dev,
 	return 0;
 }
 
+static int do_stream(struct file *fp, struct vmod_dac_stream *arg)
+{
+	struct vmod16a2_dev *dev = fp->private_data;
+	struct vmod16a2_registers __iomem *regp = 
+		(struct vmod16a2_registers __iomem *)dev->config->address;
+
+	if (arg->channel == 0)
+		return dacstream_start(&dev->stream, fp, arg,
+				&regp->dac0in, &regp->ldac0);
+	else if (arg->channel == 1)
+		return dacstream_start(&dev->stream, fp, arg,
+				&regp->dac1in, &regp->ldac1);
+	printk(KERN_ERR PFX "invalid channel %d\n", arg->channel);
+	return -EINVAL;
+}
+
+static ssize_t write(struct file *fp, const char __user *buf,
+		size_t count, loff_t *offp)
+{
+	struct vmod16a2_dev *dev = fp->private_data;
+
+	return dacstream_write(&dev->stream, fp, buf, count);
+}
+
 static int ioctl(struct inode *inode,
 		struct file *fp,
 		unsigned op,
 		unsigned long arg)
 {
-	struct vmod_dev *devp = fp->private_data;
+	struct vmod16a2_dev *devp = fp->private_data;
 	struct vmod16a2_convert cvrt, *cvrtp = &cvrt;
+	struct vmod_dac_stream stream;
+	struct vmod_dac_stream_status status;
 
 	switch (op) {
 
 	case VMOD16A2_IOCPUT:
 		if (copy_from_user(cvrtp, (const void __user*)arg, sizeof(cvrt)) != 0)
 			return -EINVAL;
-		return do_output(devp, cvrtp);
+		return do_output(devp->config, cvrtp);
+		break;
+
+	case VMOD16A2_IOCSTREAM:
+		if (copy_from_user(&stream, (const void __user*)arg, sizeof(stream)) != 0)
+			return -EINVAL;
+		return do_stream(fp, &stream);
+		break;
+
+	case VMOD16A2_IOCSTOP:
+		dacstream_stop(&devp->stream);
+		return 0;
+		break;
+
+	case VMOD16A2_IOCSTREAMSTATUS:
+		dacstream_status(&devp->stream, &status);
+		if (copy_to_user((void __user*)arg, &status, sizeof(status)) != 0)
+			return -EINVAL;
+		return 0;
 		break;
 
 	default:
@@ -88,17 +142,22 @@ static struct file_operations vmod16a2_fops = {
 	.ioctl =    ioctl,
 	.open =     open,
 	.release =  release,
+	.write =    write,
 };
 
 /* module initialization and cleanup */
 static int __init init(void)
 {
-	int err;
+	int i, err;
 
 	printk(KERN_INFO PFX "initializing driver");
 	err = read_params(DRIVER_NAME, &config);
 	if (err != 0)
 		return -1;
+	for (i = 0; i < config.num_modules; i++) {
+		device_list[i].config = &config.module[i];
+		dacstream_init(&device_list[i].stream);
+	}
 
 	err = alloc_chrdev_region(&devno, 0, VMOD16A2_MAX_MODULES, DRIVER_NAME);
 	if (err != 0)
@@ -122,8 +181,12 @@ fail_chrdev:	return -1;
 
 static void __exit exit(void)
 {
+	int i;
+
 	cdev_del(&cdev);
 	unregister_chrdev_region(devno, VMOD16A2_MAX_MODULES);
+	for (i = 0; i < config.num_modules; i++)
+		dacstream_stop(&device_list[i].stream);
 }
 
 module_init(init);
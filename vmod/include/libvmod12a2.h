@@ -18,6 +18,8 @@
 #ifndef _LIBVMOD12A2_H_
 #define _LIBVMOD12A2_H_
 
+#include "dacstream.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +50,55 @@ int vmod12a2_get_handle(unsigned int lun);
  */
 int vmod12a2_convert(int fd, int channel, int datum);
 
+/**
+ * @brief start streaming a waveform to a channel
+ *
+ * The driver plays one sample every period_us microseconds from an
+ * hrtimer, out of two blocks of block_size samples each, so that one
+ * block is refilled with vmod12a2_stream_write() while the other one
+ * plays. The playback starts with the first block written. A period
+ * with no sample queued holds the output and counts an underrun,
+ * unless loop is set, in which case the last block is replayed until a
+ * new one is queued.
+ *
+ * @param  fd    	Device handle identifying board
+ * @param  channel    	Channel on the board to write to
+ * @param  period_us	Playback period in microseconds, at least
+ *			VMOD_DAC_STREAM_MIN_PERIOD (50us)
+ * @param  block_size	Samples per block, at most VMOD_DAC_STREAM_MAX_BLOCK
+ * @param  loop		Replay the last block while no new one is queued
+ *
+ * @return 0 on success, <0 on failure (errno EBUSY if already streaming,
+ *         EINVAL if the period is too short)
+ */
+int vmod12a2_stream_start(int fd, int channel, unsigned int period_us,
+	unsigned int block_size, int loop);
+
+/**
+ * @brief queue samples for a stream
+ *
+ * Blocks while both blocks are queued, unless the handle is
+ * non-blocking, and returns once all samples are queued.
+ *
+ * @param  fd    	Device handle identifying board
+ * @param  samples	Digital 12-bit values (0x000-0xfff)
+ * @param  n		Number of samples
+ *
+ * @return number of samples queued, <0 on failure
+ */
+int vmod12a2_stream_write(int fd, const unsigned short *samples, int n);
+
+/**
+ * @brief stop a stream, queued samples are dropped
+ */
+int vmod12a2_stream_stop(int fd);
+
+/**
+ * @brief get the stream counters: samples played and queued,
+ * underruns and late timer ticks
+ */
+int vmod12a2_stream_status(int fd, struct vmod_dac_stream_status *status);
+
 /**
  * @brief close a channel handle
  *
@@ -18,6 +18,8 @@
 #ifndef _LIBVMOD12E16_H_
 #define _LIBVMOD12E16_H_
 
+#include "vmod12e16drvr.h"
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -75,6 +77,65 @@ int vmod12e16_get_handle(unsigned int carrier_lun);
 int vmod12e16_convert(int fd, int channel,
 	enum vmod12e16_amplification factor, int *value);
 
+/**
+ * @brief start a streaming scan
+ *
+ * Convert the nchans channels listed in channels once every period_us
+ * microseconds, nscans times (0 for continuous), with the same
+ * amplification factor. The period must allow for the slowest
+ * conversion of every listed channel (32us each). The samples are
+ * read with vmod12e16_scan_read() or by mmap()ing the device ring,
+ * see struct vmod12e16_ring.
+ *
+ * @param  fd    	Device handle
+ * @param  channels	Channels to convert, in scan order
+ * @param  nchans	Number of channels (1..16)
+ * @param  factor	Amplification factor
+ * @param  period_us	Scan period in microseconds
+ * @param  nscans	Number of scans, 0 to run until stopped
+ *
+ * @return 0 on success, <0 on failure (errno EBUSY if a scan is running)
+ */
+int vmod12e16_scan_start(int fd, const int *channels, int nchans,
+	enum vmod12e16_amplification factor,
+	unsigned int period_us, unsigned int nscans);
+
+/**
+ * @brief read scan samples
+ *
+ * Blocks until at least one sample is available, unless the handle
+ * was opened O_NONBLOCK, and returns up to max samples.
+ *
+ * @return number of samples read, 0 when the scan is over and the
+ *         ring is empty, <0 on failure
+ */
+int vmod12e16_scan_read(int fd, struct vmod12e16_sample *samples, int max);
+
+/**
+ * @brief stop a streaming scan
+ */
+int vmod12e16_scan_stop(int fd);
+
+/**
+ * @brief get the scan counters: samples produced and consumed,
+ * overruns of the ring, missed scan periods and conversion timeouts
+ */
+int vmod12e16_scan_status(int fd, struct vmod12e16_scan_status *status);
+
+/**
+ * @brief bulk counterpart of vmod12e16_convert
+ *
+ * Run nscans scans of the listed channels at the given period and
+ * collect the nscans * nchans samples, in scan order, into samples.
+ *
+ * @return number of samples collected, less than nscans * nchans if
+ *         the ring overran, <0 on failure
+ */
+int vmod12e16_convert_bulk(int fd, const int *channels, int nchans,
+	enum vmod12e16_amplification factor,
+	unsigned int period_us, unsigned int nscans,
+	struct vmod12e16_sample *samples);
+
 /**
  *
  * @brief close a handle
@@ -9,6 +9,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <errno.h>
 #include "vmod12a2.h"
 #include "libvmod12a2.h"
 
@@ -22,7 +23,7 @@ int vmod12a2_get_handle(unsigned int lun)
 
 	/* open the device file */
 	snprintf(devname, filename_sz, "/dev/%s.%d", driver_name, lun);
-	fd = open(devname, O_RDONLY);
+	fd = open(devname, O_RDWR);
 	return fd;
 }
 
@@ -36,6 +37,46 @@ int vmod12a2_convert(int fd, int channel, int datum)
         return ioctl(fd, VMOD12A2_IOCPUT, &arg);
 }
 
+int vmod12a2_stream_start(int fd, int channel, unsigned int period_us,
+	unsigned int block_size, int loop)
+{
+	struct vmod_dac_stream	arg;
+
+	arg.channel    = channel;
+	arg.period_us  = period_us;
+	arg.block_size = block_size;
+	arg.flags      = loop ? VMOD_DAC_STREAM_LOOP : 0;
+	return ioctl(fd, VMOD12A2_IOCSTREAM, &arg);
+}
+
+int vmod12a2_stream_write(int fd, const unsigned short *samples, int n)
+{
+	int done;
+	ssize_t cc;
+
+	/* the driver takes at most one block per write */
+	for (done = 0; done < n; done += cc / sizeof(*samples)) {
+		cc = write(fd, &samples[done], (n - done) * sizeof(*samples));
+		if (cc < 0) {
+			if (errno == EINTR)
+				cc = 0;
+			else
+				return done ? done : -1;
+		}
+	}
+	return done;
+}
+
+int vmod12a2_stream_stop(int fd)
+{
+	return ioctl(fd, VMOD12A2_IOCSTOP);
+}
+
+int vmod12a2_stream_status(int fd, struct vmod_dac_stream_status *status)
+{
+	return ioctl(fd, VMOD12A2_IOCSTREAMSTATUS, status);
+}
+
 int vmod12a2_close(int fd)
 {
 	return close(fd);
@@ -10,6 +10,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include "vmod12e16drvr.h"
 #include "libvmod12e16.h"
 
@@ -38,6 +40,77 @@ int vmod12e16_convert(int fd, int channel,
 	return 0;
 }
 
+int vmod12e16_scan_start(int fd, const int *channels, int nchans,
+	enum vmod12e16_amplification factor,
+	unsigned int period_us, unsigned int nscans)
+{
+	struct vmod12e16_scan scan;
+	int i;
+
+	if (nchans < 1 || nchans > sizeof(scan.channels)) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&scan, 0, sizeof(scan));
+	scan.amplification = factor;
+	scan.nchans        = nchans;
+	scan.period_us     = period_us;
+	scan.nscans        = nscans;
+	for (i = 0; i < nchans; i++)
+		scan.channels[i] = channels[i];
+	return ioctl(fd, VMOD12E16_IOCSCAN, &scan);
+}
+
+int vmod12e16_scan_read(int fd, struct vmod12e16_sample *samples, int max)
+{
+	ssize_t n;
+
+	n = read(fd, samples, max * sizeof(struct vmod12e16_sample));
+	if (n < 0)
+		return -1;
+	return n / sizeof(struct vmod12e16_sample);
+}
+
+int vmod12e16_scan_stop(int fd)
+{
+	return ioctl(fd, VMOD12E16_IOCSTOP);
+}
+
+int vmod12e16_scan_status(int fd, struct vmod12e16_scan_status *status)
+{
+	return ioctl(fd, VMOD12E16_IOCSCANSTATUS, status);
+}
+
+int vmod12e16_convert_bulk(int fd, const int *channels, int nchans,
+	enum vmod12e16_amplification factor,
+	unsigned int period_us, unsigned int nscans,
+	struct vmod12e16_sample *samples)
+{
+	int want = nscans * nchans;
+	int got, n;
+
+	if (nscans == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (vmod12e16_scan_start(fd, channels, nchans, factor,
+			period_us, nscans) != 0)
+		return -1;
+
+	/* the read returns 0 once the scan is over and drained */
+	for (got = 0; got < want; got += n) {
+		n = vmod12e16_scan_read(fd, &samples[got], want - got);
+		if (n < 0) {
+			vmod12e16_scan_stop(fd);
+			return -1;
+		}
+		if (n == 0)
+			break;
+	}
+	vmod12e16_scan_stop(fd);
+	return got;
+}
+
 int vmod12e16_close(int fd)
 {
 	return close(fd);
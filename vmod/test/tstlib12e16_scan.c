@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "libvmod12e16.h"
+
+#define MAX_SAMPLES	(1<<16)
+
+static struct vmod12e16_sample samples[MAX_SAMPLES];
+
+int main(int argc, char *argv[])
+{
+	int lun, ampli, nchans, i, n;
+	unsigned int period, nscans;
+	int channels[16];
+	struct vmod12e16_scan_status status;
+	struct timeval t0, t1;
+	double secs;
+	int fd;
+
+	if (argc < 6) {
+		fprintf(stderr, "usage: %s lun ampli period_us nscans channel...\n", argv[0]);
+		return 1;
+	}
+
+	lun    = atoi(argv[1]);
+	ampli  = atoi(argv[2]);
+	period = strtoul(argv[3], NULL, 0);
+	nscans = strtoul(argv[4], NULL, 0);
+	nchans = argc - 5;
+	if (nchans > 16) {
+		fprintf(stderr, "at most 16 channels\n");
+		return 1;
+	}
+	for (i = 0; i < nchans; i++)
+		channels[i] = atoi(argv[5 + i]);
+	if (nscans * nchans > MAX_SAMPLES) {
+		fprintf(stderr, "at most %d samples\n", MAX_SAMPLES);
+		return 1;
+	}
+
+	fd = vmod12e16_get_handle(lun);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open handle for lun %d\n", lun);
+		return 1;
+	}
+
+	gettimeofday(&t0, NULL);
+	n = vmod12e16_convert_bulk(fd, channels, nchans, ampli,
+			period, nscans, samples);
+	gettimeofday(&t1, NULL);
+	if (n < 0) {
+		perror("vmod12e16_convert_bulk");
+		return 1;
+	}
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1000000.0;
+
+	for (i = 0; i < n; i++)
+		printf("%5d %u.%09u ch %2d %4d = %7.4f%s\n",
+			samples[i].scan, samples[i].sec, samples[i].nsec,
+			samples[i].channel, samples[i].data,
+			20.0*((float)samples[i].data/(1<<12)) - 10.0,
+			samples[i].timeout ? " timeout" : "");
+
+	memset(&status, 0, sizeof(status));
+	vmod12e16_scan_status(fd, &status);
+	printf("samples: %d in %.3fs (%.0f/s) scans: %u overruns: %u "
+		"missed: %u timeouts: %u\n",
+		n, secs, secs > 0.0 ? n / secs : 0.0, status.scans,
+		status.overruns, status.missed, status.timeouts);
+
+	vmod12e16_close(fd);
+	return 0;
+}
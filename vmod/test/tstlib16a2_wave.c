@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "libvmod16a2.h"
+
+/* VMOD 16A2 precision */
+#define VMOD_DAC_INPUT_RANGE (1<<16)
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: tstlib16a2_wave lun channel period_us points amplitude_volts [seconds]\n"
+		"       plays one sine period of the given number of points, looped\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int lun, channel, points, seconds, i, fd;
+	unsigned int period;
+	float volts;
+	unsigned short *wave;
+	struct vmod_dac_stream_status st;
+
+	if (argc != 6 && argc != 7) {
+		usage();
+		return 1;
+	}
+	lun     = atoi(argv[1]);
+	channel = atoi(argv[2]);
+	period  = strtoul(argv[3], NULL, 0);
+	points  = atoi(argv[4]);
+	volts   = atof(argv[5]);
+	seconds = argc == 7 ? atoi(argv[6]) : 10;
+	if (points <= 0 || points > VMOD_DAC_STREAM_MAX_BLOCK || volts < 0.0 || volts > 10.0) {
+		usage();
+		return 1;
+	}
+
+	wave = calloc(points, sizeof(*wave));
+	if (wave == NULL) {
+		perror("calloc");
+		return 1;
+	}
+	for (i = 0; i < points; i++) {
+		float v = volts * sin(2 * M_PI * i / points);
+		int d = VMOD_DAC_INPUT_RANGE * (v + 10.0) / 20.0;
+		wave[i] = d >= VMOD_DAC_INPUT_RANGE ? VMOD_DAC_INPUT_RANGE - 1 : d;
+	}
+
+	fd = vmod16a2_get_handle(lun);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open handle for lun %d\n", lun);
+		return 1;
+	}
+	if (vmod16a2_stream_start(fd, channel, period, points, 1) != 0) {
+		perror("vmod16a2_stream_start");
+		return 1;
+	}
+	if (vmod16a2_stream_write(fd, wave, points) != points) {
+		perror("vmod16a2_stream_write");
+		return 1;
+	}
+
+	for (i = 0; i < seconds; i++) {
+		sleep(1);
+		memset(&st, 0, sizeof(st));
+		vmod16a2_stream_status(fd, &st);
+		printf("played: %lu underruns: %lu missed: %lu\n",
+			st.played, st.underruns, st.missed);
+	}
+
+	vmod16a2_stream_stop(fd);
+	vmod16a2_close(fd);
+	free(wave);
+	return 0;
+}